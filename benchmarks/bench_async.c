@@ -2,6 +2,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/eventfd.h>
 
 #include <ev.h>
@@ -85,6 +86,86 @@ static void bench_evio_async(bool use_uring)
     pthread_cond_destroy(&ctx.cond);
 }
 
+// --- evio, multiple producers ---
+#define MP_PRODUCERS 16
+#define MP_PINGS (NUM_PINGS / MP_PRODUCERS)
+
+typedef struct evio_mp_ctx evio_mp_ctx;
+
+typedef struct {
+    evio_mp_ctx *ctx;
+    evio_async async;
+    _Atomic uint64_t stamp;
+    _Atomic size_t acked;
+} evio_mp_producer;
+
+struct evio_mp_ctx {
+    evio_loop *loop;
+    size_t done;
+    uint64_t latency;
+    evio_mp_producer producers[MP_PRODUCERS];
+};
+
+static void evio_mp_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_mp_producer *p = base->data;
+    evio_mp_ctx *ctx = p->ctx;
+
+    ctx->latency += get_time_ns() - atomic_load_explicit(&p->stamp, memory_order_acquire);
+    atomic_fetch_add_explicit(&p->acked, 1, memory_order_release);
+
+    if (++ctx->done == MP_PRODUCERS * MP_PINGS) {
+        evio_break(loop, EVIO_BREAK_ALL);
+    }
+}
+
+static void *evio_mp_thread(void *arg)
+{
+    evio_mp_producer *p = arg;
+    for (size_t i = 0; i < MP_PINGS; ++i) {
+        atomic_store_explicit(&p->stamp, get_time_ns(), memory_order_release);
+        evio_async_send(p->ctx->loop, &p->async);
+
+        while (atomic_load_explicit(&p->acked, memory_order_acquire) <= i) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+// Throughput against latency: wake-up moderation trades loop wake-ups for latency.
+static void bench_evio_async_mp(const char *name, evio_time max_delay, size_t min_batch)
+{
+    evio_mp_ctx *ctx = calloc(1, sizeof(*ctx));
+    ctx->loop = evio_loop_new(EVIO_FLAG_NONE);
+    evio_set_wake_moderation(ctx->loop, max_delay, min_batch);
+
+    for (size_t i = 0; i < MP_PRODUCERS; ++i) {
+        evio_mp_producer *p = &ctx->producers[i];
+        p->ctx = ctx;
+        evio_async_init(&p->async, evio_mp_cb);
+        p->async.data = p;
+        evio_async_start(ctx->loop, &p->async);
+    }
+
+    pthread_t threads[MP_PRODUCERS];
+    uint64_t start = get_time_ns();
+    for (size_t i = 0; i < MP_PRODUCERS; ++i) {
+        pthread_create(&threads[i], NULL, evio_mp_thread, &ctx->producers[i]);
+    }
+    evio_run(ctx->loop, EVIO_RUN_DEFAULT);
+    uint64_t end = get_time_ns();
+    for (size_t i = 0; i < MP_PRODUCERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    print_benchmark("async_mp_throughput", name, end - start, MP_PRODUCERS * MP_PINGS);
+    print_benchmark("async_mp_latency", name, ctx->latency, MP_PRODUCERS * MP_PINGS);
+
+    evio_loop_free(ctx->loop);
+    free(ctx);
+}
+
 // --- libev ---
 typedef struct {
     struct ev_loop *loop;
@@ -314,6 +395,9 @@ int main(void)
     print_versions();
     bench_evio_async(false);
     bench_evio_async(true);
+    bench_evio_async_mp("evio", 0, 0);
+    bench_evio_async_mp("evio-moderated-50us", EVIO_TIME_FROM_USEC(50), 0);
+    bench_evio_async_mp("evio-moderated-50us-batch8", EVIO_TIME_FROM_USEC(50), 8);
     bench_libev_async();
     bench_libevent_async();
     bench_libuv_async();
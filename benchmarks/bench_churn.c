@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -30,9 +31,9 @@ static void dummy_libuv_cb(uv_poll_t *w, int status, int events) {}
 static void dummy_libevent_cb(evutil_socket_t fd, short what, void *arg) {}
 
 // --- evio ---
-static void bench_evio_churn(int fds[NUM_WATCHERS], bool use_uring)
+static double bench_evio_churn(int fds[NUM_WATCHERS], const char *name, int flags)
 {
-    evio_loop *loop = evio_loop_new(use_uring ? EVIO_FLAG_URING : EVIO_FLAG_NONE);
+    evio_loop *loop = evio_loop_new(flags);
     evio_poll io[NUM_WATCHERS];
 
     for (size_t i = 0; i < NUM_WATCHERS; ++i) {
@@ -53,10 +54,10 @@ static void bench_evio_churn(int fds[NUM_WATCHERS], bool use_uring)
     }
     uint64_t end = get_time_ns();
 
-    const char *name = use_uring ? "evio-uring" : "evio";
     print_benchmark("poll_churn", name, end - start, NUM_ITERATIONS * NUM_WATCHERS * 2);
 
     evio_loop_free(loop);
+    return (double)(end - start) / (NUM_ITERATIONS * NUM_WATCHERS * 2);
 }
 
 // --- libev ---
@@ -170,8 +171,16 @@ int main(void)
         fds[i] = pipes[i][0];
     }
 
-    bench_evio_churn(fds, false);
-    bench_evio_churn(fds, true);
+    double epoll = bench_evio_churn(fds, "evio", EVIO_FLAG_NONE);
+    double uring = bench_evio_churn(fds, "evio-uring", EVIO_FLAG_URING);
+    double single = bench_evio_churn(fds, "evio-uring-single",
+                                     EVIO_FLAG_URING | EVIO_FLAG_SINGLE_THREAD);
+    double sqpoll = bench_evio_churn(fds, "evio-uring-sqpoll", EVIO_FLAG_SQPOLL);
+
+    // Per-op delta of the io_uring paths against plain epoll_ctl calls
+    printf("poll_churn delta: evio-uring %+.2f ns, evio-uring-single %+.2f ns, "
+           "evio-uring-sqpoll %+.2f ns\n\n",
+           uring - epoll, single - epoll, sqpoll - epoll);
 
     bench_libev_churn(fds);
     bench_libevent_churn(fds);
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "evio.h"
+#include "bench.h"
+
+#define BUF_SIZE (4 * 1024 * 1024)
+#define PASSES 50
+
+static const char *const kernel_names[] = {
+    [EVIO_FRAME_SCALAR] = "scalar",
+    [EVIO_FRAME_SSE2]   = "sse2",
+    [EVIO_FRAME_AVX2]   = "avx2",
+};
+
+static uint64_t get_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Lines of 0 to 1023 bytes, as in a text protocol with mixed message sizes.
+static size_t fill_lines(uint8_t *buf, size_t size)
+{
+    size_t len = 0;
+    uint32_t seed = 12345;
+    for (;;) {
+        seed = seed * 1103515245 + 12345;
+        size_t n = (seed >> 16) % 1024;
+        if (len + n + 1 > size) {
+            return len;
+        }
+        memset(buf + len, 'a' + (int)(n % 26), n);
+        buf[len + n] = '\n';
+        len += n + 1;
+    }
+}
+
+static void bench_frame_delim(const uint8_t *buf, size_t len, int simd)
+{
+    evio_frame f;
+    evio_frame_init_delim(&f, '\n', SIZE_MAX - 1);
+    if (!evio_frame_set_simd(&f, simd)) {
+        return;
+    }
+
+    size_t frames = 0;
+    size_t bytes = 0;
+
+    uint64_t start = get_time_ns();
+    uint64_t cycles = get_cycles();
+    for (size_t pass = 0; pass < PASSES; ++pass) {
+        const void *frame;
+        size_t size;
+        size_t off = 0;
+        size_t n;
+        while ((n = evio_frame_parse(&f, buf + off, len - off, &frame, &size))) {
+            bytes += size;
+            off += n;
+            ++frames;
+        }
+    }
+    cycles = get_cycles() - cycles;
+    uint64_t end = get_time_ns();
+
+    if (bytes == 0) {
+        return;
+    }
+
+    print_benchmark("frame_delim", kernel_names[simd], end - start, frames);
+    printf("BENCHMARK: frame_delim_%s_gbps: %.2f GB/s\n", kernel_names[simd],
+           (double)(len * PASSES) / (double)(end - start));
+    if (cycles) {
+        printf("BENCHMARK: frame_delim_%s_bpc: %.2f bytes/cycle\n", kernel_names[simd],
+               (double)(len * PASSES) / (double)cycles);
+    }
+}
+
+static void bench_frame_varint(const uint8_t *buf, size_t len)
+{
+    evio_frame f;
+    evio_frame_init_varint(&f, SIZE_MAX);
+
+    size_t frames = 0;
+    uint64_t start = get_time_ns();
+    uint64_t cycles = get_cycles();
+    for (size_t pass = 0; pass < PASSES; ++pass) {
+        const void *frame;
+        size_t size;
+        size_t off = 0;
+        size_t n;
+        while ((n = evio_frame_parse(&f, buf + off, len - off, &frame, &size))) {
+            off += n;
+            ++frames;
+        }
+    }
+    cycles = get_cycles() - cycles;
+    uint64_t end = get_time_ns();
+
+    print_benchmark("frame_varint", "evio", end - start, frames);
+    if (cycles) {
+        printf("BENCHMARK: frame_varint_bpc: %.2f bytes/cycle\n",
+               (double)(len * PASSES) / (double)cycles);
+    }
+}
+
+// The same line sizes, each behind a varint length prefix.
+static size_t fill_varint(uint8_t *buf, size_t size)
+{
+    size_t len = 0;
+    uint32_t seed = 12345;
+    for (;;) {
+        seed = seed * 1103515245 + 12345;
+        size_t n = (seed >> 16) % 1024;
+        if (len + n + 2 > size) {
+            return len;
+        }
+        if (n < 0x80) {
+            buf[len++] = (uint8_t)n;
+        } else {
+            buf[len++] = (uint8_t)(n | 0x80);
+            buf[len++] = (uint8_t)(n >> 7);
+        }
+        memset(buf + len, 'a' + (int)(n % 26), n);
+        len += n;
+    }
+}
+
+int main(void)
+{
+    print_versions();
+
+    uint8_t *buf = evio_malloc(BUF_SIZE);
+    size_t len = fill_lines(buf, BUF_SIZE);
+    bench_frame_delim(buf, len, EVIO_FRAME_SCALAR);
+    bench_frame_delim(buf, len, EVIO_FRAME_SSE2);
+    bench_frame_delim(buf, len, EVIO_FRAME_AVX2);
+
+    len = fill_varint(buf, BUF_SIZE);
+    bench_frame_varint(buf, len);
+
+    evio_free(buf);
+    return EXIT_SUCCESS;
+}
@@ -112,6 +112,83 @@ static void bench_evio_poll(bool use_uring)
     close(fds[1]);
 }
 
+// --- evio (edge-triggered) ---
+// Both watchers stay registered with EVIO_EDGE: no epoll_ctl() per ping.
+// The reader drains until EAGAIN and writes the next batch itself; the
+// writer watcher only resumes a batch that hit EAGAIN.
+static void evio_et_write_batch(evio_loop *loop, evio_poll_ctx *ctx)
+{
+    while (ctx->writes < NUM_PINGS && ctx->writes - ctx->reads < BATCH) {
+        size_t todo = NUM_PINGS - ctx->writes;
+        if (todo > BATCH) {
+            todo = BATCH;
+        }
+        size_t bytes = todo * MSG_SIZE;
+        memset(ctx->buf, 'p', bytes);
+        if (write(ctx->write_fd, ctx->buf, bytes) <= 0) {
+            break;
+        }
+        ctx->writes += todo;
+    }
+}
+
+static void evio_et_read_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_poll_ctx *ctx = (evio_poll_ctx *)base->data;
+    for (;;) {
+        ssize_t n = read(ctx->read_fd, ctx->buf, sizeof(ctx->buf));
+        if (n <= 0) {
+            break;
+        }
+        ctx->read_accum += (size_t)n;
+        size_t msgs = ctx->read_accum / MSG_SIZE;
+        ctx->reads += msgs;
+        ctx->read_accum -= msgs * MSG_SIZE;
+    }
+    if (ctx->reads >= NUM_PINGS) {
+        evio_break(loop, EVIO_BREAK_ALL);
+        return;
+    }
+    evio_et_write_batch(loop, ctx);
+}
+
+static void evio_et_write_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_et_write_batch(loop, (evio_poll_ctx *)base->data);
+}
+
+static void bench_evio_poll_edge(bool use_uring)
+{
+    int fds[2] = { -1, -1 };
+    pipe(fds);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+    evio_loop *loop = evio_loop_new(use_uring ? EVIO_FLAG_URING : EVIO_FLAG_NONE);
+
+    evio_poll_ctx ctx = {
+        .read_fd = fds[0],
+        .write_fd = fds[1],
+    };
+
+    evio_poll_init(&ctx.reader_watcher, evio_et_read_cb, ctx.read_fd, EVIO_READ | EVIO_EDGE);
+    ctx.reader_watcher.data = &ctx;
+
+    evio_poll_init(&ctx.writer_watcher, evio_et_write_cb, ctx.write_fd, EVIO_WRITE | EVIO_EDGE);
+    ctx.writer_watcher.data = &ctx;
+
+    uint64_t start = get_time_ns();
+    evio_poll_start(loop, &ctx.reader_watcher);
+    evio_poll_start(loop, &ctx.writer_watcher);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    uint64_t end = get_time_ns();
+
+    print_benchmark("poll_ping_pong", use_uring ? "evio-uring-et" : "evio-et", end - start, NUM_PINGS);
+    evio_loop_free(loop);
+    close(fds[0]);
+    close(fds[1]);
+}
+
 // --- libev ---
 typedef struct {
     ev_io reader_watcher;
@@ -402,6 +479,8 @@ int main(void)
     print_versions();
     bench_evio_poll(false);
     bench_evio_poll(true);
+    bench_evio_poll_edge(false);
+    bench_evio_poll_edge(true);
     bench_libev_poll();
     bench_libevent_poll();
     bench_libuv_poll();
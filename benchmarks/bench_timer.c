@@ -281,6 +281,48 @@ static void bench_libevent_timer_many_active(void)
     event_base_free(base);
 }
 
+// Many timers spread over simulated time (heap cost without clock noise).
+#define NUM_SPREAD_TIMERS 50000
+#define SPREAD_STEP EVIO_TIME_FROM_MSEC(1)
+#define SPREAD_ADVANCE EVIO_TIME_FROM_MSEC(100)
+
+// --- evio ---
+static void evio_spread_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    size_t *count = base->data;
+    ++(*count);
+}
+
+static void bench_evio_timer_virtual_spread(void)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    evio_set_clockid(loop, EVIO_CLOCK_VIRTUAL);
+
+    evio_timer *timers = evio_calloc(NUM_SPREAD_TIMERS, sizeof(evio_timer));
+
+    size_t count = 0;
+    uint32_t seed = 1;
+
+    uint64_t start = get_time_ns();
+    for (size_t i = 0; i < NUM_SPREAD_TIMERS; ++i) {
+        // Deadlines in pseudo-random order, up to NUM_SPREAD_TIMERS steps ahead.
+        seed = seed * 1103515245u + 12345u;
+        evio_timer_init(&timers[i], evio_spread_cb, 0);
+        evio_timer_start(loop, &timers[i], SPREAD_STEP * (1 + (seed >> 8) % NUM_SPREAD_TIMERS));
+        timers[i].data = &count;
+    }
+
+    while (evio_run(loop, EVIO_RUN_NOWAIT)) {
+        evio_step_time(loop, SPREAD_ADVANCE);
+    }
+    uint64_t end = get_time_ns();
+
+    print_benchmark("timer_virtual_spread", "evio", end - start, NUM_SPREAD_TIMERS);
+
+    evio_free(timers);
+    evio_loop_free(loop);
+}
+
 int main(void)
 {
     print_versions();
@@ -299,5 +341,9 @@ int main(void)
     bench_libevent_timer_many_active();
     bench_libuv_timer_many_active();
 
+    printf("\n");
+
+    bench_evio_timer_virtual_spread();
+
     return EXIT_SUCCESS;
 }
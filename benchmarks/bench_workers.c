@@ -151,6 +151,7 @@ struct evio_worker {
     unsigned int conns;
     unsigned int k;
     bool use_uring;
+    evio_mask mode;
 
     evio_loop *loop;
     evio_async async;
@@ -167,7 +168,7 @@ struct evio_worker {
 
 static void evio_conn_update_events(evio_loop *loop, evio_conn *c)
 {
-    evio_mask want = EVIO_READ | (c->out_pending ? EVIO_WRITE : 0);
+    evio_mask want = EVIO_READ | (c->out_pending ? EVIO_WRITE : 0) | c->w->mode;
     if (!c->want_write && (want & EVIO_WRITE)) {
         c->want_write = true;
         evio_poll_change(loop, &c->io, c->srv_fd, want);
@@ -240,7 +241,7 @@ static void evio_conn_reopen(evio_loop *loop, evio_conn *c)
     c->cli_recv_accum = 0;
     c->want_write = false;
 
-    evio_poll_change(loop, &c->io, c->srv_fd, EVIO_READ);
+    evio_poll_change(loop, &c->io, c->srv_fd, EVIO_READ | c->w->mode);
 
     close(old_srv);
     close(old_cli);
@@ -282,7 +283,7 @@ static void *evio_workers_thread(void *ptr)
         c->cli_recv_accum = 0;
         c->want_write = false;
 
-        evio_poll_init(&c->io, evio_conn_cb, c->srv_fd, EVIO_READ);
+        evio_poll_init(&c->io, evio_conn_cb, c->srv_fd, EVIO_READ | w->mode);
         c->io.data = c;
         evio_poll_start(w->loop, &c->io);
     }
@@ -382,7 +383,8 @@ static void *evio_workers_thread(void *ptr)
     return NULL;
 }
 
-static void bench_evio_workers(unsigned int workers, unsigned int conns, unsigned int k, bool use_uring)
+static void bench_evio_workers(unsigned int workers, unsigned int conns, unsigned int k,
+                               bool use_uring, evio_mask mode)
 {
     pthread_barrier_t ready;
     pthread_barrier_t start;
@@ -412,6 +414,7 @@ static void bench_evio_workers(unsigned int workers, unsigned int conns, unsigne
         w[i].conns = conns;
         w[i].k = k;
         w[i].use_uring = use_uring;
+        w[i].mode = mode;
         w[i].msgs_target = (uint64_t)conns * MSGS_PER_CONN;
         if (pthread_create(&w[i].thr, NULL, evio_workers_thread, &w[i]) != 0) {
             abort();
@@ -433,7 +436,9 @@ static void bench_evio_workers(unsigned int workers, unsigned int conns, unsigne
     pthread_barrier_destroy(&finish);
 
     uint64_t ops = (uint64_t)workers * (uint64_t)conns * MSGS_PER_CONN;
-    print_benchmark("workers", use_uring ? "evio-uring" : "evio", end_ns - start_ns, ops);
+    const char *name = use_uring ? (mode ? "evio-uring-lazy" : "evio-uring")
+                                 : (mode ? "evio-lazy" : "evio");
+    print_benchmark("workers", name, end_ns - start_ns, ops);
     free(w);
 }
 
@@ -1474,8 +1479,10 @@ int main(void)
         conns = 1;
     }
 
-    bench_evio_workers(workers, conns, k, false);
-    bench_evio_workers(workers, conns, k, true);
+    bench_evio_workers(workers, conns, k, false, 0);
+    bench_evio_workers(workers, conns, k, true, 0);
+    bench_evio_workers(workers, conns, k, false, EVIO_LAZY);
+    bench_evio_workers(workers, conns, k, true, EVIO_LAZY);
     bench_libev_workers(workers, conns, k);
     bench_libevent_workers(workers, conns, k);
     bench_libuv_workers(workers, conns, k);
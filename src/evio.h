@@ -163,12 +163,17 @@ enum evio_event_mask {
     EVIO_CLEANUP    = 0x200, /**< A cleanup phase event. */
     EVIO_ONCE       = 0x400, /**< A one-shot poll or timer event occurred. */
     EVIO_ERROR      = 0x800, /**< An error occurred on a watcher. */
+    EVIO_EDGE       = 0x1000, /**< Edge-triggered registration for poll watchers. */
+    EVIO_LAZY       = 0x2000, /**< Lazy write interest for poll watchers (implies `EVIO_EDGE`). */
+    EVIO_EXCLUSIVE  = 0x4000, /**< Exclusive wake-up registration for poll watchers. */
 };
 
 /** @brief Flags for `evio_loop_new` to customize loop creation. */
 enum evio_loop_flags {
-    EVIO_FLAG_NONE  = 0x000, /**< Default flags. */
-    EVIO_FLAG_URING = 0x001, /**< Use io_uring to optimize `epoll_ctl` syscalls if available. */
+    EVIO_FLAG_NONE          = 0x000, /**< Default flags. */
+    EVIO_FLAG_URING         = 0x001, /**< Use io_uring to optimize `epoll_ctl` syscalls if available. */
+    EVIO_FLAG_SINGLE_THREAD = 0x002, /**< Only the creating thread uses the loop (io_uring single-issuer mode). */
+    EVIO_FLAG_SQPOLL        = 0x004, /**< Submit io_uring operations from a kernel polling thread (implies `EVIO_FLAG_URING`). */
 };
 
 /** @brief Flags for `evio_run` to control loop execution. */
@@ -359,5 +364,19 @@ void evio_invoke(evio_loop *loop, evio_base *base, evio_mask emask)
 #include "evio_check.h"
 #include "evio_cleanup.h"
 #include "evio_once.h"
+#include "evio_accept.h"
+#include "evio_zsend.h"
+#include "evio_relay.h"
+#include "evio_fs.h"
+#include "evio_dgram.h"
+#include "evio_stream.h"
+#include "evio_cork.h"
+#include "evio_frame.h"
+#include "evio_pacer.h"
+#include "evio_child.h"
+#include "evio_mt.h"
+#include "evio_watchdog.h"
+#include "evio_recorder.h"
+#include "evio_trace.h"
 
 // IWYU pragma: end_exports
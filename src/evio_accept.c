@@ -0,0 +1,348 @@
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include "evio_core.h"
+#include "evio_accept.h"
+
+#ifndef EVIO_ACCEPT_BATCH
+/** @brief The maximum number of connections accepted per wake-up. */
+#define EVIO_ACCEPT_BATCH 64
+#endif
+
+#ifndef EVIO_ACCEPT_RESERVE
+/** @brief The number of fds below `RLIMIT_NOFILE` kept free for other uses. */
+#define EVIO_ACCEPT_RESERVE 16
+#endif
+
+#ifndef EVIO_ACCEPT_RETRY
+/** @brief The delay before a paused accept watcher retries. */
+#define EVIO_ACCEPT_RETRY EVIO_TIME_FROM_MSEC(100)
+#endif
+
+/** @brief The flags for accepted sockets. */
+#define EVIO_ACCEPT_FLAGS (SOCK_NONBLOCK | SOCK_CLOEXEC)
+
+/** @brief The multishot accept request of an accept watcher. */
+struct evio_accept_uring {
+    evio_uring_req req;     /**< The io_uring request. */
+    evio_accept *w;         /**< The owning watcher, or `NULL` once stopped. */
+    bool pause;             /**< Pause when the request terminates. */
+    bool unsupported;       /**< Multishot accept is unavailable: use epoll. */
+};
+
+/**
+ * @brief Checks if an accept error means the process is out of resources.
+ * @param err The error number.
+ * @return `true` if accepting should pause and retry later.
+ */
+static bool evio_accept_exhausted(int err)
+{
+    return err == EMFILE || err == ENFILE || err == ENOBUFS || err == ENOMEM;
+}
+
+/**
+ * @brief Checks if an accept error only affects the connection being accepted.
+ * @details Linux passes pending network errors of the new socket to `accept4`.
+ * @param err The error number.
+ * @return `true` if accepting can continue.
+ */
+static bool evio_accept_transient(int err)
+{
+    switch (err) {
+        case EINTR:
+        case ECONNABORTED:
+        case EPROTO:
+        case ENOPROTOOPT:
+        case EHOSTDOWN:
+        case ENONET:
+        case EHOSTUNREACH:
+        case ENETDOWN:
+        case ENETUNREACH:
+        case EOPNOTSUPP:
+        case ETIMEDOUT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Queues an accepted connection.
+ * @param w The accept watcher.
+ * @param fd The connected socket.
+ */
+static void evio_accept_push(evio_accept *w, int fd)
+{
+    w->fds = evio_list_ensure(w->fds, sizeof(*w->fds), w->count + 1, &w->total);
+    w->fds[w->count++] = fd;
+}
+
+/**
+ * @brief Arms the watcher: multishot accept if available, epoll otherwise.
+ * @param loop The event loop.
+ * @param w The accept watcher.
+ */
+static void evio_accept_arm(evio_loop *loop, evio_accept *w)
+{
+    struct evio_accept_uring *u = w->uring;
+
+    if (u && !u->unsupported) {
+        if (evio_uring_accept(loop, &u->req, w->io.fd, EVIO_ACCEPT_FLAGS)) {
+            return;
+        }
+        u->unsupported = true; // GCOVR_EXCL_LINE
+    }
+
+    // The accept watcher holds the loop reference.
+    evio_poll_start(loop, &w->io);
+    evio_unref(loop);
+}
+
+/**
+ * @brief Pauses accepting until the retry timer fires.
+ * @param loop The event loop.
+ * @param w The accept watcher.
+ */
+static void evio_accept_pause(evio_loop *loop, evio_accept *w)
+{
+    if (w->io.active) {
+        evio_ref(loop);
+        evio_poll_stop(loop, &w->io);
+    }
+
+    if (!w->tm.active) {
+        evio_timer_start(loop, &w->tm, EVIO_ACCEPT_RETRY);
+        evio_unref(loop);
+    }
+}
+
+/**
+ * @brief Stops the watcher after the listening socket failed.
+ * @param loop The event loop.
+ * @param w The accept watcher.
+ */
+static void evio_accept_fail(evio_loop *loop, evio_accept *w)
+{
+    evio_accept_stop(loop, w);
+    evio_queue_event(loop, &w->base, EVIO_READ | EVIO_ERROR);
+}
+
+/**
+ * @brief Internal callback for the listening socket poll watcher.
+ * @details Accepts up to `EVIO_ACCEPT_BATCH` connections, then invokes the
+ * user callback if any connection is queued.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_poll` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_accept_poll_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_accept *w = container_of(base, evio_accept, io.base);
+
+    if (__evio_unlikely(emask & EVIO_ERROR)) {
+        // The poll watcher was stopped, keep the refcount balanced.
+        evio_ref(loop);
+        evio_accept_fail(loop, w);
+        return;
+    }
+
+    for (size_t i = 0; i < EVIO_ACCEPT_BATCH; ++i) {
+        int fd = accept4(w->io.fd, NULL, NULL, EVIO_ACCEPT_FLAGS);
+        if (__evio_unlikely(fd < 0)) {
+            int err = errno;
+            if (err == EAGAIN) {
+                break;
+            }
+            if (evio_accept_transient(err)) {
+                continue;
+            }
+            if (evio_accept_exhausted(err)) {
+                evio_accept_pause(loop, w);
+                break;
+            }
+            evio_accept_fail(loop, w);
+            return;
+        }
+
+        evio_accept_push(w, fd);
+
+        if (__evio_unlikely(fd >= w->limit)) {
+            evio_accept_pause(loop, w);
+            break;
+        }
+    }
+
+    if (w->head < w->count) {
+        w->cb(loop, &w->base, EVIO_READ);
+    }
+}
+
+/**
+ * @brief Internal callback for the retry timer.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_timer` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_accept_timer_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_accept *w = container_of(base, evio_accept, tm.base);
+
+    // The timer was stopped, keep the refcount balanced.
+    evio_ref(loop);
+    evio_accept_arm(loop, w);
+}
+
+/**
+ * @brief Completion callback of the multishot accept request.
+ * @param loop The event loop.
+ * @param req The io_uring request.
+ * @param res The accepted fd, or a negative error code.
+ * @param more `true` if the request stays armed.
+ */
+static void evio_accept_uring_cb(evio_loop *loop, evio_uring_req *req, int res, bool more)
+{
+    struct evio_accept_uring *u = container_of(req, struct evio_accept_uring, req);
+    evio_accept *w = u->w;
+
+    if (__evio_unlikely(!w)) {
+        // Stopped while the request was being canceled.
+        if (res >= 0) {
+            close(res);
+        }
+        return;
+    }
+
+    if (res >= 0) {
+        evio_accept_push(w, res);
+        evio_queue_event(loop, &w->base, EVIO_READ);
+
+        if (__evio_unlikely(res >= w->limit) && more && !u->pause) {
+            u->pause = true;
+            evio_uring_cancel(loop, req, false);
+        }
+    }
+
+    if (more) {
+        return;
+    }
+
+    if (__evio_unlikely(res == -EINVAL)) {
+        // GCOVR_EXCL_START
+        u->unsupported = true;
+        evio_accept_arm(loop, w);
+        return;
+        // GCOVR_EXCL_STOP
+    }
+
+    if (u->pause || evio_accept_exhausted(-res)) {
+        u->pause = false;
+        evio_accept_pause(loop, w);
+        return;
+    }
+
+    if (res >= 0 || evio_accept_transient(-res) || res == -ECANCELED) {
+        evio_accept_arm(loop, w);
+        return;
+    }
+
+    evio_accept_fail(loop, w);
+}
+
+void evio_accept_init(evio_accept *w, evio_cb cb, int fd)
+{
+    evio_init(&w->base, cb);
+    evio_poll_init(&w->io, evio_accept_poll_cb, fd, EVIO_READ | EVIO_EXCLUSIVE);
+    evio_timer_init(&w->tm, evio_accept_timer_cb, 0);
+    w->uring = NULL;
+    w->fds = NULL;
+    w->head = 0;
+    w->count = 0;
+    w->total = 0;
+    w->limit = INT_MAX;
+}
+
+void evio_accept_start(evio_loop *loop, evio_accept *w)
+{
+    if (__evio_unlikely(w->active)) {
+        return;
+    }
+
+    // This takes one ref for the accept watcher itself.
+    evio_list_start(loop, &w->base, &loop->accept, true);
+
+    w->limit = INT_MAX;
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 &&
+        rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < (rlim_t)INT_MAX) {
+        w->limit = rl.rlim_cur > EVIO_ACCEPT_RESERVE ?
+                   (int)(rl.rlim_cur - EVIO_ACCEPT_RESERVE) : 0;
+    }
+
+    if (loop->iou) {
+        w->uring = evio_malloc(sizeof(*w->uring));
+        *w->uring = (struct evio_accept_uring) {
+            .req.cb = evio_accept_uring_cb,
+            .w      = w,
+        };
+    }
+
+    evio_accept_arm(loop, w);
+}
+
+void evio_accept_stop(evio_loop *loop, evio_accept *w)
+{
+    evio_clear_pending(loop, &w->base);
+    evio_clear_pending(loop, &w->io.base);
+    evio_clear_pending(loop, &w->tm.base);
+
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    struct evio_accept_uring *u = w->uring;
+    if (u) {
+        w->uring = NULL;
+        u->w = NULL;
+        evio_uring_cancel(loop, &u->req, true);
+        evio_free(u);
+    }
+
+    // The ref/unref pairs keep the refcount balanced for the sub-watchers,
+    // which do not hold a reference of their own.
+    if (w->io.active) {
+        evio_ref(loop);
+        evio_poll_stop(loop, &w->io);
+    }
+
+    if (w->tm.active) {
+        evio_ref(loop);
+        evio_timer_stop(loop, &w->tm);
+    }
+
+    for (size_t i = w->head; i < w->count; ++i) {
+        close(w->fds[i]);
+    }
+
+    evio_free(w->fds);
+    w->fds = NULL;
+    w->head = 0;
+    w->count = 0;
+    w->total = 0;
+
+    // This stops the accept watcher and performs the final unref.
+    evio_list_stop(loop, &w->base, &loop->accept, true);
+}
+
+int evio_accept_next(evio_accept *w)
+{
+    if (w->head == w->count) {
+        w->head = 0;
+        w->count = 0;
+        return -1;
+    }
+
+    return w->fds[w->head++];
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+/**
+ * @file evio_accept.h
+ * @brief A watcher that accepts connections on a listening socket.
+ * @details Built for several loops sharing one listening socket: the socket
+ * is registered with `EVIO_EXCLUSIVE`, so a new connection wakes one loop
+ * instead of all of them, and each wake-up drains a bounded batch of
+ * `accept4` calls. On loops created with `EVIO_FLAG_URING`, a multishot
+ * accept request is used instead where the kernel supports it.
+ *
+ * When the process runs out of file descriptors (or is close to the
+ * `RLIMIT_NOFILE` soft limit), the watcher pauses and retries after a short
+ * delay instead of spinning on a listening socket that stays readable.
+ */
+
+#include "evio.h"
+
+struct evio_accept_uring;
+
+/** @brief A watcher that accepts connections on a listening socket. */
+typedef struct evio_accept {
+    EVIO_BASE;
+    evio_poll io;       /**< @private The listening socket poll watcher. */
+    evio_timer tm;      /**< @private The retry timer while paused. */
+    struct evio_accept_uring *uring; /**< @private The multishot accept request, if any. */
+    int *fds;           /**< @private Accepted connections not taken yet. */
+    size_t head;        /**< @private Index of the next connection to take. */
+    size_t count;       /**< @private Number of entries in `fds`. */
+    size_t total;       /**< @private Capacity of `fds`. */
+    int limit;          /**< @private The fd number at which accepting pauses. */
+} evio_accept;
+
+/**
+ * @brief Initializes an accept watcher.
+ * @details The callback receives `EVIO_READ` when connections are available,
+ * to be taken with `evio_accept_next`. If the listening socket fails,
+ * the watcher is stopped and the callback receives `EVIO_ERROR`.
+ * @param w The accept watcher to initialize.
+ * @param cb The callback to invoke when connections are accepted.
+ * @param fd The listening socket (non-blocking).
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_accept_init(evio_accept *w, evio_cb cb, int fd);
+
+/**
+ * @brief Starts an accept watcher.
+ * @param loop The event loop.
+ * @param w The accept watcher to start.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_accept_start(evio_loop *loop, evio_accept *w);
+
+/**
+ * @brief Stops an accept watcher.
+ * @details Connections accepted but not taken yet are closed.
+ * @param loop The event loop.
+ * @param w The accept watcher to stop.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_accept_stop(evio_loop *loop, evio_accept *w);
+
+/**
+ * @brief Takes the next accepted connection.
+ * @details Connections are non-blocking and close-on-exec, and owned by the
+ * caller once taken. Connections not taken in the callback stay queued.
+ * @param w The accept watcher.
+ * @return The connected socket, or -1 if none is queued.
+ */
+__evio_public __evio_nonnull(1) __evio_nodiscard
+int evio_accept_next(evio_accept *w);
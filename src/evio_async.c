@@ -1,6 +1,25 @@
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
 #include "evio_core.h"
 #include "evio_async.h"
 
+/**
+ * @brief Internal callback for the wake-up moderation timer.
+ * @details The expired timer only wakes the loop; the sends are processed
+ * through `event_pending` like any other wake-up.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_poll` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_async_wake_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    uint64_t expirations;
+    ssize_t res = read(loop->wake.fd, &expirations, sizeof(expirations));
+    (void)res;
+}
+
 void evio_async_start(evio_loop *loop, evio_async *w)
 {
     if (__evio_unlikely(w->active)) {
@@ -22,7 +41,34 @@ void evio_async_send(evio_loop *loop, evio_async *w)
 {
     atomic_store_explicit(&w->status.value, 1, memory_order_release);
 
-    if (!atomic_exchange_explicit(&loop->async_pending.value, 1, memory_order_acq_rel)) {
-        evio_eventfd_write(loop);
+    const bool first = !atomic_exchange_explicit(&loop->async_pending.value, 1, memory_order_acq_rel);
+
+    if (__evio_unlikely(atomic_load_explicit(&loop->wake_delay.value, memory_order_acquire))) {
+        evio_eventfd_moderate(loop);
+    } else if (first) {
+        evio_eventfd_send(loop);
     }
 }
+
+void evio_set_wake_moderation(evio_loop *loop, evio_time max_delay, size_t min_batch)
+{
+    // Once started, the timer watcher stays active until the loop is freed:
+    // a send racing with disabling moderation may still arm the timer.
+    if (max_delay && !loop->wake.active) {
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        // GCOVR_EXCL_START
+        if (__evio_unlikely(fd < 0)) {
+            int err = errno;
+            EVIO_ABORT("timerfd_create() failed, error %d: %s\n", err, EVIO_STRERROR(err));
+        }
+        // GCOVR_EXCL_STOP
+
+        evio_eventfd_init(loop);
+        evio_poll_init(&loop->wake, evio_async_wake_cb, fd, EVIO_READ);
+        evio_poll_start(loop, &loop->wake);
+        evio_unref(loop);
+    }
+
+    atomic_store_explicit(&loop->wake_batch.value, min_batch, memory_order_relaxed);
+    atomic_store_explicit(&loop->wake_delay.value, max_delay, memory_order_release);
+}
@@ -54,9 +54,26 @@ void evio_async_stop(evio_loop *loop, evio_async *w);
 
 /**
  * @brief Sends an event to an async watcher from any thread.
- * @details Thread-safe.
+ * @details Thread-safe. Nothing refers to the loop once this returns, so it
+ * may then be freed by its own thread.
  * @param loop The event loop to wake up.
  * @param w The async watcher to signal.
  */
 __evio_public __evio_nonnull(1, 2)
 void evio_async_send(evio_loop *loop, evio_async *w);
+
+/**
+ * @brief Configures wake-up moderation for `evio_async_send`.
+ * @details By default, the first send after the loop went to sleep writes
+ * the eventfd and wakes the loop right away. With moderation, the first send
+ * arms a timer instead, and the loop wakes up when `max_delay` expires or
+ * when `min_batch` sends have accumulated, whichever comes first. Sends while
+ * the loop is awake cost no syscall either way. Signals are not moderated.
+ *
+ * Must be called from the loop thread.
+ * @param loop The event loop.
+ * @param max_delay The maximum wake-up delay in nanoseconds, or 0 to disable moderation.
+ * @param min_batch The number of sends that wake the loop early, or 0 to always wait for `max_delay`.
+ */
+__evio_public __evio_nonnull(1)
+void evio_set_wake_moderation(evio_loop *loop, evio_time max_delay, size_t min_batch);
@@ -0,0 +1,250 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "evio_core.h"
+#include "evio_child.h"
+#include "evio_child_sys.h"
+
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+#ifndef CLONE_PIDFD
+#define CLONE_PIDFD 0x00001000
+#endif
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+/** @brief The first version of `struct clone_args` (Linux 5.3). */
+struct evio_clone_args {
+    uint64_t flags;         /**< Flags bit mask (`CLONE_*`). */
+    uint64_t pidfd;         /**< Where to store the pidfd (`CLONE_PIDFD`). */
+    uint64_t child_tid;     /**< Unused. */
+    uint64_t parent_tid;    /**< Unused. */
+    uint64_t exit_signal;   /**< The signal sent to the parent on exit. */
+    uint64_t stack;         /**< Unused, the child runs on a copy of the stack. */
+    uint64_t stack_size;    /**< Unused. */
+    uint64_t tls;           /**< Unused. */
+};
+
+/**
+ * @brief Stops the watcher and reports an error.
+ * @param loop The event loop.
+ * @param w The child watcher.
+ * @param err The error number.
+ */
+static void evio_child_fail(evio_loop *loop, evio_child *w, int err)
+{
+    evio_child_stop(loop, w);
+    w->err = err;
+    evio_queue_event(loop, &w->base, EVIO_READ | EVIO_ERROR);
+}
+
+/**
+ * @brief Internal callback for the pidfd poll watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_poll` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_child_poll_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_child *w = container_of(base, evio_child, io.base);
+
+    if (__evio_unlikely(emask & EVIO_ERROR)) {
+        // The poll watcher was stopped, keep the refcount balanced.
+        evio_ref(loop);
+        evio_child_fail(loop, w, EBADF);
+        return;
+    }
+
+    siginfo_t info;
+    info.si_pid = 0;
+    if (waitid((idtype_t)P_PIDFD, (id_t)w->io.fd, &info, WEXITED | WNOHANG) < 0) {
+        if (errno != EINTR) {
+            evio_child_fail(loop, w, errno);
+        }
+        return;
+    }
+
+    if (__evio_unlikely(!info.si_pid)) {
+        return; // GCOVR_EXCL_LINE
+    }
+
+    w->pid = info.si_pid;
+    switch (info.si_code) {
+        case CLD_EXITED:
+            w->status = (info.si_status & 0xff) << 8;
+            break;
+
+        case CLD_DUMPED:
+            w->status = (info.si_status & 0x7f) | 0x80;
+            break;
+
+        default:
+            w->status = info.si_status & 0x7f;
+            break;
+    }
+
+    evio_child_stop(loop, w);
+    evio_queue_event(loop, &w->base, EVIO_READ);
+}
+
+void evio_child_init(evio_child *w, evio_cb cb, int pidfd)
+{
+    evio_init(&w->base, cb);
+    evio_poll_init(&w->io, evio_child_poll_cb, pidfd, EVIO_READ);
+    w->pid = 0;
+    w->status = 0;
+    w->err = 0;
+}
+
+void evio_child_start(evio_loop *loop, evio_child *w)
+{
+    if (__evio_unlikely(w->active)) {
+        return;
+    }
+
+    w->pid = 0;
+    w->status = 0;
+    w->err = 0;
+
+    // This takes one ref for the child watcher itself.
+    evio_list_start(loop, &w->base, &loop->child, true);
+    evio_poll_start(loop, &w->io);
+    evio_unref(loop);
+}
+
+void evio_child_stop(evio_loop *loop, evio_child *w)
+{
+    evio_clear_pending(loop, &w->base);
+    evio_clear_pending(loop, &w->io.base);
+
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    if (w->io.active) {
+        evio_ref(loop);
+        evio_poll_stop(loop, &w->io);
+    }
+
+    evio_list_stop(loop, &w->base, &loop->child, true);
+}
+
+/**
+ * @brief Runs the program in the child process.
+ * @details Only uses async-signal-safe functions, since the child is a copy
+ * of a possibly multithreaded parent.
+ * @param fd The pipe to report a failing `execve` to.
+ * @param path The path of the program.
+ * @param argv The argument list.
+ * @param envp The environment.
+ */
+__attribute__((__noreturn__))
+static void evio_child_exec(int fd, const char *path, char *const argv[], char *const envp[])
+{
+    // Signals caught by the parent must not run its handlers here.
+    struct sigaction sa = { .sa_handler = SIG_DFL };
+    for (int sig = 1; sig < NSIG; ++sig) {
+        struct sigaction old;
+        if (sigaction(sig, NULL, &old) == 0 && old.sa_handler != SIG_DFL &&
+            old.sa_handler != SIG_IGN) {
+            sigaction(sig, &sa, NULL);
+        }
+    }
+
+    sigset_t set;
+    sigemptyset(&set);
+    sigprocmask(SIG_SETMASK, &set, NULL);
+
+    execve(path, argv, envp);
+
+    int err = errno;
+    while (write(fd, &err, sizeof(err)) < 0 && errno == EINTR) {}
+    _exit(127);
+}
+
+int evio_child_spawn(const char *path, char *const argv[], char *const envp[], pid_t *pid)
+{
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
+        return -1; // GCOVR_EXCL_LINE
+    }
+
+    if (!envp) {
+        envp = environ;
+    }
+
+    // No signal handler may run in the child before it resets them.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    int pidfd = -1;
+    struct evio_clone_args args = {
+        .flags = CLONE_PIDFD,
+        .pidfd = (uint64_t)(uintptr_t)&pidfd,
+        .exit_signal = SIGCHLD,
+    };
+
+    pid_t child = (pid_t)EVIO_CLONE3(&args, sizeof(args));
+    if (child < 0 && (errno == ENOSYS || errno == EPERM)) {
+        // No clone3: Linux before 5.3, or filtered by seccomp.
+        child = fork();
+    }
+
+    if (child == 0) {
+        close(pipefd[0]);
+        evio_child_exec(pipefd[1], path, argv, envp);
+    }
+
+    int err = errno;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    close(pipefd[1]);
+
+    if (__evio_unlikely(child < 0)) {
+        // GCOVR_EXCL_START
+        close(pipefd[0]);
+        errno = err;
+        return -1;
+        // GCOVR_EXCL_STOP
+    }
+
+    if (pidfd < 0) {
+        pidfd = (int)syscall(SYS_pidfd_open, child, 0);
+        if (__evio_unlikely(pidfd < 0)) {
+            // GCOVR_EXCL_START
+            err = errno;
+            kill(child, SIGKILL);
+            while (waitpid(child, NULL, 0) < 0 && errno == EINTR) {}
+            close(pipefd[0]);
+            errno = err;
+            return -1;
+            // GCOVR_EXCL_STOP
+        }
+    }
+
+    // The pipe is closed by a successful execve, or carries its error.
+    ssize_t n;
+    while ((n = read(pipefd[0], &err, sizeof(err))) < 0 && errno == EINTR) {}
+    close(pipefd[0]);
+
+    if (n == sizeof(err)) {
+        siginfo_t info;
+        while (waitid((idtype_t)P_PIDFD, (id_t)pidfd, &info, WEXITED) < 0 && errno == EINTR) {}
+        close(pidfd);
+        errno = err;
+        return -1;
+    }
+
+    if (pid) {
+        *pid = child;
+    }
+    return pidfd;
+}
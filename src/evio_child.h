@@ -0,0 +1,105 @@
+#pragma once
+
+/**
+ * @file evio_child.h
+ * @brief Child process watchers based on pidfds.
+ * @details A child watcher waits for one child process through its pidfd,
+ * which becomes readable when the child exits. The watcher then reaps exactly
+ * that child with `waitid(P_PIDFD)`: there is no `SIGCHLD` handler, no scan
+ * over all children, and no exit is lost to signal coalescing.
+ *
+ * `evio_child_spawn` starts a program and returns its pidfd, using `clone3`
+ * with `CLONE_PIDFD`, or `fork` and `pidfd_open` on kernels without it.
+ * A pidfd of a child started by other means can be obtained with
+ * `pidfd_open`.
+ */
+
+#include "evio.h"
+
+/** @brief A child process watcher. */
+typedef struct evio_child {
+    EVIO_BASE;
+    evio_poll io;       /**< @private The poll watcher of the pidfd. */
+    pid_t pid;          /**< @private The pid of the reaped child, or 0. */
+    int status;         /**< @private The wait status of the reaped child. */
+    int err;            /**< @private The error that stopped the watcher, or 0. */
+} evio_child;
+
+/**
+ * @brief Initializes a child watcher.
+ * @details The callback receives `EVIO_READ` once the child has exited and
+ * has been reaped; the watcher is stopped before the callback. If reaping
+ * fails (e.g. `ECHILD` when someone else reaped it), the callback receives
+ * `EVIO_READ | EVIO_ERROR` instead (see `evio_child_error`).
+ * @param w The child watcher to initialize.
+ * @param cb The callback to invoke.
+ * @param pidfd The pidfd of the child, which the caller keeps owning.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_child_init(evio_child *w, evio_cb cb, int pidfd);
+
+/**
+ * @brief Starts a child watcher.
+ * @param loop The event loop.
+ * @param w The child watcher to start.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_child_start(evio_loop *loop, evio_child *w);
+
+/**
+ * @brief Stops a child watcher.
+ * @details The child is not reaped.
+ * @param loop The event loop.
+ * @param w The child watcher to stop.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_child_stop(evio_loop *loop, evio_child *w);
+
+/**
+ * @brief Starts a program in a child process.
+ * @details The child gets an empty signal mask, and inherits the file
+ * descriptors without `FD_CLOEXEC`. The call returns once the program runs,
+ * so that a failing `execve` is reported here (the child is reaped then).
+ * @param path The path of the program.
+ * @param argv The argument list, terminated by `NULL`.
+ * @param envp The environment, terminated by `NULL`, or `NULL` to inherit it.
+ * @param pid The pid of the child, or `NULL`.
+ * @return The pidfd of the child (with `FD_CLOEXEC`), or -1 with `errno` set.
+ */
+__evio_public __evio_nonnull(1, 2) __evio_nodiscard
+int evio_child_spawn(const char *path, char *const argv[], char *const envp[], pid_t *pid);
+
+/**
+ * @brief Gets the pid of the reaped child.
+ * @param w The child watcher.
+ * @return The pid, or 0 if the child was not reaped by the watcher.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+pid_t evio_child_pid(const evio_child *w)
+{
+    return w->pid;
+}
+
+/**
+ * @brief Gets the wait status of the reaped child.
+ * @details The status has the `waitpid` layout, for `WIFEXITED`,
+ * `WEXITSTATUS`, `WIFSIGNALED`, `WTERMSIG` and `WCOREDUMP`.
+ * @param w The child watcher.
+ * @return The wait status.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+int evio_child_status(const evio_child *w)
+{
+    return w->status;
+}
+
+/**
+ * @brief Gets the error that stopped a child watcher.
+ * @param w The child watcher.
+ * @return The error number, or 0.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+int evio_child_error(const evio_child *w)
+{
+    return w->err;
+}
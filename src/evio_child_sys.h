@@ -0,0 +1,25 @@
+#pragma once
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef EVIO_TESTING
+
+void evio_child_test_inject_clone3_fail_once(int err);
+
+long evio_test_clone3(void *args, size_t size);
+
+#define EVIO_CLONE3(args, size) \
+    evio_test_clone3((args), (size))
+
+#elif defined(SYS_clone3)
+
+#define EVIO_CLONE3(args, size) \
+    syscall(SYS_clone3, (args), (size))
+
+#else
+
+#define EVIO_CLONE3(args, size) \
+    (errno = ENOSYS, -1L)
+
+#endif
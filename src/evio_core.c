@@ -176,7 +176,12 @@ void evio_invoke_pending(evio_loop *loop)
             EVIO_ASSERT(evio_pending_get_index(p->base) == index);
 
             p->base->pending = 0;
+            evio_heartbeat(loop, p->base->cb, 0);
+            EVIO_PROBE3(dispatch, loop, p->base, p->emask);
+            evio_recorder_add(loop, EVIO_REC_DISPATCH, -1, p->emask,
+                              p->base, (uintptr_t)p->base->cb);
             p->base->cb(loop, p->base, p->emask);
+            evio_heartbeat(loop, NULL, 0);
         }
     }
 }
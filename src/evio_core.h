@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <sys/epoll.h>
 
 #include "evio.h"
 #include "evio_alloc.h"
@@ -19,6 +20,7 @@
 #include "evio_async.h"
 #include "evio_uring.h"
 #include "evio_eventfd.h"
+#include "evio_usdt.h"
 
 // IWYU pragma: end_exports
 
@@ -32,14 +34,69 @@
 /** @brief The maximum number of events the epoll buffer can grow to. */
 #define EVIO_MAX_EVENTS ((size_t)INT_MAX / sizeof(struct epoll_event))
 
-/** @brief Internal flag combined with emask to indicate edge-triggered mode. */
-#define EVIO_POLLET 0x80u
+#ifndef EVIO_RECORDER_EVENTS
+/** @brief The number of records kept by the per-loop flight recorder (power of 2). */
+#define EVIO_RECORDER_EVENTS ((size_t)256)
+#endif
+
+_Static_assert((EVIO_RECORDER_EVENTS & (EVIO_RECORDER_EVENTS - 1)) == 0,
+               "EVIO_RECORDER_EVENTS must be a power of 2");
+
 /** @brief Internal flag indicating an invalidated file descriptor. */
 #define EVIO_FD_INVAL 0x80u
+/** @brief Internal flag: the last epoll event of a lazy fd reported `EPOLLOUT`. */
+#define EVIO_FD_WRITABLE 0x100u
+
+/** @brief Heartbeat bit set while the loop is blocked in epoll or outside `evio_run`. */
+#define EVIO_BEAT_IDLE UINT64_C(1)
+
+/** @brief Opaque state of the loop stall watchdog. */
+typedef struct evio_watchdog evio_watchdog;
 
 /** @brief A bitmask for file-descriptor flags (e.g., `EVIO_FD_INVAL`). */
 typedef uint16_t evio_flag;
 
+/** @brief Flight recorder record types. */
+typedef enum {
+    EVIO_REC_NONE = 0,  /**< Unused slot. */
+    EVIO_REC_ITER,      /**< Loop iteration start. */
+    EVIO_REC_FD_CTL,    /**< epoll_ctl() issued: `arg` fd, `aux` op, `emask` new mask. */
+    EVIO_REC_POLL,      /**< epoll result: `arg` fd, `emask` received mask. */
+    EVIO_REC_DISPATCH,  /**< Callback dispatched: `ptr` watcher, `aux` callback. */
+    EVIO_REC_TIMER,     /**< Timer fired: `ptr` watcher, `aux` deadline. */
+    EVIO_REC_URING,     /**< io_uring CQE error: `arg` fd, `aux` op | res << 32. */
+} evio_rec_type;
+
+/** @brief A fixed-size flight recorder record. */
+typedef struct {
+    evio_time time;     /**< Cached loop time when the record was written. */
+    const void *ptr;    /**< Type-specific pointer (usually the watcher). */
+    uint64_t aux;       /**< Type-specific value. */
+    int32_t arg;        /**< Type-specific value (usually the fd). */
+    uint16_t type;      /**< The record type (`evio_rec_type`). */
+    evio_mask emask;    /**< The event mask, if any. */
+} evio_rec;
+
+/** @brief Event stream capture record types. */
+typedef enum {
+    EVIO_TRACE_POLL = 1,    /**< Readiness event: `arg` fd, `emask` received mask. */
+    EVIO_TRACE_TIME,        /**< Loop time update, before timers fire. */
+    EVIO_TRACE_TIMER,       /**< Timer fired. */
+    EVIO_TRACE_ASYNC,       /**< Async wake-up: `arg` index in the async list. */
+    EVIO_TRACE_SIGNAL,      /**< Signal wake-up: `arg` signal number. */
+} evio_trace_type;
+
+/** @brief A captured event stream record, as written to the trace. */
+typedef struct {
+    uint64_t time;          /**< Loop time relative to the capture start. */
+    int32_t arg;            /**< Type-specific value. */
+    uint16_t type;          /**< The record type (`evio_trace_type`). */
+    uint16_t emask;         /**< The event mask, if any. */
+} evio_trace_rec;
+
+/** @brief Opaque state of a running event stream capture. */
+typedef struct evio_trace evio_trace;
+
 /** @brief A pending event to be processed. */
 typedef struct {
     evio_base *base;    /**< The watcher that the event belongs to. */
@@ -71,7 +128,12 @@ typedef struct {
 EVIO_ATOMIC_SIZE_CHECK(int);
 EVIO_ATOMIC_ALIGNED_SIZE_CHECK(int);
 
+EVIO_ATOMIC_SIZE_CHECK(uint64_t);
+EVIO_ATOMIC_SIZE_CHECK(evio_cb);
+
 EVIO_ATOMIC_LOCK_FREE_CHECK(int);
+EVIO_ATOMIC_LOCK_FREE_CHECK(uint64_t);
+EVIO_ATOMIC_LOCK_FREE_CHECK(evio_cb);
 EVIO_ATOMIC_LOCK_FREE_CHECK(evio_loop *);
 
 #define EVIO_SIGSET_WORDS (((NSIG - 1) + 63u) / 64u)
@@ -99,22 +161,59 @@ struct evio_loop {
 
     evio_uring *iou;            /**< Optional io_uring context for batched epoll_ctl. */
     size_t iou_count;           /**< Number of pending io_uring operations. */
+    evio_watchdog *wd;          /**< Optional stall watchdog (see `evio_watchdog_start`). */
+    evio_trace *trace;          /**< Optional event stream capture (see `evio_trace_start`). */
+
+    evio_time busy_max;         /**< The busy-poll spin budget limit, 0 if disabled (see `evio_set_busy_poll`). */
+    evio_time busy_budget;      /**< The current adaptive busy-poll spin budget. */
+    uint32_t busy_rate;         /**< The recent busy-poll hit rate, in 1/256 units. */
 
     void *data;                 /**< User-assignable data pointer. */
     evio_poll event;            /**< The internal eventfd poll watcher for loop wake-ups. */
+    evio_poll wake;             /**< The internal timerfd poll watcher bounding moderated wake-ups. */
     evio_list async;            /**< List of active async watchers. */
     evio_list cleanup;          /**< List of active cleanup watchers. */
     evio_list once;             /**< List of active once watchers. */
+    evio_list accept;           /**< List of active accept watchers. */
+    evio_list zsend;            /**< List of active zero-copy send watchers. */
+    evio_list relay;            /**< List of active relay watchers. */
+    evio_list dgram;            /**< List of active datagram watchers. */
+    evio_list stream;           /**< List of active stream watchers. */
+    evio_list cork;             /**< List of cork watchers holding unwritten data. */
+    evio_list child;            /**< List of active child watchers. */
+    evio_list fs;               /**< List of active file operation watchers. */
+    struct evio_fs_queue *fsq;  /**< Completed thread pool file operations, created on first use. */
 
     EVIO_ATOMIC(int) eventfd_allow; /**< Flag to allow writing to the eventfd (thread-sync). */
     EVIO_ATOMIC(int) event_pending; /**< Flag indicating a pending eventfd notification. */
     EVIO_ATOMIC(int) async_pending; /**< Flag indicating at least one async watcher is pending. */
     EVIO_ATOMIC(int) signal_pending;/**< Flag indicating at least one signal is pending. */
+    EVIO_ATOMIC(uint64_t) wake_delay;   /**< Maximum delay of a moderated wake-up, 0 if disabled. */
+    EVIO_ATOMIC(uint64_t) wake_batch;   /**< Number of sends that wake the loop right away, 0 for none. */
+    EVIO_ATOMIC(uint64_t) wake_count;   /**< Number of moderated sends since the last wake-up. */
+    EVIO_ATOMIC(uint64_t) wd_beat;  /**< Watchdog heartbeat counter (see `EVIO_BEAT_IDLE`). */
+    EVIO_ATOMIC(evio_cb) wd_cb;     /**< The watcher callback currently running, for the watchdog. */
 
     sigset_t sigmask;           /**< Signal mask used in epoll_pwait to block signals. */
     uint64_t sig_active[EVIO_SIGSET_WORDS]; /**< Active signal set for this loop. */
+
+    size_t rec_head;            /**< Total number of flight recorder records written. */
+    evio_rec rec[EVIO_RECORDER_EVENTS]; /**< Flight recorder ring (see `evio_recorder_dump`). */
 };
 
+/**
+ * @brief Converts a registered fd event mask to epoll events.
+ * @param emask The fd event mask.
+ * @return The epoll event flags.
+ */
+static inline uint32_t evio_poll_events(evio_mask emask)
+{
+    return ((emask & EVIO_READ)      ? EPOLLIN        : 0) |
+           ((emask & EVIO_WRITE)     ? EPOLLOUT       : 0) |
+           ((emask & EVIO_EDGE)      ? EPOLLET        : 0) |
+           ((emask & EVIO_EXCLUSIVE) ? EPOLLEXCLUSIVE : 0);
+}
+
 /**
  * @brief Sets the pending state of a watcher.
  * @details Encode (index, queue) into `base->pending`.
@@ -150,6 +249,70 @@ size_t evio_pending_get_queue(const evio_base *base)
     return (base->pending - 1) & 1;
 }
 
+/**
+ * @brief Advances the watchdog heartbeat, if the watchdog is running.
+ * @param loop The event loop.
+ * @param cb The watcher callback about to run, or `NULL`.
+ * @param idle `EVIO_BEAT_IDLE` if the loop is about to block or leave `evio_run`, 0 otherwise.
+ */
+static inline __evio_nonnull(1)
+void evio_heartbeat(evio_loop *loop, evio_cb cb, uint64_t idle)
+{
+    if (__evio_unlikely(loop->wd)) {
+        const uint64_t beat = atomic_load_explicit(&loop->wd_beat.value, memory_order_relaxed);
+        atomic_store_explicit(&loop->wd_cb.value, cb, memory_order_relaxed);
+        atomic_store_explicit(&loop->wd_beat.value, ((beat + 2) & ~EVIO_BEAT_IDLE) | idle,
+                              memory_order_release);
+    }
+}
+
+/**
+ * @brief Appends a record to the loop's flight recorder ring.
+ * @param loop The event loop.
+ * @param type The record type.
+ * @param arg Type-specific value (usually the fd).
+ * @param emask The event mask, if any.
+ * @param ptr Type-specific pointer (usually the watcher).
+ * @param aux Type-specific value.
+ */
+static inline __evio_nonnull(1)
+void evio_recorder_add(evio_loop *loop, evio_rec_type type, int arg, evio_mask emask,
+                       const void *ptr, uint64_t aux)
+{
+    evio_rec *r = &loop->rec[loop->rec_head++ & (EVIO_RECORDER_EVENTS - 1)];
+    r->time = loop->time;
+    r->ptr = ptr;
+    r->aux = aux;
+    r->arg = arg;
+    r->type = type;
+    r->emask = emask;
+}
+
+/**
+ * @brief Appends a record to the running event stream capture.
+ * @param loop The event loop.
+ * @param type The record type.
+ * @param arg Type-specific value.
+ * @param emask The event mask, if any.
+ */
+__evio_nonnull(1)
+void evio_trace_write(evio_loop *loop, evio_trace_type type, int arg, evio_mask emask);
+
+/**
+ * @brief Captures an event if an event stream capture is running.
+ * @param loop The event loop.
+ * @param type The record type.
+ * @param arg Type-specific value.
+ * @param emask The event mask, if any.
+ */
+static inline __evio_nonnull(1)
+void evio_trace_add(evio_loop *loop, evio_trace_type type, int arg, evio_mask emask)
+{
+    if (__evio_unlikely(loop->trace)) {
+        evio_trace_write(loop, type, arg, emask);
+    }
+}
+
 /**
  * @brief Queues an event for a watcher.
  * @param loop The event loop.
@@ -292,6 +455,36 @@ void evio_signal_process_pending(evio_loop *loop);
 __evio_nonnull(1)
 void evio_signal_cleanup_loop(evio_loop *loop);
 
+/**
+ * @brief Gets the loop whose `evio_run` is executing in this thread.
+ * @return The innermost running loop, or `NULL` outside `evio_run`.
+ */
+__evio_nodiscard
+evio_loop *evio_loop_running(void);
+
+/**
+ * @brief Stops the active file operation watchers of a loop and frees its
+ * thread pool completion queue, if any.
+ * @details Waits for the operations running on pool threads.
+ * @param loop The event loop.
+ */
+__evio_nonnull(1)
+void evio_fs_cleanup(evio_loop *loop);
+
+/**
+ * @brief Writes the data of all active cork watchers.
+ * @param loop The event loop.
+ */
+__evio_nonnull(1)
+void evio_cork_flush(evio_loop *loop);
+
+/**
+ * @brief Dumps the flight recorder of the loop running in this thread, if any, on abort.
+ * @param stream The abort output stream.
+ */
+__evio_nonnull(1) __evio_cold
+void evio_recorder_abort(FILE *stream);
+
 /**
  * @brief Updates file descriptor watchers in the event loop via epoll_ctl.
  * @param loop The event loop.
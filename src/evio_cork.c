@@ -0,0 +1,267 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "evio_core.h"
+#include "evio_cork.h"
+#include "evio_uring.h"
+
+/** @brief A send request on io_uring. */
+struct evio_cork_op {
+    evio_uring_req req;     /**< The io_uring request. */
+    evio_cork *w;           /**< The owning watcher, or `NULL` once stopped. */
+    char *buf;              /**< The data the kernel may still read once stopped. */
+};
+
+/**
+ * @brief Checks if a send request is in flight.
+ * @param w The cork watcher.
+ * @return `true` while the kernel holds `out`.
+ */
+static bool evio_cork_busy(const evio_cork *w)
+{
+    return w->op && w->op->req.inflight;
+}
+
+/**
+ * @brief Stops the watcher and reports an error.
+ * @param loop The event loop.
+ * @param w The cork watcher.
+ * @param err The error number.
+ */
+static void evio_cork_fail(evio_loop *loop, evio_cork *w, int err)
+{
+    evio_cork_stop(loop, w);
+    w->err = err;
+    evio_queue_event(loop, &w->base, EVIO_WRITE | EVIO_ERROR);
+}
+
+/**
+ * @brief Waits for the fd to become writable.
+ * @param loop The event loop.
+ * @param w The cork watcher.
+ */
+static void evio_cork_block(evio_loop *loop, evio_cork *w)
+{
+    // The cork watcher holds the loop reference.
+    w->blocked = true;
+    evio_poll_start(loop, &w->io);
+    evio_unref(loop);
+}
+
+/**
+ * @brief Internal completion callback for send requests on io_uring.
+ * @param loop The event loop.
+ * @param req The io_uring request.
+ * @param res The number of bytes sent or a negative error code.
+ * @param more Unused.
+ */
+static void evio_cork_uring_cb(evio_loop *loop, evio_uring_req *req, int res, bool more)
+{
+    struct evio_cork_op *op = container_of(req, struct evio_cork_op, req);
+    evio_cork *w = op->w;
+
+    if (__evio_unlikely(!w)) {
+        // Stopped while the kernel still held the data.
+        if (!req->inflight) {
+            evio_free(op->buf);
+            evio_free(op);
+        }
+        return;
+    }
+
+    if (res >= 0) {
+        // The rest goes out at the next flush.
+        w->off += (size_t)res;
+    } else if (res == -EAGAIN) {
+        evio_cork_block(loop, w);
+    } else if (res == -ENOTSOCK) {
+        // Not a socket: write with epoll at the next flush instead.
+        w->nosock = true;
+    } else if (res != -EINTR) {
+        evio_cork_fail(loop, w, -res);
+    }
+}
+
+/**
+ * @brief Writes the corked data until it is all written, the fd is full,
+ * or a send request is submitted.
+ * @param loop The event loop.
+ * @param w The cork watcher.
+ */
+static void evio_cork_send(evio_loop *loop, evio_cork *w)
+{
+    for (;;) {
+        if (w->off == w->outlen) {
+            if (!w->len) {
+                evio_list_stop(loop, &w->base, &loop->cork, true);
+                return;
+            }
+
+            // Write the corked data while new data goes to the old buffer.
+            char *out = w->out;
+            size_t outsize = w->outsize;
+            w->out = w->buf;
+            w->outsize = w->size;
+            w->outlen = w->len;
+            w->off = 0;
+            w->buf = out;
+            w->size = outsize;
+            w->len = 0;
+        }
+
+        if (loop->iou && !w->nosock) {
+            if (!w->op) {
+                w->op = evio_malloc(sizeof(*w->op));
+                w->op->req = (evio_uring_req) { .cb = evio_cork_uring_cb };
+            }
+            w->op->w = w;
+            w->op->buf = NULL;
+            if (evio_uring_send(loop, &w->op->req, w->io.fd, w->out + w->off,
+                                w->outlen - w->off, MSG_NOSIGNAL)) {
+                return;
+            }
+        }
+
+        ssize_t n = w->nosock
+                    ? write(w->io.fd, w->out + w->off, w->outlen - w->off)
+                    : send(w->io.fd, w->out + w->off, w->outlen - w->off,
+                           MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n >= 0) {
+            w->off += (size_t)n;
+            continue;
+        }
+
+        int err = errno;
+        if (err == EAGAIN) {
+            evio_cork_block(loop, w);
+            return;
+        }
+        if (err == EINTR) {
+            continue; // GCOVR_EXCL_LINE
+        }
+        if (err == ENOTSOCK && !w->nosock) {
+            w->nosock = true;
+            continue;
+        }
+
+        evio_cork_fail(loop, w, err);
+        return;
+    }
+}
+
+/**
+ * @brief Internal callback for the poll watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_poll` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_cork_poll_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_cork *w = container_of(base, evio_cork, io.base);
+
+    if (__evio_unlikely(emask & EVIO_ERROR)) {
+        // The poll watcher was stopped, keep the refcount balanced.
+        evio_ref(loop);
+        w->blocked = false;
+        evio_cork_fail(loop, w, EBADF);
+        return;
+    }
+
+    evio_ref(loop);
+    evio_poll_stop(loop, &w->io);
+    w->blocked = false;
+    evio_cork_send(loop, w);
+}
+
+void evio_cork_init(evio_cork *w, evio_cb cb, int fd)
+{
+    evio_init(&w->base, cb);
+    evio_poll_init(&w->io, evio_cork_poll_cb, fd, EVIO_WRITE);
+    w->op = NULL;
+    w->buf = NULL;
+    w->len = 0;
+    w->size = 0;
+    w->out = NULL;
+    w->off = 0;
+    w->outlen = 0;
+    w->outsize = 0;
+    w->err = 0;
+    w->blocked = false;
+    w->nosock = false;
+}
+
+void evio_cork_write(evio_loop *loop, evio_cork *w, const void *buf, size_t len)
+{
+    if (__evio_unlikely(!len)) {
+        return;
+    }
+
+    if (w->len + len > w->size) {
+        size_t size = w->size ? w->size : 4096;
+        while (size < w->len + len) {
+            size *= 2;
+        }
+        w->buf = evio_realloc(w->buf, size);
+        w->size = size;
+    }
+
+    memcpy(w->buf + w->len, buf, len);
+    w->len += len;
+
+    if (!w->active) {
+        w->err = 0;
+        evio_list_start(loop, &w->base, &loop->cork, true);
+    }
+}
+
+void evio_cork_stop(evio_loop *loop, evio_cork *w)
+{
+    evio_clear_pending(loop, &w->base);
+    evio_clear_pending(loop, &w->io.base);
+
+    if (w->blocked) {
+        w->blocked = false;
+        evio_ref(loop);
+        evio_poll_stop(loop, &w->io);
+    }
+
+    if (evio_cork_busy(w)) {
+        // The completion callback frees the data the kernel still holds.
+        w->op->w = NULL;
+        w->op->buf = w->out;
+        evio_uring_cancel(loop, &w->op->req, false);
+    } else {
+        evio_free(w->op);
+        evio_free(w->out);
+    }
+
+    evio_free(w->buf);
+    w->op = NULL;
+    w->buf = NULL;
+    w->len = 0;
+    w->size = 0;
+    w->out = NULL;
+    w->off = 0;
+    w->outlen = 0;
+    w->outsize = 0;
+
+    evio_list_stop(loop, &w->base, &loop->cork, true);
+}
+
+void evio_cork_flush(evio_loop *loop)
+{
+    // Finished watchers are swapped with the last one, which is already done.
+    for (size_t i = loop->cork.count; i-- > 0;) {
+        evio_cork *w = container_of(loop->cork.ptr[i], evio_cork, base);
+        if (!w->blocked && !evio_cork_busy(w)) {
+            evio_cork_send(loop, w);
+        }
+    }
+
+    // Submit all the send requests at once.
+    if (loop->iou_count) {
+        evio_uring_flush(loop);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+/**
+ * @file evio_cork.h
+ * @brief Coalesces the writes of one loop iteration into one write per fd.
+ * @details When several callbacks answer on the same socket within one
+ * iteration, writing each response costs a system call. A cork watcher
+ * collects them instead: data written to it during the iteration is copied
+ * into a per-fd buffer, and the loop writes all corked fds once the
+ * callbacks and check watchers have run (and again before it blocks, for
+ * data written by prepare watchers or outside the loop).
+ *
+ * On loops created with `EVIO_FLAG_URING`, the writes of all corked sockets
+ * are submitted to the ring as one batch, so an iteration costs a single
+ * system call however many sockets it answered.
+ *
+ * If a socket cannot take all the data, the rest is written once it is
+ * writable; data corked meanwhile is appended after it.
+ */
+
+#include "evio.h"
+
+struct evio_cork_op;
+
+/** @brief A write coalescing watcher. */
+typedef struct evio_cork {
+    EVIO_BASE;
+    evio_poll io;               /**< @private Waits for the fd to become writable. */
+    struct evio_cork_op *op;    /**< @private The send request on io_uring, or `NULL`. */
+    char *buf;                  /**< @private Data corked since the last write. */
+    size_t len;                 /**< @private Number of bytes in `buf`. */
+    size_t size;                /**< @private Capacity of `buf`. */
+    char *out;                  /**< @private Data being written. */
+    size_t off;                 /**< @private Number of bytes of `out` written. */
+    size_t outlen;              /**< @private Number of bytes in `out`. */
+    size_t outsize;             /**< @private Capacity of `out`. */
+    int err;                    /**< @private The error that stopped writing, or 0. */
+    bool blocked;               /**< @private Waiting for the fd to become writable. */
+    bool nosock;                /**< @private The fd is not a socket, use `write`. */
+} evio_cork;
+
+/**
+ * @brief Initializes a cork watcher.
+ * @details The watcher is active, and keeps the loop alive, while it holds
+ * data that is not written yet. The callback only receives
+ * `EVIO_WRITE | EVIO_ERROR` if writing failed (see `evio_cork_error`); the
+ * watcher is stopped and unwritten data is discarded before the callback.
+ * @param w The cork watcher to initialize.
+ * @param cb The callback to invoke on errors.
+ * @param fd The file descriptor to write to (non-blocking).
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_cork_init(evio_cork *w, evio_cb cb, int fd);
+
+/**
+ * @brief Corks data for writing.
+ * @details The data is copied, and written at the end of the iteration.
+ * @param loop The event loop.
+ * @param w The cork watcher.
+ * @param buf The data.
+ * @param len The length of the data.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_cork_write(evio_loop *loop, evio_cork *w, const void *buf, size_t len);
+
+/**
+ * @brief Stops a cork watcher and frees its buffers.
+ * @details Data that is not written yet is discarded. The buffers are kept
+ * between iterations for reuse, so this must also be called on an inactive
+ * watcher before it is freed.
+ * @param loop The event loop.
+ * @param w The cork watcher to stop.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_cork_stop(evio_loop *loop, evio_cork *w);
+
+/**
+ * @brief Gets the number of bytes that are not written yet.
+ * @param w The cork watcher.
+ * @return The number of pending bytes.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+size_t evio_cork_pending(const evio_cork *w)
+{
+    return w->len + (w->outlen - w->off);
+}
+
+/**
+ * @brief Gets the error that stopped a cork watcher.
+ * @param w The cork watcher.
+ * @return The error number, or 0.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+int evio_cork_error(const evio_cork *w)
+{
+    return w->err;
+}
@@ -0,0 +1,481 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#include "evio_core.h"
+#include "evio_dgram.h"
+
+/** @brief The maximum number of datagrams in one `UDP_SEGMENT` message. */
+#define EVIO_DGRAM_GSO_SEGS 64
+
+/** @brief The maximum payload of one `UDP_SEGMENT` message, below the IPv4 and IPv6 limits. */
+#define EVIO_DGRAM_GSO_BYTES 65000
+
+/** @brief Ancillary data for one `UDP_GRO` or `UDP_SEGMENT` value. */
+typedef union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+} evio_dgram_cmsg;
+
+/** @brief The receive buffers of a datagram watcher. */
+struct evio_dgram_rx {
+    struct mmsghdr hdrs[EVIO_DGRAM_BATCH];          /**< The `recvmmsg` headers. */
+    struct iovec iov[EVIO_DGRAM_BATCH];             /**< One buffer per datagram. */
+    struct sockaddr_storage addrs[EVIO_DGRAM_BATCH];/**< The source addresses. */
+    evio_dgram_cmsg cmsgs[EVIO_DGRAM_BATCH];        /**< The GRO segment sizes. */
+    evio_dgram_msg msgs[EVIO_DGRAM_BATCH];          /**< The batch handed to the callback. */
+    char bufs[];                                    /**< The payload buffers. */
+};
+
+/** @brief A datagram in the send queue. */
+struct evio_dgram_pkt {
+    size_t off;                     /**< The offset of the payload in the queue data. */
+    size_t len;                     /**< The length of the payload. */
+    struct sockaddr_storage addr;   /**< The destination address. */
+    socklen_t addrlen;              /**< The length of the destination address, or 0. */
+};
+
+/** @brief The send queue of a datagram watcher. */
+struct evio_dgram_tx {
+    struct mmsghdr hdrs[EVIO_DGRAM_BATCH];      /**< The `sendmmsg` headers. */
+    struct iovec iov[EVIO_DGRAM_BATCH];         /**< One buffer per message. */
+    evio_dgram_cmsg cmsgs[EVIO_DGRAM_BATCH];    /**< The GSO segment sizes. */
+    size_t segs[EVIO_DGRAM_BATCH];              /**< Number of queued datagrams per message. */
+    struct evio_dgram_pkt *pkts;                /**< The queued datagrams. */
+    size_t head;                                /**< Index of the first unsent datagram. */
+    size_t count;                               /**< Number of queued datagrams. */
+    size_t total;                               /**< Capacity of the datagram array. */
+    char *data;                                 /**< The queued payloads, back to back. */
+    size_t len;                                 /**< Number of bytes used in the data. */
+    size_t size;                                /**< Capacity of the data. */
+    size_t queued;                              /**< Number of unsent payload bytes. */
+    bool gso;                                   /**< The socket accepts `UDP_SEGMENT`. */
+    bool blocked;                               /**< Waiting for the socket to become writable. */
+};
+
+/**
+ * @brief Checks if a queued datagram can extend a `UDP_SEGMENT` message.
+ * @details All segments but the last must have the length of the first one.
+ * @param first The first datagram of the message.
+ * @param prev The last datagram of the message.
+ * @param next The candidate datagram.
+ * @param segs Number of datagrams in the message.
+ * @param bytes Number of payload bytes in the message.
+ * @return `true` if the datagram can be appended.
+ */
+static bool evio_dgram_coalesce(const struct evio_dgram_pkt *first,
+                                const struct evio_dgram_pkt *prev,
+                                const struct evio_dgram_pkt *next,
+                                size_t segs, size_t bytes)
+{
+    return segs < EVIO_DGRAM_GSO_SEGS &&
+           prev->len == first->len &&
+           next->len && next->len <= first->len &&
+           bytes + next->len <= EVIO_DGRAM_GSO_BYTES &&
+           next->addrlen == first->addrlen &&
+           memcmp(&next->addr, &first->addr, first->addrlen) == 0;
+}
+
+/**
+ * @brief Builds the `sendmmsg` headers for the next queued datagrams.
+ * @details Payloads are stored back to back, so a `UDP_SEGMENT` message
+ * takes a single buffer.
+ * @param tx The send queue.
+ * @return Number of messages built.
+ */
+static size_t evio_dgram_build(struct evio_dgram_tx *tx)
+{
+    size_t n = 0;
+
+    for (size_t i = tx->head; i < tx->count && n < EVIO_DGRAM_BATCH; ++n) {
+        const struct evio_dgram_pkt *first = &tx->pkts[i];
+        size_t bytes = first->len;
+        size_t j = i + 1;
+
+        if (tx->gso) {
+            while (j < tx->count &&
+                   evio_dgram_coalesce(first, &tx->pkts[j - 1], &tx->pkts[j], j - i, bytes)) {
+                bytes += tx->pkts[j++].len;
+            }
+        }
+
+        struct msghdr *msg = &tx->hdrs[n].msg_hdr;
+        *msg = (struct msghdr) {
+            .msg_name = first->addrlen ? (void *)&first->addr : NULL,
+            .msg_namelen = first->addrlen,
+            .msg_iov = &tx->iov[n],
+            .msg_iovlen = 1,
+        };
+        tx->iov[n] = (struct iovec) {
+            .iov_base = tx->data + first->off,
+            .iov_len = bytes,
+        };
+
+        if (j - i > 1) {
+            msg->msg_control = tx->cmsgs[n].buf;
+            msg->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+            uint16_t segment = (uint16_t)first->len;
+            memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+        }
+
+        tx->segs[n] = j - i;
+        i = j;
+    }
+    return n;
+}
+
+/**
+ * @brief Drops the datagrams of the first messages from the send queue.
+ * @details Once the sent datagrams are at least half of the queue, the unsent
+ * ones are moved to the front, so that a queue that never fully drains does
+ * not grow with the total amount of data ever sent.
+ * @param tx The send queue.
+ * @param n Number of messages.
+ */
+static void evio_dgram_consume(struct evio_dgram_tx *tx, size_t n)
+{
+    for (size_t k = 0; k < n; ++k) {
+        for (size_t i = 0; i < tx->segs[k]; ++i) {
+            tx->queued -= tx->pkts[tx->head++].len;
+        }
+    }
+
+    if (tx->head == tx->count) {
+        tx->head = 0;
+        tx->count = 0;
+        tx->len = 0;
+        return;
+    }
+
+    if (tx->head < tx->count - tx->head) {
+        return;
+    }
+
+    const size_t off = tx->pkts[tx->head].off;
+    tx->count -= tx->head;
+    tx->len -= off;
+    memmove(tx->pkts, tx->pkts + tx->head, tx->count * sizeof(*tx->pkts));
+    memmove(tx->data, tx->data + off, tx->len);
+    for (size_t i = 0; i < tx->count; ++i) {
+        tx->pkts[i].off -= off;
+    }
+    tx->head = 0;
+}
+
+/**
+ * @brief Starts or stops the internal prepare watcher without changing the refcount.
+ * @param loop The event loop.
+ * @param w The datagram watcher.
+ * @param on `true` if the send queue should be flushed before the loop blocks.
+ */
+static void evio_dgram_schedule(evio_loop *loop, evio_dgram *w, bool on)
+{
+    // The datagram watcher holds the loop reference.
+    if (on && !w->flush.active) {
+        evio_prepare_start(loop, &w->flush);
+        evio_unref(loop);
+    } else if (!on && w->flush.active) {
+        evio_ref(loop);
+        evio_prepare_stop(loop, &w->flush);
+    }
+}
+
+/**
+ * @brief Sends queued datagrams until the queue is empty or the socket is full.
+ * @param loop The event loop.
+ * @param w The datagram watcher.
+ */
+static void evio_dgram_send_queue(evio_loop *loop, evio_dgram *w)
+{
+    struct evio_dgram_tx *tx = w->tx;
+    bool failed = false;
+
+    evio_dgram_schedule(loop, w, false);
+
+    while (tx->head < tx->count) {
+        size_t n = evio_dgram_build(tx);
+
+        int sent = sendmmsg(w->io.fd, tx->hdrs, (unsigned int)n, MSG_DONTWAIT);
+        if (sent > 0) {
+            evio_dgram_consume(tx, (size_t)sent);
+            continue;
+        }
+
+        int err = errno;
+        if (err == EAGAIN) {
+            break;
+        }
+        if (err == EINTR) {
+            continue; // GCOVR_EXCL_LINE
+        }
+        if (tx->segs[0] > 1 && (err == EIO || err == EINVAL)) {
+            // The device cannot segment, fall back to one message per datagram.
+            tx->gso = false; // GCOVR_EXCL_LINE
+            continue; // GCOVR_EXCL_LINE
+        }
+
+        // The first message was refused, drop it and go on with the rest.
+        evio_dgram_consume(tx, 1);
+        w->err = err;
+        failed = true;
+    }
+
+    bool blocked = tx->head < tx->count;
+    if (blocked != tx->blocked) {
+        tx->blocked = blocked;
+        evio_poll_change(loop, &w->io, w->io.fd, blocked ? EVIO_READ | EVIO_WRITE : EVIO_READ);
+    }
+
+    if (failed) {
+        evio_queue_event(loop, &w->base, EVIO_WRITE | EVIO_ERROR);
+    }
+}
+
+/**
+ * @brief Receives one batch of datagrams and invokes the callback.
+ * @param loop The event loop.
+ * @param w The datagram watcher.
+ */
+static void evio_dgram_recv(evio_loop *loop, evio_dgram *w)
+{
+    struct evio_dgram_rx *rx = w->rx;
+
+    for (size_t i = 0; i < EVIO_DGRAM_BATCH; ++i) {
+        struct msghdr *msg = &rx->hdrs[i].msg_hdr;
+        msg->msg_namelen = sizeof(rx->addrs[i]);
+        msg->msg_controllen = sizeof(rx->cmsgs[i]);
+        msg->msg_flags = 0;
+    }
+
+    int n = recvmmsg(w->io.fd, rx->hdrs, EVIO_DGRAM_BATCH, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return;
+        }
+
+        // e.g. an ICMP error on a connected socket
+        w->err = errno;
+        w->msgs = rx->msgs;
+        w->count = 0;
+        w->cb(loop, &w->base, EVIO_READ | EVIO_ERROR);
+        return;
+    }
+
+    for (size_t i = 0; i < (size_t)n; ++i) {
+        struct msghdr *msg = &rx->hdrs[i].msg_hdr;
+        size_t segment = 0;
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int value;
+                memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+                segment = value > 0 ? (size_t)value : 0;
+            }
+        }
+
+        rx->msgs[i] = (evio_dgram_msg) {
+            .data = rx->iov[i].iov_base,
+            .len = rx->hdrs[i].msg_len,
+            .segment = segment < rx->hdrs[i].msg_len ? segment : 0,
+            .addr = msg->msg_namelen ? (const struct sockaddr *)&rx->addrs[i] : NULL,
+            .addrlen = msg->msg_namelen,
+            .truncated = msg->msg_flags & MSG_TRUNC,
+        };
+    }
+
+    w->msgs = rx->msgs;
+    w->count = (size_t)n;
+    w->cb(loop, &w->base, EVIO_READ);
+}
+
+/**
+ * @brief Internal callback for the poll watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_poll` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_dgram_io_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_dgram *w = container_of(base, evio_dgram, io.base);
+
+    if (__evio_unlikely(emask & EVIO_ERROR)) {
+        // The poll watcher was stopped, keep the refcount balanced.
+        evio_ref(loop);
+        evio_dgram_stop(loop, w);
+        w->err = EBADF;
+        evio_queue_event(loop, &w->base, EVIO_READ | EVIO_ERROR);
+        return;
+    }
+
+    if (emask & EVIO_WRITE) {
+        evio_dgram_send_queue(loop, w);
+    }
+
+    if ((emask & EVIO_READ) && w->active) {
+        evio_dgram_recv(loop, w);
+    }
+}
+
+/**
+ * @brief Internal callback for the prepare watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_prepare` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_dgram_flush_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_dgram *w = container_of(base, evio_dgram, flush.base);
+    evio_dgram_send_queue(loop, w);
+}
+
+void evio_dgram_init(evio_dgram *w, evio_cb cb, int fd, size_t size)
+{
+    evio_init(&w->base, cb);
+    evio_poll_init(&w->io, evio_dgram_io_cb, fd, EVIO_READ);
+    evio_prepare_init(&w->flush, evio_dgram_flush_cb);
+    w->rx = NULL;
+    w->tx = NULL;
+    w->msgs = NULL;
+    w->count = 0;
+    w->size = size ? size : EVIO_DGRAM_SIZE;
+    w->err = 0;
+}
+
+void evio_dgram_start(evio_loop *loop, evio_dgram *w)
+{
+    if (__evio_unlikely(w->active)) {
+        return;
+    }
+
+    struct evio_dgram_rx *rx = evio_malloc(sizeof(*rx) + EVIO_DGRAM_BATCH * w->size);
+    for (size_t i = 0; i < EVIO_DGRAM_BATCH; ++i) {
+        rx->iov[i] = (struct iovec) {
+            .iov_base = rx->bufs + i * w->size,
+            .iov_len = w->size,
+        };
+        rx->hdrs[i].msg_hdr = (struct msghdr) {
+            .msg_name = &rx->addrs[i],
+            .msg_iov = &rx->iov[i],
+            .msg_iovlen = 1,
+            .msg_control = rx->cmsgs[i].buf,
+        };
+    }
+
+    struct evio_dgram_tx *tx = evio_calloc(1, sizeof(*tx));
+    int segment = 0;
+    socklen_t optlen = sizeof(segment);
+    tx->gso = getsockopt(w->io.fd, SOL_UDP, UDP_SEGMENT, &segment, &optlen) == 0;
+
+    w->rx = rx;
+    w->tx = tx;
+    w->msgs = rx->msgs;
+    w->count = 0;
+    w->err = 0;
+
+    // This takes one ref for the datagram watcher itself.
+    evio_list_start(loop, &w->base, &loop->dgram, true);
+
+    evio_poll_set(&w->io, w->io.fd, EVIO_READ);
+    evio_poll_start(loop, &w->io);
+    evio_unref(loop);
+}
+
+void evio_dgram_stop(evio_loop *loop, evio_dgram *w)
+{
+    evio_clear_pending(loop, &w->base);
+    evio_clear_pending(loop, &w->io.base);
+
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    evio_dgram_schedule(loop, w, false);
+    if (w->io.active) {
+        evio_ref(loop);
+        evio_poll_stop(loop, &w->io);
+    }
+
+    evio_free(w->tx->pkts);
+    evio_free(w->tx->data);
+    evio_free(w->tx);
+    evio_free(w->rx);
+    w->tx = NULL;
+    w->rx = NULL;
+    w->msgs = NULL;
+    w->count = 0;
+
+    evio_list_stop(loop, &w->base, &loop->dgram, true);
+}
+
+bool evio_dgram_set_gro(evio_dgram *w, bool on)
+{
+    int value = on;
+    return setsockopt(w->io.fd, SOL_UDP, UDP_GRO, &value, sizeof(value)) == 0;
+}
+
+void evio_dgram_send(evio_loop *loop, evio_dgram *w, const void *buf, size_t len,
+                     const struct sockaddr *addr, uint32_t addrlen)
+{
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    struct evio_dgram_tx *tx = w->tx;
+    EVIO_ASSERT(!addr || addrlen <= sizeof(struct sockaddr_storage));
+
+    if (tx->count == tx->total) {
+        tx->total = tx->total ? tx->total * 2 : EVIO_DGRAM_BATCH;
+        tx->pkts = evio_reallocarray(tx->pkts, tx->total, sizeof(*tx->pkts));
+    }
+
+    if (!tx->data || tx->len + len > tx->size) {
+        size_t size = tx->size ? tx->size : 4096;
+        while (size < tx->len + len) {
+            size *= 2;
+        }
+        tx->data = evio_realloc(tx->data, size);
+        tx->size = size;
+    }
+
+    struct evio_dgram_pkt *pkt = &tx->pkts[tx->count++];
+    pkt->off = tx->len;
+    pkt->len = len;
+    pkt->addrlen = addr ? addrlen : 0;
+    if (addr) {
+        memcpy(&pkt->addr, addr, addrlen);
+    }
+
+    if (len) {
+        memcpy(tx->data + tx->len, buf, len);
+    }
+    tx->len += len;
+    tx->queued += len;
+
+    if (!tx->blocked) {
+        evio_dgram_schedule(loop, w, true);
+    }
+}
+
+void evio_dgram_flush(evio_loop *loop, evio_dgram *w)
+{
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    if (!w->tx->blocked) {
+        evio_dgram_send_queue(loop, w);
+    }
+}
+
+size_t evio_dgram_queued(const evio_dgram *w)
+{
+    return w->tx ? w->tx->queued : 0;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+/**
+ * @file evio_dgram.h
+ * @brief A watcher for batched datagram I/O.
+ * @details Built for high-rate UDP: each readiness event receives up to
+ * `EVIO_DGRAM_BATCH` datagrams with a single `recvmmsg` call into buffers
+ * owned by the watcher, and the callback handles them as one batch.
+ *
+ * Outgoing datagrams are copied into a send queue, which is flushed with
+ * `sendmmsg` once per loop iteration, before the loop blocks. Consecutive
+ * datagrams to the same destination with the same length are sent as one
+ * `UDP_SEGMENT` message when the kernel supports it. If the socket buffer
+ * is full, the rest of the queue is sent once the socket is writable.
+ *
+ * With `evio_dgram_set_gro`, the kernel may coalesce datagrams of one flow
+ * into a single buffer; `evio_dgram_msg.segment` then holds the size of
+ * the datagrams in it.
+ */
+
+#include "evio.h"
+
+#ifndef EVIO_DGRAM_BATCH
+/** @brief The maximum number of datagrams received or sent per system call. */
+#define EVIO_DGRAM_BATCH 64
+#endif
+
+#ifndef EVIO_DGRAM_SIZE
+/** @brief The default size of each receive buffer. */
+#define EVIO_DGRAM_SIZE 2048
+#endif
+
+struct sockaddr;
+struct evio_dgram_rx;
+struct evio_dgram_tx;
+
+/** @brief A received datagram. */
+typedef struct {
+    void *data;                 /**< The payload, valid until the callback returns. */
+    size_t len;                 /**< The length of the payload. */
+    size_t segment;             /**< The size of coalesced datagrams, or 0 for a single one. */
+    const struct sockaddr *addr;/**< The source address. */
+    uint32_t addrlen;           /**< The length of the source address. */
+    bool truncated;             /**< The datagram did not fit the buffer. */
+} evio_dgram_msg;
+
+/** @brief A batched datagram watcher. */
+typedef struct evio_dgram {
+    EVIO_BASE;
+    evio_poll io;               /**< @private The poll watcher of the socket. */
+    evio_prepare flush;         /**< @private Flushes the send queue before the loop blocks. */
+    struct evio_dgram_rx *rx;   /**< @private The receive buffers. */
+    struct evio_dgram_tx *tx;   /**< @private The send queue. */
+    const evio_dgram_msg *msgs; /**< @private The received batch. */
+    size_t count;               /**< @private Number of datagrams in the received batch. */
+    size_t size;                /**< @private The size of each receive buffer. */
+    int err;                    /**< @private The last error, or 0. */
+} evio_dgram;
+
+/**
+ * @brief Initializes a datagram watcher.
+ * @details The callback receives `EVIO_READ` with a batch of datagrams (see
+ * `evio_dgram_batch`). Errors do not stop the watcher: a failed receive is
+ * reported with `EVIO_READ | EVIO_ERROR` and an empty batch, and a datagram
+ * the kernel refused to send is dropped and reported with
+ * `EVIO_WRITE | EVIO_ERROR` (see `evio_dgram_error`).
+ * @param w The datagram watcher to initialize.
+ * @param cb The callback to invoke with received datagrams.
+ * @param fd The datagram socket (non-blocking).
+ * @param size The size of each receive buffer, or 0 for `EVIO_DGRAM_SIZE`.
+ * Larger datagrams are truncated; with GRO enabled, use 65535.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_dgram_init(evio_dgram *w, evio_cb cb, int fd, size_t size);
+
+/**
+ * @brief Starts a datagram watcher.
+ * @details Allocates the receive buffers.
+ * @param loop The event loop.
+ * @param w The datagram watcher to start.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_dgram_start(evio_loop *loop, evio_dgram *w);
+
+/**
+ * @brief Stops a datagram watcher.
+ * @details Datagrams still in the send queue are discarded.
+ * @param loop The event loop.
+ * @param w The datagram watcher to stop.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_dgram_stop(evio_loop *loop, evio_dgram *w);
+
+/**
+ * @brief Enables or disables UDP generic receive offload on the socket.
+ * @param w The datagram watcher.
+ * @param on `true` to let the kernel coalesce received datagrams.
+ * @return `true` on success, `false` if the kernel does not support it.
+ */
+__evio_public __evio_nonnull(1)
+bool evio_dgram_set_gro(evio_dgram *w, bool on);
+
+/**
+ * @brief Queues a datagram for sending.
+ * @details The payload and the address are copied. The queue is flushed
+ * before the loop blocks again; queued datagrams keep their order.
+ * @param loop The event loop.
+ * @param w The active datagram watcher.
+ * @param buf The payload.
+ * @param len The length of the payload.
+ * @param addr The destination address, or `NULL` on a connected socket.
+ * @param addrlen The length of the destination address.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_dgram_send(evio_loop *loop, evio_dgram *w, const void *buf, size_t len,
+                     const struct sockaddr *addr, uint32_t addrlen);
+
+/**
+ * @brief Sends the queued datagrams right away.
+ * @param loop The event loop.
+ * @param w The datagram watcher.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_dgram_flush(evio_loop *loop, evio_dgram *w);
+
+/**
+ * @brief Gets the number of payload bytes waiting in the send queue.
+ * @details Senders may use it to apply backpressure.
+ * @param w The datagram watcher.
+ * @return The number of queued bytes.
+ */
+__evio_public __evio_nonnull(1) __evio_nodiscard
+size_t evio_dgram_queued(const evio_dgram *w);
+
+/**
+ * @brief Gets the batch of received datagrams.
+ * @details Only valid in the callback.
+ * @param w The datagram watcher.
+ * @param msgs The received datagrams.
+ * @return The number of datagrams.
+ */
+static inline __evio_nonnull(1, 2) __evio_nodiscard
+size_t evio_dgram_batch(const evio_dgram *w, const evio_dgram_msg **msgs)
+{
+    *msgs = w->msgs;
+    return w->count;
+}
+
+/**
+ * @brief Gets the last error of a datagram watcher.
+ * @param w The datagram watcher.
+ * @return The error number, or 0.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+int evio_dgram_error(const evio_dgram *w)
+{
+    return w->err;
+}
@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 #include "evio_core.h"
 #include "evio_eventfd.h"
@@ -21,10 +22,15 @@ void evio_eventfd_init(evio_loop *loop)
     }
 
     loop->event.fd = fd;
-    loop->event.emask = EVIO_POLL | EVIO_POLLET | EVIO_READ;
+    loop->event.emask = EVIO_POLL | EVIO_EDGE | EVIO_READ;
 
     evio_poll_start(loop, &loop->event);
     evio_unref(loop);
+
+    // Wake-ups from other loops may arrive as io_uring completions.
+    if (loop->iou) {
+        evio_uring_watch(loop);
+    }
 }
 
 /**
@@ -83,6 +89,46 @@ static void evio_eventfd_notify(int fd)
     }
 }
 
+/**
+ * @brief Wakes up a loop from a loop callback or another thread.
+ * @details From a callback of another loop where both loops use io_uring,
+ * the wake-up is posted as an `IORING_OP_MSG_RING` completion to the ring of
+ * the target loop, which is watched by its epoll instance. The eventfd is
+ * written otherwise, or if the message cannot be posted.
+ * @param loop The event loop to wake up.
+ */
+static void evio_eventfd_wake(evio_loop *loop)
+{
+    if (loop->iou) {
+        evio_loop *from = evio_loop_running();
+        if (from && from != loop && from->iou && evio_uring_msg(from, loop)) {
+            return;
+        }
+    }
+
+    evio_eventfd_kick(loop);
+}
+
+void evio_eventfd_kick(evio_loop *loop)
+{
+    int err = errno;
+    evio_eventfd_notify(loop->event.fd);
+    errno = err;
+}
+
+void evio_eventfd_send(evio_loop *loop)
+{
+    if (atomic_exchange_explicit(&loop->event_pending.value, 1, memory_order_acq_rel)) {
+        return;
+    }
+
+    if (!atomic_load_explicit(&loop->eventfd_allow.value, memory_order_acquire)) {
+        return;
+    }
+
+    evio_eventfd_wake(loop);
+}
+
 void evio_eventfd_write(evio_loop *loop)
 {
     if (atomic_exchange_explicit(&loop->event_pending.value, 1, memory_order_acq_rel)) {
@@ -98,10 +144,55 @@ void evio_eventfd_write(evio_loop *loop)
     errno = err;
 }
 
+void evio_eventfd_moderate(evio_loop *loop)
+{
+    const uint64_t count = atomic_fetch_add_explicit(&loop->wake_count.value, 1, memory_order_acq_rel) + 1;
+    const uint64_t batch = atomic_load_explicit(&loop->wake_batch.value, memory_order_relaxed);
+
+    if (count == 1) {
+        if (atomic_exchange_explicit(&loop->event_pending.value, 1, memory_order_acq_rel)) {
+            return;
+        }
+    } else if (count != batch) {
+        return;
+    }
+
+    // The loop is awake and sees `event_pending` before it blocks.
+    if (!atomic_load_explicit(&loop->eventfd_allow.value, memory_order_acquire)) {
+        return;
+    }
+
+    if (count == batch) {
+        evio_eventfd_wake(loop);
+        return;
+    }
+
+    int err = errno;
+    const evio_time delay = atomic_load_explicit(&loop->wake_delay.value, memory_order_acquire);
+    struct itimerspec its = {
+        .it_value.tv_sec = (time_t)(delay / EVIO_TIME_PER_SEC),
+        .it_value.tv_nsec = (long)(delay % EVIO_TIME_PER_SEC),
+    };
+    timerfd_settime(loop->wake.fd, 0, &its, NULL);
+    errno = err;
+}
+
 void evio_eventfd_cb(evio_loop *loop, evio_base *base, evio_mask emask)
 {
     EVIO_ASSERT(base == &loop->event.base);
 
+    if (__evio_unlikely(loop->wake.active)) {
+        const uint64_t batch = atomic_load_explicit(&loop->wake_batch.value, memory_order_relaxed);
+
+        // Woken by a full batch: cancel the fallback timer. No send can arm
+        // it again until the count is reset.
+        if (batch && atomic_load_explicit(&loop->wake_count.value, memory_order_acquire) >= batch) {
+            timerfd_settime(loop->wake.fd, 0, &(struct itimerspec) { 0 }, NULL);
+        }
+
+        // Reset before `event_pending`: a send counted from here on arms a new wake-up.
+        atomic_store_explicit(&loop->wake_count.value, 0, memory_order_release);
+    }
     atomic_store_explicit(&loop->event_pending.value, 0, memory_order_release);
 
     evio_signal_process_pending(loop);
@@ -111,6 +202,8 @@ void evio_eventfd_cb(evio_loop *loop, evio_base *base, evio_mask emask)
             evio_async *w = container_of(loop->async.ptr[i], evio_async, base);
 
             if (atomic_exchange_explicit(&w->status.value, 0, memory_order_acq_rel)) {
+                EVIO_PROBE2(async_wakeup, loop, w);
+                evio_trace_add(loop, EVIO_TRACE_ASYNC, (int)i, EVIO_ASYNC);
                 evio_queue_event(loop, &w->base, EVIO_ASYNC);
             }
         }
@@ -17,11 +17,42 @@ void evio_eventfd_init(evio_loop *loop);
 
 /**
  * @brief Writes to the eventfd to wake up a sleeping event loop.
+ * @details Async-signal-safe.
  * @param loop The event loop.
  */
 __evio_nonnull(1)
 void evio_eventfd_write(evio_loop *loop);
 
+/**
+ * @brief Wakes up a sleeping event loop on behalf of `evio_async_send`.
+ * @details Like `evio_eventfd_write`, but called from a callback of another
+ * io_uring loop without SQPOLL, the wake-up is posted with
+ * `IORING_OP_MSG_RING` instead.
+ * Not async-signal-safe.
+ * @param loop The event loop.
+ */
+__evio_nonnull(1)
+void evio_eventfd_send(evio_loop *loop);
+
+/**
+ * @brief Unconditionally writes to the eventfd of a loop.
+ * @details Used when a `IORING_OP_MSG_RING` wake-up could not be posted
+ * before `evio_uring_msg` returned.
+ * @param loop The event loop.
+ */
+__evio_nonnull(1)
+void evio_eventfd_kick(evio_loop *loop);
+
+/**
+ * @brief Signals pending async work subject to wake-up moderation.
+ * @details The first send since the last wake-up arms the fallback timer,
+ * the send that completes the batch writes the eventfd.
+ * Must only be called while `wake_delay` is set.
+ * @param loop The event loop.
+ */
+__evio_nonnull(1)
+void evio_eventfd_moderate(evio_loop *loop);
+
 /**
  * @brief The internal callback for handling eventfd notifications.
  * @param loop The event loop.
@@ -0,0 +1,342 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "evio_core.h"
+#include "evio_frame.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EVIO_FRAME_X86 1
+#endif
+
+/** @brief The maximum length of a 64-bit varint. */
+#define EVIO_FRAME_VARINT_MAX 10
+
+/** @brief The best kernel the CPU supports, detected once. */
+static int evio_frame_best = EVIO_FRAME_SCALAR;
+
+/** @brief Guards the CPU feature detection. */
+static pthread_once_t evio_frame_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief The portable delimiter scanning kernel.
+ * @param buf The data.
+ * @param len The length of the data.
+ * @param delim The delimiter.
+ * @return The offset of the first delimiter, or `len`.
+ */
+static size_t evio_frame_scan_scalar(const uint8_t *buf, size_t len, uint8_t delim)
+{
+    const uint8_t *p = memchr(buf, delim, len);
+    return p ? (size_t)(p - buf) : len;
+}
+
+#ifdef EVIO_FRAME_X86
+
+/**
+ * @brief The SSE2 delimiter scanning kernel.
+ * @param buf The data.
+ * @param len The length of the data.
+ * @param delim The delimiter.
+ * @return The offset of the first delimiter, or `len`.
+ */
+__attribute__((target("sse2")))
+static size_t evio_frame_scan_sse2(const uint8_t *buf, size_t len, uint8_t delim)
+{
+    const __m128i needle = _mm_set1_epi8((char)delim);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    for (; i < len; ++i) {
+        if (buf[i] == delim) {
+            return i;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief The AVX2 delimiter scanning kernel.
+ * @details Checks the first 32 bytes unaligned, then 128 aligned bytes per
+ * iteration with a single branch.
+ * @param buf The data.
+ * @param len The length of the data.
+ * @param delim The delimiter.
+ * @return The offset of the first delimiter, or `len`.
+ */
+__attribute__((target("avx2")))
+static size_t evio_frame_scan_avx2(const uint8_t *buf, size_t len, uint8_t delim)
+{
+    const __m256i needle = _mm256_set1_epi8((char)delim);
+    unsigned int mask;
+
+    if (len < 32) {
+        return evio_frame_scan_sse2(buf, len, delim);
+    }
+
+    mask = (unsigned int)_mm256_movemask_epi8(
+               _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)buf), needle));
+    if (mask) {
+        return (size_t)__builtin_ctz(mask);
+    }
+
+    // Continue from the next 32-byte boundary, overlapping the first block.
+    size_t i = 32 - ((uintptr_t)buf & 31);
+
+    for (; i + 128 <= len; i += 128) {
+        const __m256i *p = (const __m256i *)(buf + i);
+        __m256i a = _mm256_cmpeq_epi8(_mm256_load_si256(p + 0), needle);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_load_si256(p + 1), needle);
+        __m256i c = _mm256_cmpeq_epi8(_mm256_load_si256(p + 2), needle);
+        __m256i d = _mm256_cmpeq_epi8(_mm256_load_si256(p + 3), needle);
+        __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+        if (_mm256_testz_si256(any, any)) {
+            continue;
+        }
+
+        uint64_t lo = (uint32_t)_mm256_movemask_epi8(a) |
+                      (uint64_t)(uint32_t)_mm256_movemask_epi8(b) << 32;
+        if (lo) {
+            return i + (size_t)__builtin_ctzll(lo);
+        }
+        uint64_t hi = (uint32_t)_mm256_movemask_epi8(c) |
+                      (uint64_t)(uint32_t)_mm256_movemask_epi8(d) << 32;
+        return i + 64 + (size_t)__builtin_ctzll(hi);
+    }
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_load_si256((const __m256i *)(buf + i));
+        mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    if (i < len) {
+        // The last block ends at the end of the data and may overlap.
+        size_t last = len - 32;
+        __m256i v = _mm256_loadu_si256((const __m256i *)(buf + last));
+        mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+        mask >>= i - last;
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return len;
+}
+
+#endif
+
+/** @brief Detects the best kernel the CPU supports. */
+static void evio_frame_detect(void)
+{
+#ifdef EVIO_FRAME_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        evio_frame_best = EVIO_FRAME_AVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        evio_frame_best = EVIO_FRAME_SSE2; // GCOVR_EXCL_LINE
+    }
+#endif
+}
+
+bool evio_frame_set_simd(evio_frame *f, int simd)
+{
+    pthread_once(&evio_frame_once, evio_frame_detect);
+
+    if (simd == EVIO_FRAME_AUTO) {
+        simd = evio_frame_best;
+    }
+
+    if (simd < EVIO_FRAME_SCALAR || simd > evio_frame_best) {
+        return false;
+    }
+
+    switch (simd) {
+#ifdef EVIO_FRAME_X86
+        case EVIO_FRAME_AVX2:
+            f->scan = evio_frame_scan_avx2;
+            break;
+
+        case EVIO_FRAME_SSE2:
+            f->scan = evio_frame_scan_sse2;
+            break;
+#endif
+
+        default:
+            f->scan = evio_frame_scan_scalar;
+            break;
+    }
+
+    f->simd = simd;
+    return true;
+}
+
+/**
+ * @brief Initializes the fields common to all decoders.
+ * @param f The decoder.
+ * @param type The frame format.
+ * @param max The maximum frame length.
+ */
+static void evio_frame_init(evio_frame *f, int type, size_t max)
+{
+    f->max = max;
+    f->scanned = 0;
+    f->type = type;
+    f->err = 0;
+    f->delim = 0;
+    f->width = 0;
+
+    // The detected kernel is always supported.
+    evio_frame_set_simd(f, EVIO_FRAME_AUTO);
+}
+
+void evio_frame_init_delim(evio_frame *f, uint8_t delim, size_t max)
+{
+    evio_frame_init(f, EVIO_FRAME_DELIM, max);
+    f->delim = delim;
+}
+
+void evio_frame_init_varint(evio_frame *f, size_t max)
+{
+    evio_frame_init(f, EVIO_FRAME_VARINT, max);
+}
+
+void evio_frame_init_fixed(evio_frame *f, size_t width, size_t max)
+{
+    EVIO_ASSERT(width == 1 || width == 2 || width == 4 || width == 8);
+
+    evio_frame_init(f, EVIO_FRAME_FIXED, max);
+    f->width = (uint8_t)width;
+}
+
+/**
+ * @brief Finds a delimited frame.
+ * @param f The decoder.
+ * @param p The data.
+ * @param len The length of the data.
+ * @param frame The frame payload.
+ * @param size The length of the frame payload.
+ * @return Number of bytes the frame takes, or 0.
+ */
+static size_t evio_frame_parse_delim(evio_frame *f, const uint8_t *p, size_t len,
+                                     const void **frame, size_t *size)
+{
+    // Only the bytes a frame may still end in need scanning.
+    size_t limit = f->max < len ? f->max + 1 : len;
+    size_t start = f->scanned < limit ? f->scanned : limit;
+    size_t end = start + f->scan(p + start, limit - start, f->delim);
+
+    if (end == limit) {
+        f->scanned = limit;
+        if (limit > f->max) {
+            f->err = EMSGSIZE;
+        }
+        return 0;
+    }
+
+    f->scanned = 0;
+    *frame = p;
+    *size = end;
+    return end + 1;
+}
+
+/**
+ * @brief Decodes a length prefix.
+ * @param f The decoder.
+ * @param p The data.
+ * @param len The length of the data.
+ * @param value The decoded length.
+ * @return The length of the prefix, or 0 if it is not complete or invalid.
+ */
+static size_t evio_frame_prefix(evio_frame *f, const uint8_t *p, size_t len, uint64_t *value)
+{
+    if (f->type == EVIO_FRAME_FIXED) {
+        if (len < f->width) {
+            return 0;
+        }
+
+        uint64_t v = 0;
+        for (size_t i = 0; i < f->width; ++i) {
+            v = v << 8 | p[i];
+        }
+        *value = v;
+        return f->width;
+    }
+
+    uint64_t v = 0;
+    for (size_t i = 0; i < len && i < EVIO_FRAME_VARINT_MAX; ++i) {
+        v |= (uint64_t)(p[i] & 0x7f) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            // The tenth byte may only hold the top bit of a 64-bit value.
+            if (i == EVIO_FRAME_VARINT_MAX - 1 && p[i] > 1) {
+                break;
+            }
+            *value = v;
+            return i + 1;
+        }
+    }
+
+    if (len >= EVIO_FRAME_VARINT_MAX) {
+        f->err = EPROTO;
+    }
+    return 0;
+}
+
+size_t evio_frame_parse(evio_frame *f, const void *buf, size_t len,
+                        const void **frame, size_t *size)
+{
+    if (__evio_unlikely(f->err)) {
+        return 0;
+    }
+
+    const uint8_t *p = buf;
+    if (f->type == EVIO_FRAME_DELIM) {
+        return evio_frame_parse_delim(f, p, len, frame, size);
+    }
+
+    uint64_t value;
+    size_t prefix = evio_frame_prefix(f, p, len, &value);
+    if (!prefix) {
+        return 0;
+    }
+
+    if (value > f->max) {
+        f->err = EMSGSIZE;
+        return 0;
+    }
+
+    if (len - prefix < value) {
+        return 0;
+    }
+
+    *frame = p + prefix;
+    *size = (size_t)value;
+    return prefix + (size_t)value;
+}
+
+bool evio_frame_next(evio_loop *loop, evio_frame *f, evio_stream *w,
+                     const void **frame, size_t *size)
+{
+    size_t len;
+    const void *buf = evio_stream_peek(w, &len);
+    if (!len) {
+        return false;
+    }
+
+    size_t n = evio_frame_parse(f, buf, len, frame, size);
+    if (!n) {
+        return false;
+    }
+
+    evio_stream_consume(loop, w, n);
+    return true;
+}
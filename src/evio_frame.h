@@ -0,0 +1,145 @@
+#pragma once
+
+/**
+ * @file evio_frame.h
+ * @brief Frame decoders for delimited and length-prefixed protocols.
+ * @details A decoder splits the read buffer of an `evio_stream` into frames
+ * without copying them: `evio_frame_next` returns each complete frame as a
+ * pointer into the buffer, and is called in a loop from the stream callback.
+ *
+ * Delimiters are found with SSE2 or AVX2 kernels, chosen at run time from
+ * the CPU features, with a portable fallback. The scan resumes where the
+ * previous one stopped, so a frame arriving in many reads is only scanned
+ * once. Length prefixes are either little-endian base-128 varints or fixed
+ * big-endian integers of 1, 2, 4 or 8 bytes.
+ */
+
+#include "evio.h"
+
+/** @brief Frame boundary formats. */
+enum evio_frame_type {
+    EVIO_FRAME_DELIM    = 0, /**< Frames end with a delimiter byte. */
+    EVIO_FRAME_VARINT   = 1, /**< Frames start with a varint length. */
+    EVIO_FRAME_FIXED    = 2, /**< Frames start with a fixed-width big-endian length. */
+};
+
+/** @brief Delimiter scanning kernels. */
+enum evio_frame_simd {
+    EVIO_FRAME_AUTO     = 0, /**< The best kernel the CPU supports. */
+    EVIO_FRAME_SCALAR   = 1, /**< The portable kernel (`memchr`). */
+    EVIO_FRAME_SSE2     = 2, /**< 16 bytes per comparison. */
+    EVIO_FRAME_AVX2     = 3, /**< 32 bytes per comparison. */
+};
+
+/**
+ * @brief A delimiter scanning kernel.
+ * @param buf The data.
+ * @param len The length of the data.
+ * @param delim The delimiter.
+ * @return The offset of the first delimiter, or `len` if there is none.
+ */
+typedef size_t (*evio_frame_scan_fn)(const uint8_t *buf, size_t len, uint8_t delim);
+
+/** @brief A frame decoder. */
+typedef struct evio_frame {
+    evio_frame_scan_fn scan;    /**< @private The delimiter scanning kernel. */
+    size_t max;                 /**< @private The maximum frame length. */
+    size_t scanned;             /**< @private Number of bytes known to hold no delimiter. */
+    int type;                   /**< @private The frame format (`enum evio_frame_type`). */
+    int simd;                   /**< @private The kernel in use (`enum evio_frame_simd`). */
+    int err;                    /**< @private The decoding error, or 0. */
+    uint8_t delim;              /**< @private The delimiter. */
+    uint8_t width;              /**< @private The width of a fixed length prefix. */
+} evio_frame;
+
+/**
+ * @brief Initializes a decoder for delimited frames (e.g. lines).
+ * @param f The decoder to initialize.
+ * @param delim The delimiter, which is not part of the frames.
+ * @param max The maximum frame length, excluding the delimiter.
+ */
+__evio_public __evio_nonnull(1)
+void evio_frame_init_delim(evio_frame *f, uint8_t delim, size_t max);
+
+/**
+ * @brief Initializes a decoder for frames with a varint length prefix.
+ * @details The prefix is an unsigned LEB128 varint (as in protobuf).
+ * @param f The decoder to initialize.
+ * @param max The maximum frame length, excluding the prefix.
+ */
+__evio_public __evio_nonnull(1)
+void evio_frame_init_varint(evio_frame *f, size_t max);
+
+/**
+ * @brief Initializes a decoder for frames with a fixed-width length prefix.
+ * @param f The decoder to initialize.
+ * @param width The width of the big-endian prefix: 1, 2, 4 or 8 bytes.
+ * @param max The maximum frame length, excluding the prefix.
+ */
+__evio_public __evio_nonnull(1)
+void evio_frame_init_fixed(evio_frame *f, size_t width, size_t max);
+
+/**
+ * @brief Selects the delimiter scanning kernel.
+ * @param f The decoder.
+ * @param simd The kernel (`enum evio_frame_simd`).
+ * @return `false` if the CPU does not support it; the kernel is unchanged.
+ */
+__evio_public __evio_nonnull(1)
+bool evio_frame_set_simd(evio_frame *f, int simd);
+
+/**
+ * @brief Gets the delimiter scanning kernel in use.
+ * @param f The decoder.
+ * @return The kernel (`enum evio_frame_simd`), never `EVIO_FRAME_AUTO`.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+int evio_frame_get_simd(const evio_frame *f)
+{
+    return f->simd;
+}
+
+/**
+ * @brief Finds the first complete frame in a buffer.
+ * @details Until a frame is returned, each call must pass the same data,
+ * possibly extended, since the delimiter scan resumes where it stopped.
+ * @param f The decoder.
+ * @param buf The data.
+ * @param len The length of the data.
+ * @param frame The frame payload, pointing into `buf`.
+ * @param size The length of the frame payload.
+ * @return Number of bytes the frame takes in `buf`, or 0 if the frame is
+ * not complete yet or the data is invalid (see `evio_frame_error`).
+ */
+__evio_public __evio_nonnull(1, 4, 5)
+size_t evio_frame_parse(evio_frame *f, const void *buf, size_t len,
+                        const void **frame, size_t *size);
+
+/**
+ * @brief Takes the next complete frame from the read buffer of a stream.
+ * @details The frame is consumed from the stream; its data stays valid until
+ * the stream callback returns.
+ * @param loop The event loop.
+ * @param f The decoder.
+ * @param w The stream watcher.
+ * @param frame The frame payload.
+ * @param size The length of the frame payload.
+ * @return `true` if a frame was taken, `false` if none is complete yet or the
+ * data is invalid (see `evio_frame_error`).
+ */
+__evio_public __evio_nonnull(1, 2, 3, 4, 5)
+bool evio_frame_next(evio_loop *loop, evio_frame *f, evio_stream *w,
+                     const void **frame, size_t *size);
+
+/**
+ * @brief Gets the decoding error.
+ * @details Once set, no more frames are returned.
+ * @param f The decoder.
+ * @return `EMSGSIZE` for a frame above the maximum length, `EPROTO` for a
+ * malformed varint, or 0.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+int evio_frame_error(const evio_frame *f)
+{
+    return f->err;
+}
@@ -0,0 +1,478 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "evio_core.h"
+#include "evio_fs.h"
+
+#ifndef EVIO_FS_THREADS
+/** @brief The number of threads of the shared pool running file operations. */
+#define EVIO_FS_THREADS 4
+#endif
+
+/** @brief The states of an operation on the thread pool. */
+enum {
+    EVIO_FS_QUEUED  = 0, /**< Waiting for a pool thread. */
+    EVIO_FS_RUNNING = 1, /**< Being executed by a pool thread. */
+    EVIO_FS_DONE    = 2, /**< Completed, handed back to the loop. */
+};
+
+/** @brief A file operation in progress. */
+struct evio_fs_task {
+    evio_uring_req req;             /**< The io_uring request. */
+    evio_uring_file_args args;      /**< The operation and its arguments. */
+    evio_fs *w;                     /**< The owning watcher, or `NULL` once stopped. */
+    evio_loop *loop;                /**< The loop to complete the operation in. */
+    struct evio_fs_task *next;      /**< The next operation in a queue. */
+    int64_t res;                    /**< The result, once executed by a pool thread. */
+    int state;                      /**< The thread pool state. */
+    bool uring;                     /**< The operation was submitted to the ring. */
+    bool canceled;                  /**< Stopped while running on a pool thread. */
+    char path[];                    /**< The copy of the path, if any. */
+};
+
+/** @brief The completed pool operations of a loop. */
+struct evio_fs_queue {
+    evio_async async;               /**< Wakes the loop for completions. */
+    pthread_mutex_t mutex;          /**< Protects the list. */
+    struct evio_fs_task *head;      /**< The first completed operation. */
+    struct evio_fs_task *tail;      /**< The last completed operation. */
+};
+
+/** @brief The thread pool shared by all loops. */
+static struct {
+    pthread_mutex_t mutex;          /**< Protects the queue and the task states. */
+    pthread_cond_t cond;            /**< Signaled when an operation is queued. */
+    pthread_cond_t done;            /**< Signaled when a canceled operation finished. */
+    struct evio_fs_task *head;      /**< The first queued operation. */
+    struct evio_fs_task *tail;      /**< The last queued operation. */
+} evio_fs_pool = {
+    .mutex  = PTHREAD_MUTEX_INITIALIZER,
+    .cond   = PTHREAD_COND_INITIALIZER,
+    .done   = PTHREAD_COND_INITIALIZER,
+};
+
+/** @brief Starts the pool threads once. */
+static pthread_once_t evio_fs_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Executes a file operation with blocking system calls.
+ * @param args The operation and its arguments.
+ * @return The result, or a negative error code.
+ */
+static int64_t evio_fs_exec(const evio_uring_file_args *args)
+{
+    ssize_t ret;
+
+    switch (args->op) {
+        case EVIO_URING_OPEN:
+            ret = openat(args->fd, args->path, args->flags, (mode_t)args->mode);
+            break;
+
+        case EVIO_URING_READ:
+            ret = args->off < 0 ? read(args->fd, args->buf, args->len) :
+                  pread(args->fd, args->buf, args->len, (off_t)args->off);
+            break;
+
+        case EVIO_URING_WRITE:
+            ret = args->off < 0 ? write(args->fd, args->buf, args->len) :
+                  pwrite(args->fd, args->buf, args->len, (off_t)args->off);
+            break;
+
+        case EVIO_URING_FSYNC:
+            ret = args->flags ? fdatasync(args->fd) : fsync(args->fd);
+            break;
+
+        case EVIO_URING_STATX:
+            ret = statx(args->fd, args->path, args->flags, args->mode, args->buf);
+            break;
+
+        default:
+            ret = close(args->fd);
+            break;
+    }
+
+    return ret < 0 ? -errno : ret;
+}
+
+/**
+ * @brief Frees an operation whose watcher was stopped.
+ * @param task The operation, which is no longer executing.
+ */
+static void evio_fs_discard(struct evio_fs_task *task)
+{
+    if (task->args.op == EVIO_URING_OPEN && task->res >= 0) {
+        close((int)task->res);
+    }
+    evio_free(task);
+}
+
+/**
+ * @brief Completes an operation and queues the watcher callback.
+ * @param loop The event loop.
+ * @param task The operation.
+ * @param res The result of the operation.
+ */
+static void evio_fs_complete(evio_loop *loop, struct evio_fs_task *task, int64_t res)
+{
+    evio_fs *w = task->w;
+    const int op = task->args.op;
+
+    w->task = NULL;
+    w->result = res;
+    evio_free(task);
+
+    evio_list_stop(loop, &w->base, &loop->fs, true);
+
+    const bool read = op == EVIO_URING_OPEN || op == EVIO_URING_READ || op == EVIO_URING_STATX;
+    evio_queue_event(loop, &w->base, read ? EVIO_READ : EVIO_WRITE);
+}
+
+/**
+ * @brief Completion callback of a ring operation.
+ * @param loop The event loop.
+ * @param req The io_uring request of the operation.
+ * @param res The result, or a negative error code.
+ * @param more Always `false` for file operations.
+ */
+static void evio_fs_uring_cb(evio_loop *loop, evio_uring_req *req, int res, bool more)
+{
+    struct evio_fs_task *task = container_of(req, struct evio_fs_task, req);
+
+    if (__evio_unlikely(!task->w)) {
+        // Stopped: freed once the cancellation returns.
+        task->res = res;
+        return;
+    }
+
+    evio_fs_complete(loop, task, res);
+}
+
+/**
+ * @brief Internal callback for the completion queue async watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_async` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_fs_async_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    struct evio_fs_queue *q = container_of(base, struct evio_fs_queue, async.base);
+
+    pthread_mutex_lock(&q->mutex);
+    struct evio_fs_task *task = q->head;
+    q->head = NULL;
+    q->tail = NULL;
+    pthread_mutex_unlock(&q->mutex);
+
+    for (struct evio_fs_task *next; task; task = next) {
+        next = task->next;
+        evio_fs_complete(loop, task, task->res);
+    }
+}
+
+/**
+ * @brief The pool thread function.
+ * @details A completed operation is handed to its loop while the pool lock
+ * is held, so a concurrent stop either removes it from the loop queue or
+ * waits for it.
+ * @param arg Unused.
+ * @return Never returns.
+ */
+static void *evio_fs_thread(void *arg)
+{
+    pthread_mutex_lock(&evio_fs_pool.mutex);
+
+    for (;;) {
+        struct evio_fs_task *task = evio_fs_pool.head;
+        if (!task) {
+            pthread_cond_wait(&evio_fs_pool.cond, &evio_fs_pool.mutex);
+            continue;
+        }
+
+        evio_fs_pool.head = task->next;
+        if (!evio_fs_pool.head) {
+            evio_fs_pool.tail = NULL;
+        }
+        task->state = EVIO_FS_RUNNING;
+
+        pthread_mutex_unlock(&evio_fs_pool.mutex);
+        const int64_t res = evio_fs_exec(&task->args);
+        pthread_mutex_lock(&evio_fs_pool.mutex);
+
+        task->res = res;
+        task->state = EVIO_FS_DONE;
+
+        if (task->canceled) {
+            // The stopping thread frees it.
+            pthread_cond_broadcast(&evio_fs_pool.done);
+            continue;
+        }
+
+        struct evio_fs_queue *q = task->loop->fsq;
+        task->next = NULL;
+
+        pthread_mutex_lock(&q->mutex);
+        if (q->tail) {
+            q->tail->next = task;
+        } else {
+            q->head = task;
+        }
+        q->tail = task;
+        pthread_mutex_unlock(&q->mutex);
+
+        evio_async_send(task->loop, &q->async);
+    }
+
+    return NULL; // GCOVR_EXCL_LINE
+}
+
+/**
+ * @brief Starts the pool threads.
+ */
+static void evio_fs_pool_start(void)
+{
+    for (size_t i = 0; i < EVIO_FS_THREADS; ++i) {
+        pthread_t thread;
+        int rc = pthread_create(&thread, NULL, evio_fs_thread, NULL);
+        // GCOVR_EXCL_START
+        if (__evio_unlikely(rc != 0)) {
+            EVIO_ABORT("pthread_create() failed: %d\n", rc);
+        }
+        // GCOVR_EXCL_STOP
+        pthread_detach(thread);
+    }
+}
+
+/**
+ * @brief Creates the completion queue of a loop on first use.
+ * @param loop The event loop.
+ */
+static void evio_fs_queue_init(evio_loop *loop)
+{
+    if (__evio_likely(loop->fsq)) {
+        return;
+    }
+
+    struct evio_fs_queue *q = evio_malloc(sizeof(*q));
+    q->head = NULL;
+    q->tail = NULL;
+    pthread_mutex_init(&q->mutex, NULL);
+
+    // The operations hold the loop references.
+    evio_async_init(&q->async, evio_fs_async_cb);
+    evio_async_start(loop, &q->async);
+    evio_unref(loop);
+
+    loop->fsq = q;
+}
+
+/**
+ * @brief Starts an operation.
+ * @param loop The event loop.
+ * @param w The inactive file operation watcher.
+ * @param args The operation and its arguments.
+ */
+static void evio_fs_submit(evio_loop *loop, evio_fs *w, const evio_uring_file_args *args)
+{
+    EVIO_ASSERT(!w->active);
+
+    const size_t len = args->path ? strlen(args->path) + 1 : 0;
+
+    struct evio_fs_task *task = evio_malloc(sizeof(*task) + len);
+    *task = (struct evio_fs_task) {
+        .req.cb = evio_fs_uring_cb,
+        .args   = *args,
+        .w      = w,
+        .loop   = loop,
+    };
+
+    if (len) {
+        // Also keeps the path valid until the ring reads it.
+        memcpy(task->path, args->path, len);
+        task->args.path = task->path;
+    }
+
+    w->task = task;
+    evio_list_start(loop, &w->base, &loop->fs, true);
+
+    if (loop->iou && evio_uring_file(loop, &task->req, &task->args)) {
+        task->uring = true;
+        return;
+    }
+
+    evio_fs_queue_init(loop);
+    pthread_once(&evio_fs_once, evio_fs_pool_start);
+
+    pthread_mutex_lock(&evio_fs_pool.mutex);
+    if (evio_fs_pool.tail) {
+        evio_fs_pool.tail->next = task;
+    } else {
+        evio_fs_pool.head = task;
+    }
+    evio_fs_pool.tail = task;
+    pthread_cond_signal(&evio_fs_pool.cond);
+    pthread_mutex_unlock(&evio_fs_pool.mutex);
+}
+
+/**
+ * @brief Cancels an operation on the thread pool.
+ * @param loop The event loop.
+ * @param task The operation.
+ */
+static void evio_fs_cancel(evio_loop *loop, struct evio_fs_task *task)
+{
+    pthread_mutex_lock(&evio_fs_pool.mutex);
+
+    if (task->state == EVIO_FS_QUEUED) {
+        struct evio_fs_task **link = &evio_fs_pool.head, *prev = NULL;
+        while (*link != task) {
+            prev = *link;
+            link = &(*link)->next;
+        }
+        *link = task->next;
+        if (evio_fs_pool.tail == task) {
+            evio_fs_pool.tail = prev;
+        }
+        evio_free(task);
+    } else if (task->state == EVIO_FS_RUNNING) {
+        task->canceled = true;
+        while (task->state != EVIO_FS_DONE) {
+            pthread_cond_wait(&evio_fs_pool.done, &evio_fs_pool.mutex);
+        }
+        evio_fs_discard(task);
+    } else {
+        struct evio_fs_queue *q = loop->fsq;
+
+        pthread_mutex_lock(&q->mutex);
+        struct evio_fs_task **link = &q->head, *prev = NULL;
+        while (*link != task) {
+            prev = *link;
+            link = &(*link)->next;
+        }
+        *link = task->next;
+        if (q->tail == task) {
+            q->tail = prev;
+        }
+        pthread_mutex_unlock(&q->mutex);
+
+        evio_fs_discard(task);
+    }
+
+    pthread_mutex_unlock(&evio_fs_pool.mutex);
+}
+
+void evio_fs_init(evio_fs *w, evio_cb cb)
+{
+    evio_init(&w->base, cb);
+    w->task = NULL;
+    w->result = 0;
+}
+
+void evio_fs_open(evio_loop *loop, evio_fs *w, const char *path, int flags, unsigned int mode)
+{
+    evio_fs_submit(loop, w, &(evio_uring_file_args) {
+        .op     = EVIO_URING_OPEN,
+        .fd     = AT_FDCWD,
+        .path   = path,
+        .flags  = flags,
+        .mode   = mode,
+    });
+}
+
+void evio_fs_read(evio_loop *loop, evio_fs *w, int fd, void *buf, size_t len, int64_t off)
+{
+    evio_fs_submit(loop, w, &(evio_uring_file_args) {
+        .op     = EVIO_URING_READ,
+        .fd     = fd,
+        .buf    = buf,
+        .len    = len,
+        .off    = off < 0 ? -1 : off,
+    });
+}
+
+void evio_fs_write(evio_loop *loop, evio_fs *w, int fd, const void *buf, size_t len, int64_t off)
+{
+    evio_fs_submit(loop, w, &(evio_uring_file_args) {
+        .op     = EVIO_URING_WRITE,
+        .fd     = fd,
+        .buf    = (void *)buf,
+        .len    = len,
+        .off    = off < 0 ? -1 : off,
+    });
+}
+
+void evio_fs_fsync(evio_loop *loop, evio_fs *w, int fd, bool datasync)
+{
+    evio_fs_submit(loop, w, &(evio_uring_file_args) {
+        .op     = EVIO_URING_FSYNC,
+        .fd     = fd,
+        .flags  = datasync,
+    });
+}
+
+void evio_fs_statx(evio_loop *loop, evio_fs *w, int dirfd, const char *path,
+                   int flags, unsigned int mask, struct statx *buf)
+{
+    evio_fs_submit(loop, w, &(evio_uring_file_args) {
+        .op     = EVIO_URING_STATX,
+        .fd     = dirfd,
+        .path   = path,
+        .buf    = buf,
+        .flags  = flags,
+        .mode   = mask,
+    });
+}
+
+void evio_fs_close(evio_loop *loop, evio_fs *w, int fd)
+{
+    evio_fs_submit(loop, w, &(evio_uring_file_args) {
+        .op     = EVIO_URING_CLOSE,
+        .fd     = fd,
+    });
+}
+
+void evio_fs_stop(evio_loop *loop, evio_fs *w)
+{
+    evio_clear_pending(loop, &w->base);
+
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    struct evio_fs_task *task = w->task;
+    w->task = NULL;
+
+    if (task->uring) {
+        task->w = NULL;
+        task->res = -ECANCELED;
+        evio_uring_cancel(loop, &task->req, true);
+        evio_fs_discard(task);
+    } else {
+        evio_fs_cancel(loop, task);
+    }
+
+    evio_list_stop(loop, &w->base, &loop->fs, true);
+}
+
+void evio_fs_cleanup(evio_loop *loop)
+{
+    // Pool threads must not hand operations back to the freed loop: queued
+    // ones are removed and running ones are waited for, like on stop.
+    for (size_t i = loop->fs.count; i--;) {
+        evio_fs *w = container_of(loop->fs.ptr[i], evio_fs, base);
+        evio_fs_stop(loop, w);
+    }
+
+    struct evio_fs_queue *q = loop->fsq;
+    if (!q) {
+        return;
+    }
+
+    EVIO_ASSERT(!q->head);
+
+    pthread_mutex_destroy(&q->mutex);
+    evio_free(q);
+    loop->fsq = NULL;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+/**
+ * @file evio_fs.h
+ * @brief Asynchronous regular-file operations.
+ * @details Regular files cannot be watched with epoll: they are always
+ * reported ready, and a blocking read or write in a callback stalls the
+ * whole loop. An `evio_fs` watcher runs one file operation at a time off
+ * the loop and invokes its callback with the result.
+ *
+ * On loops created with `EVIO_FLAG_URING`, operations are submitted to the
+ * loop's ring. Otherwise they run on a small thread pool shared by all loops,
+ * started on first use, and completions are handed back to the loop with an
+ * internal async watcher.
+ *
+ * A watcher is active while its operation is in progress, and keeps the loop
+ * alive. The callback receives `EVIO_READ` for open, read and statx, and
+ * `EVIO_WRITE` for write, fsync and close; the result is taken with
+ * `evio_fs_result`, and the watcher can start its next operation right away.
+ */
+
+#include "evio.h"
+
+struct statx;
+struct evio_fs_task;
+
+/** @brief An asynchronous file operation watcher. */
+typedef struct evio_fs {
+    EVIO_BASE;
+    struct evio_fs_task *task;  /**< @private The operation in progress. */
+    int64_t result;             /**< @private The result of the last operation. */
+} evio_fs;
+
+/**
+ * @brief Initializes a file operation watcher.
+ * @param w The file operation watcher to initialize.
+ * @param cb The callback to invoke when an operation completes.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_fs_init(evio_fs *w, evio_cb cb);
+
+/**
+ * @brief Opens a file (`openat` relative to the working directory).
+ * @details The path is copied. The result is the new file descriptor.
+ * @param loop The event loop.
+ * @param w The inactive file operation watcher.
+ * @param path The path of the file.
+ * @param flags The `open` flags (`O_CLOEXEC` is not implied).
+ * @param mode The mode for created files.
+ */
+__evio_public __evio_nonnull(1, 2, 3)
+void evio_fs_open(evio_loop *loop, evio_fs *w, const char *path, int flags, unsigned int mode);
+
+/**
+ * @brief Reads from a file.
+ * @details The result is the number of bytes read, 0 at end of file.
+ * @param loop The event loop.
+ * @param w The inactive file operation watcher.
+ * @param fd The file descriptor.
+ * @param buf The buffer, which must stay valid until the operation completes.
+ * @param len The number of bytes to read.
+ * @param off The file offset, or -1 to read at the file position.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_fs_read(evio_loop *loop, evio_fs *w, int fd, void *buf, size_t len, int64_t off);
+
+/**
+ * @brief Writes to a file.
+ * @details The result is the number of bytes written.
+ * @param loop The event loop.
+ * @param w The inactive file operation watcher.
+ * @param fd The file descriptor.
+ * @param buf The data, which must stay valid until the operation completes.
+ * @param len The number of bytes to write.
+ * @param off The file offset, or -1 to write at the file position.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_fs_write(evio_loop *loop, evio_fs *w, int fd, const void *buf, size_t len, int64_t off);
+
+/**
+ * @brief Flushes a file to storage.
+ * @param loop The event loop.
+ * @param w The inactive file operation watcher.
+ * @param fd The file descriptor.
+ * @param datasync `true` to flush only the data and the metadata needed to read it back.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_fs_fsync(evio_loop *loop, evio_fs *w, int fd, bool datasync);
+
+/**
+ * @brief Gets the status of a file.
+ * @details The path is copied. The result is 0 on success.
+ * @param loop The event loop.
+ * @param w The inactive file operation watcher.
+ * @param dirfd The directory for relative paths (`AT_FDCWD`), or the file
+ * itself with an empty path and `AT_EMPTY_PATH`.
+ * @param path The path of the file.
+ * @param flags The `statx` flags (e.g. `AT_SYMLINK_NOFOLLOW`).
+ * @param mask The fields to get (e.g. `STATX_SIZE`).
+ * @param buf The result, which must stay valid until the operation completes.
+ */
+__evio_public __evio_nonnull(1, 2, 4, 7)
+void evio_fs_statx(evio_loop *loop, evio_fs *w, int dirfd, const char *path,
+                   int flags, unsigned int mask, struct statx *buf);
+
+/**
+ * @brief Closes a file descriptor.
+ * @param loop The event loop.
+ * @param w The inactive file operation watcher.
+ * @param fd The file descriptor.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_fs_close(evio_loop *loop, evio_fs *w, int fd);
+
+/**
+ * @brief Stops a file operation watcher.
+ * @details Cancels the operation in progress without invoking the callback.
+ * An operation the kernel or a pool thread is already executing cannot be
+ * interrupted, and this waits for it to finish, so its buffer may be reused
+ * right away. A file opened by a stopped `evio_fs_open` is closed.
+ * @param loop The event loop.
+ * @param w The file operation watcher to stop.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_fs_stop(evio_loop *loop, evio_fs *w);
+
+/**
+ * @brief Gets the result of the last completed operation.
+ * @param w The file operation watcher.
+ * @return The result of the operation, or a negative error code.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+int64_t evio_fs_result(const evio_fs *w)
+{
+    return w->result;
+}
@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
 
 #include "evio_core.h"
 #include "evio_loop.h"
@@ -9,6 +10,23 @@
 void evio_test_loop_after_timeout(evio_loop *loop, int *timeout);
 #endif
 
+/** @brief The innermost loop running `evio_run` in this thread. */
+static _Thread_local evio_loop *evio_loop_current;
+
+#ifndef EVIO_BUSY_POLL_MIN_RATE
+/**
+ * @brief The lower bound of the busy-poll hit rate, in 1/256 units.
+ * @details Keeps a minimal spin budget, so the loop notices when spinning
+ * starts to pay off again.
+ */
+#define EVIO_BUSY_POLL_MIN_RATE 16
+#endif
+
+#ifndef EVIO_BUSY_POLL_NAPI_BUDGET
+/** @brief The number of packets per NAPI busy-poll attempt (`EPIOCSPARAMS`). */
+#define EVIO_BUSY_POLL_NAPI_BUDGET 8
+#endif
+
 /**
  * @brief Gets the current monotonic time from the loop's configured clock.
  * @param loop The event loop.
@@ -17,6 +35,10 @@ void evio_test_loop_after_timeout(evio_loop *loop, int *timeout);
 static __evio_nonnull(1) __evio_nodiscard
 evio_time evio_clock_gettime(const evio_loop *loop)
 {
+    if (__evio_unlikely(loop->clock_id == EVIO_CLOCK_VIRTUAL)) {
+        return loop->time;
+    }
+
     struct timespec ts;
     int rc = clock_gettime(loop->clock_id, &ts);
     if (__evio_unlikely(rc < 0)) {
@@ -31,6 +53,7 @@ evio_time evio_clock_gettime(const evio_loop *loop)
 /**
  * @brief Calculates the timeout for the `epoll_pwait` call.
  * @details 0: don't block. -1: no timers. Otherwise: ms until next timer.
+ * With `EVIO_CLOCK_VIRTUAL`, active timers never make the loop block.
  * @param loop The event loop.
  * @return The timeout in milliseconds.
  */
@@ -48,6 +71,10 @@ static int evio_timeout(evio_loop *loop)
         return -1;
     }
 
+    if (__evio_unlikely(loop->clock_id == EVIO_CLOCK_VIRTUAL)) {
+        return 0;
+    }
+
     const evio_node *node = &loop->timer.ptr[0];
     if (node->time <= loop->time) {
         return 0;
@@ -63,7 +90,84 @@ static int evio_timeout(evio_loop *loop)
     return (int)diff_ms;
 }
 
-evio_loop *evio_loop_new(int flags)
+/**
+ * @brief Reads the monotonic clock used to bound busy-polling.
+ * @details Independent of the loop clock, which may be coarse or virtual.
+ * @return The current time in nanoseconds.
+ */
+static evio_time evio_busy_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return EVIO_TIME_FROM_SEC(ts.tv_sec) + EVIO_TIME(ts.tv_nsec);
+}
+
+/**
+ * @brief Polls without blocking for up to the current spin budget.
+ * @details Producers skip the eventfd write while `eventfd_allow` is clear,
+ * so `event_pending` is checked on every spin. The hit rate is an
+ * exponentially weighted average of recent spins, and scales the budget.
+ * @param loop The event loop.
+ * @param timeout The blocking timeout in milliseconds, reduced by the time spent spinning.
+ * @return `true` if events were received, `false` if the loop should block.
+ */
+static bool evio_busy_poll(evio_loop *loop, int *timeout)
+{
+    evio_time budget = loop->busy_budget;
+    if (*timeout > 0 && budget > EVIO_TIME_FROM_MSEC(*timeout)) {
+        budget = EVIO_TIME_FROM_MSEC(*timeout);
+    }
+
+    const evio_time start = evio_busy_now();
+    evio_time elapsed = 0;
+    bool hit = false;
+
+    do {
+        if (atomic_load_explicit(&loop->event_pending.value, memory_order_acquire)) {
+            hit = true;
+            break;
+        }
+
+        evio_poll_wait(loop, 0);
+        if (loop->pending[loop->pending_queue].count) {
+            hit = true;
+            break;
+        }
+
+        elapsed = evio_busy_now() - start;
+    } while (elapsed < budget);
+
+    uint32_t rate = loop->busy_rate;
+    rate = hit ? rate + ((256 - rate) >> 3) : rate - (rate >> 3);
+    if (rate < EVIO_BUSY_POLL_MIN_RATE) {
+        rate = EVIO_BUSY_POLL_MIN_RATE;
+    }
+    loop->busy_rate = rate;
+    loop->busy_budget = loop->busy_max / 256 * rate + loop->busy_max % 256 * rate / 256;
+
+    if (!hit && *timeout > 0) {
+        const evio_time spent = elapsed / EVIO_TIME_PER_MSEC;
+        *timeout = spent < (evio_time)*timeout ? *timeout - (int)spent : 0;
+    }
+
+    return hit;
+}
+
+evio_loop *evio_loop_running(void)
+{
+    return evio_loop_current;
+}
+
+/**
+ * @brief Creates a new event loop.
+ * @param flags Flags to customize loop creation.
+ * @param depth The io_uring submission queue depth, or 0 for the default.
+ * @param cpu The CPU for the submission queue polling thread, or -1.
+ * @param parent The io_uring instance to attach to, or NULL.
+ * @return A new event loop instance, or NULL on failure.
+ */
+static evio_loop *evio_loop_create(int flags, uint32_t depth, int cpu,
+                                   const evio_uring *parent)
 {
     int fd = epoll_create1(EPOLL_CLOEXEC);
     if (__evio_unlikely(fd < 0)) {
@@ -76,14 +180,18 @@ evio_loop *evio_loop_new(int flags)
     loop->fd = fd;
     loop->event.cb = evio_eventfd_cb;
     loop->event.fd = -1;
+    loop->wake.fd = -1;
 
     atomic_init(&loop->eventfd_allow.value, 0);
     atomic_init(&loop->event_pending.value, 0);
     atomic_init(&loop->async_pending.value, 0);
     atomic_init(&loop->signal_pending.value, 0);
+    atomic_init(&loop->wake_delay.value, 0);
+    atomic_init(&loop->wake_batch.value, 0);
+    atomic_init(&loop->wake_count.value, 0);
 
-    if (flags & EVIO_FLAG_URING) {
-        loop->iou = evio_uring_new();
+    if (flags & (EVIO_FLAG_URING | EVIO_FLAG_SQPOLL)) {
+        loop->iou = evio_uring_new(flags, depth, cpu, parent);
     }
 
     // GCOVR_EXCL_START
@@ -103,9 +211,37 @@ evio_loop *evio_loop_new(int flags)
 
     sigemptyset(&loop->sigmask);
     sigaddset(&loop->sigmask, SIGPROF);
+
     return loop;
 }
 
+evio_loop *evio_loop_new(int flags)
+{
+    return evio_loop_create(flags, 0, -1, NULL);
+}
+
+evio_loop *evio_loop_new_uring(int flags, uint32_t depth)
+{
+    return evio_loop_create(flags | EVIO_FLAG_URING, depth, -1, NULL);
+}
+
+evio_loop *evio_loop_new_sqpoll(int flags, uint32_t depth, int cpu)
+{
+    return evio_loop_create(flags | EVIO_FLAG_SQPOLL, depth, cpu, NULL);
+}
+
+evio_loop *evio_loop_new_attached(int flags, uint32_t depth, const evio_loop *parent)
+{
+    const evio_uring *iou = parent->iou;
+
+    flags |= EVIO_FLAG_URING;
+    if (iou && evio_uring_sqpoll(iou)) {
+        flags |= EVIO_FLAG_SQPOLL;
+    }
+
+    return evio_loop_create(flags, depth, -1, iou);
+}
+
 void evio_loop_free(evio_loop *loop)
 {
     loop->pending[0].count = 0;
@@ -117,6 +253,9 @@ void evio_loop_free(evio_loop *loop)
     }
 
     evio_signal_cleanup_loop(loop);
+    evio_fs_cleanup(loop);
+    evio_watchdog_stop(loop);
+    evio_trace_stop(loop);
 
     if (loop->iou) {
         evio_uring_free(loop->iou);
@@ -126,6 +265,10 @@ void evio_loop_free(evio_loop *loop)
         close(loop->event.fd);
     }
 
+    if (loop->wake.fd >= 0) {
+        close(loop->wake.fd);
+    }
+
     if (loop->fd >= 0) {
         close(loop->fd);
     }
@@ -147,7 +290,21 @@ void evio_loop_free(evio_loop *loop)
     evio_free(loop->check.ptr);
     evio_free(loop->cleanup.ptr);
     evio_free(loop->once.ptr);
+    evio_free(loop->accept.ptr);
+    evio_free(loop->zsend.ptr);
+    evio_free(loop->relay.ptr);
+    evio_free(loop->dgram.ptr);
+    evio_free(loop->stream.ptr);
+    evio_free(loop->cork.ptr);
+    evio_free(loop->child.ptr);
+    evio_free(loop->fs.ptr);
     evio_free(loop->events.ptr);
+
+    // A run left by a jumping abort handler keeps the loop current.
+    if (evio_loop_current == loop) {
+        evio_loop_current = NULL;
+    }
+
     evio_free(loop);
 }
 
@@ -198,11 +355,43 @@ void evio_set_clockid(evio_loop *loop, clockid_t clock_id)
     loop->time = evio_clock_gettime(loop);
 }
 
+void evio_step_time(evio_loop *loop, evio_time delta)
+{
+    if (__evio_unlikely(loop->clock_id != EVIO_CLOCK_VIRTUAL)) {
+        return;
+    }
+
+    loop->time = delta > EVIO_TIME_MAX - loop->time ? EVIO_TIME_MAX : loop->time + delta;
+}
+
 clockid_t evio_get_clockid(const evio_loop *loop)
 {
     return loop->clock_id;
 }
 
+void evio_set_busy_poll(evio_loop *loop, evio_time budget)
+{
+    loop->busy_max = budget;
+    loop->busy_budget = budget;
+    loop->busy_rate = 256;
+
+#ifdef EPIOCSPARAMS
+    const evio_time usecs = budget / EVIO_TIME_PER_USEC;
+    struct epoll_params params = {
+        .busy_poll_usecs = usecs < UINT32_MAX ? (uint32_t)usecs : UINT32_MAX,
+        .busy_poll_budget = budget ? EVIO_BUSY_POLL_NAPI_BUDGET : 0,
+    };
+
+    // Optional: unsupported kernels and missing privileges are not errors.
+    (void)ioctl(loop->fd, EPIOCSPARAMS, &params);
+#endif
+}
+
+evio_time evio_get_busy_poll(const evio_loop *loop)
+{
+    return loop->busy_max;
+}
+
 int evio_run(evio_loop *loop, int flags)
 {
     int done = loop->done;
@@ -212,9 +401,32 @@ int evio_run(evio_loop *loop, int flags)
 
     flags &= EVIO_RUN_NOWAIT | EVIO_RUN_ONCE;
     loop->done = EVIO_BREAK_CANCEL;
+
+    evio_loop *outer = evio_loop_current;
+    evio_loop_current = loop;
+
+    // The ring fd is registered with this thread for the run only: a loop may
+    // be run by different threads over its lifetime. Short runs keep the fd
+    // lookup instead of two extra syscalls.
+    const bool ring = loop->iou && flags == EVIO_RUN_DEFAULT &&
+                      evio_uring_register_ring(loop->iou);
+
+    // A nested run restores the outer callback's heartbeat state on return.
+    evio_cb outer_cb = NULL;
+    uint64_t outer_idle = EVIO_BEAT_IDLE;
+    if (__evio_unlikely(loop->wd)) {
+        outer_cb = atomic_load_explicit(&loop->wd_cb.value, memory_order_relaxed);
+        outer_idle = atomic_load_explicit(&loop->wd_beat.value, memory_order_relaxed) & EVIO_BEAT_IDLE;
+    }
+
+    evio_heartbeat(loop, NULL, 0);
     evio_invoke_pending(loop);
 
     do {
+        evio_heartbeat(loop, NULL, 0);
+        EVIO_PROBE1(iter_start, loop);
+        evio_recorder_add(loop, EVIO_REC_ITER, -1, 0, NULL, loop->rec_head);
+
         if (loop->prepare.count) {
             evio_queue_events(loop, loop->prepare.ptr, loop->prepare.count, EVIO_PREPARE);
             evio_invoke_pending(loop);
@@ -224,9 +436,18 @@ int evio_run(evio_loop *loop, int flags)
             break;
         }
 
+        // Data corked by prepare watchers or outside the loop.
+        if (loop->cork.count) {
+            evio_cork_flush(loop);
+        }
+
         evio_poll_update(loop);
 
-        atomic_store_explicit(&loop->eventfd_allow.value, 1, memory_order_release);
+        // While busy-polling, producers skip the eventfd write.
+        const bool busy = __evio_unlikely(loop->busy_max) && !(flags & EVIO_RUN_NOWAIT);
+        if (__evio_likely(!busy)) {
+            atomic_store_explicit(&loop->eventfd_allow.value, 1, memory_order_release);
+        }
 
         int timeout = (flags & EVIO_RUN_NOWAIT) ? 0 : evio_timeout(loop);
 
@@ -234,11 +455,24 @@ int evio_run(evio_loop *loop, int flags)
         evio_test_loop_after_timeout(loop, &timeout);
 #endif
 
-        if (timeout && atomic_load_explicit(&loop->event_pending.value, memory_order_acquire)) {
-            timeout = 0;
+        evio_heartbeat(loop, NULL, EVIO_BEAT_IDLE);
+
+        bool polled = false;
+        if (__evio_unlikely(busy)) {
+            polled = timeout && evio_busy_poll(loop, &timeout);
+            if (!polled) {
+                atomic_store_explicit(&loop->eventfd_allow.value, 1, memory_order_release);
+            }
+        }
+
+        if (__evio_likely(!polled)) {
+            if (timeout && atomic_load_explicit(&loop->event_pending.value, memory_order_acquire)) {
+                timeout = 0;
+            }
+            evio_poll_wait(loop, timeout);
         }
 
-        evio_poll_wait(loop, timeout);
+        evio_heartbeat(loop, NULL, 0);
         atomic_store_explicit(&loop->eventfd_allow.value, 0, memory_order_relaxed);
 
         if (atomic_load_explicit(&loop->event_pending.value, memory_order_acquire) &&
@@ -259,6 +493,14 @@ int evio_run(evio_loop *loop, int flags)
             evio_queue_events(loop, loop->check.ptr, loop->check.count, EVIO_CHECK);
             evio_invoke_pending(loop);
         }
+
+        // One write per corked fd for all the callbacks of this iteration.
+        if (loop->cork.count) {
+            evio_cork_flush(loop);
+            evio_invoke_pending(loop);
+        }
+
+        EVIO_PROBE1(iter_end, loop);
     } while (__evio_likely(
                  loop->refcount &&
                  loop->done == EVIO_BREAK_CANCEL &&
@@ -269,6 +511,18 @@ int evio_run(evio_loop *loop, int flags)
     EVIO_ASSERT(loop->pending[loop->pending_queue].count == 0);
     // GCOVR_EXCL_STOP
 
+    // Submit requests queued by the last callbacks, like cross-loop wake-ups.
+    if (loop->iou_count) {
+        evio_uring_flush(loop);
+    }
+
+    if (ring) {
+        evio_uring_unregister_ring(loop->iou);
+    }
+
+    evio_loop_current = outer;
+    evio_heartbeat(loop, outer_cb, outer_idle);
+
     if (loop->done == EVIO_BREAK_ALL) {
         return 0;
     }
@@ -10,6 +10,14 @@
 
 #include "evio.h"
 
+/**
+ * @brief A virtual clock source for `evio_set_clockid`.
+ * @details The loop time only advances through `evio_step_time`, and the loop
+ * never sleeps waiting for timers, so timer behaviour can be simulated faster
+ * than real time. Not a valid kernel clock.
+ */
+#define EVIO_CLOCK_VIRTUAL ((clockid_t)0x7fffffff)
+
 /**
  * @brief Creates a new event loop.
  * @param flags Flags to customize loop creation (e.g., `EVIO_FLAG_URING`).
@@ -18,6 +26,55 @@
 __evio_public __evio_nodiscard
 evio_loop *evio_loop_new(int flags);
 
+/**
+ * @brief Creates a new event loop with an io_uring of the given depth.
+ * @details `EVIO_FLAG_URING` is implied. A deeper ring submits more
+ * `epoll_ctl` operations per `io_uring_enter` call when many watchers change
+ * in one iteration. Operations that do not fit in the ring are queued and
+ * submitted in ring-sized batches at the end of the update.
+ * @param flags Flags to customize loop creation (e.g., `EVIO_FLAG_SINGLE_THREAD`).
+ * @param depth The number of submission queue entries, or 0 for the default.
+ * Rounded up to a power of two and clamped by the kernel.
+ * @return A new event loop instance, or NULL on failure.
+ */
+__evio_public __evio_nodiscard
+evio_loop *evio_loop_new_uring(int flags, uint32_t depth);
+
+/**
+ * @brief Creates a new event loop that submits io_uring operations from a
+ * kernel polling thread.
+ * @details `EVIO_FLAG_SQPOLL` is implied. While the polling thread is awake,
+ * `epoll_ctl` operations cost no system call; it goes to sleep after a
+ * second without submissions and is woken up on the next one. The loop still
+ * waits for the results before blocking in `epoll_wait`, by polling the
+ * completion queue. If the kernel refuses the polling thread (e.g. for lack
+ * of permission or an invalid CPU), the loop falls back to the regular
+ * io_uring mode.
+ * @param flags Flags to customize loop creation (e.g., `EVIO_FLAG_SINGLE_THREAD`).
+ * @param depth The number of submission queue entries, or 0 for the default.
+ * @param cpu The CPU to pin the polling thread to, or -1 to leave it unpinned.
+ * @return A new event loop instance, or NULL on failure.
+ */
+__evio_public __evio_nodiscard
+evio_loop *evio_loop_new_sqpoll(int flags, uint32_t depth, int cpu);
+
+/**
+ * @brief Creates a new io_uring event loop attached to the ring of another loop.
+ * @details The new ring is set up with `IORING_SETUP_ATTACH_WQ`, so it shares
+ * the async workers of `parent` instead of getting its own, and its
+ * submission queue polling thread if `parent` has one (`EVIO_FLAG_SQPOLL` is
+ * then implied). The number of kernel threads stays the same however many
+ * loops are attached. `parent` may run on another thread and may be freed
+ * before the attached loops. If `parent` has no ring, this is the same as
+ * `evio_loop_new_uring`.
+ * @param flags Flags to customize loop creation (e.g., `EVIO_FLAG_SINGLE_THREAD`).
+ * @param depth The number of submission queue entries, or 0 for the default.
+ * @param parent The loop to attach to.
+ * @return A new event loop instance, or NULL on failure.
+ */
+__evio_public __evio_nodiscard __evio_nonnull(3)
+evio_loop *evio_loop_new_attached(int flags, uint32_t depth, const evio_loop *parent);
+
 /**
  * @brief Frees an event loop and all associated resources.
  * Invokes cleanup watchers.
@@ -84,12 +141,23 @@ void *evio_get_userdata(const evio_loop *loop);
 
 /**
  * @brief Sets the loop's clock source ID.
+ * @details Switching to `EVIO_CLOCK_VIRTUAL` keeps the current loop time.
  * @param loop The event loop.
  * @param clock_id The new `clockid_t` to use (e.g., `CLOCK_MONOTONIC`).
  */
 __evio_public __evio_nonnull(1)
 void evio_set_clockid(evio_loop *loop, clockid_t clock_id);
 
+/**
+ * @brief Advances the loop time of a loop using `EVIO_CLOCK_VIRTUAL`.
+ * @details Timers that become due fire on the next loop iteration.
+ * The time saturates at `EVIO_TIME_MAX`. No-op for other clock sources.
+ * @param loop The event loop.
+ * @param delta The time to advance by, in nanoseconds.
+ */
+__evio_public __evio_nonnull(1)
+void evio_step_time(evio_loop *loop, evio_time delta);
+
 /**
  * @brief Gets the loop's current clock source ID.
  * @param loop The event loop.
@@ -98,6 +166,31 @@ void evio_set_clockid(evio_loop *loop, clockid_t clock_id);
 __evio_public __evio_nonnull(1) __evio_nodiscard
 clockid_t evio_get_clockid(const evio_loop *loop);
 
+/**
+ * @brief Enables adaptive busy-polling before the loop blocks.
+ * @details Instead of blocking in `epoll_pwait` right away, the loop polls
+ * without a timeout for up to the spin budget, which trades CPU time for
+ * wake-up latency. The budget in use adapts to the recent hit rate: it
+ * shrinks while spinning rarely finds events and grows back up to `budget`
+ * when it does. While spinning, `evio_async_send` and signals from other
+ * threads skip the eventfd write.
+ *
+ * Where the kernel supports it (`EPIOCSPARAMS`), the epoll instance is also
+ * configured for NAPI busy-polling of the same duration.
+ * @param loop The event loop.
+ * @param budget The maximum spin time in nanoseconds, or 0 to disable.
+ */
+__evio_public __evio_nonnull(1)
+void evio_set_busy_poll(evio_loop *loop, evio_time budget);
+
+/**
+ * @brief Gets the busy-poll spin budget limit.
+ * @param loop The event loop.
+ * @return The value set with `evio_set_busy_poll`, 0 if disabled.
+ */
+__evio_public __evio_nonnull(1) __evio_nodiscard
+evio_time evio_get_busy_poll(const evio_loop *loop);
+
 /**
  * @brief Runs the event loop.
  * @details Returns 0 if `refcount == 0` or stopped via `EVIO_BREAK_ALL`.
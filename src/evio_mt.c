@@ -0,0 +1,422 @@
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "evio_core.h"
+#include "evio_mt.h"
+
+#ifndef EVIO_MT_EVENTS
+/**
+ * @brief The maximum number of events a worker takes per `epoll_wait`.
+ * @details Events taken by a worker are disarmed and wait for that worker,
+ * so a single event per wake-up keeps a slow callback from holding back
+ * other ready file descriptors.
+ */
+#define EVIO_MT_EVENTS 1
+#endif
+
+/** @brief The number of slots per slot chunk. */
+#define EVIO_MT_CHUNK 1024u
+
+/** @brief The maximum number of slot chunks. */
+#define EVIO_MT_CHUNKS 4096u
+
+/** @brief The `epoll_event` data of the stop eventfd. */
+#define EVIO_MT_WAKE UINT64_MAX
+
+/**
+ * @brief The slot state flags, the generation is kept in the upper 32 bits.
+ * @details A slot with neither `ARMED` nor `RUNNING` set is free.
+ */
+enum {
+    EVIO_MT_ARMED   = 0x1, /**< Registered and waiting for an event. */
+    EVIO_MT_RUNNING = 0x2, /**< A worker owns the watcher. */
+    EVIO_MT_PENDING = 0x4, /**< An event arrived while running. */
+    EVIO_MT_STOP    = 0x8, /**< Stopped while running. */
+};
+
+/** @brief The dispatcher state of a watcher. */
+typedef struct {
+    _Atomic uint64_t state;     /**< The generation and the state flags. */
+    _Atomic uint32_t events;    /**< The epoll events received while running. */
+    evio_mt_poll *w;            /**< The watcher, valid while active. */
+    uint32_t next;              /**< The next free slot (1-based), or 0. */
+} evio_mt_slot;
+
+/** @brief The internal state of a multi-threaded dispatcher. */
+struct evio_mt {
+    int fd;                     /**< The shared epoll file descriptor. */
+    int wake;                   /**< The eventfd that stops the workers. */
+    pthread_mutex_t mutex;      /**< Protects the slot allocation. */
+    pthread_cond_t cond;        /**< Signaled when a running watcher is stopped. */
+    uint32_t free;              /**< The first free slot (1-based), or 0. */
+    uint32_t count;             /**< The number of allocated slots. */
+    size_t nthreads;            /**< The number of worker threads. */
+    pthread_t *threads;         /**< The worker threads. */
+    _Atomic(evio_mt_slot *) chunks[EVIO_MT_CHUNKS]; /**< The slot chunks. */
+};
+
+/** @brief The slot whose callback runs on the current thread. */
+static _Thread_local evio_mt_slot *evio_mt_current;
+
+/**
+ * @brief Converts an event mask to epoll events.
+ * @param emask The event mask.
+ * @return The epoll events, including `EPOLLONESHOT`.
+ */
+static inline uint32_t evio_mt_events(evio_mask emask)
+{
+    return ((emask & EVIO_READ)  ? EPOLLIN  : 0) |
+           ((emask & EVIO_WRITE) ? EPOLLOUT : 0) | EPOLLONESHOT;
+}
+
+/**
+ * @brief Converts epoll events to an event mask.
+ * @param events The epoll events.
+ * @return The event mask.
+ */
+static inline evio_mask evio_mt_emask(uint32_t events)
+{
+    return ((events & (EPOLLIN  | EPOLLERR | EPOLLHUP)) ? EVIO_READ  : 0) |
+           ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) ? EVIO_WRITE : 0);
+}
+
+/**
+ * @brief Looks up a slot by its 0-based index.
+ * @details Chunks are never freed while the dispatcher exists, so the lookup
+ * needs no lock.
+ * @param mt The dispatcher.
+ * @param idx The slot index.
+ * @return The slot.
+ */
+static inline evio_mt_slot *evio_mt_slot_get(evio_mt *mt, uint32_t idx)
+{
+    evio_mt_slot *chunk = atomic_load_explicit(&mt->chunks[idx / EVIO_MT_CHUNK],
+                                               memory_order_acquire);
+    return &chunk[idx % EVIO_MT_CHUNK];
+}
+
+/**
+ * @brief Registers or re-arms a watcher in the shared epoll set.
+ * @param mt The dispatcher.
+ * @param op `EPOLL_CTL_ADD` or `EPOLL_CTL_MOD`.
+ * @param fd The file descriptor.
+ * @param emask The events to watch.
+ * @param idx The slot index.
+ * @param gen The slot generation.
+ * @return The result of `epoll_ctl`.
+ */
+static int evio_mt_ctl(evio_mt *mt, int op, int fd, evio_mask emask, uint32_t idx, uint32_t gen)
+{
+    struct epoll_event ev = {
+        .events = evio_mt_events(emask),
+        .data.u64 = ((uint64_t)gen << 32) | idx,
+    };
+    return epoll_ctl(mt->fd, op, fd, &ev);
+}
+
+/**
+ * @brief Frees a slot and bumps its generation.
+ * @details Events still queued for the old generation are dropped.
+ * @param mt The dispatcher.
+ * @param s The slot.
+ * @param idx The slot index.
+ */
+static void evio_mt_slot_release(evio_mt *mt, evio_mt_slot *s, uint32_t idx)
+{
+    pthread_mutex_lock(&mt->mutex);
+    uint64_t gen = atomic_load_explicit(&s->state, memory_order_relaxed) >> 32;
+    atomic_store_explicit(&s->state, (gen + 1) << 32, memory_order_release);
+    atomic_store_explicit(&s->events, 0, memory_order_relaxed);
+    s->w = NULL;
+    s->next = mt->free;
+    mt->free = idx + 1;
+    pthread_cond_broadcast(&mt->cond);
+    pthread_mutex_unlock(&mt->mutex);
+}
+
+/**
+ * @brief Dispatches an event to a watcher.
+ * @details The worker that moves the slot from `ARMED` to `RUNNING` owns the
+ * watcher until it is re-armed. An event that arrives after the watcher was
+ * re-armed but before the owner released it is handed over to the owner
+ * with `PENDING`, so the callback never runs concurrently.
+ * @param mt The dispatcher.
+ * @param data The `epoll_event` data (generation and slot index).
+ * @param events The received epoll events.
+ */
+static void evio_mt_dispatch(evio_mt *mt, uint64_t data, uint32_t events)
+{
+    const uint32_t idx = (uint32_t)data;
+    const uint32_t gen = (uint32_t)(data >> 32);
+    evio_mt_slot *s = evio_mt_slot_get(mt, idx);
+
+    uint64_t st = atomic_load_explicit(&s->state, memory_order_acquire);
+    for (;;) {
+        if ((uint32_t)(st >> 32) != gen || !(st & (EVIO_MT_ARMED | EVIO_MT_RUNNING))) {
+            return; // Stale event of a stopped watcher
+        }
+
+        if (st & EVIO_MT_RUNNING) {
+            atomic_fetch_or_explicit(&s->events, events, memory_order_relaxed);
+            if (atomic_compare_exchange_weak_explicit(&s->state, &st, st | EVIO_MT_PENDING,
+                                                      memory_order_acq_rel, memory_order_acquire)) {
+                return;
+            }
+            continue;
+        }
+
+        if (atomic_compare_exchange_weak_explicit(&s->state, &st,
+                                                  (st & ~(uint64_t)EVIO_MT_ARMED) | EVIO_MT_RUNNING,
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            break;
+        }
+    }
+
+    evio_mt_poll *w = s->w;
+    const int fd = w->fd;
+    events |= atomic_exchange_explicit(&s->events, 0, memory_order_relaxed);
+
+    for (;;) {
+        evio_mt_current = s;
+        w->cb(mt, w, evio_mt_emask(events));
+        evio_mt_current = NULL;
+
+        st = atomic_load_explicit(&s->state, memory_order_acquire);
+        if (st & EVIO_MT_STOP) {
+            // The watcher may be gone already, do not touch it.
+            evio_mt_slot_release(mt, s, idx);
+            return;
+        }
+
+        // Re-arm while still owning the watcher. A failure means that the
+        // fd was closed without stopping the watcher; nothing can be done.
+        evio_mt_ctl(mt, EPOLL_CTL_MOD, fd, w->emask, idx, gen);
+
+        for (;;) {
+            if (st & EVIO_MT_STOP) {
+                evio_mt_slot_release(mt, s, idx);
+                return;
+            }
+
+            if (st & EVIO_MT_PENDING) {
+                if (atomic_compare_exchange_weak_explicit(&s->state, &st, st & ~(uint64_t)EVIO_MT_PENDING,
+                                                          memory_order_acq_rel, memory_order_acquire)) {
+                    events = atomic_exchange_explicit(&s->events, 0, memory_order_relaxed);
+                    break;
+                }
+                continue;
+            }
+
+            if (atomic_compare_exchange_weak_explicit(&s->state, &st,
+                                                      (st & ~(uint64_t)EVIO_MT_RUNNING) | EVIO_MT_ARMED,
+                                                      memory_order_acq_rel, memory_order_acquire)) {
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief A worker thread.
+ * @param ptr The dispatcher.
+ * @return Always `NULL`.
+ */
+static void *evio_mt_thread(void *ptr)
+{
+    evio_mt *mt = ptr;
+    struct epoll_event events[EVIO_MT_EVENTS];
+
+    for (;;) {
+        int n = epoll_wait(mt->fd, events, EVIO_MT_EVENTS, -1);
+        // GCOVR_EXCL_START
+        if (__evio_unlikely(n < 0)) {
+            int err = errno;
+            if (err == EINTR) {
+                continue;
+            }
+            EVIO_ABORT("epoll_wait() failed, error %d: %s\n", err, EVIO_STRERROR(err));
+        }
+        // GCOVR_EXCL_STOP
+
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.u64 == EVIO_MT_WAKE) {
+                return NULL;
+            }
+            evio_mt_dispatch(mt, events[i].data.u64, events[i].events);
+        }
+    }
+}
+
+evio_mt *evio_mt_new(size_t threads)
+{
+    if (!threads) {
+        threads = 1;
+    }
+
+    evio_mt *mt = evio_calloc(1, sizeof(*mt));
+
+    mt->fd = epoll_create1(EPOLL_CLOEXEC);
+    // GCOVR_EXCL_START
+    if (__evio_unlikely(mt->fd < 0)) {
+        int err = errno;
+        EVIO_ABORT("epoll_create1() failed, error %d: %s\n", err, EVIO_STRERROR(err));
+    }
+    // GCOVR_EXCL_STOP
+
+    mt->wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    // GCOVR_EXCL_START
+    if (__evio_unlikely(mt->wake < 0)) {
+        int err = errno;
+        EVIO_ABORT("eventfd() failed, error %d: %s\n", err, EVIO_STRERROR(err));
+    }
+    // GCOVR_EXCL_STOP
+
+    // Level-triggered and never drained: once signaled, it wakes every worker.
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.u64 = EVIO_MT_WAKE,
+    };
+    // GCOVR_EXCL_START
+    if (__evio_unlikely(epoll_ctl(mt->fd, EPOLL_CTL_ADD, mt->wake, &ev) < 0)) {
+        int err = errno;
+        EVIO_ABORT("epoll_ctl() failed, error %d: %s\n", err, EVIO_STRERROR(err));
+    }
+    // GCOVR_EXCL_STOP
+
+    pthread_mutex_init(&mt->mutex, NULL);
+    pthread_cond_init(&mt->cond, NULL);
+
+    mt->threads = evio_calloc(threads, sizeof(*mt->threads));
+    for (size_t i = 0; i < threads; ++i) {
+        int rc = pthread_create(&mt->threads[i], NULL, evio_mt_thread, mt);
+        // GCOVR_EXCL_START
+        if (__evio_unlikely(rc != 0)) {
+            EVIO_ABORT("pthread_create() failed: %d\n", rc);
+        }
+        // GCOVR_EXCL_STOP
+        mt->nthreads++;
+    }
+
+    return mt;
+}
+
+void evio_mt_free(evio_mt *mt)
+{
+    uint64_t value = 1;
+    // GCOVR_EXCL_START
+    if (__evio_unlikely(write(mt->wake, &value, sizeof(value)) != sizeof(value))) {
+        int err = errno;
+        EVIO_ABORT("write() failed, error %d: %s\n", err, EVIO_STRERROR(err));
+    }
+    // GCOVR_EXCL_STOP
+
+    for (size_t i = 0; i < mt->nthreads; ++i) {
+        pthread_join(mt->threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < EVIO_MT_CHUNKS; ++i) {
+        evio_free(atomic_load_explicit(&mt->chunks[i], memory_order_relaxed));
+    }
+
+    pthread_cond_destroy(&mt->cond);
+    pthread_mutex_destroy(&mt->mutex);
+    close(mt->wake);
+    close(mt->fd);
+    evio_free(mt->threads);
+    evio_free(mt);
+}
+
+int evio_mt_poll_start(evio_mt *mt, evio_mt_poll *w)
+{
+    if (__evio_unlikely(w->slot)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&mt->mutex);
+
+    uint32_t idx;
+    if (mt->free) {
+        idx = mt->free - 1;
+        mt->free = evio_mt_slot_get(mt, idx)->next;
+    } else {
+        idx = mt->count;
+        // GCOVR_EXCL_START
+        if (__evio_unlikely(idx >= EVIO_MT_CHUNK * EVIO_MT_CHUNKS)) {
+            EVIO_ABORT("Too many evio_mt watchers\n");
+        }
+        // GCOVR_EXCL_STOP
+
+        if (idx % EVIO_MT_CHUNK == 0) {
+            evio_mt_slot *chunk = evio_calloc(EVIO_MT_CHUNK, sizeof(*chunk));
+            atomic_store_explicit(&mt->chunks[idx / EVIO_MT_CHUNK], chunk, memory_order_release);
+        }
+        mt->count++;
+    }
+
+    evio_mt_slot *s = evio_mt_slot_get(mt, idx);
+    const uint32_t gen = (uint32_t)(atomic_load_explicit(&s->state, memory_order_relaxed) >> 32);
+    s->w = w;
+    s->next = 0;
+    atomic_store_explicit(&s->state, ((uint64_t)gen << 32) | EVIO_MT_ARMED, memory_order_release);
+
+    pthread_mutex_unlock(&mt->mutex);
+
+    __atomic_store_n(&w->slot, idx + 1, __ATOMIC_RELAXED);
+
+    if (__evio_unlikely(evio_mt_ctl(mt, EPOLL_CTL_ADD, w->fd, w->emask, idx, gen) < 0)) {
+        int err = errno;
+        __atomic_store_n(&w->slot, 0, __ATOMIC_RELAXED);
+        evio_mt_slot_release(mt, s, idx);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+void evio_mt_poll_stop(evio_mt *mt, evio_mt_poll *w)
+{
+    if (__evio_unlikely(!w->slot)) {
+        return;
+    }
+
+    const uint32_t idx = w->slot - 1;
+    evio_mt_slot *s = evio_mt_slot_get(mt, idx);
+    __atomic_store_n(&w->slot, 0, __ATOMIC_RELAXED);
+
+    uint64_t st = atomic_load_explicit(&s->state, memory_order_acquire);
+    for (;;) {
+        if (st & EVIO_MT_RUNNING) {
+            if (atomic_compare_exchange_weak_explicit(&s->state, &st, st | EVIO_MT_STOP,
+                                                      memory_order_acq_rel, memory_order_acquire)) {
+                break;
+            }
+            continue;
+        }
+
+        // Armed: no worker owns the watcher, events of this generation are dropped.
+        if (atomic_compare_exchange_weak_explicit(&s->state, &st, st | EVIO_MT_RUNNING | EVIO_MT_STOP,
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            epoll_ctl(mt->fd, EPOLL_CTL_DEL, w->fd, NULL);
+            evio_mt_slot_release(mt, s, idx);
+            return;
+        }
+    }
+
+    // The watcher is running: its owner releases the slot once the callback
+    // returns. Unregister now, while the fd is known to be open.
+    epoll_ctl(mt->fd, EPOLL_CTL_DEL, w->fd, NULL);
+
+    if (evio_mt_current == s) {
+        return;
+    }
+
+    const uint32_t gen = (uint32_t)(st >> 32);
+    pthread_mutex_lock(&mt->mutex);
+    while ((uint32_t)(atomic_load_explicit(&s->state, memory_order_acquire) >> 32) == gen) {
+        pthread_cond_wait(&mt->cond, &mt->mutex);
+    }
+    pthread_mutex_unlock(&mt->mutex);
+}
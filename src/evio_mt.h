@@ -0,0 +1,132 @@
+#pragma once
+
+/**
+ * @file evio_mt.h
+ * @brief A multi-threaded dispatcher sharing one epoll set between workers.
+ * @details An alternative to sharding file descriptors across per-thread
+ * loops for workloads where the cost per connection is very uneven. All
+ * watchers are registered with `EPOLLONESHOT` in one epoll instance, and any
+ * of the worker threads can pick up a ready file descriptor. A watcher is
+ * re-armed after its callback returns, so a given watcher never runs on two
+ * threads at once, while different watchers run in parallel.
+ *
+ * Events are tagged with a slot index and a generation counter, so an event
+ * dequeued for a watcher that has been stopped in the meantime is dropped.
+ *
+ * The dispatcher has no timers or other watcher types: callbacks that need
+ * them should hand work over to a regular `evio_loop` (e.g. with
+ * `evio_async_send`).
+ */
+
+#include "evio.h"
+
+/** @brief An opaque multi-threaded dispatcher. */
+typedef struct evio_mt evio_mt;
+
+/** @brief A file descriptor watcher of a multi-threaded dispatcher. */
+typedef struct evio_mt_poll evio_mt_poll;
+
+/**
+ * @brief The type for multi-threaded watcher callbacks.
+ * @details Runs on one of the worker threads. The same watcher is never
+ * invoked concurrently, and it is not re-armed until the callback returns.
+ * @param mt The dispatcher.
+ * @param w The watcher that received the event.
+ * @param emask The received event mask (`EVIO_READ` and/or `EVIO_WRITE`).
+ */
+typedef void (*evio_mt_cb)(evio_mt *mt, evio_mt_poll *w, evio_mask emask);
+
+/** @brief A file descriptor watcher of a multi-threaded dispatcher. */
+struct evio_mt_poll {
+    evio_mt_cb cb;      /**< The callback function. */
+    void *data;         /**< User data pointer. */
+    int fd;             /**< The file descriptor to watch. */
+    evio_mask emask;    /**< The events to watch (`EVIO_READ`, `EVIO_WRITE`). */
+    uint32_t slot;      /**< @private 1-based slot index, or 0 if stopped (atomic stores). */
+};
+
+/**
+ * @brief Initializes a multi-threaded watcher.
+ * @param w The watcher to initialize.
+ * @param cb The callback to invoke on events.
+ * @param fd The file descriptor to watch.
+ * @param emask The events to watch (`EVIO_READ`, `EVIO_WRITE`).
+ */
+static inline __evio_nonnull(1, 2)
+void evio_mt_poll_init(evio_mt_poll *w, evio_mt_cb cb, int fd, evio_mask emask)
+{
+    w->cb = cb;
+    w->data = NULL;
+    w->fd = fd;
+    w->emask = emask & (EVIO_READ | EVIO_WRITE);
+    w->slot = 0;
+}
+
+/**
+ * @brief Changes the events of a multi-threaded watcher.
+ * @details Must only be called from the watcher's own callback, or while the
+ * watcher is stopped. The new events take effect when the watcher is re-armed.
+ * @param w The watcher.
+ * @param emask The events to watch (`EVIO_READ`, `EVIO_WRITE`).
+ */
+static inline __evio_nonnull(1)
+void evio_mt_poll_set(evio_mt_poll *w, evio_mask emask)
+{
+    w->emask = emask & (EVIO_READ | EVIO_WRITE);
+}
+
+/**
+ * @brief Checks if a multi-threaded watcher is active.
+ * @details May be called from any thread. A start or stop running on another
+ * thread at the same time may or may not be seen.
+ * @param w The watcher.
+ * @return `true` if the watcher is started.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+bool evio_mt_poll_is_active(const evio_mt_poll *w)
+{
+    return __atomic_load_n(&w->slot, __ATOMIC_RELAXED) != 0;
+}
+
+/**
+ * @brief Creates a dispatcher and starts its worker threads.
+ * @param threads The number of worker threads (at least one is started).
+ * @return The new dispatcher.
+ */
+__evio_public __evio_nodiscard __evio_returns_nonnull
+evio_mt *evio_mt_new(size_t threads);
+
+/**
+ * @brief Stops the worker threads and frees the dispatcher.
+ * @details Waits for running callbacks to return. All watchers should be
+ * stopped before, but their file descriptors are not closed either way.
+ * Must not be called from a worker thread.
+ * @param mt The dispatcher.
+ */
+__evio_public __evio_nonnull(1)
+void evio_mt_free(evio_mt *mt);
+
+/**
+ * @brief Starts a multi-threaded watcher.
+ * @details If the watcher is already active, this is a no-op.
+ * May be called from any thread, including worker callbacks.
+ * @param mt The dispatcher.
+ * @param w The watcher to start.
+ * @return 0 on success, or -1 with `errno` set if the file descriptor
+ * could not be registered.
+ */
+__evio_public __evio_nonnull(1, 2)
+int evio_mt_poll_start(evio_mt *mt, evio_mt_poll *w);
+
+/**
+ * @brief Stops a multi-threaded watcher.
+ * @details If the watcher is not active, this is a no-op. When called from
+ * the watcher's own callback, it is not re-armed once the callback returns,
+ * and the watcher may be freed right away. When the callback is running on
+ * another thread, this waits for it to return. In both cases the watcher is
+ * never invoked again after this returns.
+ * @param mt The dispatcher.
+ * @param w The watcher to stop.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_mt_poll_stop(evio_mt *mt, evio_mt_poll *w);
@@ -0,0 +1,285 @@
+#include "evio_core.h"
+#include "evio_pacer.h"
+
+/** @brief Caps refill times, so that sums of loop times never overflow. */
+#define EVIO_PACER_TIME_MAX (EVIO_TIME_MAX / 4)
+
+/**
+ * @brief A token bucket.
+ * @details Stored as the time the bucket is full again (GCRA): taking `n`
+ * tokens moves that time `n / rate` seconds forward, and is allowed while it
+ * stays within `limit` (the refill time of the whole bucket) of the loop
+ * time.
+ */
+struct evio_pacer_bucket {
+    evio_time tat;      /**< The time the bucket is full again. */
+    evio_time limit;    /**< The refill time of `burst` tokens. */
+    uint64_t rate;      /**< Tokens per second, 0 for a free entry. */
+    uint64_t burst;     /**< The bucket size. */
+    uint64_t want;      /**< Tokens the paused watcher waits for. */
+    evio_poll *w;       /**< The paused watcher, or `NULL`. */
+    uint32_t paused;    /**< 1-based index in the paused list, or 0. */
+    uint32_t next;      /**< 1-based index of the next free entry, or 0. */
+};
+
+/**
+ * @brief Computes the refill time of a number of tokens, rounded up.
+ * @param n Number of tokens.
+ * @param rate Tokens per second.
+ * @return The refill time in nanoseconds.
+ */
+static evio_time evio_pacer_cost(uint64_t n, uint64_t rate)
+{
+    uint64_t sec = n / rate;
+    if (sec >= EVIO_PACER_TIME_MAX / EVIO_TIME_PER_SEC) {
+        return EVIO_PACER_TIME_MAX;
+    }
+    return sec * EVIO_TIME_PER_SEC + ((n % rate) * EVIO_TIME_PER_SEC + rate - 1) / rate;
+}
+
+/**
+ * @brief Looks up a bucket.
+ * @param p The pacer.
+ * @param id The index of the bucket.
+ * @return The bucket.
+ */
+static struct evio_pacer_bucket *evio_pacer_bucket(const evio_pacer *p, uint32_t id)
+{
+    EVIO_ASSERT(id < p->count && p->buckets[id].rate);
+    return &p->buckets[id];
+}
+
+/**
+ * @brief Gets the time a paused watcher is resumed.
+ * @param b The bucket.
+ * @return The time the bucket holds the tokens the watcher waits for.
+ */
+static evio_time evio_pacer_wake(const struct evio_pacer_bucket *b)
+{
+    evio_time t = b->tat + evio_pacer_cost(b->want, b->rate);
+    return t > b->limit ? t - b->limit : 0;
+}
+
+/**
+ * @brief Sets the internal timer to expire at a loop time.
+ * @details Moves the timer in the heap rather than stopping it, so that an
+ * expiry already queued for the current iteration is kept.
+ * @param loop The event loop.
+ * @param p The pacer.
+ * @param wake The expiry time.
+ */
+static void evio_pacer_arm(evio_loop *loop, evio_pacer *p, evio_time wake)
+{
+    if (wake < loop->time) {
+        wake = loop->time;
+    }
+
+    p->wake = wake;
+    if (!p->tm.active) {
+        evio_timer_start(loop, &p->tm, wake - loop->time);
+        return;
+    }
+
+    loop->timer.ptr[p->tm.active - 1].time = wake;
+    evio_heap_adjust(loop->timer.ptr, p->tm.active - 1, loop->timer.count);
+}
+
+/**
+ * @brief Removes a bucket from the paused list.
+ * @details The paused watcher is forgotten, and not started.
+ * @param loop The event loop.
+ * @param p The pacer.
+ * @param b The bucket.
+ */
+static void evio_pacer_unpause(evio_loop *loop, evio_pacer *p, struct evio_pacer_bucket *b)
+{
+    if (!b->paused) {
+        return;
+    }
+
+    size_t idx = b->paused - 1;
+    size_t count = --p->npaused;
+    if (idx < count) {
+        p->paused[idx] = p->paused[count];
+        p->buckets[p->paused[idx]].paused = (uint32_t)idx + 1;
+    }
+
+    b->paused = 0;
+    b->w = NULL;
+    b->want = 0;
+
+    if (!count) {
+        evio_timer_stop(loop, &p->tm);
+    }
+}
+
+/**
+ * @brief Internal callback for the refill timer.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_timer` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_pacer_timer_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_pacer *p = container_of(base, evio_pacer, tm.base);
+    evio_time next = EVIO_TIME_MAX;
+
+    for (size_t i = 0; i < p->npaused;) {
+        struct evio_pacer_bucket *b = &p->buckets[p->paused[i]];
+        evio_time wake = evio_pacer_wake(b);
+
+        if (wake > loop->time) {
+            if (wake < next) {
+                next = wake;
+            }
+            ++i;
+            continue;
+        }
+
+        // The last entry moves to this slot.
+        evio_poll *w = b->w;
+        evio_pacer_unpause(loop, p, b);
+        evio_poll_start(loop, w);
+    }
+
+    if (p->npaused) {
+        evio_pacer_arm(loop, p, next);
+    }
+}
+
+void evio_pacer_init(evio_pacer *p)
+{
+    evio_timer_init(&p->tm, evio_pacer_timer_cb, 0);
+    p->buckets = NULL;
+    p->count = 0;
+    p->total = 0;
+    p->paused = NULL;
+    p->npaused = 0;
+    p->paused_total = 0;
+    p->wake = 0;
+    p->free = 0;
+}
+
+void evio_pacer_stop(evio_loop *loop, evio_pacer *p)
+{
+    evio_timer_stop(loop, &p->tm);
+    evio_free(p->buckets);
+    evio_free(p->paused);
+    evio_pacer_init(p);
+}
+
+uint32_t evio_pacer_add(evio_pacer *p, uint64_t rate, uint64_t burst)
+{
+    EVIO_ASSERT(rate > 0 && rate <= EVIO_PACER_RATE_MAX && burst > 0);
+
+    uint32_t id;
+    if (p->free) {
+        id = p->free - 1;
+        p->free = p->buckets[id].next;
+    } else {
+        if (__evio_unlikely(p->count >= UINT32_MAX)) {
+            EVIO_ABORT("Too many buckets\n"); // GCOVR_EXCL_LINE
+        }
+        p->buckets = evio_list_ensure(p->buckets, sizeof(*p->buckets),
+                                      p->count + 1, &p->total);
+        id = (uint32_t)p->count++;
+    }
+
+    p->buckets[id] = (struct evio_pacer_bucket) {
+        .limit = evio_pacer_cost(burst, rate),
+        .rate = rate,
+        .burst = burst,
+    };
+    return id;
+}
+
+void evio_pacer_remove(evio_loop *loop, evio_pacer *p, uint32_t id)
+{
+    struct evio_pacer_bucket *b = evio_pacer_bucket(p, id);
+    evio_pacer_unpause(loop, p, b);
+    b->rate = 0;
+    b->next = p->free;
+    p->free = id + 1;
+}
+
+uint64_t evio_pacer_available(const evio_loop *loop, const evio_pacer *p, uint32_t id)
+{
+    const struct evio_pacer_bucket *b = evio_pacer_bucket(p, id);
+    if (b->tat <= loop->time) {
+        return b->burst;
+    }
+
+    evio_time debt = b->tat - loop->time;
+    if (debt >= b->limit) {
+        return 0;
+    }
+
+    // Rounded down, so that the result can always be taken.
+    evio_time t = b->limit - debt;
+    uint64_t n = t / EVIO_TIME_PER_SEC * b->rate +
+                 t % EVIO_TIME_PER_SEC * b->rate / EVIO_TIME_PER_SEC;
+    return n < b->burst ? n : b->burst;
+}
+
+void evio_pacer_set(evio_loop *loop, evio_pacer *p, uint32_t id,
+                    uint64_t rate, uint64_t burst)
+{
+    EVIO_ASSERT(rate > 0 && rate <= EVIO_PACER_RATE_MAX && burst > 0);
+
+    uint64_t n = evio_pacer_available(loop, p, id);
+    struct evio_pacer_bucket *b = evio_pacer_bucket(p, id);
+
+    b->rate = rate;
+    b->burst = burst;
+    b->limit = evio_pacer_cost(burst, rate);
+    b->tat = loop->time + b->limit - evio_pacer_cost(n < burst ? n : burst, rate);
+
+    if (b->paused) {
+        if (b->want > burst) {
+            b->want = burst;
+        }
+
+        evio_time wake = evio_pacer_wake(b);
+        if (wake < p->wake) {
+            evio_pacer_arm(loop, p, wake);
+        }
+    }
+}
+
+bool evio_pacer_take(evio_loop *loop, evio_pacer *p, uint32_t id,
+                     uint64_t n, evio_poll *w)
+{
+    struct evio_pacer_bucket *b = evio_pacer_bucket(p, id);
+    if (__evio_unlikely(n > b->burst)) {
+        return false;
+    }
+
+    evio_time cost = evio_pacer_cost(n, b->rate);
+    evio_time t = b->tat > loop->time ? b->tat : loop->time;
+    if (t + cost <= loop->time + b->limit) {
+        b->tat = t + cost;
+        return true;
+    }
+
+    if (!w) {
+        return false;
+    }
+
+    evio_poll_stop(loop, w);
+    b->w = w;
+    b->want = n;
+
+    if (!b->paused) {
+        p->paused = evio_list_ensure(p->paused, sizeof(*p->paused),
+                                     p->npaused + 1, &p->paused_total);
+        p->paused[p->npaused++] = id;
+        b->paused = (uint32_t)p->npaused;
+    }
+
+    // The timer only moves for a refill earlier than all the others.
+    evio_time wake = evio_pacer_wake(b);
+    if (!p->tm.active || wake < p->wake) {
+        evio_pacer_arm(loop, p, wake);
+    }
+    return false;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+/**
+ * @file evio_pacer.h
+ * @brief Token bucket rate limiting for many tenants on one timer.
+ * @details A pacer holds any number of token buckets in one array, addressed
+ * by index. Each bucket refills at its own rate up to its burst size. Taking
+ * tokens is a few arithmetic operations on the bucket; the buckets are
+ * refilled lazily from the loop time, so idle buckets cost nothing.
+ *
+ * When a bucket runs out, `evio_pacer_take` can pause a poll watcher: the
+ * watcher is stopped and started again once the bucket holds the requested
+ * tokens. All paused watchers share one internal timer, armed for the
+ * earliest refill, so pacing adds a single entry to the timer heap however
+ * many tenants are paused.
+ */
+
+#include "evio.h"
+
+/** @brief The highest bucket rate, in tokens per second (about 18 billion). */
+#define EVIO_PACER_RATE_MAX (EVIO_TIME_MAX / EVIO_TIME_PER_SEC)
+
+struct evio_pacer_bucket;
+
+/** @brief A set of token buckets. */
+typedef struct evio_pacer {
+    evio_timer tm;                      /**< @private Resumes paused watchers. */
+    struct evio_pacer_bucket *buckets;  /**< @private The buckets, by index. */
+    size_t count;                       /**< @private Number of entries in `buckets`. */
+    size_t total;                       /**< @private Capacity of `buckets`. */
+    uint32_t *paused;                   /**< @private Indexes of the buckets with paused watchers. */
+    size_t npaused;                     /**< @private Number of entries in `paused`. */
+    size_t paused_total;                /**< @private Capacity of `paused`. */
+    evio_time wake;                     /**< @private The time the timer is armed for. */
+    uint32_t free;                      /**< @private 1-based index of the first free bucket, or 0. */
+} evio_pacer;
+
+/**
+ * @brief Initializes a pacer.
+ * @param p The pacer to initialize.
+ */
+__evio_public __evio_nonnull(1)
+void evio_pacer_init(evio_pacer *p);
+
+/**
+ * @brief Stops a pacer and frees its buckets.
+ * @details Paused watchers stay stopped.
+ * @param loop The event loop.
+ * @param p The pacer.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_pacer_stop(evio_loop *loop, evio_pacer *p);
+
+/**
+ * @brief Adds a token bucket.
+ * @details The bucket starts full. Indexes of removed buckets are reused.
+ * @param p The pacer.
+ * @param rate The refill rate, in tokens per second (1 to `EVIO_PACER_RATE_MAX`).
+ * @param burst The bucket size, in tokens (at least 1).
+ * @return The index of the bucket.
+ */
+__evio_public __evio_nonnull(1) __evio_nodiscard
+uint32_t evio_pacer_add(evio_pacer *p, uint64_t rate, uint64_t burst);
+
+/**
+ * @brief Removes a token bucket.
+ * @details A watcher paused on the bucket stays stopped. A paused watcher
+ * must not be freed before its bucket is removed.
+ * @param loop The event loop.
+ * @param p The pacer.
+ * @param id The index of the bucket.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_pacer_remove(evio_loop *loop, evio_pacer *p, uint32_t id);
+
+/**
+ * @brief Changes the rate and size of a token bucket.
+ * @details The tokens the bucket holds are kept, up to the new size.
+ * A paused watcher is resumed at the refill time for the new rate.
+ * @param loop The event loop.
+ * @param p The pacer.
+ * @param id The index of the bucket.
+ * @param rate The refill rate, in tokens per second (1 to `EVIO_PACER_RATE_MAX`).
+ * @param burst The bucket size, in tokens (at least 1).
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_pacer_set(evio_loop *loop, evio_pacer *p, uint32_t id,
+                    uint64_t rate, uint64_t burst);
+
+/**
+ * @brief Takes tokens from a bucket, pausing a watcher if there are too few.
+ * @details Either all the tokens are taken, or none. In the latter case, if
+ * `w` is not `NULL` it is stopped and started again once the bucket holds
+ * `n` tokens; the callback then takes them. A watcher paused on the bucket
+ * before is replaced (and stays stopped). Taking more than the bucket size
+ * always fails, and never pauses.
+ * @param loop The event loop.
+ * @param p The pacer.
+ * @param id The index of the bucket.
+ * @param n Number of tokens to take.
+ * @param w The poll watcher to pause, or `NULL`.
+ * @return `true` if the tokens were taken.
+ */
+__evio_public __evio_nonnull(1, 2)
+bool evio_pacer_take(evio_loop *loop, evio_pacer *p, uint32_t id,
+                     uint64_t n, evio_poll *w);
+
+/**
+ * @brief Gets the number of tokens in a bucket.
+ * @param loop The event loop.
+ * @param p The pacer.
+ * @param id The index of the bucket.
+ * @return The number of tokens that can be taken now.
+ */
+__evio_public __evio_nonnull(1, 2) __evio_nodiscard
+uint64_t evio_pacer_available(const evio_loop *loop, const evio_pacer *p, uint32_t id);
+
+/**
+ * @brief Gets the number of paused watchers.
+ * @param p The pacer.
+ * @return The number of watchers waiting for tokens.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+size_t evio_pacer_paused(const evio_pacer *p)
+{
+    return p->npaused;
+}
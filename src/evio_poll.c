@@ -4,6 +4,59 @@
 #include "evio_core.h"
 #include "evio_poll.h"
 
+/**
+ * @brief Removes an fd from epoll so it can be added again.
+ * @details `EPOLL_CTL_MOD` fails with EINVAL for fds registered with
+ * `EPOLLEXCLUSIVE` (and for any fd switching to it), so those are
+ * re-registered instead. Errors surface on the following add.
+ * @param loop The event loop.
+ * @param fd The file descriptor.
+ */
+static void evio_poll_readd(evio_loop *loop, int fd)
+{
+    evio_recorder_add(loop, EVIO_REC_FD_CTL, fd, 0, NULL, EPOLL_CTL_DEL);
+    (void)epoll_ctl(loop->fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+/**
+ * @brief Queues a write event for a lazy watcher if its fd was last reported writable.
+ * @details No new edge arrives for an fd that stayed writable, so turning
+ * write interest on has to replay the remembered readiness. The readiness is
+ * only remembered from events of the current registration.
+ * @param loop The event loop.
+ * @param w The lazy poll watcher.
+ */
+static void evio_poll_lazy_write(evio_loop *loop, evio_poll *w)
+{
+    const evio_fds *fds = &loop->fds.ptr[w->fd];
+
+    if ((w->emask & EVIO_WRITE) &&
+        (fds->emask & EVIO_LAZY) &&
+        (fds->flags & EVIO_FD_WRITABLE)) {
+        evio_queue_event(loop, &w->base, EVIO_POLL | EVIO_WRITE);
+    }
+}
+
+/**
+ * @brief Drops events a lazy watcher no longer wants from its pending event.
+ * @param loop The event loop.
+ * @param w The lazy poll watcher.
+ */
+static void evio_poll_lazy_mask(evio_loop *loop, evio_poll *w)
+{
+    if (!w->base.pending) {
+        return;
+    }
+
+    evio_pending_list *pending = &loop->pending[evio_pending_get_queue(&w->base)];
+    evio_pending *p = &pending->ptr[evio_pending_get_index(&w->base)];
+
+    p->emask &= ~(EVIO_READ | EVIO_WRITE) | w->emask;
+    if (!(p->emask & (EVIO_READ | EVIO_WRITE))) {
+        evio_clear_pending(loop, &w->base);
+    }
+}
+
 void evio_poll_start(evio_loop *loop, evio_poll *w)
 {
     EVIO_ASSERT(w->fd >= 0);
@@ -33,6 +86,10 @@ void evio_poll_start(evio_loop *loop, evio_poll *w)
 
     evio_queue_fd_change(loop, w->fd, w->emask & EVIO_POLL);
     w->emask &= ~EVIO_POLL;
+
+    if (w->emask & EVIO_LAZY) {
+        evio_poll_lazy_write(loop, w);
+    }
 }
 
 void evio_poll_stop(evio_loop *loop, evio_poll *w)
@@ -58,19 +115,22 @@ void evio_poll_stop(evio_loop *loop, evio_poll *w)
 
 void evio_poll_change(evio_loop *loop, evio_poll *w, int fd, evio_mask emask)
 {
-    emask &= EVIO_READ | EVIO_WRITE;
+    emask &= EVIO_READ | EVIO_WRITE | EVIO_EDGE | EVIO_LAZY | EVIO_EXCLUSIVE;
+    if (emask & EVIO_LAZY) {
+        emask |= EVIO_EDGE;
+    }
 
     if (fd != w->fd) {
         evio_poll_stop(loop, w);
         evio_poll_set(w, fd, emask);
 
-        if (emask) {
+        if (emask & (EVIO_READ | EVIO_WRITE)) {
             evio_poll_start(loop, w);
         }
         return;
     }
 
-    if (!emask) {
+    if (!(emask & (EVIO_READ | EVIO_WRITE))) {
         evio_poll_stop(loop, w);
         w->emask = 0;
         return;
@@ -84,11 +144,27 @@ void evio_poll_change(evio_loop *loop, evio_poll *w, int fd, evio_mask emask)
 
     EVIO_ASSERT(w->fd >= 0 && (size_t)w->fd < loop->fds.count);
 
-    if (w->emask != emask) {
+    if (w->emask == emask) {
+        return;
+    }
+
+    if (w->emask & emask & EVIO_LAZY) {
+        // Lazy write interest: the fd stays armed for EPOLLOUT.
+        const evio_mask old = w->emask;
         w->emask = emask;
-        evio_clear_pending(loop, &w->base);
-        evio_queue_fd_change(loop, w->fd, EVIO_POLL);
+        evio_poll_lazy_mask(loop, w);
+        if (!(old & EVIO_WRITE)) {
+            evio_poll_lazy_write(loop, w);
+        }
+        if (!(loop->fds.ptr[w->fd].emask & EVIO_LAZY) || ((old ^ emask) & EVIO_READ)) {
+            evio_queue_fd_change(loop, w->fd, 0);
+        }
+        return;
     }
+
+    w->emask = emask;
+    evio_clear_pending(loop, &w->base);
+    evio_queue_fd_change(loop, w->fd, EVIO_POLL);
 }
 
 void evio_poll_update(evio_loop *loop)
@@ -107,17 +183,32 @@ void evio_poll_update(evio_loop *loop)
 
         fds->changes = 0;
         fds->emask = 0;
-        fds->flags = 0;
+        fds->flags &= EVIO_FD_WRITABLE;
 
+        // Edge-triggered, lazy or exclusive only if every watcher on the fd asks for it.
+        evio_mask mode = EVIO_EDGE | EVIO_LAZY | EVIO_EXCLUSIVE;
         for (size_t i = fds->list.count; i--;) {
             const evio_poll *w = container_of(fds->list.ptr[i], const evio_poll, base);
             fds->emask |= w->emask;
+            mode &= w->emask;
         }
 
-        fds->emask &= EVIO_POLLET | EVIO_READ | EVIO_WRITE;
+        fds->emask &= EVIO_READ | EVIO_WRITE;
+        if (fds->emask) {
+            fds->emask |= mode;
+            if (mode & EVIO_LAZY) {
+                fds->emask |= EVIO_WRITE;
+            } else {
+                fds->flags &= ~EVIO_FD_WRITABLE;
+            }
+        }
 
         if (!fds->emask) {
-            fds->emask = emask;
+            // The registration stays, but the fd number may be reused before
+            // the next start: forget the readiness and the lazy mode of the
+            // last watchers. The exclusive bit still describes the registration.
+            fds->emask = emask & ~(EVIO_EDGE | EVIO_LAZY);
+            fds->flags &= ~EVIO_FD_WRITABLE;
             if (fds->errors) {
                 evio_flush_fd_error(loop, fds->errors - 1);
                 fds->errors = 0;
@@ -129,13 +220,19 @@ void evio_poll_update(evio_loop *loop)
             continue;
         }
 
-        ev.events = ((fds->emask & EVIO_READ)   ? EPOLLIN  : 0) |
-                    ((fds->emask & EVIO_WRITE)  ? EPOLLOUT : 0) |
-                    ((fds->emask & EVIO_POLLET) ? EPOLLET  : 0);
-
+        ev.events = evio_poll_events(fds->emask);
         ev.data.u64 = ((uint64_t)fd) | ((uint64_t)++fds->gen << 32);
 
+        // Only EPOLLOUT reported for the new generation counts as writable:
+        // the kernel reports the current readiness of a modified or added fd.
+        fds->flags &= ~EVIO_FD_WRITABLE;
+
         int op = emask ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if (__evio_unlikely((emask | fds->emask) & EVIO_EXCLUSIVE) && op == EPOLL_CTL_MOD) {
+            evio_poll_readd(loop, fd);
+            op = EPOLL_CTL_ADD;
+        }
+        evio_recorder_add(loop, EVIO_REC_FD_CTL, fd, fds->emask, NULL, op);
 
         if (loop->iou) {
             evio_uring_ctl(loop, op, fd, &ev);
@@ -191,6 +288,8 @@ void evio_poll_wait(evio_loop *loop, int timeout)
         timeout = 0;
     }
 
+    EVIO_PROBE2(poll_enter, loop, timeout);
+
     int events_count;
     for (;;) {
         events_count = epoll_pwait(loop->fd,
@@ -209,6 +308,8 @@ void evio_poll_wait(evio_loop *loop, int timeout)
         EVIO_ABORT("epoll_pwait() failed, error %d: %s\n", err, EVIO_STRERROR(err));
     }
 
+    EVIO_PROBE2(poll_exit, loop, events_count);
+
     for (size_t i = 0; i < (size_t)events_count; ++i) {
         struct epoll_event *ev = &loop->events.ptr[i];
 
@@ -237,14 +338,28 @@ void evio_poll_wait(evio_loop *loop, int timeout)
         evio_mask emask =
             ((ev->events & (EPOLLIN  | EPOLLERR | EPOLLHUP)) ? EVIO_READ   : 0) |
             ((ev->events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) ? EVIO_WRITE  : 0) |
-            ((ev->events & (EPOLLET))                        ? EVIO_POLLET : 0);
+            ((ev->events & (EPOLLET))                        ? EVIO_EDGE   : 0);
+
+        evio_recorder_add(loop, EVIO_REC_POLL, fd, emask, NULL, ev->events);
+        evio_trace_add(loop, EVIO_TRACE_POLL, fd, emask & (EVIO_READ | EVIO_WRITE));
+
+        if (fds->emask & EVIO_LAZY) {
+            if (ev->events & EPOLLOUT) {
+                fds->flags |= EVIO_FD_WRITABLE;
+            } else {
+                fds->flags &= ~EVIO_FD_WRITABLE;
+            }
+        }
 
         if (__evio_unlikely(emask & ~fds->emask)) {
-            ev->events = ((fds->emask & EVIO_READ)   ? EPOLLIN  : 0) |
-                         ((fds->emask & EVIO_WRITE)  ? EPOLLOUT : 0) |
-                         ((fds->emask & EVIO_POLLET) ? EPOLLET  : 0);
+            ev->events = evio_poll_events(fds->emask);
 
             int op = fds->emask ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+            if (__evio_unlikely(fds->emask & EVIO_EXCLUSIVE)) {
+                evio_poll_readd(loop, fd);
+                op = EPOLL_CTL_ADD;
+            }
+            evio_recorder_add(loop, EVIO_REC_FD_CTL, fd, fds->emask, NULL, op);
 
             // GCOVR_EXCL_START
             if (!loop->iou || op == EPOLL_CTL_DEL) {
@@ -289,6 +404,7 @@ void evio_poll_wait(evio_loop *loop, int timeout)
 
         // GCOVR_EXCL_START
         if (fds->emask && __evio_likely(!fds->changes)) {
+            evio_trace_add(loop, EVIO_TRACE_POLL, fd, fds->emask & (EVIO_READ | EVIO_WRITE));
             evio_queue_fd_events(loop, fd, fds->emask);
         }
         // GCOVR_EXCL_STOP
@@ -4,6 +4,24 @@
  * @file evio_poll.h
  * @brief An I/O watcher for monitoring file descriptor readiness.
  * @details epoll-backed. EPERM on add/mod => treated as "always ready".
+ *
+ * Watchers are level-triggered by default. With `EVIO_EDGE` in the event mask,
+ * the fd is registered edge-triggered and the watcher is notified once per
+ * readiness change, so it must read or write until `EAGAIN`. An fd is only
+ * registered edge-triggered while all of its watchers request `EVIO_EDGE`;
+ * otherwise edge-triggered watchers on it are notified level-triggered.
+ *
+ * With `EVIO_LAZY` (which implies `EVIO_EDGE`), an fd whose watchers are all
+ * lazy stays registered for `EPOLLOUT`, and `EVIO_WRITE` is filtered in
+ * userspace: toggling `EVIO_WRITE` with `evio_poll_change` costs no syscall.
+ * Turning write interest on while the fd was last reported writable delivers
+ * an `EVIO_WRITE` event on the next dispatch.
+ *
+ * With `EVIO_EXCLUSIVE`, an fd whose watchers all request it is registered with
+ * `EPOLLEXCLUSIVE`: when several loops watch the same fd (e.g. a shared
+ * listening socket), an event wakes one of them instead of all. Changing the
+ * events of such an fd re-registers it, since the kernel does not allow
+ * modifying exclusive registrations.
  */
 
 #include "evio.h"
@@ -12,7 +30,7 @@
 typedef struct evio_poll {
     EVIO_BASE;
     int fd;             /**< The file descriptor to monitor. */
-    evio_mask emask;    /**< The event mask (`EVIO_READ` or `EVIO_WRITE`). */
+    evio_mask emask;    /**< The event mask (`EVIO_READ`, `EVIO_WRITE`, `EVIO_EDGE`). */
 } evio_poll;
 
 /**
@@ -37,29 +55,42 @@ evio_mask evio_poll_get_events(const evio_poll *w)
     return w->emask & (EVIO_READ | EVIO_WRITE);
 }
 
+/**
+ * @brief Checks if a poll watcher requests edge-triggered notification.
+ * @param w The poll watcher.
+ * @return `true` if `EVIO_EDGE` is set, `false` otherwise.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+bool evio_poll_is_edge(const evio_poll *w)
+{
+    return w->emask & EVIO_EDGE;
+}
+
 /**
  * @brief Modifies the event mask for a poll watcher.
  * @param w The poll watcher to modify.
- * @param emask The new event mask (`EVIO_READ` or `EVIO_WRITE`).
+ * @param emask The new event mask (`EVIO_READ` and/or `EVIO_WRITE`, optionally `EVIO_EDGE`, `EVIO_LAZY`, `EVIO_EXCLUSIVE`).
  */
 static inline __evio_nonnull(1)
 void evio_poll_modify(evio_poll *w, evio_mask emask)
 {
-    w->emask = (emask & (EVIO_READ | EVIO_WRITE)) | (w->emask & EVIO_POLL);
+    emask &= EVIO_READ | EVIO_WRITE | EVIO_EDGE | EVIO_LAZY | EVIO_EXCLUSIVE;
+    w->emask = emask | ((emask & EVIO_LAZY) ? EVIO_EDGE : 0) | (w->emask & EVIO_POLL);
 }
 
 /**
  * @brief Sets the file descriptor and event mask for a poll watcher.
  * @param w The poll watcher to set up.
  * @param fd The file descriptor to monitor.
- * @param emask The event mask (`EVIO_READ` or `EVIO_WRITE`).
+ * @param emask The event mask (`EVIO_READ` and/or `EVIO_WRITE`, optionally `EVIO_EDGE`, `EVIO_LAZY`, `EVIO_EXCLUSIVE`).
  */
 static inline __evio_nonnull(1)
 void evio_poll_set(evio_poll *w, int fd, evio_mask emask)
 {
     EVIO_ASSERT(fd >= 0);
     w->fd = fd;
-    w->emask = (emask & (EVIO_READ | EVIO_WRITE)) | EVIO_POLL;
+    emask &= EVIO_READ | EVIO_WRITE | EVIO_EDGE | EVIO_LAZY | EVIO_EXCLUSIVE;
+    w->emask = emask | ((emask & EVIO_LAZY) ? EVIO_EDGE : 0) | EVIO_POLL;
 }
 
 /**
@@ -67,7 +98,7 @@ void evio_poll_set(evio_poll *w, int fd, evio_mask emask)
  * @param w The poll watcher to initialize.
  * @param cb The callback to invoke for I/O events.
  * @param fd The file descriptor to monitor.
- * @param emask The event mask (`EVIO_READ` or `EVIO_WRITE`).
+ * @param emask The event mask (`EVIO_READ` and/or `EVIO_WRITE`, optionally `EVIO_EDGE`, `EVIO_LAZY`, `EVIO_EXCLUSIVE`).
  */
 static inline __evio_nonnull(1, 2)
 void evio_poll_init(evio_poll *w, evio_cb cb, int fd, evio_mask emask)
@@ -97,7 +128,7 @@ void evio_poll_stop(evio_loop *loop, evio_poll *w);
  * @param loop The event loop.
  * @param w The poll watcher to change.
  * @param fd The new file descriptor.
- * @param emask The new event mask (`EVIO_READ` or `EVIO_WRITE`).
+ * @param emask The new event mask (`EVIO_READ` and/or `EVIO_WRITE`, optionally `EVIO_EDGE`, `EVIO_LAZY`, `EVIO_EXCLUSIVE`).
  */
 __evio_public __evio_nonnull(1, 2)
 void evio_poll_change(evio_loop *loop, evio_poll *w, int fd, evio_mask emask);
@@ -0,0 +1,85 @@
+#include <inttypes.h>
+#include <sys/epoll.h>
+
+#include "evio_core.h"
+#include "evio_recorder.h"
+
+/**
+ * @brief Returns a printable name for an epoll_ctl() operation.
+ * @param op The operation.
+ * @return A static string.
+ */
+static const char *evio_recorder_op(uint32_t op)
+{
+    switch (op) {
+        case EPOLL_CTL_ADD:
+            return "ADD";
+        case EPOLL_CTL_MOD:
+            return "MOD";
+        case EPOLL_CTL_DEL:
+            return "DEL";
+        default: // GCOVR_EXCL_LINE
+            return "?"; // GCOVR_EXCL_LINE
+    }
+}
+
+void evio_recorder_dump(const evio_loop *loop, FILE *stream)
+{
+    const size_t head = loop->rec_head;
+    const size_t count = head < EVIO_RECORDER_EVENTS ? head : EVIO_RECORDER_EVENTS;
+
+    fprintf(stream, "evio flight recorder (loop %p, %zu of %zu records):\n",
+            (const void *)loop, count, head);
+
+    for (size_t i = head - count; i != head; ++i) {
+        const evio_rec *r = &loop->rec[i & (EVIO_RECORDER_EVENTS - 1)];
+
+        fprintf(stream, "  %20" PRIu64 " ", r->time);
+
+        switch ((evio_rec_type)r->type) {
+            case EVIO_REC_ITER:
+                fprintf(stream, "ITER\n");
+                break;
+
+            case EVIO_REC_FD_CTL:
+                fprintf(stream, "FD_CTL   fd=%d op=%s emask=0x%x\n",
+                        r->arg, evio_recorder_op((uint32_t)r->aux), r->emask);
+                break;
+
+            case EVIO_REC_POLL:
+                fprintf(stream, "POLL     fd=%d emask=0x%x events=0x%" PRIx64 "\n",
+                        r->arg, r->emask, r->aux);
+                break;
+
+            case EVIO_REC_DISPATCH:
+                fprintf(stream, "DISPATCH w=%p cb=0x%" PRIx64 " emask=0x%x\n",
+                        r->ptr, r->aux, r->emask);
+                break;
+
+            case EVIO_REC_TIMER:
+                fprintf(stream, "TIMER    w=%p due=%" PRIu64 "\n", r->ptr, r->aux);
+                break;
+
+            case EVIO_REC_URING:
+                fprintf(stream, "URING    fd=%d op=%s res=%d\n",
+                        r->arg, evio_recorder_op((uint32_t)r->aux),
+                        (int32_t)(uint32_t)(r->aux >> 32));
+                break;
+
+            // GCOVR_EXCL_START
+            default:
+                fprintf(stream, "? type=%u\n", r->type);
+                break;
+                // GCOVR_EXCL_STOP
+        }
+    }
+}
+
+void evio_recorder_abort(FILE *stream)
+{
+    const evio_loop *loop = evio_loop_running();
+    if (loop) {
+        fputc('\n', stream);
+        evio_recorder_dump(loop, stream);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+/**
+ * @file evio_recorder.h
+ * @brief A per-loop flight recorder of recent loop events.
+ * @details Every loop keeps a fixed-size ring of its most recent events:
+ * iteration boundaries, epoll_ctl() changes, epoll results, dispatched
+ * callbacks, timer fires and io_uring completion errors. The ring of the loop
+ * running on the aborting thread, if any, is dumped to the `evio_set_abort`
+ * stream on `EVIO_ABORT`.
+ */
+
+#include "evio.h"
+
+/**
+ * @brief Writes the decoded flight recorder records of a loop, oldest first.
+ * @param loop The event loop.
+ * @param stream The output stream.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_recorder_dump(const evio_loop *loop, FILE *stream);
@@ -0,0 +1,238 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "evio_core.h"
+#include "evio_relay.h"
+
+#ifndef EVIO_RELAY_PIPE_SIZE
+/** @brief The requested capacity of the internal pipe (the kernel default is used if refused). */
+#define EVIO_RELAY_PIPE_SIZE (256 * 1024)
+#endif
+
+/** @brief The flags for `splice` calls. */
+#define EVIO_RELAY_SPLICE (SPLICE_F_MOVE | SPLICE_F_NONBLOCK)
+
+/**
+ * @brief Stops the relay and reports the end of relaying.
+ * @param loop The event loop.
+ * @param w The relay watcher.
+ * @param err The error number, or 0 after end of file.
+ */
+static void evio_relay_finish(evio_loop *loop, evio_relay *w, int err)
+{
+    evio_relay_stop(loop, w);
+    w->err = err;
+    evio_queue_event(loop, &w->base, EVIO_READ | (err ? EVIO_ERROR : 0));
+}
+
+/**
+ * @brief Moves data through the pipe until neither side can make progress.
+ * @details `EAGAIN` from the input side is ambiguous while the pipe holds
+ * data: it may be out of buffer slots before its byte capacity is reached.
+ * The input is then only considered drained once a read into an empty pipe
+ * fails.
+ * @param loop The event loop.
+ * @param w The relay watcher.
+ * @return `false` if the relay has ended.
+ */
+static bool evio_relay_pump(evio_loop *loop, evio_relay *w)
+{
+    bool full = false;
+
+    for (bool progress = true; progress;) {
+        progress = false;
+
+        if (w->readable && !w->eof && !full && w->buffered < w->size) {
+            ssize_t n = splice(w->in.fd, NULL, w->pipe[1], NULL,
+                               w->size - w->buffered, EVIO_RELAY_SPLICE);
+            if (n > 0) {
+                w->buffered += (size_t)n;
+                progress = true;
+            } else if (n == 0) {
+                w->eof = true;
+            } else if (errno == EAGAIN) {
+                if (w->buffered) {
+                    full = true;
+                } else {
+                    w->readable = false;
+                }
+            } else if (errno == EINTR) {
+                progress = true; // GCOVR_EXCL_LINE
+            } else {
+                evio_relay_finish(loop, w, errno);
+                return false;
+            }
+        }
+
+        if (w->writable && w->buffered) {
+            ssize_t n = splice(w->pipe[0], NULL, w->out.fd, NULL,
+                               w->buffered, EVIO_RELAY_SPLICE);
+            if (n > 0) {
+                w->buffered -= (size_t)n;
+                w->bytes += (size_t)n;
+                full = false;
+                progress = true;
+            } else if (n < 0 && errno == EAGAIN) {
+                w->writable = false;
+            } else if (n < 0 && errno == EINTR) {
+                progress = true; // GCOVR_EXCL_LINE
+            } else {
+                evio_relay_finish(loop, w, n < 0 ? errno : EPIPE);
+                return false;
+            }
+        }
+    }
+
+    if (w->eof && !w->buffered) {
+        evio_relay_finish(loop, w, 0);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Starts or stops a sub-watcher without changing the refcount.
+ * @param loop The event loop.
+ * @param io The poll watcher.
+ * @param on `true` if the watcher should be active.
+ */
+static void evio_relay_watch(evio_loop *loop, evio_poll *io, bool on)
+{
+    // The relay watcher holds the loop reference.
+    if (on && !io->active) {
+        evio_poll_start(loop, io);
+        evio_unref(loop);
+    } else if (!on && io->active) {
+        evio_ref(loop);
+        evio_poll_stop(loop, io);
+    }
+}
+
+/**
+ * @brief Watches each side only while readiness is needed to make progress.
+ * @param loop The event loop.
+ * @param w The relay watcher.
+ */
+static void evio_relay_arm(evio_loop *loop, evio_relay *w)
+{
+    evio_relay_watch(loop, &w->in, !w->eof && !w->readable);
+    evio_relay_watch(loop, &w->out, w->buffered && !w->writable);
+}
+
+/**
+ * @brief Internal callback for the input poll watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_poll` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_relay_in_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_relay *w = container_of(base, evio_relay, in.base);
+
+    if (__evio_unlikely(emask & EVIO_ERROR)) {
+        // The poll watcher was stopped, keep the refcount balanced.
+        evio_ref(loop);
+        evio_relay_finish(loop, w, EBADF);
+        return;
+    }
+
+    w->readable = true;
+    if (evio_relay_pump(loop, w)) {
+        evio_relay_arm(loop, w);
+    }
+}
+
+/**
+ * @brief Internal callback for the output poll watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_poll` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_relay_out_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_relay *w = container_of(base, evio_relay, out.base);
+
+    if (__evio_unlikely(emask & EVIO_ERROR)) {
+        // The poll watcher was stopped, keep the refcount balanced.
+        evio_ref(loop);
+        evio_relay_finish(loop, w, EBADF);
+        return;
+    }
+
+    w->writable = true;
+    if (evio_relay_pump(loop, w)) {
+        evio_relay_arm(loop, w);
+    }
+}
+
+void evio_relay_init(evio_relay *w, evio_cb cb, int in, int out)
+{
+    evio_init(&w->base, cb);
+    evio_poll_init(&w->in, evio_relay_in_cb, in, EVIO_READ | EVIO_EDGE);
+    evio_poll_init(&w->out, evio_relay_out_cb, out, EVIO_WRITE | EVIO_EDGE);
+    w->pipe[0] = -1;
+    w->pipe[1] = -1;
+    w->buffered = 0;
+    w->size = 0;
+    w->bytes = 0;
+    w->err = 0;
+    w->readable = false;
+    w->writable = false;
+    w->eof = false;
+}
+
+void evio_relay_start(evio_loop *loop, evio_relay *w)
+{
+    if (__evio_unlikely(w->active)) {
+        return;
+    }
+
+    // This takes one ref for the relay watcher itself.
+    evio_list_start(loop, &w->base, &loop->relay, true);
+
+    w->buffered = 0;
+    w->bytes = 0;
+    w->err = 0;
+    w->readable = false;
+    w->writable = true;
+    w->eof = false;
+
+    if (__evio_unlikely(pipe2(w->pipe, O_NONBLOCK | O_CLOEXEC) < 0)) {
+        evio_relay_finish(loop, w, errno);
+        return;
+    }
+
+    int size = fcntl(w->pipe[1], F_SETPIPE_SZ, EVIO_RELAY_PIPE_SIZE);
+    if (size < 0) {
+        size = fcntl(w->pipe[1], F_GETPIPE_SZ); // GCOVR_EXCL_LINE
+    }
+    w->size = size > 0 ? (size_t)size : 4096;
+
+    evio_relay_arm(loop, w);
+}
+
+void evio_relay_stop(evio_loop *loop, evio_relay *w)
+{
+    evio_clear_pending(loop, &w->base);
+    evio_clear_pending(loop, &w->in.base);
+    evio_clear_pending(loop, &w->out.base);
+
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    evio_relay_watch(loop, &w->in, false);
+    evio_relay_watch(loop, &w->out, false);
+
+    for (size_t i = 0; i < 2; ++i) {
+        if (w->pipe[i] >= 0) {
+            close(w->pipe[i]);
+            w->pipe[i] = -1;
+        }
+    }
+
+    w->buffered = 0;
+    evio_list_stop(loop, &w->base, &loop->relay, true);
+}
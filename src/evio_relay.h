@@ -0,0 +1,92 @@
+#pragma once
+
+/**
+ * @file evio_relay.h
+ * @brief A watcher that moves data from one file descriptor to another.
+ * @details Built for proxies: data is moved with `splice` through an internal
+ * pipe, so the payload never passes through user space. A relay works in one
+ * direction; a proxied connection uses two relays with the sockets swapped.
+ *
+ * Backpressure follows readiness: the input is only read while the pipe has
+ * room, and the pipe is only drained while the output accepts data. Both
+ * sockets are watched edge-triggered, and a watch is only dropped while its
+ * side cannot make progress (a readable input with a full pipe, or a
+ * writable output with an empty pipe), so a relay in steady state makes no
+ * `epoll_ctl` calls.
+ *
+ * Unlike `send` with `MSG_NOSIGNAL`, `splice` to a socket whose peer is gone
+ * raises `SIGPIPE`, so proxies should ignore that signal.
+ */
+
+#include "evio.h"
+
+/** @brief A watcher that relays data between two file descriptors. */
+typedef struct evio_relay {
+    EVIO_BASE;
+    evio_poll in;       /**< @private The input poll watcher. */
+    evio_poll out;      /**< @private The output poll watcher. */
+    int pipe[2];        /**< @private The internal pipe, or -1. */
+    size_t buffered;    /**< @private Number of bytes in the pipe. */
+    size_t size;        /**< @private The capacity of the pipe. */
+    size_t bytes;       /**< @private Number of bytes written to the output. */
+    int err;            /**< @private The error that stopped the relay, or 0. */
+    bool readable;      /**< @private The input may have data. */
+    bool writable;      /**< @private The output may accept data. */
+    bool eof;           /**< @private The input reached end of file. */
+} evio_relay;
+
+/**
+ * @brief Initializes a relay watcher.
+ * @details The callback receives `EVIO_READ` once the input reached end of
+ * file and all data was written to the output, or `EVIO_READ | EVIO_ERROR`
+ * if either side failed (see `evio_relay_error`). In both cases the watcher
+ * is stopped before the callback; the file descriptors are left open, e.g.
+ * to shut down the output for writing.
+ * @param w The relay watcher to initialize.
+ * @param cb The callback to invoke when relaying ends.
+ * @param in The file descriptor to read from (non-blocking).
+ * @param out The file descriptor to write to (non-blocking).
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_relay_init(evio_relay *w, evio_cb cb, int in, int out);
+
+/**
+ * @brief Starts a relay watcher.
+ * @details Creates the internal pipe. If that fails, the callback receives
+ * `EVIO_READ | EVIO_ERROR`.
+ * @param loop The event loop.
+ * @param w The relay watcher to start.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_relay_start(evio_loop *loop, evio_relay *w);
+
+/**
+ * @brief Stops a relay watcher.
+ * @details Data still in the internal pipe is discarded.
+ * @param loop The event loop.
+ * @param w The relay watcher to stop.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_relay_stop(evio_loop *loop, evio_relay *w);
+
+/**
+ * @brief Gets the number of bytes written to the output since the relay was started.
+ * @param w The relay watcher.
+ * @return The number of bytes relayed.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+size_t evio_relay_bytes(const evio_relay *w)
+{
+    return w->bytes;
+}
+
+/**
+ * @brief Gets the error that stopped a relay.
+ * @param w The relay watcher.
+ * @return The error number, or 0 if relaying did not fail.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+int evio_relay_error(const evio_relay *w)
+{
+    return w->err;
+}
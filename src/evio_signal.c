@@ -76,6 +76,8 @@ static void evio_signal_process_pending_idx(evio_loop *loop, unsigned int idx)
     }
 
     if (atomic_exchange_explicit(&sig->status.value, 0, memory_order_acq_rel)) {
+        EVIO_PROBE2(signal_wakeup, loop, idx + 1);
+        evio_trace_add(loop, EVIO_TRACE_SIGNAL, (int)idx + 1, EVIO_SIGNAL);
         for (size_t j = sig->list.count; j--;) {
             evio_signal *w = container_of(sig->list.ptr[j], evio_signal, base);
             EVIO_ASSERT(w->signum == (int)idx + 1);
@@ -0,0 +1,529 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "evio_core.h"
+#include "evio_stream.h"
+
+#ifndef EVIO_STREAM_CHUNK
+/** @brief The capacity of the chunks small writes are copied into. */
+#define EVIO_STREAM_CHUNK (16 * 1024)
+#endif
+
+#ifndef EVIO_STREAM_READ
+/** @brief The minimum free space in the read buffer before each read. */
+#define EVIO_STREAM_READ (16 * 1024)
+#endif
+
+/** @brief The maximum number of chunks gathered by one write. */
+#define EVIO_STREAM_IOV 64
+
+/** @brief A chunk of the write queue. */
+struct evio_stream_chunk {
+    struct evio_stream_chunk *next; /**< The next chunk in the queue. */
+    const char *base;               /**< The data. */
+    size_t len;                     /**< The length of the data. */
+    size_t off;                     /**< Number of bytes written. */
+    size_t cap;                     /**< Capacity of `buf`, or 0 for caller-owned data. */
+    evio_stream_release_cb release; /**< The release callback of caller-owned data, or `NULL`. */
+    void *ctx;                      /**< The context pointer of the release callback. */
+    char buf[];                     /**< The copied data. */
+};
+
+/**
+ * @brief Frees a written or discarded chunk, keeping one copy chunk for reuse.
+ * @param w The stream watcher.
+ * @param c The chunk.
+ */
+static void evio_stream_free_chunk(evio_stream *w, struct evio_stream_chunk *c)
+{
+    if (c->release) {
+        c->release(c->ctx);
+    }
+
+    if (c->cap == EVIO_STREAM_CHUNK && !w->spare) {
+        w->spare = c;
+        return;
+    }
+    evio_free(c);
+}
+
+/**
+ * @brief Appends a new chunk to the write queue.
+ * @param w The stream watcher.
+ * @param cap The capacity of the copy buffer, or 0 for caller-owned data.
+ * @return The new chunk.
+ */
+static struct evio_stream_chunk *evio_stream_push(evio_stream *w, size_t cap)
+{
+    struct evio_stream_chunk *c;
+    if (cap == EVIO_STREAM_CHUNK && w->spare) {
+        c = w->spare;
+        w->spare = NULL;
+    } else {
+        c = evio_malloc(sizeof(*c) + cap);
+    }
+
+    c->next = NULL;
+    c->base = c->buf;
+    c->len = 0;
+    c->off = 0;
+    c->cap = cap;
+    c->release = NULL;
+    c->ctx = NULL;
+
+    if (w->tail) {
+        w->tail->next = c;
+    } else {
+        w->head = c;
+    }
+    w->tail = c;
+    return c;
+}
+
+/**
+ * @brief Drops written bytes from the head of the write queue.
+ * @param w The stream watcher.
+ * @param n Number of bytes written.
+ */
+static void evio_stream_advance(evio_stream *w, size_t n)
+{
+    w->queued -= n;
+
+    while (w->head) {
+        struct evio_stream_chunk *c = w->head;
+        size_t take = c->len - c->off;
+        if (take > n) {
+            c->off += n;
+            break;
+        }
+
+        n -= take;
+        w->head = c->next;
+        if (!w->head) {
+            w->tail = NULL;
+        }
+        evio_stream_free_chunk(w, c);
+    }
+}
+
+/**
+ * @brief Starts or stops the internal prepare watcher without changing the refcount.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ * @param on `true` if the write queue should be flushed before the loop blocks.
+ */
+static void evio_stream_schedule(evio_loop *loop, evio_stream *w, bool on)
+{
+    // The stream watcher holds the loop reference.
+    if (on && !w->flush.active) {
+        evio_prepare_start(loop, &w->flush);
+        evio_unref(loop);
+    } else if (!on && w->flush.active) {
+        evio_ref(loop);
+        evio_prepare_stop(loop, &w->flush);
+    }
+}
+
+/**
+ * @brief Watches the fd for the events the stream is waiting for.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ */
+static void evio_stream_arm(evio_loop *loop, evio_stream *w)
+{
+    evio_mask emask = (w->reading && !w->full && !w->eof ? EVIO_READ : 0) |
+                      (w->blocked ? EVIO_WRITE : 0);
+
+    // The stream watcher holds the loop reference.
+    if (!emask) {
+        if (w->io.active) {
+            evio_ref(loop);
+            evio_poll_stop(loop, &w->io);
+        }
+    } else if (!w->io.active) {
+        evio_poll_set(&w->io, w->io.fd, emask);
+        evio_poll_start(loop, &w->io);
+        evio_unref(loop);
+    } else if ((w->io.emask & (EVIO_READ | EVIO_WRITE)) != emask) {
+        evio_poll_change(loop, &w->io, w->io.fd, emask);
+    }
+}
+
+/**
+ * @brief Stops the stream and reports an error.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ * @param emask `EVIO_READ` or `EVIO_WRITE`.
+ * @param err The error number.
+ */
+static void evio_stream_fail(evio_loop *loop, evio_stream *w, evio_mask emask, int err)
+{
+    evio_stream_stop(loop, w);
+    w->err = err;
+    evio_queue_event(loop, &w->base, emask | EVIO_ERROR);
+}
+
+/**
+ * @brief Writes queued chunks until the queue is empty or the fd is full.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ */
+static void evio_stream_send(evio_loop *loop, evio_stream *w)
+{
+    evio_stream_schedule(loop, w, false);
+
+    while (w->head) {
+        struct iovec iov[EVIO_STREAM_IOV];
+        size_t n = 0;
+
+        for (struct evio_stream_chunk *c = w->head; c && n < EVIO_STREAM_IOV; c = c->next) {
+            iov[n++] = (struct iovec) {
+                .iov_base = (void *)(c->base + c->off),
+                .iov_len = c->len - c->off,
+            };
+        }
+
+        ssize_t r;
+        if (!w->nosock) {
+            struct msghdr msg = { .msg_iov = iov, .msg_iovlen = n };
+            r = sendmsg(w->io.fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } else {
+            r = writev(w->io.fd, iov, (int)n);
+        }
+
+        if (r >= 0) {
+            evio_stream_advance(w, (size_t)r);
+            continue;
+        }
+
+        int err = errno;
+        if (err == EAGAIN) {
+            break;
+        }
+        if (err == EINTR) {
+            continue; // GCOVR_EXCL_LINE
+        }
+        if (err == ENOTSOCK && !w->nosock) {
+            w->nosock = true;
+            continue;
+        }
+
+        evio_stream_fail(loop, w, EVIO_WRITE, err);
+        return;
+    }
+
+    w->blocked = w->head != NULL;
+    evio_stream_arm(loop, w);
+
+    if (w->congested && w->queued <= w->low) {
+        w->congested = false;
+        evio_queue_event(loop, &w->base, EVIO_WRITE);
+    }
+}
+
+/**
+ * @brief Reads into the read buffer and invokes the callback.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ */
+static void evio_stream_recv(evio_loop *loop, evio_stream *w)
+{
+    // Move unconsumed data to the front, then grow if still short of space.
+    if (w->rpos && w->rsize - w->rlen < EVIO_STREAM_READ) {
+        memmove(w->rbuf, w->rbuf + w->rpos, w->rlen - w->rpos);
+        w->rlen -= w->rpos;
+        w->rpos = 0;
+    }
+
+    if (w->rsize - w->rlen < EVIO_STREAM_READ) {
+        size_t size = w->rsize ? w->rsize * 2 : EVIO_STREAM_READ;
+        while (size - w->rlen < EVIO_STREAM_READ) {
+            size *= 2;
+        }
+        w->rbuf = evio_realloc(w->rbuf, size);
+        w->rsize = size;
+    }
+
+    ssize_t n = read(w->io.fd, w->rbuf + w->rlen, w->rsize - w->rlen);
+    if (n > 0) {
+        w->rlen += (size_t)n;
+        if (w->rlen - w->rpos >= w->rhigh) {
+            // Bounds the buffer until the callback catches up.
+            w->full = true;
+            evio_stream_arm(loop, w);
+        }
+    } else if (n == 0) {
+        w->eof = true;
+        evio_stream_arm(loop, w);
+    } else if (errno == EAGAIN || errno == EINTR) {
+        return;
+    } else {
+        evio_stream_fail(loop, w, EVIO_READ, errno);
+        return;
+    }
+
+    w->cb(loop, &w->base, EVIO_READ);
+}
+
+/**
+ * @brief Internal callback for the poll watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_poll` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_stream_io_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_stream *w = container_of(base, evio_stream, io.base);
+
+    if (__evio_unlikely(emask & EVIO_ERROR)) {
+        // The poll watcher was stopped, keep the refcount balanced.
+        evio_ref(loop);
+        evio_stream_fail(loop, w, EVIO_READ, EBADF);
+        return;
+    }
+
+    if ((emask & EVIO_WRITE) && w->blocked) {
+        evio_stream_send(loop, w);
+    }
+
+    if ((emask & EVIO_READ) && w->active && w->reading && !w->full && !w->eof) {
+        evio_stream_recv(loop, w);
+    }
+}
+
+/**
+ * @brief Internal callback for the prepare watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_prepare` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_stream_flush_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_stream *w = container_of(base, evio_stream, flush.base);
+    evio_stream_send(loop, w);
+}
+
+/**
+ * @brief Accounts for queued bytes and schedules the flush.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ * @param len Number of bytes queued.
+ * @return `false` if the write queue is above the high watermark.
+ */
+static bool evio_stream_queue(evio_loop *loop, evio_stream *w, size_t len)
+{
+    w->queued += len;
+
+    if (!w->blocked && w->head) {
+        evio_stream_schedule(loop, w, true);
+    }
+
+    if (w->queued > w->high) {
+        w->congested = true;
+        return false;
+    }
+    return true;
+}
+
+void evio_stream_init(evio_stream *w, evio_cb cb, int fd)
+{
+    evio_init(&w->base, cb);
+    evio_poll_init(&w->io, evio_stream_io_cb, fd, EVIO_READ);
+    evio_prepare_init(&w->flush, evio_stream_flush_cb);
+    w->head = NULL;
+    w->tail = NULL;
+    w->spare = NULL;
+    w->queued = 0;
+    w->high = EVIO_STREAM_HIGH;
+    w->low = EVIO_STREAM_LOW;
+    w->rbuf = NULL;
+    w->rpos = 0;
+    w->rlen = 0;
+    w->rsize = 0;
+    w->rhigh = EVIO_STREAM_READ_HIGH;
+    w->err = 0;
+    w->reading = true;
+    w->full = false;
+    w->eof = false;
+    w->blocked = false;
+    w->congested = false;
+    w->nosock = false;
+}
+
+void evio_stream_start(evio_loop *loop, evio_stream *w)
+{
+    if (__evio_unlikely(w->active)) {
+        return;
+    }
+
+    w->err = 0;
+    w->eof = false;
+    w->blocked = false;
+    w->congested = false;
+
+    // This takes one ref for the stream watcher itself.
+    evio_list_start(loop, &w->base, &loop->stream, true);
+    evio_stream_arm(loop, w);
+}
+
+void evio_stream_stop(evio_loop *loop, evio_stream *w)
+{
+    evio_clear_pending(loop, &w->base);
+    evio_clear_pending(loop, &w->io.base);
+
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    evio_stream_schedule(loop, w, false);
+    if (w->io.active) {
+        evio_ref(loop);
+        evio_poll_stop(loop, &w->io);
+    }
+    w->blocked = false;
+
+    while (w->head) {
+        struct evio_stream_chunk *c = w->head;
+        w->head = c->next;
+        evio_stream_free_chunk(w, c);
+    }
+    w->tail = NULL;
+    w->queued = 0;
+
+    evio_free(w->spare);
+    w->spare = NULL;
+
+    evio_free(w->rbuf);
+    w->rbuf = NULL;
+    w->rpos = 0;
+    w->rlen = 0;
+    w->rsize = 0;
+    w->full = false;
+
+    evio_list_stop(loop, &w->base, &loop->stream, true);
+}
+
+void evio_stream_set_watermarks(evio_stream *w, size_t high, size_t low)
+{
+    w->high = high;
+    w->low = low < high ? low : high;
+}
+
+void evio_stream_set_read_watermark(evio_loop *loop, evio_stream *w, size_t high)
+{
+    w->rhigh = high ? high : 1;
+    w->full = w->rlen - w->rpos >= w->rhigh;
+    if (w->active) {
+        evio_stream_arm(loop, w);
+    }
+}
+
+bool evio_stream_write(evio_loop *loop, evio_stream *w, const void *buf, size_t len)
+{
+    if (__evio_unlikely(!w->active)) {
+        return false;
+    }
+
+    const char *p = buf;
+    size_t left = len;
+
+    struct evio_stream_chunk *c = w->tail;
+    if (c && c->cap > c->len && left) {
+        size_t n = c->cap - c->len < left ? c->cap - c->len : left;
+        memcpy(c->buf + c->len, p, n);
+        c->len += n;
+        p += n;
+        left -= n;
+    }
+
+    if (left) {
+        c = evio_stream_push(w, left > EVIO_STREAM_CHUNK ? left : EVIO_STREAM_CHUNK);
+        memcpy(c->buf, p, left);
+        c->len = left;
+    }
+
+    return evio_stream_queue(loop, w, len);
+}
+
+bool evio_stream_writev(evio_loop *loop, evio_stream *w, const struct iovec *iov, size_t iovcnt,
+                        evio_stream_release_cb release, void *ctx)
+{
+    if (__evio_unlikely(!w->active)) {
+        if (release) {
+            release(ctx);
+        }
+        return false;
+    }
+
+    size_t len = 0;
+    struct evio_stream_chunk *last = NULL;
+
+    for (size_t i = 0; i < iovcnt; ++i) {
+        if (!iov[i].iov_len) {
+            continue;
+        }
+
+        last = evio_stream_push(w, 0);
+        last->base = iov[i].iov_base;
+        last->len = iov[i].iov_len;
+        len += iov[i].iov_len;
+    }
+
+    // The buffers are released along with the last one.
+    if (last) {
+        last->release = release;
+        last->ctx = ctx;
+    } else if (release) {
+        release(ctx);
+    }
+
+    return evio_stream_queue(loop, w, len);
+}
+
+void evio_stream_flush(evio_loop *loop, evio_stream *w)
+{
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    if (!w->blocked) {
+        evio_stream_send(loop, w);
+    }
+}
+
+void evio_stream_pause(evio_loop *loop, evio_stream *w)
+{
+    w->reading = false;
+    if (w->active) {
+        evio_stream_arm(loop, w);
+    }
+}
+
+void evio_stream_resume(evio_loop *loop, evio_stream *w)
+{
+    w->reading = true;
+    if (w->active) {
+        evio_stream_arm(loop, w);
+    }
+}
+
+void evio_stream_consume(evio_loop *loop, evio_stream *w, size_t len)
+{
+    EVIO_ASSERT(len <= w->rlen - w->rpos);
+
+    w->rpos += len;
+    if (w->rpos == w->rlen) {
+        w->rpos = 0;
+        w->rlen = 0;
+    }
+
+    if (w->full && w->rlen - w->rpos < w->rhigh) {
+        w->full = false;
+        if (w->active) {
+            evio_stream_arm(loop, w);
+        }
+    }
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+/**
+ * @file evio_stream.h
+ * @brief A buffered byte stream on top of a poll watcher.
+ * @details Handles the bookkeeping every stream protocol needs: a read buffer
+ * the callback consumes at its own pace, a write queue with partial-write
+ * tracking, and write interest that is only turned on while the socket is
+ * full.
+ *
+ * Writes are queued and sent once per loop iteration, before the loop blocks,
+ * gathering the queued chunks into one `sendmsg` (`writev` for non-sockets).
+ * Small writes are copied into shared chunks; `evio_stream_writev` queues
+ * caller-owned buffers without copying and hands them back once written.
+ *
+ * Backpressure follows the usual watermark scheme: a write that leaves more
+ * than the high watermark queued returns `false`, and the callback receives
+ * `EVIO_WRITE` once the queue has drained to the low watermark.
+ *
+ * The read buffer is one contiguous span, so that `evio_stream_peek` and the
+ * frame decoders see all unconsumed data at once: unconsumed data is moved
+ * to the front before reading, and the buffer grows as needed. Reading
+ * pauses once the unconsumed data reaches the read watermark, and resumes
+ * once `evio_stream_consume` brings it back below.
+ */
+
+#include "evio.h"
+
+#ifndef EVIO_STREAM_HIGH
+/** @brief The default high watermark of the write queue. */
+#define EVIO_STREAM_HIGH (64 * 1024)
+#endif
+
+#ifndef EVIO_STREAM_LOW
+/** @brief The default low watermark of the write queue. */
+#define EVIO_STREAM_LOW (16 * 1024)
+#endif
+
+#ifndef EVIO_STREAM_READ_HIGH
+/** @brief The default amount of unconsumed data at which reading pauses. */
+#define EVIO_STREAM_READ_HIGH (1024 * 1024)
+#endif
+
+struct iovec;
+struct evio_stream_chunk;
+
+/**
+ * @brief The callback invoked once caller-owned buffers are no longer used.
+ * @param ctx The context pointer passed to `evio_stream_writev`.
+ */
+typedef void (*evio_stream_release_cb)(void *ctx);
+
+/** @brief A buffered stream watcher. */
+typedef struct evio_stream {
+    EVIO_BASE;
+    evio_poll io;                       /**< @private The poll watcher of the file descriptor. */
+    evio_prepare flush;                 /**< @private Flushes the write queue before the loop blocks. */
+    struct evio_stream_chunk *head;     /**< @private The first chunk of the write queue. */
+    struct evio_stream_chunk *tail;     /**< @private The last chunk of the write queue. */
+    struct evio_stream_chunk *spare;    /**< @private A free chunk kept for reuse. */
+    size_t queued;                      /**< @private Number of bytes in the write queue. */
+    size_t high;                        /**< @private The high watermark of the write queue. */
+    size_t low;                         /**< @private The low watermark of the write queue. */
+    char *rbuf;                         /**< @private The read buffer. */
+    size_t rpos;                        /**< @private Offset of the first unconsumed byte. */
+    size_t rlen;                        /**< @private End of the data in the read buffer. */
+    size_t rsize;                       /**< @private Capacity of the read buffer. */
+    size_t rhigh;                       /**< @private Unconsumed data at which reading pauses. */
+    int err;                            /**< @private The error that stopped the stream, or 0. */
+    bool reading;                       /**< @private Reading is not paused. */
+    bool full;                          /**< @private The read buffer reached the read watermark. */
+    bool eof;                           /**< @private The peer closed its side. */
+    bool blocked;                       /**< @private Waiting for the fd to become writable. */
+    bool congested;                     /**< @private The write queue exceeded the high watermark. */
+    bool nosock;                        /**< @private The fd is not a socket, use `writev`. */
+} evio_stream;
+
+/**
+ * @brief Initializes a stream watcher.
+ * @details The callback receives:
+ * - `EVIO_READ` after new data was read (see `evio_stream_peek`), or once the
+ *   peer closed its side (see `evio_stream_eof`);
+ * - `EVIO_WRITE` once the write queue drained to the low watermark after a
+ *   write exceeded the high watermark;
+ * - `EVIO_READ | EVIO_ERROR` or `EVIO_WRITE | EVIO_ERROR` if reading or
+ *   writing failed (see `evio_stream_error`). The watcher is stopped before
+ *   the callback.
+ *
+ * @param w The stream watcher to initialize.
+ * @param cb The callback to invoke.
+ * @param fd The file descriptor (non-blocking).
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_stream_init(evio_stream *w, evio_cb cb, int fd);
+
+/**
+ * @brief Starts a stream watcher.
+ * @details The watcher stays active, and keeps the loop alive, until it is
+ * stopped, even after end of file.
+ * @param loop The event loop.
+ * @param w The stream watcher to start.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_stream_start(evio_loop *loop, evio_stream *w);
+
+/**
+ * @brief Stops a stream watcher.
+ * @details Unread and unsent data is discarded; caller-owned buffers are
+ * released.
+ * @param loop The event loop.
+ * @param w The stream watcher to stop.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_stream_stop(evio_loop *loop, evio_stream *w);
+
+/**
+ * @brief Sets the watermarks of the write queue.
+ * @details The defaults are `EVIO_STREAM_HIGH` and `EVIO_STREAM_LOW`.
+ * @param w The stream watcher.
+ * @param high Writes leaving more than this many bytes queued return `false`.
+ * @param low The queue size at which `EVIO_WRITE` is reported (at most `high`).
+ */
+__evio_public __evio_nonnull(1)
+void evio_stream_set_watermarks(evio_stream *w, size_t high, size_t low);
+
+/**
+ * @brief Sets the read watermark.
+ * @details The default is `EVIO_STREAM_READ_HIGH`. Reading pauses while at
+ * least this many bytes are unconsumed.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ * @param high The unconsumed data at which reading pauses (at least 1), or
+ * `SIZE_MAX` for no limit.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_stream_set_read_watermark(evio_loop *loop, evio_stream *w, size_t high);
+
+/**
+ * @brief Queues data for writing.
+ * @details The data is copied.
+ * @param loop The event loop.
+ * @param w The active stream watcher.
+ * @param buf The data.
+ * @param len The length of the data.
+ * @return `false` if the write queue is above the high watermark.
+ */
+__evio_public __evio_nonnull(1, 2)
+bool evio_stream_write(evio_loop *loop, evio_stream *w, const void *buf, size_t len);
+
+/**
+ * @brief Queues caller-owned buffers for writing, without copying them.
+ * @details The buffers must stay valid until `release` is invoked, once all
+ * of them were written or the stream was stopped. The iovec array itself
+ * is copied.
+ * @param loop The event loop.
+ * @param w The active stream watcher.
+ * @param iov The buffers.
+ * @param iovcnt The number of buffers.
+ * @param release The callback invoked with `ctx` once the buffers are
+ * released, or `NULL`.
+ * @param ctx The context pointer for the release callback.
+ * @return `false` if the write queue is above the high watermark.
+ */
+__evio_public __evio_nonnull(1, 2)
+bool evio_stream_writev(evio_loop *loop, evio_stream *w, const struct iovec *iov, size_t iovcnt,
+                        evio_stream_release_cb release, void *ctx);
+
+/**
+ * @brief Writes the queued data right away.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_stream_flush(evio_loop *loop, evio_stream *w);
+
+/**
+ * @brief Stops reading until `evio_stream_resume` is called.
+ * @details Used to stop a producer whose output is congested.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_stream_pause(evio_loop *loop, evio_stream *w);
+
+/**
+ * @brief Resumes reading after `evio_stream_pause`.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_stream_resume(evio_loop *loop, evio_stream *w);
+
+/**
+ * @brief Gets the unconsumed data in the read buffer.
+ * @details The pointer is valid until the next read, i.e. until the
+ * callback returns.
+ * @param w The stream watcher.
+ * @param len The number of unconsumed bytes.
+ * @return The unconsumed data.
+ */
+static inline __evio_nonnull(1, 2) __evio_nodiscard
+void *evio_stream_peek(const evio_stream *w, size_t *len)
+{
+    *len = w->rlen - w->rpos;
+    return w->rbuf ? w->rbuf + w->rpos : NULL;
+}
+
+/**
+ * @brief Marks data in the read buffer as consumed.
+ * @details Unconsumed data stays buffered, and is reported again along with
+ * the next data read. Reading resumes if it was paused by the read watermark.
+ * @param loop The event loop.
+ * @param w The stream watcher.
+ * @param len The number of bytes consumed, at most the unconsumed length.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_stream_consume(evio_loop *loop, evio_stream *w, size_t len);
+
+/**
+ * @brief Gets the number of bytes in the write queue.
+ * @param w The stream watcher.
+ * @return The number of queued bytes.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+size_t evio_stream_queued(const evio_stream *w)
+{
+    return w->queued;
+}
+
+/**
+ * @brief Checks if the peer closed its side of the stream.
+ * @param w The stream watcher.
+ * @return `true` after end of file was read.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+bool evio_stream_eof(const evio_stream *w)
+{
+    return w->eof;
+}
+
+/**
+ * @brief Gets the error that stopped a stream.
+ * @param w The stream watcher.
+ * @return The error number, or 0.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+int evio_stream_error(const evio_stream *w)
+{
+    return w->err;
+}
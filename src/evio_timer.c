@@ -78,6 +78,8 @@ evio_time evio_timer_remaining(const evio_loop *loop, const evio_timer *w)
 
 void evio_timer_update(evio_loop *loop)
 {
+    evio_trace_add(loop, EVIO_TRACE_TIME, 0, 0);
+
     while (
         loop->timer.count &&
         loop->timer.ptr[0].time <= loop->time
@@ -85,6 +87,9 @@ void evio_timer_update(evio_loop *loop)
         evio_node *node = &loop->timer.ptr[0];
         evio_timer *w = container_of(node->base, evio_timer, base);
 
+        EVIO_PROBE2(timer_fire, loop, w);
+        evio_recorder_add(loop, EVIO_REC_TIMER, -1, 0, w, node->time);
+        evio_trace_add(loop, EVIO_TRACE_TIMER, 0, EVIO_TIMER);
         evio_queue_event(loop, &w->base, EVIO_TIMER);
 
         if (!w->repeat || __evio_unlikely(node->time > EVIO_TIME_MAX - w->repeat)) {
@@ -0,0 +1,162 @@
+#include <errno.h>
+
+#include "evio_core.h"
+#include "evio_trace.h"
+
+/** @brief The trace file magic. */
+#define EVIO_TRACE_MAGIC "EVIOTRC"
+/** @brief The trace format version. */
+#define EVIO_TRACE_VERSION 1u
+/** @brief The number of records buffered before writing to the stream. */
+#define EVIO_TRACE_BUFFER 256
+
+/** @brief The trace file header. */
+typedef struct {
+    char magic[8];          /**< `EVIO_TRACE_MAGIC`, NUL-terminated. */
+    uint32_t version;       /**< `EVIO_TRACE_VERSION`. */
+    uint32_t size;          /**< The record size in bytes. */
+} evio_trace_hdr;
+
+/** @brief The internal state of a running capture. */
+struct evio_trace {
+    FILE *stream;           /**< The output stream. */
+    evio_time start;        /**< The loop time when the capture started. */
+    size_t count;           /**< The number of buffered records. */
+    bool failed;            /**< Set if a write to the stream failed. */
+    evio_trace_rec buf[EVIO_TRACE_BUFFER]; /**< The record buffer. */
+};
+
+_Static_assert(sizeof(evio_trace_rec) == 16, "evio_trace_rec must be 16 bytes");
+
+/**
+ * @brief Writes buffered records to the stream.
+ * @param trace The capture state.
+ */
+static void evio_trace_flush(evio_trace *trace)
+{
+    if (trace->count && fwrite(trace->buf, sizeof(*trace->buf), trace->count,
+                               trace->stream) != trace->count) {
+        trace->failed = true;
+    }
+    trace->count = 0;
+}
+
+void evio_trace_write(evio_loop *loop, evio_trace_type type, int arg, evio_mask emask)
+{
+    evio_trace *trace = loop->trace;
+
+    if (type == EVIO_TRACE_POLL && __evio_unlikely(arg == loop->event.fd)) {
+        // The internal eventfd is captured as async/signal wake-ups.
+        return;
+    }
+
+    evio_trace_rec *r = &trace->buf[trace->count++];
+    r->time = loop->time - trace->start;
+    r->arg = arg;
+    r->type = type;
+    r->emask = emask;
+
+    if (trace->count == EVIO_TRACE_BUFFER) {
+        evio_trace_flush(trace);
+    }
+}
+
+void evio_trace_start(evio_loop *loop, FILE *stream)
+{
+    if (__evio_unlikely(loop->trace)) {
+        return;
+    }
+
+    evio_trace *trace = evio_malloc(sizeof(*trace));
+    trace->stream = stream;
+    trace->start = loop->time;
+    trace->count = 0;
+
+    evio_trace_hdr hdr = {
+        .magic = EVIO_TRACE_MAGIC,
+        .version = EVIO_TRACE_VERSION,
+        .size = sizeof(evio_trace_rec),
+    };
+    trace->failed = fwrite(&hdr, sizeof(hdr), 1, stream) != 1;
+
+    loop->trace = trace;
+}
+
+int evio_trace_stop(evio_loop *loop)
+{
+    evio_trace *trace = loop->trace;
+    if (!trace) {
+        return 0;
+    }
+
+    evio_trace_flush(trace);
+    if (fflush(trace->stream) != 0) {
+        trace->failed = true;
+    }
+
+    int rc = trace->failed ? -1 : 0;
+    evio_free(trace);
+    loop->trace = NULL;
+    return rc;
+}
+
+long evio_trace_replay(evio_loop *loop, FILE *stream)
+{
+    evio_trace_hdr hdr;
+    if (fread(&hdr, sizeof(hdr), 1, stream) != 1 ||
+        memcmp(hdr.magic, EVIO_TRACE_MAGIC, sizeof(EVIO_TRACE_MAGIC)) != 0 ||
+        hdr.version != EVIO_TRACE_VERSION ||
+        hdr.size != sizeof(evio_trace_rec)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The trace drives the loop time.
+    const clockid_t clock_id = evio_get_clockid(loop);
+    evio_set_clockid(loop, EVIO_CLOCK_VIRTUAL);
+
+    const evio_time start = loop->time;
+    long iterations = 0;
+
+    evio_trace_rec r;
+    while (fread(&r, sizeof(r), 1, stream) == 1) {
+        switch ((evio_trace_type)r.type) {
+            case EVIO_TRACE_POLL:
+                evio_feed_fd_event(loop, r.arg, r.emask);
+                break;
+
+            case EVIO_TRACE_TIME:
+                evio_poll_update(loop);
+                loop->time = start + r.time;
+                evio_timer_update(loop);
+                evio_invoke_pending(loop);
+                ++iterations;
+                break;
+
+            case EVIO_TRACE_TIMER:
+                // Timers fire from the replayed loop time.
+                break;
+
+            case EVIO_TRACE_ASYNC:
+                if (r.arg >= 0 && (size_t)r.arg < loop->async.count) {
+                    evio_feed_event(loop, loop->async.ptr[r.arg], EVIO_ASYNC);
+                }
+                evio_invoke_pending(loop);
+                break;
+
+            case EVIO_TRACE_SIGNAL:
+                evio_feed_signal(loop, r.arg);
+                evio_invoke_pending(loop);
+                break;
+
+            default:
+                evio_set_clockid(loop, clock_id);
+                errno = EINVAL;
+                return -1;
+        }
+    }
+
+    evio_invoke_pending(loop);
+    evio_set_clockid(loop, clock_id);
+    return iterations;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+/**
+ * @file evio_trace.h
+ * @brief Capture and replay of loop event streams.
+ * @details A capture writes the readiness events, timer fires, async and
+ * signal wake-ups of a running loop into a compact binary trace (16 bytes per
+ * record). A replay feeds the trace back into another loop through the
+ * `evio_feed_*` functions, driving the loop time from the trace instead of the
+ * system clock, so callback and dispatch changes can be benchmarked against
+ * recorded traffic offline and reproducibly.
+ *
+ * File descriptors and signals are matched by number. Async watchers are
+ * matched by their position among the active async watchers of the loop.
+ * Traces use the host byte order.
+ */
+
+#include "evio.h"
+
+/**
+ * @brief Starts capturing the event stream of a loop.
+ * @details Writes the trace header immediately. If a capture is already
+ * running, this is a no-op.
+ * @param loop The event loop.
+ * @param stream The output stream. Must stay open until `evio_trace_stop`.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_trace_start(evio_loop *loop, FILE *stream);
+
+/**
+ * @brief Stops capturing and flushes buffered records.
+ * @details If no capture is running, this is a no-op.
+ * @param loop The event loop.
+ * @return 0 on success, or -1 if any write to the stream failed.
+ */
+__evio_public __evio_nonnull(1)
+int evio_trace_stop(evio_loop *loop);
+
+/**
+ * @brief Replays a captured trace into a loop.
+ * @details Each captured iteration sets the loop time to the recorded time
+ * (relative to the loop time when the replay starts), fires due timers and
+ * invokes the fed callbacks. The loop is not polled during the replay and
+ * runs on `EVIO_CLOCK_VIRTUAL`; the previous clock source is restored on return.
+ * @param loop The event loop.
+ * @param stream The input stream, positioned at the trace header.
+ * @return The number of replayed iterations, or -1 with `errno` set to
+ * `EINVAL` if the stream is not a valid trace.
+ */
+__evio_public __evio_nonnull(1, 2)
+long evio_trace_replay(evio_loop *loop, FILE *stream);
@@ -9,8 +9,19 @@
 #include "evio_uring.h"
 #include "evio_uring_sys.h"
 
+/** @brief An epoll_ctl operation waiting for a free submission queue entry. */
+struct evio_uring_op {
+    struct epoll_event ev;  /**< The epoll event. */
+    int fd;                 /**< The file descriptor. */
+    int op;                 /**< The epoll operation. */
+};
+
 struct evio_uring {
-    struct epoll_event events[EVIO_URING_EVENTS]; /**< Local cache for epoll_event structs. */
+    struct epoll_event *events; /**< Local cache for epoll_event structs, one per SQE. */
+    struct evio_uring_op *over; /**< Overflow queue of epoll_ctl operations. */
+    size_t over_head;       /**< Index of the first queued overflow operation. */
+    size_t over_count;      /**< Number of overflow operations, including submitted ones. */
+    size_t over_total;      /**< Allocated capacity of the overflow queue. */
     uint32_t *sqhead;       /**< Pointer to the submission queue head. */
     uint32_t *cqhead;       /**< Pointer to the completion queue head. */
     uint32_t *sqtail;       /**< Pointer to the submission queue tail. */
@@ -22,11 +33,43 @@ struct evio_uring {
     struct io_uring_sqe *sqe; /**< Pointer to the start of the SQE array. */
     size_t maxlen;          /**< Length of the main mmap'd region. */
     size_t sqelen;          /**< Length of the SQE mmap'd region. */
+    size_t ctl;             /**< Number of queued or submitted epoll_ctl operations not yet reaped. */
+    uint32_t *sqflags;      /**< Pointer to the submission queue flags. */
+    bool sqpoll;            /**< A kernel thread polls the submission queue. */
+    bool no_msg;            /**< `IORING_OP_MSG_RING` is not supported by the kernel. */
+    uint32_t msg_seq;       /**< Tag of the last sent wake-up. */
+    int msg_res;            /**< Result of the last sent wake-up, or 1 until reaped. */
+    uint64_t owner;         /**< Id of the thread the ring fd is registered with, or 0. */
+    unsigned int index;     /**< The registered ring fd index in the owner thread. */
+    evio_poll io;           /**< Watches the ring for request completions. */
     int fd;                 /**< The io_uring file descriptor. */
 };
 
-_Static_assert(EVIO_URING_EVENTS <= 256,
-               "EVIO_URING_EVENTS must fit in user_data slot encoding");
+/** @brief `user_data` tag of request completions (the rest is the request pointer). */
+#define EVIO_URING_REQ  (UINT64_C(1) << 63)
+/** @brief `user_data` tag of completions that need no processing. */
+#define EVIO_URING_SKIP (UINT64_C(1) << 62)
+/** @brief `user_data` tag of sent wake-ups (the rest is the sequence number). */
+#define EVIO_URING_MSG  (UINT64_C(1) << 61)
+
+/** @brief The size of the kernel signal set (the libc `sigset_t` is larger). */
+#define EVIO_URING_SIGSET_SIZE (_NSIG / 8)
+
+/** @brief The last thread id handed out by `evio_uring_thread_id`. */
+static uint64_t evio_uring_thread_last;
+
+/**
+ * @brief The id of the current thread, or 0 until first used.
+ * @details Registered ring fds are private to the registering thread. Ids are
+ * never reused, unlike the addresses of thread-local variables or thread ids
+ * of exited threads.
+ */
+static _Thread_local uint64_t evio_uring_thread;
+
+#ifndef EVIO_URING_SQ_SPIN
+/** @brief Polls of the completion queue before blocking while the SQPOLL thread catches up. */
+#define EVIO_URING_SQ_SPIN 1024
+#endif
 
 /** @brief Atomic load with acquire memory ordering. */
 #define evio_uring_load(ptr)      __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
@@ -68,10 +111,68 @@ int evio_uring_enter(unsigned int fd,
 }
 
 /**
- * @brief Submits pending `io_uring` operations and waits for their completion.
+ * @brief Gets the id of the current thread.
+ * @return The thread id, never 0.
+ */
+static inline __evio_nodiscard
+uint64_t evio_uring_thread_id(void)
+{
+    if (__evio_unlikely(!evio_uring_thread)) {
+        evio_uring_thread = __atomic_add_fetch(&evio_uring_thread_last, 1, __ATOMIC_RELAXED);
+    }
+    return evio_uring_thread;
+}
+
+/**
+ * @brief Enters the ring, using the registered ring fd in its owner thread.
+ * @param iou The io_uring instance.
+ * @param to_submit Number of SQEs to submit.
+ * @param min_complete Number of CQEs to wait for.
+ * @param flags Flags for the enter operation.
+ * @param sig Signal mask.
+ * @param sz Size of the signal mask.
+ * @return 0 on success, or a negative error code.
+ */
+static inline __evio_nodiscard
+int evio_uring_enter_ring(const evio_uring *iou,
+                          unsigned int to_submit,
+                          unsigned int min_complete,
+                          unsigned int flags,
+                          sigset_t *sig, size_t sz)
+{
+#ifdef IORING_ENTER_REGISTERED_RING
+    if (iou->owner && iou->owner == evio_uring_thread) {
+        return evio_uring_enter(iou->index, to_submit, min_complete,
+                                flags | IORING_ENTER_REGISTERED_RING, sig, sz);
+    }
+#endif
+    return evio_uring_enter((unsigned int)iou->fd, to_submit, min_complete, flags, sig, sz);
+}
+
+/**
+ * @brief Checks if the submission queue polling thread needs a wake-up.
+ * @details Must be called after the new submission queue tail is stored.
+ * @param iou The io_uring instance.
+ * @return `IORING_ENTER_SQ_WAKEUP` if the thread went idle, 0 otherwise.
+ */
+static inline unsigned int evio_uring_sq_wakeup(const evio_uring *iou)
+{
+    if (!iou->sqpoll) {
+        return 0;
+    }
+
+    // Orders the tail store before the flags load, paired with the kernel.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return (__atomic_load_n(iou->sqflags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) ?
+           IORING_ENTER_SQ_WAKEUP : 0;
+}
+
+/**
+ * @brief Submits pending `io_uring` operations and waits for completions.
  * @param loop The event loop.
+ * @param wait The number of completions to wait for.
  */
-static void evio_uring_submit_and_wait(evio_loop *loop)
+static void evio_uring_submit_and_wait(evio_loop *loop, size_t wait)
 {
     evio_uring *iou = loop->iou;
 
@@ -81,12 +182,15 @@ static void evio_uring_submit_and_wait(evio_loop *loop)
 
     unsigned int n = loop->iou_count;
     // GCOVR_EXCL_START
-    EVIO_ASSERT(n);
+    EVIO_ASSERT(n || wait);
     // GCOVR_EXCL_STOP
 
+    unsigned int min = wait < UINT_MAX ? (unsigned int)wait : UINT_MAX;
+    unsigned int flags = IORING_ENTER_GETEVENTS | evio_uring_sq_wakeup(iou);
+
     for (;;) { // GCOVR_EXCL_LINE
-        int ret = evio_uring_enter(iou->fd, n, n, IORING_ENTER_GETEVENTS,
-                                   &loop->sigmask, sizeof(loop->sigmask));
+        int ret = evio_uring_enter_ring(iou, n, min, flags,
+                                        &loop->sigmask, EVIO_URING_SIGSET_SIZE);
         // GCOVR_EXCL_START
         if (__evio_unlikely(ret < 0)) {
             int err = ret == -1 ? errno : -ret;
@@ -105,32 +209,107 @@ static void evio_uring_submit_and_wait(evio_loop *loop)
     loop->iou_count = 0;
 }
 
-void evio_uring_ctl(evio_loop *loop, int op, int fd, const struct epoll_event *ev)
+/**
+ * @brief Checks if the submission queue has no free entry.
+ * @param iou The io_uring instance.
+ * @return `true` if the submission queue is full.
+ */
+static inline bool evio_uring_sq_full(const evio_uring *iou)
 {
-    evio_uring *iou = loop->iou;
-
-    // GCOVR_EXCL_START
-    EVIO_ASSERT(iou && iou->fd >= 0);
-
-    EVIO_ASSERT(op == EPOLL_CTL_ADD ||
-                op == EPOLL_CTL_MOD);
-    // GCOVR_EXCL_STOP
-
     uint32_t mask = iou->sqmask;
     uint32_t tail = *iou->sqtail;
     uint32_t head = evio_uring_load(iou->sqhead);
+    return ((tail + 1) & mask) == (head & mask);
+}
+
+/**
+ * @brief Reserves the next submission queue entry.
+ * @details Flushes the ring first if the submission queue is full.
+ * @param loop The event loop.
+ * @param[out] slot The reserved slot index.
+ * @return The zeroed submission queue entry.
+ */
+static struct io_uring_sqe *evio_uring_get_sqe(evio_loop *loop, uint32_t *slot)
+{
+    evio_uring *iou = loop->iou;
 
-    if (__evio_unlikely(((tail + 1) & mask) == (head & mask))) {
+    if (__evio_unlikely(evio_uring_sq_full(iou))) {
         evio_uring_flush(loop);
-        head = evio_uring_load(iou->sqhead);
     }
 
-    uint32_t slot = tail & mask;
+    *slot = *iou->sqtail & iou->sqmask;
+
+    struct io_uring_sqe *sqe = &iou->sqe[*slot];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+/**
+ * @brief Publishes the submission queue entry reserved last.
+ * @param loop The event loop.
+ */
+static void evio_uring_put_sqe(evio_loop *loop)
+{
+    evio_uring *iou = loop->iou;
+    evio_uring_store(iou->sqtail, *iou->sqtail + 1);
+    ++loop->iou_count;
+}
+
+/**
+ * @brief Internal callback for the ring poll watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the ring poll watcher.
+ * @param emask The received event mask.
+ */
+static void evio_uring_poll_cb(evio_loop *loop, evio_base *base, evio_mask emask);
+
+void evio_uring_watch(evio_loop *loop)
+{
+    evio_uring *iou = loop->iou;
+
+    if (__evio_unlikely(!iou->io.active)) {
+        evio_poll_init(&iou->io, evio_uring_poll_cb, iou->fd, EVIO_READ);
+        evio_poll_start(loop, &iou->io);
+        evio_unref(loop);
+    }
+}
+
+/**
+ * @brief Reserves a submission queue entry for a request.
+ * @details Starts watching the ring for completions on first use.
+ * @param loop The event loop.
+ * @param req The request.
+ * @return The submission queue entry, with `user_data` set.
+ */
+static struct io_uring_sqe *evio_uring_req_sqe(evio_loop *loop, evio_uring_req *req)
+{
+    evio_uring_watch(loop);
+
+    uint32_t slot;
+    struct io_uring_sqe *sqe = evio_uring_get_sqe(loop, &slot);
+    sqe->user_data = (uintptr_t)req | EVIO_URING_REQ;
+
+    ++req->inflight;
+    return sqe;
+}
+
+/**
+ * @brief Queues an epoll_ctl operation into a free submission queue entry.
+ * @param loop The event loop.
+ * @param op The epoll operation.
+ * @param fd The file descriptor for the operation.
+ * @param ev The epoll_event structure for the operation.
+ */
+static void evio_uring_ctl_sqe(evio_loop *loop, int op, int fd, const struct epoll_event *ev)
+{
+    evio_uring *iou = loop->iou;
+
+    uint32_t slot;
+    struct io_uring_sqe *sqe = evio_uring_get_sqe(loop, &slot);
 
     struct epoll_event *event = &iou->events[slot];
     *event = *ev;
 
-    struct io_uring_sqe *sqe = &iou->sqe[slot];
     *sqe = (struct io_uring_sqe) {
         .opcode     = IORING_OP_EPOLL_CTL,
         .fd         = loop->fd,
@@ -138,101 +317,455 @@ void evio_uring_ctl(evio_loop *loop, int op, int fd, const struct epoll_event *e
         .addr       = (uintptr_t)event,
         .len        = op,
         .user_data  = ((uint64_t)fd) |
-                      ((uint64_t)op << 32) |
-                      ((uint64_t)slot << 34),
+                      ((uint64_t)op << 32),
     };
 
-    evio_uring_store(iou->sqtail, ++tail);
-    ++loop->iou_count;
+    evio_uring_put_sqe(loop);
+    ++iou->ctl;
 }
 
-void evio_uring_flush(evio_loop *loop)
+void evio_uring_ctl(evio_loop *loop, int op, int fd, const struct epoll_event *ev)
 {
     evio_uring *iou = loop->iou;
 
     // GCOVR_EXCL_START
     EVIO_ASSERT(iou && iou->fd >= 0);
+
+    EVIO_ASSERT(op == EPOLL_CTL_ADD ||
+                op == EPOLL_CTL_MOD);
     // GCOVR_EXCL_STOP
 
-    while (loop->iou_count) {
-        evio_uring_submit_and_wait(loop);
+    // With a full ring, the operation waits for the next flush instead of
+    // forcing a round trip in the middle of an update. Once anything is in
+    // the overflow queue, later operations follow it to keep their order.
+    if (__evio_unlikely(iou->over_count || evio_uring_sq_full(iou))) {
+        iou->over = evio_list_ensure(iou->over, sizeof(*iou->over),
+                                     iou->over_count + 1, &iou->over_total);
+        iou->over[iou->over_count++] = (struct evio_uring_op) {
+            .ev = *ev,
+            .fd = fd,
+            .op = op,
+        };
+        return;
+    }
 
-        uint32_t head = *iou->cqhead;
-        uint32_t tail = evio_uring_load(iou->cqtail);
+    evio_uring_ctl_sqe(loop, op, fd, ev);
+}
+
+/**
+ * @brief Moves overflow operations into the free submission queue entries.
+ * @param loop The event loop.
+ */
+static void evio_uring_drain(evio_loop *loop)
+{
+    evio_uring *iou = loop->iou;
 
-        for (; head != tail; ++head) {
-            uint32_t mask = iou->cqmask;
-            uint32_t slot = head & mask;
+    while (iou->over_head < iou->over_count && !evio_uring_sq_full(iou)) {
+        const struct evio_uring_op *o = &iou->over[iou->over_head++];
+        evio_uring_ctl_sqe(loop, o->op, o->fd, &o->ev);
+    }
 
-            const struct io_uring_cqe *cqe = &iou->cqe[slot];
+    if (iou->over_head == iou->over_count) {
+        iou->over_head = 0;
+        iou->over_count = 0;
+    }
+}
 
-            uint32_t fd32 = cqe->user_data & UINT32_MAX;
-            // GCOVR_EXCL_START
-            if (__evio_unlikely(fd32 >= loop->fds.count)) {
-                EVIO_ABORT("Invalid fd %u\n", fd32);
+/**
+ * @brief Processes the result of an epoll_ctl operation.
+ * @param loop The event loop.
+ * @param user_data The completion user data.
+ * @param res The completion result.
+ */
+static void evio_uring_ctl_done(evio_loop *loop, uint64_t user_data, int res)
+{
+    uint32_t fd32 = user_data & UINT32_MAX;
+    // GCOVR_EXCL_START
+    if (__evio_unlikely(fd32 >= loop->fds.count)) {
+        EVIO_ABORT("Invalid fd %u\n", fd32);
+    }
+    // GCOVR_EXCL_STOP
+
+    int fd = fd32;
+    int op = (user_data >> 32) & 3;
+    // GCOVR_EXCL_START
+    if (__evio_unlikely(op != EPOLL_CTL_ADD &&
+                        op != EPOLL_CTL_MOD)) {
+        EVIO_ABORT("Invalid fd %d op %d\n", fd, op);
+    }
+    // GCOVR_EXCL_STOP
+
+    EVIO_URING_CQE_OVERRIDE(fd, op, &res);
+
+    if (__evio_likely(res == 0)) {
+        return;
+    }
+
+    // Retries register the current state of the fd, which the SQE slot
+    // may no longer hold once the kernel consumed it.
+    const evio_fds *fds = &loop->fds.ptr[fd];
+    const struct epoll_event ev = {
+        .events     = evio_poll_events(fds->emask),
+        .data.u64   = ((uint64_t)fd) | ((uint64_t)fds->gen << 32),
+    };
+
+    evio_recorder_add(loop, EVIO_REC_URING, fd, 0, NULL,
+                      (uint32_t)op | ((uint64_t)(uint32_t)res << 32));
+
+    switch (res) {
+        case -EEXIST:
+            if (op == EPOLL_CTL_ADD) {
+                evio_uring_ctl(loop, EPOLL_CTL_MOD, fd, &ev);
+                break;
             }
-            // GCOVR_EXCL_STOP
+            __evio_fallthrough;
 
-            int fd = fd32;
-            int op = (cqe->user_data >> 32) & 3;
-            // GCOVR_EXCL_START
-            if (__evio_unlikely(op != EPOLL_CTL_ADD &&
-                                op != EPOLL_CTL_MOD)) {
-                EVIO_ABORT("Invalid fd %d op %d\n", fd, op);
+        case -ENOENT:
+            if (op == EPOLL_CTL_MOD && res == -ENOENT) {
+                evio_uring_ctl(loop, EPOLL_CTL_ADD, fd, &ev);
+                break;
             }
-            // GCOVR_EXCL_STOP
+            __evio_fallthrough;
+
+        case -EPERM:
+            if (res == -EPERM) {
+                evio_queue_fd_error(loop, fd);
+                break;
+            }
+            __evio_fallthrough;
+
+        default:
+            loop->fds.ptr[fd].gen--;
+            evio_queue_fd_errors(loop, fd);
+            break;
+    }
+}
+
+/**
+ * @brief Processes all available completions.
+ * @details The completion queue head is advanced before each completion is
+ * handled, so handlers may submit and flush again.
+ * @param loop The event loop.
+ */
+static void evio_uring_reap(evio_loop *loop)
+{
+    evio_uring *iou = loop->iou;
+
+    for (;;) {
+        uint32_t head = *iou->cqhead;
+        if (head == evio_uring_load(iou->cqtail)) {
+            break;
+        }
+
+        const struct io_uring_cqe *cqe = &iou->cqe[head & iou->cqmask];
+        const uint64_t user_data = cqe->user_data;
+        const uint32_t flags = cqe->flags;
+        const int res = cqe->res;
+
+        evio_uring_store(iou->cqhead, head + 1);
 
-            slot = (cqe->user_data >> 34) & 0xFF;
+        if (user_data & EVIO_URING_REQ) {
+            evio_uring_req *req = (evio_uring_req *)(uintptr_t)(user_data & ~EVIO_URING_REQ);
+            const bool more = flags & IORING_CQE_F_MORE;
+            if (!more) {
+                --req->inflight;
+            }
+#ifdef IORING_CQE_F_NOTIF
+            req->notif = flags & IORING_CQE_F_NOTIF;
+#endif
+            req->cb(loop, req, res, more);
+            continue;
+        }
+
+        if (user_data & EVIO_URING_MSG) {
             // GCOVR_EXCL_START
-            if (__evio_unlikely(slot >= EVIO_URING_EVENTS)) {
-                EVIO_ABORT("Invalid fd %d slot %u\n", fd, slot);
+            if (__evio_unlikely(res == -EINVAL || res == -EOPNOTSUPP)) {
+                iou->no_msg = true;
             }
             // GCOVR_EXCL_STOP
+            // Completions of earlier wake-ups are stale: their sender has
+            // already written the eventfd of the target instead.
+            if ((uint32_t)user_data == iou->msg_seq) {
+                iou->msg_res = res;
+            }
+            continue;
+        }
 
-            const struct epoll_event *ev = &iou->events[slot];
+        if (user_data & EVIO_URING_SKIP) {
+            continue;
+        }
 
-            int res = cqe->res;
-            EVIO_URING_CQE_OVERRIDE(fd, op, &res);
+        --iou->ctl;
+        evio_uring_ctl_done(loop, user_data, res);
+    }
+}
 
-            if (__evio_likely(res == 0)) {
-                continue;
-            }
+static void evio_uring_poll_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_uring_reap(loop);
+}
 
-            switch (res) {
-                case -EEXIST:
-                    if (op == EPOLL_CTL_ADD) {
-                        evio_uring_ctl(loop, EPOLL_CTL_MOD, fd, ev);
-                        break;
-                    }
-                    __evio_fallthrough;
-
-                case -ENOENT:
-                    if (op == EPOLL_CTL_MOD && res == -ENOENT) {
-                        evio_uring_ctl(loop, EPOLL_CTL_ADD, fd, ev);
-                        break;
-                    }
-                    __evio_fallthrough;
-
-                case -EPERM:
-                    if (res == -EPERM) {
-                        evio_queue_fd_error(loop, fd);
-                        break;
-                    }
-                    __evio_fallthrough;
-
-                default:
-                    loop->fds.ptr[fd].gen--;
-                    evio_queue_fd_errors(loop, fd);
-                    break;
+/**
+ * @brief Hands the queued submissions over to the submission queue polling thread.
+ * @details No system call is made while the thread is awake and the
+ * submission queue has room for the overflow queue. The results are polled
+ * from the completion queue, and only after `EVIO_URING_SQ_SPIN` empty polls
+ * does this block in `io_uring_enter`: an `epoll_ctl` that cannot take the
+ * epoll lock right away completes later from an io-wq worker.
+ * @param loop The event loop.
+ */
+static void evio_uring_sq_flush(evio_loop *loop)
+{
+    evio_uring *iou = loop->iou;
+    size_t spin = 0;
+
+    while (loop->iou_count || iou->ctl || iou->over_count) {
+        evio_uring_drain(loop);
+
+        unsigned int flags = evio_uring_sq_wakeup(iou);
+#ifdef IORING_ENTER_SQ_WAIT
+        if (evio_uring_sq_full(iou)) {
+            // Waits for the thread to make room in the submission queue.
+            flags |= IORING_ENTER_SQ_WAIT;
+        }
+#endif
+
+        while (flags) {
+            EVIO_PROBE2(uring_flush, loop, loop->iou_count);
+            int ret = evio_uring_enter_ring(iou, 0, 0, flags, NULL, 0);
+            // GCOVR_EXCL_START
+            if (__evio_unlikely(ret < 0)) {
+                int err = ret == -1 ? errno : -ret;
+                if (err == EINTR || err == EAGAIN) {
+                    continue;
+                }
+                EVIO_ABORT("io_uring_enter() failed, error %d: %s\n", err, EVIO_STRERROR(err));
             }
+            // GCOVR_EXCL_STOP
+            break;
         }
 
-        if (*iou->cqhead != head) { // GCOVR_EXCL_LINE
-            evio_uring_store(iou->cqhead, head);
+        loop->iou_count = 0;
+
+        // Registrations take effect before the next epoll_wait() like
+        // without SQPOLL, so wait for the results.
+        evio_uring_reap(loop);
+        if (iou->ctl && ++spin > EVIO_URING_SQ_SPIN) {
+            evio_uring_submit_and_wait(loop, iou->ctl);
+            evio_uring_reap(loop);
+            spin = 0;
         }
     }
 }
 
+void evio_uring_flush(evio_loop *loop)
+{
+    evio_uring *iou = loop->iou;
+
+    // GCOVR_EXCL_START
+    EVIO_ASSERT(iou && iou->fd >= 0);
+    // GCOVR_EXCL_STOP
+
+    if (iou->sqpoll) {
+        evio_uring_sq_flush(loop);
+        return;
+    }
+
+    while (loop->iou_count || iou->ctl || iou->over_count) {
+        evio_uring_drain(loop);
+        EVIO_PROBE2(uring_flush, loop, loop->iou_count);
+        evio_uring_submit_and_wait(loop, iou->ctl);
+        evio_uring_reap(loop);
+    }
+}
+
+bool evio_uring_sqpoll(const evio_uring *iou)
+{
+    return iou->sqpoll;
+}
+
+bool evio_uring_register_ring(evio_uring *iou)
+{
+#ifdef IORING_ENTER_REGISTERED_RING
+    if (iou->owner) {
+        return false;
+    }
+
+    // Saves the fd table lookup on every io_uring_enter() of this thread.
+    struct io_uring_rsrc_update up = { .offset = UINT32_MAX, .data = (uint64_t)iou->fd };
+    if (EVIO_URING_REGISTER(iou->fd, IORING_REGISTER_RING_FDS, &up, 1) == 1) {
+        iou->owner = evio_uring_thread_id();
+        iou->index = up.offset;
+        return true;
+    }
+#endif
+    return false;
+}
+
+void evio_uring_unregister_ring(evio_uring *iou)
+{
+#ifdef IORING_ENTER_REGISTERED_RING
+    EVIO_ASSERT(iou->owner == evio_uring_thread);
+
+    struct io_uring_rsrc_update up = { .offset = iou->index };
+    (void)EVIO_URING_REGISTER(iou->fd, IORING_UNREGISTER_RING_FDS, &up, 1);
+    iou->owner = 0;
+#endif
+}
+
+bool evio_uring_msg(evio_loop *loop, evio_loop *target)
+{
+#ifdef EVIO_URING_MSG_RING
+    evio_uring *iou = loop->iou;
+
+    // A polling thread posts the message later, when the target may be gone.
+    if (__evio_unlikely(iou->no_msg || iou->sqpoll)) {
+        return false;
+    }
+
+    // The sender reaps the completions of messages that went asynchronous.
+    evio_uring_watch(loop);
+
+    uint32_t slot;
+    struct io_uring_sqe *sqe = evio_uring_get_sqe(loop, &slot);
+    sqe->opcode = IORING_OP_MSG_RING;
+    sqe->fd = target->iou->fd;
+    sqe->off = EVIO_URING_SKIP; // The target completion needs no processing
+    sqe->user_data = ++iou->msg_seq | EVIO_URING_MSG;
+    evio_uring_put_sqe(loop);
+
+    // Submitted right away: the pending flag of the target keeps other
+    // senders from waking it until this message is posted.
+    iou->msg_res = 1;
+    evio_uring_submit_and_wait(loop, 0);
+    evio_uring_reap(loop);
+
+    // The result is usually posted inline. Otherwise (the target ring is
+    // busy) or on failure, the eventfd is written while the caller still
+    // holds the target, and the later completion is ignored.
+    if (__evio_unlikely(iou->msg_res)) {
+        evio_eventfd_kick(target);
+    }
+    return true;
+#else // GCOVR_EXCL_START
+    return false;
+#endif // GCOVR_EXCL_STOP
+}
+
+bool evio_uring_accept(evio_loop *loop, evio_uring_req *req, int fd, int flags)
+{
+#ifdef IORING_ACCEPT_MULTISHOT
+    struct io_uring_sqe *sqe = evio_uring_req_sqe(loop, req);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = (uint32_t)flags;
+    evio_uring_put_sqe(loop);
+    return true;
+#else // GCOVR_EXCL_START
+    return false;
+#endif // GCOVR_EXCL_STOP
+}
+
+bool evio_uring_send(evio_loop *loop, evio_uring_req *req, int fd,
+                     const void *buf, size_t len, int flags)
+{
+    struct io_uring_sqe *sqe = evio_uring_req_sqe(loop, req);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t)buf;
+    sqe->len = len < UINT32_MAX ? (uint32_t)len : UINT32_MAX;
+    sqe->msg_flags = (uint32_t)flags;
+    evio_uring_put_sqe(loop);
+    return true;
+}
+
+bool evio_uring_send_zc(evio_loop *loop, evio_uring_req *req, int fd,
+                        const void *buf, size_t len, int flags)
+{
+#ifdef IORING_CQE_F_NOTIF
+    struct io_uring_sqe *sqe = evio_uring_req_sqe(loop, req);
+    sqe->opcode = IORING_OP_SEND_ZC;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t)buf;
+    sqe->len = len < UINT32_MAX ? (uint32_t)len : UINT32_MAX;
+    sqe->msg_flags = (uint32_t)flags;
+#ifdef IORING_SEND_ZC_REPORT_USAGE
+    sqe->ioprio = IORING_SEND_ZC_REPORT_USAGE;
+#endif
+    evio_uring_put_sqe(loop);
+    return true;
+#else // GCOVR_EXCL_START
+    return false;
+#endif // GCOVR_EXCL_STOP
+}
+
+bool evio_uring_file(evio_loop *loop, evio_uring_req *req, const evio_uring_file_args *args)
+{
+    struct io_uring_sqe *sqe = evio_uring_req_sqe(loop, req);
+    sqe->fd = args->fd;
+
+    switch (args->op) {
+        case EVIO_URING_OPEN:
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->addr = (uintptr_t)args->path;
+            sqe->len = args->mode;
+            sqe->open_flags = (uint32_t)args->flags;
+            break;
+
+        case EVIO_URING_READ:
+        case EVIO_URING_WRITE:
+            sqe->opcode = args->op == EVIO_URING_READ ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr = (uintptr_t)args->buf;
+            sqe->len = args->len < UINT32_MAX ? (uint32_t)args->len : UINT32_MAX;
+            sqe->off = (uint64_t)args->off;
+            break;
+
+        case EVIO_URING_FSYNC:
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fsync_flags = args->flags ? IORING_FSYNC_DATASYNC : 0;
+            break;
+
+        case EVIO_URING_STATX:
+            sqe->opcode = IORING_OP_STATX;
+            sqe->addr = (uintptr_t)args->path;
+            sqe->len = args->mode;
+            sqe->off = (uintptr_t)args->buf;
+            sqe->statx_flags = (uint32_t)args->flags;
+            break;
+
+        default:
+            sqe->opcode = IORING_OP_CLOSE;
+            break;
+    }
+
+    evio_uring_put_sqe(loop);
+    return true;
+}
+
+void evio_uring_cancel(evio_loop *loop, evio_uring_req *req, bool wait)
+{
+    if (!req->inflight) {
+        return;
+    }
+
+    uint32_t slot;
+    struct io_uring_sqe *sqe = evio_uring_get_sqe(loop, &slot);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uintptr_t)req | EVIO_URING_REQ;
+#ifdef IORING_ASYNC_CANCEL_ALL
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+#endif
+    sqe->user_data = EVIO_URING_SKIP;
+    evio_uring_put_sqe(loop);
+
+    while (wait && req->inflight) {
+        evio_uring_submit_and_wait(loop, 1);
+        evio_uring_reap(loop);
+    }
+}
+
 /**
  * @brief Runtime probe to check if IORING_OP_EPOLL_CTL is supported.
  * @return 1 if supported, 0 if unsupported, -1 if indeterminate.
@@ -437,7 +970,7 @@ static int evio_uring_probe_epoll_ctl_cached(void)
 
 #endif
 
-evio_uring *evio_uring_new(void)
+evio_uring *evio_uring_new(int flags, uint32_t depth, int cpu, const evio_uring *parent)
 {
 #ifdef EVIO_TESTING
     if (__evio_unlikely(evio_uring_probe_epoll_ctl() != 1)) {
@@ -465,7 +998,54 @@ evio_uring *evio_uring_new(void)
     params.flags |= IORING_SETUP_NO_SQARRAY;
 #endif
 
-    int fd = evio_uring_setup(EVIO_URING_EVENTS, &params);
+#ifdef IORING_SETUP_SINGLE_ISSUER
+    // IORING_SETUP_DEFER_TASKRUN is not used: deferred completion work does
+    // not wake up the epoll instance watching the ring.
+    if (flags & EVIO_FLAG_SINGLE_THREAD) {
+        params.flags |= IORING_SETUP_SINGLE_ISSUER;
+    }
+#endif
+
+    if (!depth) {
+        depth = EVIO_URING_EVENTS;
+    }
+
+#ifdef IORING_SETUP_ATTACH_WQ
+    if (parent) {
+        // Shares the async workers, and the polling thread with SQPOLL.
+        params.flags |= IORING_SETUP_ATTACH_WQ;
+        params.wq_fd = (uint32_t)parent->fd;
+    }
+#endif
+
+    const uint32_t setup_flags = params.flags;
+    const uint32_t wq_fd = params.wq_fd;
+
+#ifdef IORING_ENTER_SQ_WAIT
+    if (flags & EVIO_FLAG_SQPOLL) {
+        // Task work runs in the polling thread, not in this one.
+#ifdef IORING_SETUP_COOP_TASKRUN
+        params.flags &= ~IORING_SETUP_COOP_TASKRUN;
+#endif
+        params.flags |= IORING_SETUP_SQPOLL;
+        if (cpu >= 0) {
+            params.flags |= IORING_SETUP_SQ_AFF;
+            params.sq_thread_cpu = (uint32_t)cpu;
+        }
+    }
+#endif
+
+    int fd = evio_uring_setup(depth, &params);
+    if (__evio_unlikely(fd < 0) && (params.flags & IORING_SETUP_SQPOLL)) {
+        // Refused, e.g. without permission or for an offline CPU:
+        // submit with io_uring_enter() instead.
+        memset(&params, 0, sizeof(params));
+        params.flags = setup_flags;
+        params.wq_fd = wq_fd;
+
+        fd = evio_uring_setup(depth, &params);
+    }
+
     // GCOVR_EXCL_START
     if (__evio_unlikely(fd < 0)) {
         int err = fd == -1 ? errno : -fd;
@@ -476,7 +1056,7 @@ evio_uring *evio_uring_new(void)
         memset(&params, 0, sizeof(params));
         params.flags = IORING_SETUP_CLAMP;
 
-        fd = evio_uring_setup(EVIO_URING_EVENTS, &params);
+        fd = evio_uring_setup(depth, &params);
         if (__evio_unlikely(fd < 0)) {
             return NULL;
         }
@@ -538,6 +1118,10 @@ evio_uring *evio_uring_new(void)
         .fd         = fd,
     };
 
+    iou->events = evio_calloc(params.sq_entries, sizeof(*iou->events));
+    iou->sqflags = (uint32_t *)(ptr + params.sq_off.flags);
+    iou->sqpoll = params.flags & IORING_SETUP_SQPOLL;
+
     // GCOVR_EXCL_START
     if (params.sq_off.array) {
         uint32_t *sqarray = (uint32_t *)(ptr + params.sq_off.array);
@@ -552,9 +1136,13 @@ evio_uring *evio_uring_new(void)
 
 void evio_uring_free(evio_uring *iou)
 {
+    EVIO_ASSERT(!iou->owner);
+
     munmap(iou->ptr, iou->maxlen);
     munmap(iou->sqe, iou->sqelen);
 
     close(iou->fd);
+    evio_free(iou->events);
+    evio_free(iou->over);
     evio_free(iou);
 }
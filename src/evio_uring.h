@@ -7,6 +7,10 @@
  * It abstracts the `io_uring` API to submit `epoll_ctl` operations
  * asynchronously, which can offer a significant performance benefit over
  * traditional syscalls on supported systems.
+ *
+ * Other operations are submitted as requests: their completions are reaped
+ * when the ring becomes readable in epoll, or while flushing `epoll_ctl`
+ * operations, and reported to the request callback.
  */
 
 #include "evio.h"
@@ -16,12 +20,42 @@ struct epoll_event;
 /** @brief Opaque type for an io_uring instance. */
 typedef struct evio_uring evio_uring;
 
+/** @brief An asynchronous io_uring request. */
+typedef struct evio_uring_req evio_uring_req;
+
+/**
+ * @brief The type for io_uring request completion callbacks.
+ * @param loop The event loop.
+ * @param req The completed request.
+ * @param res The completion result (`cqe->res`).
+ * @param more `true` if the request will post more completions.
+ */
+typedef void (*evio_uring_cb)(evio_loop *loop, evio_uring_req *req, int res, bool more);
+
+/** @brief Release completion flag of a zero-copy send whose data was copied. */
+#define EVIO_URING_ZC_COPIED (1U << 31)
+
+/** @brief An asynchronous io_uring request, embedded in its owner. */
+struct evio_uring_req {
+    evio_uring_cb cb;       /**< The completion callback. */
+    size_t inflight;        /**< Number of submitted operations that may still complete. */
+    bool notif;             /**< The completion being reported is a zero-copy release. */
+};
+
 /**
  * @brief Creates and initializes a new io_uring instance.
+ * @param flags The loop flags. With `EVIO_FLAG_SINGLE_THREAD`, the ring is
+ * set up for a single submitter thread.
+ * @param depth The number of submission queue entries, or 0 for
+ * `EVIO_URING_EVENTS`. Rounded up to a power of two and clamped by the kernel.
+ * @param cpu With `EVIO_FLAG_SQPOLL`, the CPU to pin the submission queue
+ * polling thread to, or -1 to leave it unpinned.
+ * @param parent An instance to share the async workers and the polling
+ * thread with (`IORING_SETUP_ATTACH_WQ`), or NULL.
  * @return A pointer to the new instance, or NULL if not supported or on error.
  */
 __evio_nodiscard
-evio_uring *evio_uring_new(void);
+evio_uring *evio_uring_new(int flags, uint32_t depth, int cpu, const evio_uring *parent);
 
 /**
  * @brief Frees an io_uring instance and its associated resources.
@@ -46,3 +80,151 @@ void evio_uring_ctl(evio_loop *loop, int op, int fd, const struct epoll_event *e
  */
 __evio_nonnull(1)
 void evio_uring_flush(evio_loop *loop);
+
+/**
+ * @brief Starts watching the ring for completions, if not yet.
+ * @details Required on a loop that receives `evio_uring_msg` wake-ups.
+ * @param loop The event loop.
+ */
+__evio_nonnull(1)
+void evio_uring_watch(evio_loop *loop);
+
+/**
+ * @brief Checks if a kernel thread polls the submission queue.
+ * @details Submissions then need no `io_uring_enter` call while the thread
+ * is awake, and results are polled from the completion queue.
+ * @param iou The io_uring instance.
+ * @return `true` if the ring was set up with `IORING_SETUP_SQPOLL`.
+ */
+__evio_nonnull(1) __evio_nodiscard
+bool evio_uring_sqpoll(const evio_uring *iou);
+
+/**
+ * @brief Registers the ring fd with the calling thread.
+ * @details The thread then enters the ring without a file table lookup. The
+ * registration is private to the thread, so it must be dropped by
+ * `evio_uring_unregister_ring` in the same thread before the ring is used
+ * from another thread or freed.
+ * @param iou The io_uring instance.
+ * @return `true` if registered, `false` if already registered or not supported.
+ */
+__evio_nonnull(1)
+bool evio_uring_register_ring(evio_uring *iou);
+
+/**
+ * @brief Drops the ring fd registration of the calling thread.
+ * @param iou The io_uring instance, registered by `evio_uring_register_ring`
+ * in this thread.
+ */
+__evio_nonnull(1)
+void evio_uring_unregister_ring(evio_uring *iou);
+
+/**
+ * @brief Sends an `IORING_OP_MSG_RING` wake-up to another loop.
+ * @details The message is submitted right away, and the target ring receives
+ * a completion that makes its ring fd readable in the target's epoll
+ * instance. If the message cannot be posted, the target eventfd is written
+ * instead.
+ *
+ * The result is reaped before returning. If the kernel completes the message
+ * asynchronously (when the target ring is busy), the eventfd is written as
+ * well, and the later completion never refers to the target, which may have
+ * been freed by then. Loops with a submission queue polling thread do not
+ * send messages, since they would always complete asynchronously.
+ * @param loop The sending event loop, running in this thread.
+ * @param target The event loop to wake up, which also uses io_uring.
+ * @return `true` if sent, `false` if `IORING_OP_MSG_RING` is not available
+ * or the sending loop uses SQPOLL.
+ */
+__evio_nonnull(1, 2) __evio_nodiscard
+bool evio_uring_msg(evio_loop *loop, evio_loop *target);
+
+/**
+ * @brief Queues a multishot accept request on a listening socket.
+ * @details Each accepted connection completes with the new fd as result.
+ * @param loop The event loop.
+ * @param req The request.
+ * @param fd The listening socket.
+ * @param flags The `accept4` flags for accepted sockets.
+ * @return `true` if queued, `false` if multishot accept is not available.
+ */
+__evio_nonnull(1, 2) __evio_nodiscard
+bool evio_uring_accept(evio_loop *loop, evio_uring_req *req, int fd, int flags);
+
+/**
+ * @brief Queues a send request (`IORING_OP_SEND`).
+ * @details The completion carries the number of bytes sent, or a negative
+ * error code.
+ * @param loop The event loop.
+ * @param req The request.
+ * @param fd The socket.
+ * @param buf The data to send, which must stay valid until completion.
+ * @param len The length of the data, up to `UINT32_MAX` bytes per request.
+ * @param flags The `send` flags.
+ * @return `true` if queued.
+ */
+__evio_nonnull(1, 2, 4) __evio_nodiscard
+bool evio_uring_send(evio_loop *loop, evio_uring_req *req, int fd,
+                     const void *buf, size_t len, int flags);
+
+/**
+ * @brief Queues a zero-copy send request (`IORING_OP_SEND_ZC`).
+ * @details The first completion carries the number of bytes sent, or a
+ * negative error code. If it has `more` set, a second completion follows
+ * once the kernel no longer references the buffer; its result has
+ * `EVIO_URING_ZC_COPIED` set if the data was copied after all.
+ * @param loop The event loop.
+ * @param req The request.
+ * @param fd The socket.
+ * @param buf The data to send, which must stay valid until released.
+ * @param len The length of the data, up to `UINT32_MAX` bytes per request.
+ * @param flags The `send` flags.
+ * @return `true` if queued, `false` if zero-copy send is not available.
+ */
+__evio_nonnull(1, 2, 4) __evio_nodiscard
+bool evio_uring_send_zc(evio_loop *loop, evio_uring_req *req, int fd,
+                        const void *buf, size_t len, int flags);
+
+/** @brief File operations for `evio_uring_file`. */
+enum evio_uring_file_op {
+    EVIO_URING_OPEN     = 0, /**< `openat(fd, path, flags, mode)`. */
+    EVIO_URING_READ     = 1, /**< `pread(fd, buf, len, off)`, or `read` if `off` is -1. */
+    EVIO_URING_WRITE    = 2, /**< `pwrite(fd, buf, len, off)`, or `write` if `off` is -1. */
+    EVIO_URING_FSYNC    = 3, /**< `fsync(fd)`, or `fdatasync(fd)` if `flags` is nonzero. */
+    EVIO_URING_STATX    = 4, /**< `statx(fd, path, flags, mode, buf)`. */
+    EVIO_URING_CLOSE    = 5, /**< `close(fd)`. */
+};
+
+/** @brief The arguments of a file operation. */
+typedef struct {
+    int op;                 /**< The operation (`enum evio_uring_file_op`). */
+    int fd;                 /**< The file descriptor, or directory fd for paths. */
+    const char *path;       /**< The path, for open and statx. */
+    void *buf;              /**< The data buffer, or the `struct statx` result. */
+    size_t len;             /**< The length of the data buffer. */
+    int64_t off;            /**< The file offset, or -1 for the file position. */
+    int flags;              /**< The operation flags. */
+    unsigned int mode;      /**< The open mode, or the statx mask. */
+} evio_uring_file_args;
+
+/**
+ * @brief Queues a file operation.
+ * @details The completion carries the result of the equivalent system call,
+ * or a negative error code. The arguments are read when the request is
+ * submitted, so the path must stay valid until the completion.
+ * @param loop The event loop.
+ * @param req The request.
+ * @param args The operation and its arguments.
+ * @return `true` if queued, `false` if io_uring is not available.
+ */
+__evio_nonnull(1, 2, 3) __evio_nodiscard
+bool evio_uring_file(evio_loop *loop, evio_uring_req *req, const evio_uring_file_args *args);
+
+/**
+ * @brief Cancels all in-flight operations of a request.
+ * @param loop The event loop.
+ * @param req The request to cancel.
+ * @param wait `true` to wait until the request posted its final completion.
+ */
+__evio_nonnull(1, 2)
+void evio_uring_cancel(evio_loop *loop, evio_uring_req *req, bool wait);
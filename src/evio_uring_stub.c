@@ -3,7 +3,7 @@
 #include "evio_core.h"
 #include "evio_uring.h"
 
-evio_uring *evio_uring_new(void)
+evio_uring *evio_uring_new(int flags, uint32_t depth, int cpu, const evio_uring *parent)
 {
     return NULL;
 }
@@ -22,3 +22,55 @@ void evio_uring_flush(evio_loop *loop)
 {
     EVIO_ABORT("Invalid io_uring usage\n");
 }
+
+void evio_uring_watch(evio_loop *loop)
+{
+    EVIO_ABORT("Invalid io_uring usage\n");
+}
+
+bool evio_uring_sqpoll(const evio_uring *iou)
+{
+    return false;
+}
+
+bool evio_uring_register_ring(evio_uring *iou)
+{
+    return false;
+}
+
+void evio_uring_unregister_ring(evio_uring *iou)
+{
+    EVIO_ABORT("Invalid io_uring usage\n");
+}
+
+bool evio_uring_msg(evio_loop *loop, evio_loop *target)
+{
+    return false;
+}
+
+bool evio_uring_accept(evio_loop *loop, evio_uring_req *req, int fd, int flags)
+{
+    return false;
+}
+
+bool evio_uring_send(evio_loop *loop, evio_uring_req *req, int fd,
+                     const void *buf, size_t len, int flags)
+{
+    return false;
+}
+
+bool evio_uring_send_zc(evio_loop *loop, evio_uring_req *req, int fd,
+                        const void *buf, size_t len, int flags)
+{
+    return false;
+}
+
+bool evio_uring_file(evio_loop *loop, evio_uring_req *req, const evio_uring_file_args *args)
+{
+    return false;
+}
+
+void evio_uring_cancel(evio_loop *loop, evio_uring_req *req, bool wait)
+{
+    EVIO_ABORT("Invalid io_uring usage\n");
+}
@@ -17,7 +17,7 @@
 
 #include <linux/io_uring.h>
 
-/** @brief The number of entries for the io_uring submission/completion queues. */
+/** @brief The default number of entries for the io_uring submission queue. */
 #define EVIO_URING_EVENTS 256
 
 #ifdef EVIO_TESTING
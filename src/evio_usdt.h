@@ -0,0 +1,23 @@
+#pragma once
+
+/**
+ * @file evio_usdt.h
+ * @brief Private USDT static tracepoints (not public API).
+ * @details When built with `-Dusdt=true`, each `EVIO_PROBE*` site emits an SDT
+ * note in the `evio` provider that `perf probe` and `bpftrace` can attach to.
+ * An unattached probe costs a single nop; without the option they compile away.
+ */
+
+#ifdef EVIO_USDT
+#include <sys/sdt.h>
+
+#define EVIO_PROBE1(name, a)             DTRACE_PROBE1(evio, name, a)
+#define EVIO_PROBE2(name, a, b)          DTRACE_PROBE2(evio, name, a, b)
+#define EVIO_PROBE3(name, a, b, c)       DTRACE_PROBE3(evio, name, a, b, c)
+#define EVIO_PROBE4(name, a, b, c, d)    DTRACE_PROBE4(evio, name, a, b, c, d)
+#else
+#define EVIO_PROBE1(name, a)             ((void)0)
+#define EVIO_PROBE2(name, a, b)          ((void)0)
+#define EVIO_PROBE3(name, a, b, c)       ((void)0)
+#define EVIO_PROBE4(name, a, b, c, d)    ((void)0)
+#endif
@@ -96,6 +96,7 @@ void evio_abort(const char *restrict file, int line,
         }
 
         fwrite(str, 1, len, stream);
+        evio_recorder_abort(stream);
         fflush(stream);
     }
 
@@ -0,0 +1,140 @@
+#include <pthread.h>
+
+#include "evio_core.h"
+#include "evio_watchdog.h"
+
+/** @brief The minimum sampling interval of the watchdog thread. */
+#define EVIO_WATCHDOG_MIN_INTERVAL EVIO_TIME_PER_MSEC
+
+/** @brief The internal state of a loop stall watchdog. */
+struct evio_watchdog {
+    pthread_t thread;           /**< The watchdog thread. */
+    pthread_mutex_t mutex;      /**< Protects `stop`. */
+    pthread_cond_t cond;        /**< Signaled to wake the thread on stop. */
+    evio_loop *loop;            /**< The watched event loop. */
+    evio_watchdog_cb cb;        /**< The stall callback. */
+    void *ctx;                  /**< The user context pointer. */
+    evio_time threshold;        /**< The stall threshold in nanoseconds. */
+    evio_time interval;         /**< The heartbeat sampling interval in nanoseconds. */
+    bool stop;                  /**< Set to request thread exit. */
+};
+
+/**
+ * @brief Reads the monotonic clock used by the watchdog thread.
+ * @return The current time in nanoseconds.
+ */
+static evio_time evio_watchdog_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return EVIO_TIME_FROM_SEC(ts.tv_sec) + ts.tv_nsec;
+}
+
+/**
+ * @brief The watchdog thread.
+ * @details Samples the loop heartbeat every `interval` and reports a stall
+ * once per heartbeat value that stays busy for at least `threshold`.
+ * @param ptr The watchdog state.
+ * @return Always `NULL`.
+ */
+static void *evio_watchdog_thread(void *ptr)
+{
+    evio_watchdog *wd = ptr;
+    evio_loop *loop = wd->loop;
+
+    uint64_t last = atomic_load_explicit(&loop->wd_beat.value, memory_order_acquire);
+    evio_time since = evio_watchdog_now();
+    bool reported = false;
+
+    pthread_mutex_lock(&wd->mutex);
+    while (!wd->stop) {
+        evio_time deadline = evio_watchdog_now() + wd->interval;
+        struct timespec ts = {
+            .tv_sec = (time_t)(deadline / EVIO_TIME_PER_SEC),
+            .tv_nsec = (long)(deadline % EVIO_TIME_PER_SEC),
+        };
+        pthread_cond_timedwait(&wd->cond, &wd->mutex, &ts);
+        if (wd->stop) {
+            break;
+        }
+
+        const uint64_t beat = atomic_load_explicit(&loop->wd_beat.value, memory_order_acquire);
+        const evio_time now = evio_watchdog_now();
+
+        if (beat != last || (beat & EVIO_BEAT_IDLE)) {
+            last = beat;
+            since = now;
+            reported = false;
+            continue;
+        }
+
+        if (!reported && now - since >= wd->threshold) {
+            evio_cb cb = atomic_load_explicit(&loop->wd_cb.value, memory_order_relaxed);
+            reported = true;
+
+            pthread_mutex_unlock(&wd->mutex);
+            wd->cb(loop, cb, now - since, wd->ctx);
+            pthread_mutex_lock(&wd->mutex);
+        }
+    }
+    pthread_mutex_unlock(&wd->mutex);
+    return NULL;
+}
+
+void evio_watchdog_start(evio_loop *loop, evio_time threshold, evio_watchdog_cb cb, void *ctx)
+{
+    if (__evio_unlikely(loop->wd)) {
+        return;
+    }
+
+    evio_watchdog *wd = evio_malloc(sizeof(*wd));
+    wd->loop = loop;
+    wd->cb = cb;
+    wd->ctx = ctx;
+    wd->threshold = threshold;
+    wd->interval = threshold / 4;
+    if (wd->interval < EVIO_WATCHDOG_MIN_INTERVAL) {
+        wd->interval = EVIO_WATCHDOG_MIN_INTERVAL;
+    }
+    wd->stop = false;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wd->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&wd->mutex, NULL);
+
+    // The loop is not inside evio_run() yet: start idle.
+    atomic_store_explicit(&loop->wd_cb.value, NULL, memory_order_relaxed);
+    atomic_store_explicit(&loop->wd_beat.value, EVIO_BEAT_IDLE, memory_order_release);
+
+    int rc = pthread_create(&wd->thread, NULL, evio_watchdog_thread, wd);
+    // GCOVR_EXCL_START
+    if (__evio_unlikely(rc != 0)) {
+        EVIO_ABORT("pthread_create() failed: %d\n", rc);
+    }
+    // GCOVR_EXCL_STOP
+
+    loop->wd = wd;
+}
+
+void evio_watchdog_stop(evio_loop *loop)
+{
+    evio_watchdog *wd = loop->wd;
+    if (!wd) {
+        return;
+    }
+
+    pthread_mutex_lock(&wd->mutex);
+    wd->stop = true;
+    pthread_cond_signal(&wd->cond);
+    pthread_mutex_unlock(&wd->mutex);
+
+    pthread_join(wd->thread, NULL);
+    pthread_cond_destroy(&wd->cond);
+    pthread_mutex_destroy(&wd->mutex);
+    evio_free(wd);
+
+    loop->wd = NULL;
+}
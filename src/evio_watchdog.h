@@ -0,0 +1,45 @@
+#pragma once
+
+/**
+ * @file evio_watchdog.h
+ * @brief A loop stall watchdog that reports callbacks blocking the event loop.
+ * @details A background thread samples a heartbeat that the loop updates at
+ * iteration and callback boundaries. When the heartbeat does not advance for
+ * longer than the threshold while the loop is busy (not blocked in epoll and
+ * not outside `evio_run`), the watchdog callback is invoked once per stall
+ * with the watcher callback that was running at the time.
+ */
+
+#include "evio.h"
+
+/**
+ * @brief The type for watchdog callback functions.
+ * @details Runs on the watchdog thread, not on the loop thread. It must not
+ * use the stalled loop except for thread-safe functions like `evio_async_send`.
+ * @param loop The stalled event loop.
+ * @param cb The watcher callback running when the stall was detected,
+ * or `NULL` if the loop was stalled between callbacks.
+ * @param elapsed The time without a heartbeat, in nanoseconds.
+ * @param ctx The user context pointer passed to `evio_watchdog_start`.
+ */
+typedef void (*evio_watchdog_cb)(evio_loop *loop, evio_cb cb, evio_time elapsed, void *ctx);
+
+/**
+ * @brief Starts the stall watchdog for an event loop.
+ * @details If the watchdog is already running, this is a no-op.
+ * @param loop The event loop to watch.
+ * @param threshold The stall threshold in nanoseconds.
+ * @param cb The callback to invoke on the watchdog thread when a stall is detected.
+ * @param ctx A user context pointer passed to the callback.
+ */
+__evio_public __evio_nonnull(1, 3)
+void evio_watchdog_start(evio_loop *loop, evio_time threshold, evio_watchdog_cb cb, void *ctx);
+
+/**
+ * @brief Stops the stall watchdog and joins its thread.
+ * @details If the watchdog is not running, this is a no-op.
+ * Must not be called from the watchdog callback.
+ * @param loop The event loop.
+ */
+__evio_public __evio_nonnull(1)
+void evio_watchdog_stop(evio_loop *loop);
@@ -0,0 +1,542 @@
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+#include "evio_core.h"
+#include "evio_zsend.h"
+
+/** @brief The send methods of a zero-copy send watcher. */
+enum {
+    EVIO_ZSEND_COPY     = 0, /**< Plain `send`, for sockets without zero-copy support. */
+    EVIO_ZSEND_MSG      = 1, /**< `send` with `MSG_ZEROCOPY`, notified through the error queue. */
+    EVIO_ZSEND_URING    = 2, /**< `IORING_OP_SEND_ZC` requests. */
+};
+
+/** @brief A buffer queued on a zero-copy send watcher. */
+struct evio_zsend_buf {
+    evio_uring_req req;             /**< The send request on io_uring. */
+    evio_zsend *w;                  /**< The owning watcher, or `NULL` once stopped. */
+    struct evio_zsend_buf *next;    /**< The next buffer in the queue. */
+    const void *buf;                /**< The data to send. */
+    size_t len;                     /**< The length of the data. */
+    void *data;                     /**< The user pointer. */
+    size_t off;                     /**< Number of bytes handed to the kernel. */
+    uint32_t lo;                    /**< The `MSG_ZEROCOPY` id of the first send. */
+    uint32_t calls;                 /**< Number of `MSG_ZEROCOPY` sends. */
+    uint32_t left;                  /**< Number of `MSG_ZEROCOPY` sends not notified yet. */
+    int err;                        /**< The error that stopped sending, or 0. */
+    bool copied;                    /**< The data was copied. */
+    bool released;                  /**< The buffer was moved to the released list. */
+};
+
+/**
+ * @brief Checks if the kernel is done with all the data of a buffer.
+ * @param b The buffer.
+ * @return `true` if the buffer can be released.
+ */
+static bool evio_zsend_idle(const struct evio_zsend_buf *b)
+{
+    return !b->released && (b->off == b->len || b->err) && !b->left && !b->req.inflight;
+}
+
+/**
+ * @brief Picks the send method for the epoll path.
+ * @param w The zero-copy send watcher.
+ * @return `EVIO_ZSEND_MSG` if the socket supports `MSG_ZEROCOPY`.
+ */
+static int evio_zsend_probe(evio_zsend *w)
+{
+    int one = 1;
+    if (setsockopt(w->io.fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+        return EVIO_ZSEND_MSG;
+    }
+    return EVIO_ZSEND_COPY;
+}
+
+/**
+ * @brief Moves a buffer from the send queue to the released list.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher.
+ * @param b The buffer, which the kernel is done with.
+ */
+static void evio_zsend_release(evio_loop *loop, evio_zsend *w, struct evio_zsend_buf *b)
+{
+    struct evio_zsend_buf *prev = NULL;
+    for (struct evio_zsend_buf *it = w->head; it != b; it = it->next) {
+        prev = it;
+    }
+
+    if (prev) {
+        prev->next = b->next;
+    } else {
+        w->head = b->next;
+    }
+    if (w->tail == b) {
+        w->tail = prev;
+    }
+
+    b->next = NULL;
+    b->released = true;
+    if (w->done_tail) {
+        w->done_tail->next = b;
+    } else {
+        w->done = b;
+    }
+    w->done_tail = b;
+
+    if (!--w->count) {
+        evio_unref(loop);
+    }
+
+    evio_queue_event(loop, &w->base, EVIO_WRITE | (w->err ? EVIO_ERROR : 0));
+}
+
+/**
+ * @brief Stops sending after a socket error.
+ * @details Buffers not fully sent are released once the kernel is done
+ * with the part that was sent.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher.
+ * @param err The error number.
+ */
+static void evio_zsend_fail(evio_loop *loop, evio_zsend *w, int err)
+{
+    w->err = err;
+
+    for (struct evio_zsend_buf *b = w->send, *next; b; b = next) {
+        next = b->next;
+        b->err = err;
+        if (evio_zsend_idle(b)) {
+            evio_zsend_release(loop, w, b);
+        }
+    }
+
+    w->send = NULL;
+}
+
+/**
+ * @brief Applies a `MSG_ZEROCOPY` notification for a range of send ids.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher.
+ * @param lo The first notified id.
+ * @param hi The last notified id (inclusive).
+ * @param copied `true` if the data was copied.
+ */
+static void evio_zsend_notify(evio_loop *loop, evio_zsend *w,
+                              uint32_t lo, uint32_t hi, bool copied)
+{
+    for (struct evio_zsend_buf *b = w->head, *next; b; b = next) {
+        next = b->next;
+
+        for (uint32_t i = 0; i < b->calls && b->left; ++i) {
+            // Ids wrap around: compare offsets into the range.
+            if ((uint32_t)(b->lo + i - lo) <= (uint32_t)(hi - lo)) {
+                --b->left;
+                b->copied |= copied;
+            }
+        }
+
+        if (evio_zsend_idle(b)) {
+            evio_zsend_release(loop, w, b);
+        }
+    }
+}
+
+/**
+ * @brief Reads the `MSG_ZEROCOPY` notifications from the socket error queue.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher.
+ */
+static void evio_zsend_errqueue(evio_loop *loop, evio_zsend *w)
+{
+    union {
+        char buf[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+        struct cmsghdr align;
+    } control;
+
+    for (;;) {
+        struct msghdr msg = {
+            .msg_control    = control.buf,
+            .msg_controllen = sizeof(control.buf),
+        };
+
+        if (recvmsg(w->io.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) {
+                continue; // GCOVR_EXCL_LINE
+            }
+            break;
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+                continue; // GCOVR_EXCL_LINE
+            }
+
+            struct sock_extended_err ee;
+            memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+
+            if (ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY || ee.ee_errno) {
+                continue; // GCOVR_EXCL_LINE
+            }
+
+            evio_zsend_notify(loop, w, ee.ee_info, ee.ee_data,
+                              ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+        }
+    }
+}
+
+/**
+ * @brief Hands queued data to the kernel until the socket buffer is full.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher, not using io_uring.
+ */
+static void evio_zsend_pump(evio_loop *loop, evio_zsend *w)
+{
+    bool zerocopy = w->mode == EVIO_ZSEND_MSG;
+
+    while (w->send) {
+        struct evio_zsend_buf *b = w->send;
+
+        const int flags = MSG_DONTWAIT | MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0);
+        ssize_t n = send(w->io.fd, (const char *)b->buf + b->off, b->len - b->off, flags);
+        if (__evio_unlikely(n < 0)) {
+            int err = errno;
+            if (err == EAGAIN) {
+                break;
+            }
+            // GCOVR_EXCL_START
+            if (err == EINTR) {
+                continue;
+            }
+            if (err == ENOBUFS && zerocopy) {
+                // Out of notification memory: copy this chunk.
+                zerocopy = false;
+                continue;
+            }
+            // GCOVR_EXCL_STOP
+            evio_zsend_fail(loop, w, err);
+            return;
+        }
+
+        if (flags & MSG_ZEROCOPY) {
+            if (!b->calls++) {
+                b->lo = w->seq;
+            }
+            ++b->left;
+            ++w->seq;
+        } else {
+            b->copied = true;
+        }
+
+        zerocopy = w->mode == EVIO_ZSEND_MSG;
+
+        b->off += (size_t)n;
+        if (b->off == b->len) {
+            w->send = b->next;
+            if (evio_zsend_idle(b)) {
+                evio_zsend_release(loop, w, b);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Watches the socket while there is data to send or to be notified about.
+ * @details Write readiness is needed while data is waiting; error queue
+ * reports alone only need an edge-triggered read registration, which also
+ * reports `EPOLLERR`.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher.
+ */
+static void evio_zsend_arm(evio_loop *loop, evio_zsend *w)
+{
+    evio_mask emask = 0;
+
+    if (w->mode != EVIO_ZSEND_URING) {
+        if (w->send) {
+            emask = EVIO_WRITE | EVIO_EDGE;
+        } else if (w->head && w->mode == EVIO_ZSEND_MSG) {
+            emask = EVIO_READ | EVIO_EDGE;
+        }
+    }
+
+    // The socket watcher holds no reference of its own.
+    if (!emask) {
+        if (w->io.active) {
+            evio_ref(loop);
+            evio_poll_stop(loop, &w->io);
+        }
+        return;
+    }
+
+    const bool active = w->io.active;
+    evio_poll_change(loop, &w->io, w->io.fd, emask);
+    if (!active) {
+        evio_unref(loop);
+    }
+}
+
+/**
+ * @brief Submits the next send request on io_uring.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher.
+ * @return `false` if zero-copy send is not available.
+ */
+static bool evio_zsend_submit(evio_loop *loop, evio_zsend *w)
+{
+    struct evio_zsend_buf *b = w->send;
+    if (!b || w->busy) {
+        return true;
+    }
+
+    if (!evio_uring_send_zc(loop, &b->req, w->io.fd, (const char *)b->buf + b->off,
+                            b->len - b->off, MSG_NOSIGNAL)) {
+        return false; // GCOVR_EXCL_LINE
+    }
+
+    w->busy = true;
+    return true;
+}
+
+/**
+ * @brief Sends queued data with the method in use.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher.
+ */
+static void evio_zsend_flush(evio_loop *loop, evio_zsend *w)
+{
+    if (w->mode == EVIO_ZSEND_URING) {
+        if (__evio_likely(evio_zsend_submit(loop, w))) {
+            return;
+        }
+        w->mode = evio_zsend_probe(w); // GCOVR_EXCL_LINE
+    }
+
+    evio_zsend_pump(loop, w);
+    evio_zsend_arm(loop, w);
+}
+
+/**
+ * @brief Internal callback for the socket poll watcher.
+ * @param loop The event loop.
+ * @param base The base watcher pointer of the internal `evio_poll` watcher.
+ * @param emask The received event mask.
+ */
+static void evio_zsend_poll_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_zsend *w = container_of(base, evio_zsend, io.base);
+
+    if (__evio_unlikely(emask & EVIO_ERROR)) {
+        // The poll watcher was stopped, keep the refcount balanced.
+        evio_ref(loop);
+        evio_zsend_fail(loop, w, EBADF);
+
+        // Nothing will be notified anymore.
+        for (struct evio_zsend_buf *b = w->head, *next; b; b = next) {
+            next = b->next;
+            b->left = 0;
+            evio_zsend_release(loop, w, b);
+        }
+        return;
+    }
+
+    if (w->mode == EVIO_ZSEND_MSG) {
+        evio_zsend_errqueue(loop, w);
+    }
+
+    evio_zsend_pump(loop, w);
+    evio_zsend_arm(loop, w);
+}
+
+/**
+ * @brief Completion callback of a send request.
+ * @param loop The event loop.
+ * @param req The io_uring request of the buffer.
+ * @param res The number of bytes sent or a negative error code, or the
+ * release flags for notifications.
+ * @param more `true` if a release notification follows.
+ */
+static void evio_zsend_uring_cb(evio_loop *loop, evio_uring_req *req, int res, bool more)
+{
+    struct evio_zsend_buf *b = container_of(req, struct evio_zsend_buf, req);
+    evio_zsend *w = b->w;
+
+    if (__evio_unlikely(!w)) {
+        // Stopped while the kernel still held the buffer.
+        if (!req->inflight) {
+            evio_free(b);
+        }
+        return;
+    }
+
+    if (req->notif) {
+        b->copied |= (uint32_t)res & EVIO_URING_ZC_COPIED;
+    } else {
+        w->busy = false;
+
+        if (res >= 0) {
+            b->off += (size_t)res;
+            if (b->off == b->len) {
+                w->send = b->next;
+            }
+        } else if ((res == -EOPNOTSUPP || res == -EINVAL) && !b->off) {
+            // No zero-copy for this socket type: send with epoll instead.
+            w->mode = evio_zsend_probe(w);
+        } else if (res != -EINTR && res != -EAGAIN) {
+            evio_zsend_fail(loop, w, -res);
+        }
+
+        evio_zsend_flush(loop, w);
+    }
+
+    if (evio_zsend_idle(b) && b != w->send) {
+        evio_zsend_release(loop, w, b);
+    }
+}
+
+void evio_zsend_init(evio_zsend *w, evio_cb cb, int fd)
+{
+    evio_init(&w->base, cb);
+    evio_poll_init(&w->io, evio_zsend_poll_cb, fd, 0);
+    w->head = NULL;
+    w->tail = NULL;
+    w->send = NULL;
+    w->done = NULL;
+    w->done_tail = NULL;
+    w->count = 0;
+    w->seq = 0;
+    w->mode = EVIO_ZSEND_COPY;
+    w->err = 0;
+    w->busy = false;
+}
+
+void evio_zsend_start(evio_loop *loop, evio_zsend *w)
+{
+    if (__evio_unlikely(w->active)) {
+        return;
+    }
+
+    // References are only held while buffers are not released.
+    evio_list_start(loop, &w->base, &loop->zsend, false);
+
+    w->err = 0;
+    w->mode = loop->iou ? EVIO_ZSEND_URING : evio_zsend_probe(w);
+}
+
+/**
+ * @brief Frees a list of buffers.
+ * @details Buffers with requests in flight are canceled, and freed by their
+ * completion callback.
+ * @param loop The event loop.
+ * @param b The first buffer of the list.
+ */
+static void evio_zsend_free(evio_loop *loop, struct evio_zsend_buf *b)
+{
+    for (struct evio_zsend_buf *next; b; b = next) {
+        next = b->next;
+
+        if (b->req.inflight) {
+            b->w = NULL;
+            evio_uring_cancel(loop, &b->req, false);
+            continue;
+        }
+
+        evio_free(b);
+    }
+}
+
+void evio_zsend_stop(evio_loop *loop, evio_zsend *w)
+{
+    evio_clear_pending(loop, &w->base);
+    evio_clear_pending(loop, &w->io.base);
+
+    if (__evio_unlikely(!w->active)) {
+        return;
+    }
+
+    if (w->io.active) {
+        evio_ref(loop);
+        evio_poll_stop(loop, &w->io);
+    }
+
+    if (w->count) {
+        evio_unref(loop);
+    }
+
+    evio_zsend_free(loop, w->head);
+    evio_zsend_free(loop, w->done);
+
+    w->head = NULL;
+    w->tail = NULL;
+    w->send = NULL;
+    w->done = NULL;
+    w->done_tail = NULL;
+    w->count = 0;
+    w->busy = false;
+
+    evio_list_stop(loop, &w->base, &loop->zsend, false);
+}
+
+void evio_zsend_write(evio_loop *loop, evio_zsend *w, const void *buf, size_t len, void *data)
+{
+    EVIO_ASSERT(w->active);
+
+    struct evio_zsend_buf *b = evio_malloc(sizeof(*b));
+    *b = (struct evio_zsend_buf) {
+        .req.cb = evio_zsend_uring_cb,
+        .w      = w,
+        .buf    = buf,
+        .len    = len,
+        .data   = data,
+        .err    = w->err,
+    };
+
+    if (w->tail) {
+        w->tail->next = b;
+    } else {
+        w->head = b;
+    }
+    w->tail = b;
+
+    if (!w->count++) {
+        evio_ref(loop);
+    }
+
+    if (evio_zsend_idle(b)) {
+        // Empty, or sending failed before.
+        evio_zsend_release(loop, w, b);
+        return;
+    }
+
+    if (!w->send) {
+        w->send = b;
+        evio_zsend_flush(loop, w);
+    }
+}
+
+bool evio_zsend_next(evio_zsend *w, evio_zsend_done *done)
+{
+    struct evio_zsend_buf *b = w->done;
+    if (!b) {
+        return false;
+    }
+
+    w->done = b->next;
+    if (!w->done) {
+        w->done_tail = NULL;
+    }
+
+    *done = (evio_zsend_done) {
+        .buf    = b->buf,
+        .len    = b->len,
+        .data   = b->data,
+        .sent   = b->off,
+        .err    = b->err,
+        .copied = b->copied,
+    };
+
+    evio_free(b);
+    return true;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+/**
+ * @file evio_zsend.h
+ * @brief A watcher that sends caller-owned buffers without copying them.
+ * @details Built for sending the same large payloads to many sockets: the
+ * kernel transmits straight from the caller's memory, which must not be
+ * modified or freed until the watcher releases it. Released buffers are
+ * reported through the pending queue, and taken with `evio_zsend_next`.
+ *
+ * On loops created with `EVIO_FLAG_URING`, buffers are sent with
+ * `IORING_OP_SEND_ZC` where the kernel supports it. Otherwise they are sent
+ * with `MSG_ZEROCOPY`, and the release notifications are read from the
+ * socket error queue when epoll reports it. Sockets without zero-copy
+ * support (e.g. `AF_UNIX`) fall back to plain sends, and buffers are
+ * released as soon as they are written.
+ *
+ * Zero-copy pays off for large buffers only (roughly 10 KB and up): for
+ * smaller ones, pinning the pages and handling the notifications costs more
+ * than the copy.
+ */
+
+#include "evio.h"
+
+struct evio_zsend_buf;
+
+/** @brief A watcher that sends buffers with zero-copy. */
+typedef struct evio_zsend {
+    EVIO_BASE;
+    evio_poll io;                   /**< @private The socket poll watcher. */
+    struct evio_zsend_buf *head;    /**< @private Buffers not released yet, in send order. */
+    struct evio_zsend_buf *tail;    /**< @private The last buffer in `head`. */
+    struct evio_zsend_buf *send;    /**< @private The first buffer not fully handed to the kernel. */
+    struct evio_zsend_buf *done;    /**< @private Released buffers not taken yet. */
+    struct evio_zsend_buf *done_tail; /**< @private The last buffer in `done`. */
+    size_t count;                   /**< @private Number of buffers not released yet. */
+    uint32_t seq;                   /**< @private The id of the next `MSG_ZEROCOPY` send. */
+    int mode;                       /**< @private The send method in use. */
+    int err;                        /**< @private The error that stopped sending, or 0. */
+    bool busy;                      /**< @private A send request is in flight on io_uring. */
+} evio_zsend;
+
+/** @brief A released buffer, taken with `evio_zsend_next`. */
+typedef struct {
+    const void *buf;    /**< The buffer passed to `evio_zsend_write`. */
+    size_t len;         /**< The length passed to `evio_zsend_write`. */
+    void *data;         /**< The user pointer passed to `evio_zsend_write`. */
+    size_t sent;        /**< Number of bytes sent. */
+    int err;            /**< 0 if all data was sent, or the error that stopped sending. */
+    bool copied;        /**< The data was copied after all (e.g. over loopback). */
+} evio_zsend_done;
+
+/**
+ * @brief Initializes a zero-copy send watcher.
+ * @details The callback receives `EVIO_WRITE` when released buffers are
+ * available, to be taken with `evio_zsend_next`, and also `EVIO_ERROR` once
+ * sending failed. After a failure, buffers not sent yet and any new ones are
+ * released right away with the error.
+ * @param w The zero-copy send watcher to initialize.
+ * @param cb The callback to invoke when buffers are released.
+ * @param fd The connected socket (non-blocking). It may be watched by other
+ * poll watchers too, but should not be sent to with `MSG_ZEROCOPY` otherwise.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_zsend_init(evio_zsend *w, evio_cb cb, int fd);
+
+/**
+ * @brief Starts a zero-copy send watcher.
+ * @details The watcher keeps the loop alive while it has buffers that are
+ * not released yet.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher to start.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_zsend_start(evio_loop *loop, evio_zsend *w);
+
+/**
+ * @brief Stops a zero-copy send watcher.
+ * @details Buffers that are not released yet are dropped without being
+ * reported. Those already handed to the kernel may still be referenced by
+ * it until the socket is closed and the data it holds is freed.
+ * @param loop The event loop.
+ * @param w The zero-copy send watcher to stop.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_zsend_stop(evio_loop *loop, evio_zsend *w);
+
+/**
+ * @brief Queues a buffer for sending.
+ * @details Buffers are sent in order. With epoll, sending starts right away
+ * and continues on write readiness; with io_uring, one send request is in
+ * flight at a time and is submitted with the next loop iteration.
+ * @param loop The event loop.
+ * @param w The active zero-copy send watcher.
+ * @param buf The data to send, which must stay valid and unmodified until released.
+ * @param len The length of the data.
+ * @param data A user pointer reported back with the released buffer.
+ */
+__evio_public __evio_nonnull(1, 2)
+void evio_zsend_write(evio_loop *loop, evio_zsend *w, const void *buf, size_t len, void *data);
+
+/**
+ * @brief Takes the next released buffer.
+ * @details Buffers may be released in a different order than they were sent.
+ * @param w The zero-copy send watcher.
+ * @param[out] done The released buffer.
+ * @return `true` if a buffer was taken, `false` if none is released.
+ */
+__evio_public __evio_nonnull(1, 2) __evio_nodiscard
+bool evio_zsend_next(evio_zsend *w, evio_zsend_done *done);
+
+/**
+ * @brief Gets the number of buffers that are not released yet.
+ * @param w The zero-copy send watcher.
+ * @return The number of queued and in-flight buffers.
+ */
+static inline __evio_nonnull(1) __evio_nodiscard
+size_t evio_zsend_pending(const evio_zsend *w)
+{
+    return w->count;
+}
@@ -11,6 +11,8 @@
 #include <pthread.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "evio_core.h"
 
@@ -81,3 +83,69 @@
         skip(); \
         return; \
     } while (0)
+
+// A connected pair of non-blocking stream sockets.
+static inline void socket_pair(int fds[2])
+{
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds), 0);
+}
+
+// A non-blocking TCP socket listening on a loopback port, stored in `addr`.
+static inline int listen_socket(struct sockaddr_in *addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    assert_true(fd >= 0);
+
+    *addr = (struct sockaddr_in) {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t len = sizeof(*addr);
+
+    assert_int_equal(bind(fd, (struct sockaddr *)addr, len), 0);
+    assert_int_equal(listen(fd, 256), 0);
+    assert_int_equal(getsockname(fd, (struct sockaddr *)addr, &len), 0);
+    return fd;
+}
+
+static inline void connect_clients(const struct sockaddr_in *addr, int *fds, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        fds[i] = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        assert_true(fds[i] >= 0);
+        assert_int_equal(connect(fds[i], (const struct sockaddr *)addr, sizeof(*addr)), 0);
+    }
+}
+
+static inline void close_clients(int *fds, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        close(fds[i]);
+    }
+}
+
+// A connected pair of TCP sockets over loopback, non-blocking.
+static inline void tcp_pair(int fds[2])
+{
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    assert_true(lfd >= 0);
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t len = sizeof(addr);
+
+    assert_int_equal(bind(lfd, (struct sockaddr *)&addr, len), 0);
+    assert_int_equal(listen(lfd, 1), 0);
+    assert_int_equal(getsockname(lfd, (struct sockaddr *)&addr, &len), 0);
+
+    fds[0] = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    assert_true(fds[0] >= 0);
+    int rc = connect(fds[0], (struct sockaddr *)&addr, len);
+    assert_true(rc == 0 || errno == EINPROGRESS);
+
+    fds[1] = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    assert_true(fds[1] >= 0);
+    close(lfd);
+}
@@ -0,0 +1,239 @@
+#include "test.h"
+
+typedef struct {
+    size_t called;
+    size_t accepted;
+    evio_mask emask;
+} accept_cb_data;
+
+static void accept_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    accept_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+
+    evio_accept *w = container_of(base, evio_accept, base);
+    for (int fd; (fd = evio_accept_next(w)) >= 0;) {
+        data->accepted++;
+        close(fd);
+    }
+}
+
+static void count_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    accept_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+}
+
+static void run_until_accepted(evio_loop *loop, accept_cb_data *data, size_t count)
+{
+    for (size_t i = 0; i < 100 && data->accepted < count; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+}
+
+TEST(test_evio_accept)
+{
+    accept_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    struct sockaddr_in addr;
+    int lfd = listen_socket(&addr);
+
+    evio_accept w;
+    evio_accept_init(&w, accept_cb, lfd);
+    w.data = &data;
+    evio_accept_start(loop, &w);
+
+    // Double start: no-op
+    evio_accept_start(loop, &w);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    int cfds[3];
+    connect_clients(&addr, cfds, 3);
+
+    run_until_accepted(loop, &data, 3);
+    assert_int_equal(data.accepted, 3);
+    assert_true(data.emask & EVIO_READ);
+    assert_false(data.emask & EVIO_ERROR);
+
+    // Nothing queued
+    assert_int_equal(evio_accept_next(&w), -1);
+
+    evio_accept_stop(loop, &w);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // Double stop: no-op
+    evio_accept_stop(loop, &w);
+
+    close_clients(cfds, 3);
+    close(lfd);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_accept_exclusive)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    struct sockaddr_in addr;
+    int lfd = listen_socket(&addr);
+
+    evio_accept w;
+    evio_accept_init(&w, accept_cb, lfd);
+    evio_accept_start(loop, &w);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    // The listening socket is registered with EPOLLEXCLUSIVE.
+    assert_true(loop->fds.ptr[lfd].emask & EVIO_EXCLUSIVE);
+
+    evio_accept_stop(loop, &w);
+    close(lfd);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_accept_batch)
+{
+    accept_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    struct sockaddr_in addr;
+    int lfd = listen_socket(&addr);
+
+    evio_accept w;
+    evio_accept_init(&w, count_cb, lfd);
+    w.data = &data;
+    evio_accept_start(loop, &w);
+
+    int cfds[80];
+    connect_clients(&addr, cfds, 80);
+
+    // One wake-up accepts a bounded batch.
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(w.count - w.head, 64);
+
+    // Connections not taken stay queued.
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 2);
+    assert_int_equal(w.count - w.head, 80);
+
+    size_t taken = 0;
+    for (int fd; (fd = evio_accept_next(&w)) >= 0; ++taken) {
+        close(fd);
+    }
+    assert_int_equal(taken, 80);
+
+    // Queued connections are closed on stop.
+    connect_clients(&addr, cfds, 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(w.count - w.head, 1);
+    evio_accept_stop(loop, &w);
+    assert_int_equal(w.count, 0);
+
+    close_clients(cfds, 80);
+    close(lfd);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_accept_pause)
+{
+    accept_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    struct sockaddr_in addr;
+    int lfd = listen_socket(&addr);
+
+    evio_accept w;
+    evio_accept_init(&w, accept_cb, lfd);
+    w.data = &data;
+    evio_accept_start(loop, &w);
+
+    // Pretend the fd limit is reached.
+    w.limit = 0;
+
+    int cfds[2];
+    connect_clients(&addr, cfds, 2);
+
+    run_until_accepted(loop, &data, 1);
+    for (size_t i = 0; i < 10 && !w.tm.active; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+
+    // Paused: the retry timer runs instead of the listening socket watcher.
+    assert_true(w.tm.active);
+    assert_false(w.io.active);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    size_t accepted = data.accepted;
+    assert_true(accepted >= 1);
+
+    // Below the limit again: the retry timer resumes accepting.
+    w.limit = INT_MAX;
+    for (size_t i = 0; i < 10 && w.tm.active; ++i) {
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+    assert_false(w.tm.active);
+
+    run_until_accepted(loop, &data, 2);
+    assert_int_equal(data.accepted, 2);
+
+    evio_accept_stop(loop, &w);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close_clients(cfds, 2);
+    close(lfd);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_accept_error)
+{
+    accept_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    // Not listening: readiness is reported, but accept4() fails.
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    assert_true(fd >= 0);
+
+    evio_accept w;
+    evio_accept_init(&w, count_cb, fd);
+    w.data = &data;
+    evio_accept_start(loop, &w);
+
+    for (size_t i = 0; i < 10 && !data.called; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+
+    assert_int_equal(data.called, 1);
+    assert_true(data.emask & EVIO_ERROR);
+    assert_false(evio_is_active(&w.base));
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fd);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_accept_bad_fd)
+{
+    accept_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2] = { -1, -1 };
+    assert_int_equal(pipe(fds), 0);
+    close(fds[1]);
+
+    evio_accept w;
+    evio_accept_init(&w, count_cb, fds[0]);
+    w.data = &data;
+    evio_accept_start(loop, &w);
+
+    // The fd is gone before it is registered.
+    close(fds[0]);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    assert_int_equal(data.called, 1);
+    assert_true(data.emask & EVIO_ERROR);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_loop_free(loop);
+}
@@ -1,6 +1,10 @@
 #include "test.h"
 
+#include <poll.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "evio_uring.h"
 
 typedef struct {
     size_t called;
@@ -269,3 +273,218 @@ TEST(test_evio_async_pending)
 
     assert_int_equal(data.called, 0);
 }
+
+static bool fd_readable(int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    return poll(&pfd, 1, 0) == 1;
+}
+
+static bool wake_timer_armed(evio_loop *loop)
+{
+    struct itimerspec its;
+    assert_int_equal(timerfd_gettime(loop->wake.fd, &its), 0);
+    return its.it_value.tv_sec || its.it_value.tv_nsec;
+}
+
+TEST(test_evio_async_wake_moderation_batch)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_async async;
+    evio_async_init(&async, generic_cb);
+    async.data = &data;
+    evio_async_start(loop, &async);
+
+    evio_set_wake_moderation(loop, EVIO_TIME_FROM_SEC(10), 3);
+    assert_true(loop->wake.active);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // Pretend the loop is blocked in epoll.
+    atomic_store_explicit(&loop->eventfd_allow.value, 1, memory_order_release);
+
+    // The first send arms the timer instead of waking the loop.
+    evio_async_send(loop, &async);
+    assert_false(fd_readable(loop->event.fd));
+    assert_true(wake_timer_armed(loop));
+
+    evio_async_send(loop, &async);
+    assert_false(fd_readable(loop->event.fd));
+
+    // The batch is complete: wake up now.
+    evio_async_send(loop, &async);
+    assert_true(fd_readable(loop->event.fd));
+
+    atomic_store_explicit(&loop->eventfd_allow.value, 0, memory_order_relaxed);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+
+    // The fallback timer is canceled and the count restarts.
+    assert_false(wake_timer_armed(loop));
+    assert_int_equal(atomic_load(&loop->wake_count.value), 0);
+
+    // Sends while the loop is awake cost no syscall.
+    evio_async_send(loop, &async);
+    assert_false(wake_timer_armed(loop));
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 2);
+
+    evio_async_stop(loop, &async);
+    evio_loop_free(loop);
+}
+
+typedef struct {
+    evio_loop *loop;
+    evio_async *async;
+} delay_arg;
+
+static void *delay_send_thread(void *ptr)
+{
+    delay_arg *arg = ptr;
+
+    for (int i = 1000; i--;) {
+        if (atomic_load_explicit(&arg->loop->eventfd_allow.value, memory_order_acquire)) {
+            break;
+        }
+        usleep(100);
+    }
+    usleep(10 * 1000);
+
+    evio_async_send(arg->loop, arg->async);
+    return NULL;
+}
+
+TEST(test_evio_async_wake_moderation_delay)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_async async;
+    evio_async_init(&async, generic_cb);
+    async.data = &data;
+    evio_async_start(loop, &async);
+
+    evio_set_wake_moderation(loop, EVIO_TIME_FROM_MSEC(20), 0);
+
+    pthread_t thread;
+    delay_arg arg = { .loop = loop, .async = &async };
+    assert_int_equal(pthread_create(&thread, NULL, delay_send_thread, &arg), 0);
+
+    // Blocks until the fallback timer expires.
+    while (!data.called) {
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+    assert_int_equal(pthread_join(thread, NULL), 0);
+    assert_int_equal(data.called, 1);
+    assert_false(fd_readable(loop->wake.fd));
+
+    // Disabled: the first send writes the eventfd again.
+    evio_set_wake_moderation(loop, 0, 0);
+    atomic_store_explicit(&loop->eventfd_allow.value, 1, memory_order_release);
+    evio_async_send(loop, &async);
+    assert_true(fd_readable(loop->event.fd));
+    atomic_store_explicit(&loop->eventfd_allow.value, 0, memory_order_relaxed);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 2);
+
+    evio_async_stop(loop, &async);
+    evio_loop_free(loop);
+}
+
+typedef struct {
+    evio_loop *target;
+    evio_async *async;
+    bool readable;
+} msg_arg;
+
+static void msg_send_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    msg_arg *arg = base->data;
+    evio_async_send(arg->target, arg->async);
+    arg->readable = fd_readable(arg->target->fd);
+}
+
+TEST(test_evio_async_uring_msg)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *target = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(target);
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+#ifdef EVIO_URING_MSG_RING
+    if (!target->iou || !loop->iou) {
+#endif
+        evio_loop_free(loop);
+        evio_loop_free(target);
+        TEST_SKIPF("IORING_OP_MSG_RING unsupported");
+#ifdef EVIO_URING_MSG_RING
+    }
+#endif
+
+    evio_async async;
+    evio_async_init(&async, generic_cb);
+    async.data = &data;
+    evio_async_start(target, &async);
+
+    msg_arg arg = { .target = target, .async = &async };
+    evio_timer tm;
+    evio_timer_init(&tm, msg_send_cb, 0);
+    tm.data = &arg;
+    evio_timer_start(loop, &tm, 0);
+
+    // Registers the ring of the target loop with its epoll instance.
+    evio_run(target, EVIO_RUN_NOWAIT);
+
+    // Pretend the target loop is blocked in epoll.
+    atomic_store_explicit(&target->eventfd_allow.value, 1, memory_order_release);
+
+    // Sent from a callback of another io_uring loop: a ring message.
+    assert_null(evio_loop_running());
+    evio_run(loop, EVIO_RUN_ONCE);
+    assert_null(evio_loop_running());
+
+    // Posted before the sending callback returns.
+    assert_true(arg.readable);
+    assert_false(fd_readable(target->event.fd));
+    assert_true(fd_readable(target->fd));
+
+    atomic_store_explicit(&target->eventfd_allow.value, 0, memory_order_relaxed);
+    evio_run(target, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+    assert_false(fd_readable(target->fd));
+
+    // Sent outside of a loop callback: the eventfd is written.
+    atomic_store_explicit(&target->eventfd_allow.value, 1, memory_order_release);
+    evio_async_send(target, &async);
+    assert_true(fd_readable(target->event.fd));
+
+    atomic_store_explicit(&target->eventfd_allow.value, 0, memory_order_relaxed);
+    evio_run(target, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 2);
+
+    // Sent from a callback of an SQPOLL loop: the eventfd is written, since
+    // the message would be posted after the callback returns.
+    evio_loop *sqpoll = evio_loop_new_sqpoll(EVIO_FLAG_NONE, 0, -1);
+    assert_non_null(sqpoll);
+    if (sqpoll->iou && evio_uring_sqpoll(sqpoll->iou)) {
+        evio_timer_start(sqpoll, &tm, 0);
+        atomic_store_explicit(&target->eventfd_allow.value, 1, memory_order_release);
+        evio_run(sqpoll, EVIO_RUN_ONCE);
+        assert_true(fd_readable(target->event.fd));
+
+        atomic_store_explicit(&target->eventfd_allow.value, 0, memory_order_relaxed);
+        evio_run(target, EVIO_RUN_NOWAIT);
+        assert_int_equal(data.called, 3);
+    }
+    evio_loop_free(sqpoll);
+
+    evio_async_stop(target, &async);
+    evio_loop_free(loop);
+    evio_loop_free(target);
+}
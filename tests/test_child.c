@@ -0,0 +1,254 @@
+#include "test.h"
+
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "evio_child_sys.h"
+
+static struct {
+    bool active;
+    int err;
+} evio_child_clone3_inject;
+
+void evio_child_test_inject_clone3_fail_once(int err)
+{
+    evio_child_clone3_inject.active = true;
+    evio_child_clone3_inject.err = err;
+}
+
+long evio_test_clone3(void *args, size_t size)
+{
+    if (evio_child_clone3_inject.active) {
+        evio_child_clone3_inject.active = false;
+        errno = evio_child_clone3_inject.err;
+        return -1;
+    }
+
+#ifdef SYS_clone3
+    return syscall(SYS_clone3, args, size);
+#else
+    errno = ENOSYS; // GCOVR_EXCL_LINE
+    return -1; // GCOVR_EXCL_LINE
+#endif
+}
+
+typedef struct {
+    size_t called;
+    evio_mask emask;
+    pid_t pid;
+    int status;
+    int err;
+} child_cb_data;
+
+static void child_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_child *w = container_of(base, evio_child, base);
+    child_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+    data->pid = evio_child_pid(w);
+    data->status = evio_child_status(w);
+    data->err = evio_child_error(w);
+}
+
+static int spawn_sh(const char *script, pid_t *pid)
+{
+    char sh[] = "/bin/sh";
+    char c[] = "-c";
+    char *arg = strdup(script);
+    char *argv[] = { sh, c, arg, NULL };
+    int pidfd = evio_child_spawn(sh, argv, NULL, pid);
+    free(arg);
+    return pidfd;
+}
+
+static void test_child_exit(bool fallback)
+{
+    child_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    if (fallback) {
+        evio_child_test_inject_clone3_fail_once(ENOSYS);
+    }
+
+    pid_t pid = 0;
+    int pidfd = spawn_sh("exit 3", &pid);
+    if (pidfd < 0 && (errno == ENOSYS || errno == EPERM)) {
+        evio_loop_free(loop); // GCOVR_EXCL_LINE
+        TEST_SKIP(); // GCOVR_EXCL_LINE
+    }
+    assert_true(pidfd >= 0);
+    assert_true(pid > 0);
+    assert_true(fcntl(pidfd, F_GETFD) & FD_CLOEXEC);
+
+    evio_child w;
+    evio_child_init(&w, child_cb, pidfd);
+    w.data = &data;
+    evio_child_start(loop, &w);
+    evio_child_start(loop, &w);
+    assert_true(w.active);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // The loop runs until the child exits.
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ);
+    assert_int_equal(data.pid, pid);
+    assert_true(WIFEXITED(data.status));
+    assert_int_equal(WEXITSTATUS(data.status), 3);
+    assert_int_equal(data.err, 0);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // The child is reaped.
+    assert_int_equal(waitpid(pid, NULL, WNOHANG), -1);
+    assert_int_equal(errno, ECHILD);
+
+    close(pidfd);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_child)
+{
+    test_child_exit(false);
+}
+
+TEST(test_evio_child_fork)
+{
+    test_child_exit(true);
+}
+
+TEST(test_evio_child_signal)
+{
+    child_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    // The child does not inherit the signal mask.
+    sigset_t set, old_set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    assert_int_equal(pthread_sigmask(SIG_BLOCK, &set, &old_set), 0);
+
+    pid_t pid;
+    int pidfd = spawn_sh("kill -TERM $$; exit 0", &pid);
+    assert_int_equal(pthread_sigmask(SIG_SETMASK, &old_set, NULL), 0);
+    if (pidfd < 0 && (errno == ENOSYS || errno == EPERM)) {
+        TEST_SKIP(); // GCOVR_EXCL_LINE
+    }
+    assert_true(pidfd >= 0);
+
+    evio_child w;
+    evio_child_init(&w, child_cb, pidfd);
+    w.data = &data;
+    evio_child_start(loop, &w);
+
+    while (w.active) {
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ);
+    assert_true(WIFSIGNALED(data.status));
+    assert_int_equal(WTERMSIG(data.status), SIGTERM);
+    close(pidfd);
+
+    // Stopping leaves the child alone.
+    pidfd = spawn_sh("exec sleep 10", &pid);
+    assert_true(pidfd >= 0);
+    evio_child_init(&w, child_cb, pidfd);
+    w.data = &data;
+    evio_child_start(loop, &w);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_child_stop(loop, &w);
+    evio_child_stop(loop, &w);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    assert_int_equal(kill(pid, SIGKILL), 0);
+    evio_child_start(loop, &w);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(data.called, 2);
+    assert_true(WIFSIGNALED(data.status));
+    assert_int_equal(WTERMSIG(data.status), SIGKILL);
+    close(pidfd);
+
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_child_many)
+{
+    enum { COUNT = 32 };
+    child_cb_data data[COUNT] = { 0 };
+    evio_child w[COUNT];
+    int pidfds[COUNT];
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        char script[32];
+        snprintf(script, sizeof(script), "exit %zu", i);
+        pidfds[i] = spawn_sh(script, NULL);
+        if (pidfds[i] < 0 && (errno == ENOSYS || errno == EPERM)) {
+            TEST_SKIP(); // GCOVR_EXCL_LINE
+        }
+        assert_true(pidfds[i] >= 0);
+
+        evio_child_init(&w[i], child_cb, pidfds[i]);
+        w[i].data = &data[i];
+        evio_child_start(loop, &w[i]);
+    }
+
+    evio_run(loop, EVIO_RUN_DEFAULT);
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        assert_int_equal(data[i].called, 1);
+        assert_int_equal(WEXITSTATUS(data[i].status), i);
+        close(pidfds[i]);
+    }
+
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_child_error)
+{
+    child_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    // A program that does not exist.
+    char path[] = "/nonexistent/evio";
+    char *argv[] = { path, NULL };
+    assert_int_equal(evio_child_spawn(path, argv, NULL, NULL), -1);
+    assert_int_equal(errno, ENOENT);
+
+    // A child reaped by someone else.
+    pid_t pid;
+    int pidfd = spawn_sh("exit 0", &pid);
+    if (pidfd < 0 && (errno == ENOSYS || errno == EPERM)) {
+        TEST_SKIP(); // GCOVR_EXCL_LINE
+    }
+    assert_true(pidfd >= 0);
+    assert_int_equal(waitpid(pid, NULL, 0), pid);
+
+    evio_child w;
+    evio_child_init(&w, child_cb, pidfd);
+    w.data = &data;
+    evio_child_start(loop, &w);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ | EVIO_ERROR);
+    assert_int_equal(data.err, ECHILD);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+    close(pidfd);
+
+    // Not a file descriptor.
+    evio_child_init(&w, child_cb, 1000);
+    w.data = &data;
+    evio_child_start(loop, &w);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 2);
+    assert_int_equal(data.emask, EVIO_READ | EVIO_ERROR);
+    assert_int_equal(data.err, EBADF);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_loop_free(loop);
+}
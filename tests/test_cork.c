@@ -0,0 +1,236 @@
+#include "test.h"
+
+typedef struct {
+    evio_cork cork;
+    int peer;
+    size_t called;
+    bool early;
+} cork_reply;
+
+static void reply_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    cork_reply *r = base->data;
+    evio_poll *io = container_of(base, evio_poll, base);
+
+    char buf[16];
+    while (read(io->fd, buf, sizeof(buf)) > 0) {}
+
+    // Each callback answers on the same socket.
+    evio_cork_write(loop, &r->cork, "ok;", 3);
+    r->called++;
+
+    // Nothing is written before the callbacks are done.
+    if (read(r->peer, buf, sizeof(buf)) > 0) {
+        r->early = true;
+    }
+}
+
+typedef struct {
+    size_t called;
+    evio_mask emask;
+    int err;
+} cork_cb_data;
+
+static void cork_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    cork_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+    data->err = evio_cork_error(container_of(base, evio_cork, base));
+}
+
+TEST(test_evio_cork)
+{
+    cork_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    cork_reply r = { .peer = fds[1] };
+    evio_cork_init(&r.cork, cork_cb, fds[0]);
+    r.cork.data = &data;
+    assert_int_equal(evio_cork_pending(&r.cork), 0);
+
+    // Data corked outside the loop is written before it blocks.
+    evio_cork_write(loop, &r.cork, "hello", 5);
+    evio_cork_write(loop, &r.cork, NULL, 0);
+    assert_true(r.cork.active);
+    assert_int_equal(evio_cork_pending(&r.cork), 5);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(evio_cork_pending(&r.cork), 0);
+    assert_false(r.cork.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    char buf[64];
+    assert_int_equal(read(fds[1], buf, sizeof(buf)), 5);
+    assert_int_equal(memcmp(buf, "hello", 5), 0);
+
+    // Several watchers answer within one iteration.
+    enum { COUNT = 4 };
+    int in[COUNT][2];
+    evio_poll io[COUNT];
+    for (size_t i = 0; i < COUNT; ++i) {
+        socket_pair(in[i]);
+        evio_poll_init(&io[i], reply_cb, in[i][0], EVIO_READ);
+        io[i].data = &r;
+        evio_poll_start(loop, &io[i]);
+        assert_int_equal(write(in[i][1], "?", 1), 1);
+    }
+
+    evio_run(loop, EVIO_RUN_ONCE);
+    assert_int_equal(r.called, COUNT);
+    assert_false(r.early);
+
+    assert_int_equal(read(fds[1], buf, sizeof(buf)), COUNT * 3);
+    assert_int_equal(memcmp(buf, "ok;ok;ok;ok;", COUNT * 3), 0);
+    assert_int_equal(data.called, 0);
+    assert_false(r.cork.active);
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        evio_poll_stop(loop, &io[i]);
+        close(in[i][0]);
+        close(in[i][1]);
+    }
+
+    // Stop frees the buffers, and is a no-op the second time.
+    evio_cork_stop(loop, &r.cork);
+    evio_cork_stop(loop, &r.cork);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_cork_blocked)
+{
+    cork_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+    int sndbuf = 16 * 1024;
+    assert_int_equal(setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)), 0);
+
+    evio_cork w;
+    evio_cork_init(&w, cork_cb, fds[0]);
+    w.data = &data;
+
+    enum { TOTAL = 1024 * 1024 };
+    char *out = evio_malloc(TOTAL);
+    for (size_t i = 0; i < TOTAL; ++i) {
+        out[i] = (char)(i % 251);
+    }
+    evio_cork_write(loop, &w, out, TOTAL / 2);
+
+    // The socket fills up, the rest waits for writability.
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_true(w.active);
+    assert_true(evio_cork_pending(&w) > 0);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // Data corked meanwhile is appended.
+    evio_cork_write(loop, &w, out + TOTAL / 2, TOTAL / 2);
+
+    char *in = evio_malloc(TOTAL);
+    size_t received = 0;
+    for (size_t i = 0; i < 100000 && received < TOTAL; ++i) {
+        ssize_t n = read(fds[1], in + received, TOTAL - received);
+        if (n > 0) {
+            received += (size_t)n;
+        }
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+
+    assert_int_equal(received, TOTAL);
+    assert_int_equal(memcmp(in, out, TOTAL), 0);
+    assert_false(w.active);
+    assert_int_equal(data.called, 0);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // Stopping discards unwritten data.
+    evio_cork_write(loop, &w, out, TOTAL);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_cork_stop(loop, &w);
+    assert_false(w.active);
+    assert_int_equal(evio_cork_pending(&w), 0);
+    assert_int_equal(evio_refcount(loop), 0);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    evio_free(in);
+    evio_free(out);
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_cork_error)
+{
+    cork_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    // Non-sockets are written with write.
+    int fds[2];
+    assert_int_equal(pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+
+    evio_cork w;
+    evio_cork_init(&w, cork_cb, fds[1]);
+    w.data = &data;
+    evio_cork_write(loop, &w, "pipe", 4);
+
+    for (size_t i = 0; i < 100 && w.active; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_false(w.active);
+    assert_true(w.nosock);
+
+    char buf[8];
+    assert_int_equal(read(fds[0], buf, sizeof(buf)), 4);
+    assert_int_equal(memcmp(buf, "pipe", 4), 0);
+    evio_cork_stop(loop, &w);
+    close(fds[0]);
+    close(fds[1]);
+
+    // Writing to a closed peer fails without SIGPIPE.
+    socket_pair(fds);
+    close(fds[1]);
+    evio_cork_init(&w, cork_cb, fds[0]);
+    w.data = &data;
+    evio_cork_write(loop, &w, "x", 1);
+
+    for (size_t i = 0; i < 100 && w.active; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_WRITE | EVIO_ERROR);
+    assert_int_equal(data.err, EPIPE);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+    close(fds[0]);
+
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_cork_ebadf)
+{
+    cork_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    evio_cork w;
+    evio_cork_init(&w, cork_cb, 1000);
+    w.data = &data;
+    evio_cork_write(loop, &w, "x", 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_WRITE | EVIO_ERROR);
+    assert_int_equal(data.err, EBADF);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_loop_free(loop);
+}
@@ -0,0 +1,393 @@
+#include "test.h"
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef struct {
+    size_t called;
+    size_t batches;
+    size_t received;
+    size_t bytes;
+    size_t max_batch;
+    size_t segments;
+    size_t truncated;
+    size_t errors;
+    evio_mask emask;
+    int err;
+    bool ordered;
+} dgram_cb_data;
+
+static void dgram_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_dgram *w = container_of(base, evio_dgram, base);
+    dgram_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+
+    if (emask & EVIO_ERROR) {
+        data->errors++;
+        data->err = evio_dgram_error(w);
+        return;
+    }
+
+    const evio_dgram_msg *msgs;
+    size_t count = evio_dgram_batch(w, &msgs);
+    data->batches++;
+    if (count > data->max_batch) {
+        data->max_batch = count;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        size_t segment = msgs[i].segment ? msgs[i].segment : msgs[i].len;
+        for (size_t off = 0; off < msgs[i].len; off += segment) {
+            // Each datagram starts with its sequence number.
+            unsigned char *p = (unsigned char *)msgs[i].data + off;
+            if (p[0] != (unsigned char)data->received) {
+                data->ordered = false;
+            }
+            data->received++;
+        }
+        data->bytes += msgs[i].len;
+        data->segments += msgs[i].segment != 0;
+        data->truncated += msgs[i].truncated;
+    }
+}
+
+static int udp_socket(struct sockaddr_in *addr)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    assert_true(fd >= 0);
+
+    *addr = (struct sockaddr_in) {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    assert_int_equal(bind(fd, (struct sockaddr *)addr, sizeof(*addr)), 0);
+
+    socklen_t len = sizeof(*addr);
+    assert_int_equal(getsockname(fd, (struct sockaddr *)addr, &len), 0);
+    return fd;
+}
+
+static void send_seq(evio_loop *loop, evio_dgram *w, size_t count, size_t len,
+                     const struct sockaddr_in *addr)
+{
+    unsigned char buf[256];
+    assert_true(len <= sizeof(buf));
+
+    for (size_t i = 0; i < count; ++i) {
+        memset(buf, 0xAA, len);
+        buf[0] = (unsigned char)i;
+        evio_dgram_send(loop, w, buf, len, (const struct sockaddr *)addr,
+                        addr ? sizeof(*addr) : 0);
+    }
+}
+
+static void run_until(evio_loop *loop, const dgram_cb_data *data, size_t received)
+{
+    for (size_t i = 0; i < 1000 && data->received < received; ++i) {
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+}
+
+TEST(test_evio_dgram)
+{
+    dgram_cb_data data = { .ordered = true };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    struct sockaddr_in src_addr, dst_addr;
+    int src = udp_socket(&src_addr);
+    int dst = udp_socket(&dst_addr);
+    int rcvbuf = 1024 * 1024;
+    setsockopt(dst, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    evio_dgram tx, rx;
+    evio_dgram_init(&tx, dgram_cb, src, 0);
+    evio_dgram_init(&rx, dgram_cb, dst, 0);
+    tx.data = &data;
+    rx.data = &data;
+
+    // Sending on an inactive watcher: no-op
+    send_seq(loop, &tx, 1, 100, &dst_addr);
+    evio_dgram_flush(loop, &tx);
+    assert_int_equal(evio_dgram_queued(&tx), 0);
+
+    evio_dgram_start(loop, &tx);
+    evio_dgram_start(loop, &rx);
+    assert_int_equal(evio_refcount(loop), 2);
+
+    // Double start: no-op
+    evio_dgram_start(loop, &rx);
+    assert_int_equal(evio_refcount(loop), 2);
+
+    // Datagrams are queued until the loop is about to block.
+    send_seq(loop, &tx, 200, 100, &dst_addr);
+    assert_int_equal(evio_dgram_queued(&tx), 200 * 100);
+    assert_int_equal(evio_refcount(loop), 2);
+
+    run_until(loop, &data, 200);
+    assert_int_equal(evio_dgram_queued(&tx), 0);
+    assert_int_equal(data.received, 200);
+    assert_int_equal(data.bytes, 200 * 100);
+    assert_int_equal(data.errors, 0);
+    assert_true(data.ordered);
+
+    // Several datagrams per wakeup, bounded by the batch size.
+    assert_true(data.max_batch > 1);
+    assert_true(data.max_batch <= EVIO_DGRAM_BATCH);
+    assert_true(data.batches < 200);
+
+    // Mixed sizes and an explicit flush
+    memset(&data, 0, sizeof(data));
+    data.ordered = true;
+    for (size_t i = 0; i < 20; ++i) {
+        unsigned char buf[64] = { (unsigned char)i };
+        evio_dgram_send(loop, &tx, buf, 1 + i * 3, (const struct sockaddr *)&dst_addr, sizeof(dst_addr));
+    }
+    evio_dgram_flush(loop, &tx);
+    assert_int_equal(evio_dgram_queued(&tx), 0);
+
+    run_until(loop, &data, 20);
+    assert_int_equal(data.received, 20);
+    assert_true(data.ordered);
+
+    evio_dgram_stop(loop, &tx);
+    evio_dgram_stop(loop, &rx);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // Double stop: no-op
+    evio_dgram_stop(loop, &rx);
+
+    close(src);
+    close(dst);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_dgram_gro)
+{
+    dgram_cb_data data = { .ordered = true };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    struct sockaddr_in src_addr, dst_addr;
+    int src = udp_socket(&src_addr);
+    int dst = udp_socket(&dst_addr);
+
+    evio_dgram tx, rx;
+    evio_dgram_init(&tx, dgram_cb, src, 0);
+    evio_dgram_init(&rx, dgram_cb, dst, 65535);
+    tx.data = &data;
+    rx.data = &data;
+
+    if (!evio_dgram_set_gro(&rx, true)) {
+        close(src);
+        close(dst);
+        evio_loop_free(loop);
+        TEST_SKIP();
+    }
+
+    evio_dgram_start(loop, &tx);
+    evio_dgram_start(loop, &rx);
+
+    // Equal-sized datagrams to one destination leave as one message, and
+    // may arrive coalesced.
+    send_seq(loop, &tx, 40, 200, &dst_addr);
+    run_until(loop, &data, 40);
+
+    assert_int_equal(data.received, 40);
+    assert_int_equal(data.bytes, 40 * 200);
+    assert_true(data.ordered);
+
+    assert_true(evio_dgram_set_gro(&rx, false));
+
+    evio_dgram_stop(loop, &tx);
+    evio_dgram_stop(loop, &rx);
+    close(src);
+    close(dst);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_dgram_error)
+{
+    dgram_cb_data data = { .ordered = true };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    struct sockaddr_in src_addr, dst_addr;
+    int src = udp_socket(&src_addr);
+    int dst = udp_socket(&dst_addr);
+
+    evio_dgram tx, rx;
+    evio_dgram_init(&tx, dgram_cb, src, 0);
+    evio_dgram_init(&rx, dgram_cb, dst, 16);
+    tx.data = &data;
+    rx.data = &data;
+    evio_dgram_start(loop, &tx);
+    evio_dgram_start(loop, &rx);
+
+    // An oversized datagram is dropped, the rest of the queue is sent.
+    static unsigned char big[70000];
+    evio_dgram_send(loop, &tx, big, sizeof(big), (const struct sockaddr *)&dst_addr, sizeof(dst_addr));
+    send_seq(loop, &tx, 1, 100, &dst_addr);
+    evio_dgram_flush(loop, &tx);
+    assert_int_equal(evio_dgram_queued(&tx), 0);
+    assert_true(tx.active);
+
+    run_until(loop, &data, 1);
+    assert_int_equal(data.errors, 1);
+    assert_int_equal(data.err, EMSGSIZE);
+
+    // The datagram did not fit the receive buffer.
+    assert_int_equal(data.received, 1);
+    assert_int_equal(data.bytes, 16);
+    assert_int_equal(data.truncated, 1);
+
+    evio_dgram_stop(loop, &rx);
+    close(dst);
+
+    // A connected socket whose peer is gone reports the ICMP error on receive.
+    memset(&data, 0, sizeof(data));
+    assert_int_equal(connect(src, (struct sockaddr *)&dst_addr, sizeof(dst_addr)), 0);
+    send_seq(loop, &tx, 1, 10, NULL);
+
+    for (size_t i = 0; i < 1000 && !data.errors; ++i) {
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+    assert_int_equal(data.errors, 1);
+    assert_int_equal(data.emask, EVIO_READ | EVIO_ERROR);
+    assert_int_equal(data.err, ECONNREFUSED);
+    assert_true(tx.active);
+
+    evio_dgram_stop(loop, &tx);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(src);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_dgram_blocked)
+{
+    dgram_cb_data data = { .ordered = true };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    assert_int_equal(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds), 0);
+
+    evio_dgram tx, rx;
+    evio_dgram_init(&tx, dgram_cb, fds[0], 0);
+    evio_dgram_init(&rx, dgram_cb, fds[1], 0);
+    tx.data = &data;
+    rx.data = &data;
+    evio_dgram_start(loop, &tx);
+
+    // The peer queue fills up, the rest waits for the socket to be writable.
+    send_seq(loop, &tx, 1000, 200, NULL);
+    evio_dgram_flush(loop, &tx);
+    assert_true(evio_dgram_queued(&tx) > 0);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // Flushing a blocked queue: no-op
+    size_t queued = evio_dgram_queued(&tx);
+    evio_dgram_flush(loop, &tx);
+    assert_int_equal(evio_dgram_queued(&tx), queued);
+
+    evio_dgram_start(loop, &rx);
+    run_until(loop, &data, 1000);
+
+    assert_int_equal(data.received, 1000);
+    assert_int_equal(data.bytes, 1000 * 200);
+    assert_int_equal(data.errors, 0);
+    assert_true(data.ordered);
+    assert_int_equal(evio_dgram_queued(&tx), 0);
+
+    // Stopping drops the queue.
+    send_seq(loop, &tx, 10, 200, NULL);
+    evio_dgram_stop(loop, &tx);
+    assert_int_equal(evio_dgram_queued(&tx), 0);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.received, 1000);
+
+    evio_dgram_stop(loop, &rx);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+static size_t dgram_alloc_max;
+
+static void *dgram_alloc_cb(void *ctx, void *ptr, size_t size)
+{
+    if (size > dgram_alloc_max) {
+        dgram_alloc_max = size;
+    }
+    return realloc(ptr, size);
+}
+
+TEST(test_evio_dgram_backlog)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    assert_int_equal(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds), 0);
+
+    evio_dgram tx;
+    evio_dgram_init(&tx, dgram_cb, fds[0], 0);
+    evio_dgram_start(loop, &tx);
+
+    void *ctx;
+    evio_realloc_cb cb = evio_get_allocator(&ctx);
+    evio_set_allocator(dgram_alloc_cb, NULL);
+    dgram_alloc_max = 0;
+
+    // A backlog that never drains: the peer reads as much as is sent.
+    enum { BACKLOG = 2000, ROUNDS = 500, STEP = 50, LEN = 200 };
+    unsigned char buf[LEN];
+    memset(buf, 0xAA, sizeof(buf));
+    for (size_t i = 0; i < BACKLOG; ++i) {
+        evio_dgram_send(loop, &tx, buf, LEN, NULL, 0);
+    }
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    size_t received = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+        for (size_t i = 0; i < STEP && recv(fds[1], buf, sizeof(buf), 0) == LEN; ++i) {
+            received++;
+        }
+        for (size_t i = 0; i < STEP; ++i) {
+            evio_dgram_send(loop, &tx, buf, LEN, NULL, 0);
+        }
+        evio_run(loop, EVIO_RUN_NOWAIT);
+        assert_true(evio_dgram_queued(&tx) > 0);
+    }
+    assert_true(received >= ROUNDS * STEP / 2);
+
+    // The queue is bounded by its backlog, not by the data sent through it.
+    assert_true(dgram_alloc_max < BACKLOG * LEN * 4);
+
+    evio_dgram_stop(loop, &tx);
+    evio_set_allocator(cb, ctx);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_dgram_ebadf)
+{
+    dgram_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    evio_dgram w;
+    evio_dgram_init(&w, dgram_cb, 1000, 0);
+    w.data = &data;
+    evio_dgram_start(loop, &w);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ | EVIO_ERROR);
+    assert_int_equal(data.err, EBADF);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_loop_free(loop);
+}
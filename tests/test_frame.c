@@ -0,0 +1,248 @@
+#include "test.h"
+
+static const int kernels[] = {
+    EVIO_FRAME_SCALAR,
+    EVIO_FRAME_SSE2,
+    EVIO_FRAME_AVX2,
+};
+
+TEST(test_evio_frame_delim)
+{
+    enum { SIZE = 1000 };
+    uint8_t *buf = evio_malloc(SIZE);
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(*kernels); ++k) {
+        evio_frame f;
+        evio_frame_init_delim(&f, '\n', SIZE);
+        assert_true(evio_frame_get_simd(&f) != EVIO_FRAME_AUTO);
+        if (!evio_frame_set_simd(&f, kernels[k])) {
+            continue;
+        }
+        assert_int_equal(evio_frame_get_simd(&f), kernels[k]);
+
+        // Frames of every length around the 16, 32 and 64 byte strides.
+        size_t len = 0;
+        for (size_t n = 0; n < 140 && len + n + 1 <= SIZE; n += 3) {
+            memset(buf + len, (int)('a' + n % 26), n);
+            buf[len + n] = '\n';
+            len += n + 1;
+        }
+
+        const void *frame;
+        size_t size;
+        size_t off = 0;
+        for (size_t n = 0; off < len; n += 3) {
+            size_t used = evio_frame_parse(&f, buf + off, len - off, &frame, &size);
+            assert_int_equal(used, n + 1);
+            assert_int_equal(size, n);
+            assert_ptr_equal(frame, buf + off);
+            off += used;
+        }
+        assert_int_equal(off, len);
+
+        // An incomplete frame is scanned once, then resumed.
+        memset(buf, 'x', 100);
+        buf[100] = '\n';
+        assert_int_equal(evio_frame_parse(&f, buf, 50, &frame, &size), 0);
+        assert_int_equal(f.scanned, 50);
+        assert_int_equal(evio_frame_parse(&f, buf, 101, &frame, &size), 101);
+        assert_int_equal(size, 100);
+        assert_int_equal(f.scanned, 0);
+        assert_int_equal(evio_frame_error(&f), 0);
+    }
+
+    // An unknown kernel keeps the current one.
+    evio_frame f;
+    evio_frame_init_delim(&f, 0, 16);
+    int simd = evio_frame_get_simd(&f);
+    assert_false(evio_frame_set_simd(&f, 100));
+    assert_false(evio_frame_set_simd(&f, -1));
+    assert_int_equal(evio_frame_get_simd(&f), simd);
+
+    evio_free(buf);
+}
+
+TEST(test_evio_frame_delim_max)
+{
+    char buf[64];
+    memset(buf, 'x', sizeof(buf));
+
+    const void *frame;
+    size_t size;
+
+    // A frame of exactly the maximum length.
+    evio_frame f;
+    evio_frame_init_delim(&f, ';', 40);
+    buf[40] = ';';
+    assert_int_equal(evio_frame_parse(&f, buf, sizeof(buf), &frame, &size), 41);
+    assert_int_equal(size, 40);
+
+    // One byte longer is an error, even before the delimiter arrives.
+    buf[40] = 'x';
+    assert_int_equal(evio_frame_parse(&f, buf, 40, &frame, &size), 0);
+    assert_int_equal(evio_frame_error(&f), 0);
+    assert_int_equal(evio_frame_parse(&f, buf, 41, &frame, &size), 0);
+    assert_int_equal(evio_frame_error(&f), EMSGSIZE);
+
+    // No more frames after an error.
+    buf[0] = ';';
+    assert_int_equal(evio_frame_parse(&f, buf, sizeof(buf), &frame, &size), 0);
+}
+
+TEST(test_evio_frame_varint)
+{
+    evio_frame f;
+    evio_frame_init_varint(&f, 1000);
+
+    const void *frame;
+    size_t size;
+
+    // 300 = 0xac 0x02
+    uint8_t buf[400] = { 0xac, 0x02 };
+    for (size_t i = 0; i < 300; ++i) {
+        buf[2 + i] = (uint8_t)i;
+    }
+
+    assert_int_equal(evio_frame_parse(&f, buf, 0, &frame, &size), 0);
+    assert_int_equal(evio_frame_parse(&f, buf, 1, &frame, &size), 0);
+    assert_int_equal(evio_frame_parse(&f, buf, 301, &frame, &size), 0);
+    assert_int_equal(evio_frame_parse(&f, buf, sizeof(buf), &frame, &size), 302);
+    assert_ptr_equal(frame, buf + 2);
+    assert_int_equal(size, 300);
+
+    // Empty frames.
+    buf[0] = 0;
+    assert_int_equal(evio_frame_parse(&f, buf, 1, &frame, &size), 1);
+    assert_int_equal(size, 0);
+    assert_int_equal(evio_frame_error(&f), 0);
+
+    // Above the maximum length.
+    buf[0] = 0xe9;
+    buf[1] = 0x07;
+    assert_int_equal(evio_frame_parse(&f, buf, sizeof(buf), &frame, &size), 0);
+    assert_int_equal(evio_frame_error(&f), EMSGSIZE);
+
+    // The largest 64-bit varint.
+    uint8_t big[10];
+    memset(big, 0xff, sizeof(big));
+    big[9] = 0x01;
+    evio_frame_init_varint(&f, SIZE_MAX);
+    assert_int_equal(evio_frame_parse(&f, big, sizeof(big), &frame, &size), 0);
+    assert_int_equal(evio_frame_error(&f), 0);
+
+    // More than 64 bits.
+    big[9] = 0x02;
+    assert_int_equal(evio_frame_parse(&f, big, sizeof(big), &frame, &size), 0);
+    assert_int_equal(evio_frame_error(&f), EPROTO);
+
+    // Too many bytes.
+    evio_frame_init_varint(&f, SIZE_MAX);
+    big[9] = 0x80;
+    assert_int_equal(evio_frame_parse(&f, big, 9, &frame, &size), 0);
+    assert_int_equal(evio_frame_error(&f), 0);
+    assert_int_equal(evio_frame_parse(&f, big, sizeof(big), &frame, &size), 0);
+    assert_int_equal(evio_frame_error(&f), EPROTO);
+}
+
+TEST(test_evio_frame_fixed)
+{
+    const void *frame;
+    size_t size;
+
+    static const size_t widths[] = { 1, 2, 4, 8 };
+    for (size_t i = 0; i < sizeof(widths) / sizeof(*widths); ++i) {
+        size_t width = widths[i];
+        evio_frame f;
+        evio_frame_init_fixed(&f, width, 250);
+
+        uint8_t buf[8 + 250] = { 0 };
+        buf[width - 1] = 200;
+
+        assert_int_equal(evio_frame_parse(&f, buf, width - 1, &frame, &size), 0);
+        assert_int_equal(evio_frame_parse(&f, buf, width + 199, &frame, &size), 0);
+        assert_int_equal(evio_frame_parse(&f, buf, sizeof(buf), &frame, &size), width + 200);
+        assert_ptr_equal(frame, buf + width);
+        assert_int_equal(size, 200);
+        assert_int_equal(evio_frame_error(&f), 0);
+
+        // Above the maximum length, in the most significant byte.
+        buf[0] = 0xff;
+        assert_int_equal(evio_frame_parse(&f, buf, sizeof(buf), &frame, &size), 0);
+        assert_int_equal(evio_frame_error(&f), EMSGSIZE);
+    }
+}
+
+typedef struct {
+    evio_frame frame;
+    size_t frames;
+    size_t bytes;
+    bool bad;
+} frame_cb_data;
+
+static void frame_stream_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_stream *w = container_of(base, evio_stream, base);
+    frame_cb_data *data = base->data;
+
+    const void *frame;
+    size_t size;
+    while (evio_frame_next(loop, &data->frame, w, &frame, &size)) {
+        const char *p = frame;
+        for (size_t i = 0; i < size; ++i) {
+            if (p[i] != (char)('a' + size % 26)) {
+                data->bad = true;
+            }
+        }
+        data->frames++;
+        data->bytes += size;
+    }
+}
+
+TEST(test_evio_frame_stream)
+{
+    frame_cb_data data = { 0 };
+    evio_frame_init_delim(&data.frame, '\n', 4096);
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_stream w;
+    evio_stream_init(&w, frame_stream_cb, fds[0]);
+    w.data = &data;
+    evio_stream_start(loop, &w);
+
+    // Frames split across writes, and several frames per read.
+    enum { COUNT = 200 };
+    char buf[1024];
+    size_t total = 0;
+    for (size_t n = 0; n < COUNT; ++n) {
+        size_t size = n * 7 % 1000;
+        memset(buf, (int)('a' + size % 26), size);
+        buf[size] = '\n';
+
+        size_t half = size / 2;
+        assert_int_equal(write(fds[1], buf, half), half);
+        evio_run(loop, EVIO_RUN_NOWAIT);
+        assert_int_equal(write(fds[1], buf + half, size + 1 - half), size + 1 - half);
+        if (n % 3 == 0) {
+            evio_run(loop, EVIO_RUN_NOWAIT);
+        }
+        total += size;
+    }
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    assert_int_equal(data.frames, COUNT);
+    assert_int_equal(data.bytes, total);
+    assert_false(data.bad);
+    assert_int_equal(evio_frame_error(&data.frame), 0);
+
+    size_t len;
+    (void)evio_stream_peek(&w, &len);
+    assert_int_equal(len, 0);
+
+    evio_stream_stop(loop, &w);
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
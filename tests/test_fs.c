@@ -0,0 +1,243 @@
+#include "test.h"
+
+#include <sys/stat.h>
+
+typedef struct {
+    evio_fs w;
+    char path[64];
+    char buf[16];
+    struct statx st;
+    int fd;
+    size_t step;
+    int64_t results[6];
+    evio_mask emasks[6];
+} fs_seq;
+
+static void seq_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    fs_seq *seq = container_of(base, fs_seq, w.base);
+    seq->results[seq->step] = evio_fs_result(&seq->w);
+    seq->emasks[seq->step] = emask;
+
+    switch (seq->step++) {
+        case 0:
+            seq->fd = (int)evio_fs_result(&seq->w);
+            evio_fs_write(loop, &seq->w, seq->fd, "hello world", 11, 0);
+            break;
+        case 1:
+            evio_fs_fsync(loop, &seq->w, seq->fd, true);
+            break;
+        case 2:
+            evio_fs_statx(loop, &seq->w, seq->fd, "", AT_EMPTY_PATH, STATX_SIZE, &seq->st);
+            break;
+        case 3:
+            evio_fs_read(loop, &seq->w, seq->fd, seq->buf, sizeof(seq->buf), 6);
+            break;
+        case 4:
+            evio_fs_close(loop, &seq->w, seq->fd);
+            break;
+        default:
+            break;
+    }
+}
+
+static void temp_path(char *path, size_t size)
+{
+    snprintf(path, size, "/tmp/evio_fs_XXXXXX");
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+    unlink(path);
+}
+
+TEST(test_evio_fs)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    fs_seq seq = { .fd = -1 };
+    temp_path(seq.path, sizeof(seq.path));
+
+    evio_fs_init(&seq.w, seq_cb);
+    evio_fs_open(loop, &seq.w, seq.path, O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0600);
+    assert_true(seq.w.active);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // The loop waits for the operations, then runs out of watchers.
+    evio_run(loop, EVIO_RUN_DEFAULT);
+
+    assert_int_equal(seq.step, 6);
+    assert_true(seq.results[0] >= 0);
+    assert_int_equal(seq.results[1], 11);
+    assert_int_equal(seq.results[2], 0);
+    assert_int_equal(seq.results[3], 0);
+    assert_int_equal(seq.st.stx_size, 11);
+    assert_int_equal(seq.results[4], 5);
+    assert_int_equal(memcmp(seq.buf, "world", 5), 0);
+    assert_int_equal(seq.results[5], 0);
+
+    assert_int_equal(seq.emasks[0], EVIO_READ);
+    assert_int_equal(seq.emasks[1], EVIO_WRITE);
+    assert_int_equal(seq.emasks[2], EVIO_WRITE);
+    assert_int_equal(seq.emasks[3], EVIO_READ);
+    assert_int_equal(seq.emasks[4], EVIO_READ);
+    assert_int_equal(seq.emasks[5], EVIO_WRITE);
+
+    assert_false(seq.w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    unlink(seq.path);
+    evio_loop_free(loop);
+}
+
+typedef struct {
+    size_t called;
+    evio_mask emask;
+} fs_cb_data;
+
+static void count_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    fs_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+}
+
+TEST(test_evio_fs_error)
+{
+    fs_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    evio_fs w;
+    evio_fs_init(&w, count_cb);
+    w.data = &data;
+
+    // The path is copied.
+    char path[] = "/nonexistent/evio_fs";
+    evio_fs_open(loop, &w, path, O_RDONLY | O_CLOEXEC, 0);
+    memset(path, 0, sizeof(path));
+
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ);
+    assert_int_equal(evio_fs_result(&w), -ENOENT);
+
+    // Reading at the file position
+    int fds[2];
+    assert_int_equal(pipe(fds), 0);
+    assert_int_equal(write(fds[1], "abc", 3), 3);
+
+    char buf[8];
+    evio_fs_read(loop, &w, fds[0], buf, sizeof(buf), -1);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(data.called, 2);
+    assert_int_equal(evio_fs_result(&w), 3);
+
+    evio_fs_write(loop, &w, -1, "x", 1, -1);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(data.called, 3);
+    assert_int_equal(evio_fs_result(&w), -EBADF);
+
+    // Stop after completion: no-op
+    evio_fs_stop(loop, &w);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+static void *write_later(void *arg)
+{
+    int fd = *(int *)arg;
+    usleep(20 * 1000);
+    assert_int_equal(write(fd, "x", 1), 1);
+    return NULL;
+}
+
+TEST(test_evio_fs_stop_pool)
+{
+    fs_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    // Blocking reads occupy every pool thread.
+    enum { BUSY = 4 };
+    int fds[BUSY][2];
+    evio_fs busy[BUSY];
+    char buf[BUSY][4];
+
+    for (size_t i = 0; i < BUSY; ++i) {
+        assert_int_equal(pipe(fds[i]), 0);
+        evio_fs_init(&busy[i], count_cb);
+        busy[i].data = &data;
+        evio_fs_read(loop, &busy[i], fds[i][0], buf[i], sizeof(buf[i]), -1);
+    }
+    usleep(20 * 1000);
+
+    // A queued operation is dropped.
+    evio_fs w;
+    evio_fs_init(&w, count_cb);
+    w.data = &data;
+    evio_fs_fsync(loop, &w, fds[0][1], false);
+    evio_fs_stop(loop, &w);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), BUSY);
+
+    // A running operation is waited for.
+    pthread_t thread;
+    assert_int_equal(pthread_create(&thread, NULL, write_later, &fds[0][1]), 0);
+    evio_fs_stop(loop, &busy[0]);
+    assert_false(busy[0].active);
+    pthread_join(thread, NULL);
+
+    // A completed operation not reported yet is dropped.
+    for (size_t i = 1; i < BUSY; ++i) {
+        assert_int_equal(write(fds[i][1], "x", 1), 1);
+    }
+    usleep(20 * 1000);
+    evio_fs_stop(loop, &busy[1]);
+
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(data.called, BUSY - 2);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    for (size_t i = 0; i < BUSY; ++i) {
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_fs_free_pool)
+{
+    fs_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    // Running, queued and completed operations of a freed loop.
+    enum { COUNT = 6 };
+    int fds[COUNT][2];
+    evio_fs w[COUNT];
+    char buf[COUNT][4];
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        assert_int_equal(pipe(fds[i]), 0);
+        evio_fs_init(&w[i], count_cb);
+        w[i].data = &data;
+        evio_fs_read(loop, &w[i], fds[i][0], buf[i], sizeof(buf[i]), -1);
+    }
+    assert_int_equal(write(fds[0][1], "x", 1), 1);
+    usleep(20 * 1000);
+
+    pthread_t thread;
+    assert_int_equal(pthread_create(&thread, NULL, write_later, &fds[1][1]), 0);
+    for (size_t i = 2; i < COUNT; ++i) {
+        close(fds[i][1]);
+    }
+    evio_loop_free(loop);
+    pthread_join(thread, NULL);
+
+    assert_int_equal(data.called, 0);
+    for (size_t i = 0; i < COUNT; ++i) {
+        assert_false(w[i].active);
+        close(fds[i][0]);
+    }
+    close(fds[0][1]);
+    close(fds[1][1]);
+}
@@ -213,6 +213,162 @@ TEST(test_evio_clockid)
     evio_loop_free(loop);
 }
 
+static void busy_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    size_t *called = base->data;
+    ++*called;
+}
+
+typedef struct {
+    evio_loop *loop;
+    evio_async *async;
+} busy_send_arg;
+
+static void *busy_send_thread(void *ptr)
+{
+    busy_send_arg *arg = ptr;
+    usleep(20 * 1000);
+    evio_async_send(arg->loop, arg->async);
+    return NULL;
+}
+
+TEST(test_evio_busy_poll_miss)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    assert_int_equal(evio_get_busy_poll(loop), 0);
+    evio_set_busy_poll(loop, EVIO_TIME_FROM_USEC(200));
+    assert_int_equal(evio_get_busy_poll(loop), EVIO_TIME_FROM_USEC(200));
+
+    size_t called = 0;
+    evio_timer tm;
+    evio_timer_init(&tm, busy_cb, EVIO_TIME_FROM_MSEC(2));
+    tm.data = &called;
+    evio_timer_start(loop, &tm, EVIO_TIME_FROM_MSEC(2));
+
+    // Spinning finds nothing: the budget shrinks, but not to zero.
+    for (size_t i = 0; i < 100 && called < 5; ++i) {
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+    assert_int_equal(called, 5);
+    assert_true(loop->busy_budget < EVIO_TIME_FROM_USEC(200));
+    assert_true(loop->busy_budget > 0);
+
+    // Disabled: no spinning, blocking wait only.
+    evio_set_busy_poll(loop, 0);
+    evio_run(loop, EVIO_RUN_ONCE);
+    assert_int_equal(called, 6);
+
+    evio_timer_stop(loop, &tm);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_busy_poll_hit)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_set_busy_poll(loop, EVIO_TIME_FROM_SEC(5));
+
+    size_t called = 0;
+    int fds[2];
+    assert_int_equal(pipe(fds), 0);
+    assert_int_equal(write(fds[1], "x", 1), 1);
+
+    evio_poll io;
+    evio_poll_init(&io, busy_cb, fds[0], EVIO_READ);
+    io.data = &called;
+    evio_poll_start(loop, &io);
+
+    // Found by the first spin.
+    evio_run(loop, EVIO_RUN_ONCE);
+    assert_int_equal(called, 1);
+    assert_int_equal(loop->busy_rate, 256);
+    evio_poll_stop(loop, &io);
+
+    // A send from another thread ends the spin without an eventfd write.
+    evio_async async;
+    evio_async_init(&async, busy_cb);
+    async.data = &called;
+    evio_async_start(loop, &async);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    pthread_t thread;
+    busy_send_arg arg = { .loop = loop, .async = &async };
+    assert_int_equal(pthread_create(&thread, NULL, busy_send_thread, &arg), 0);
+
+    const evio_time start = evio_get_time(loop);
+    evio_run(loop, EVIO_RUN_ONCE);
+    assert_int_equal(pthread_join(thread, NULL), 0);
+
+    evio_update_time(loop);
+    assert_true(evio_get_time(loop) - start < EVIO_TIME_FROM_SEC(1));
+    assert_int_equal(called, 2);
+    assert_int_equal(loop->busy_rate, 256);
+
+    uint64_t value;
+    assert_int_equal(read(loop->event.fd, &value, sizeof(value)), -1);
+    assert_int_equal(errno, EAGAIN);
+
+    evio_async_stop(loop, &async);
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_clock_virtual)
+{
+    generic_cb_data data = { 0 };
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    clockid_t old_clock = evio_get_clockid(loop);
+    evio_time time1 = evio_get_time(loop);
+
+    // Stepping a kernel clock: no-op
+    evio_step_time(loop, EVIO_TIME_FROM_SEC(1));
+    assert_int_equal(evio_get_time(loop), time1);
+
+    evio_set_clockid(loop, EVIO_CLOCK_VIRTUAL);
+    assert_int_equal(evio_get_clockid(loop), EVIO_CLOCK_VIRTUAL);
+    assert_int_equal(evio_get_time(loop), time1);
+
+    // Virtual time does not advance on its own
+    usleep(2000);
+    evio_update_time(loop);
+    assert_int_equal(evio_get_time(loop), time1);
+
+    evio_timer tm;
+    evio_timer_init(&tm, generic_cb, 0);
+    tm.data = &data;
+    evio_timer_start(loop, &tm, EVIO_TIME_FROM_SEC(3600));
+
+    // Active timers never block the loop
+    evio_run(loop, EVIO_RUN_ONCE);
+    assert_int_equal(data.called, 0);
+
+    evio_step_time(loop, EVIO_TIME_FROM_SEC(3599));
+    evio_run(loop, EVIO_RUN_ONCE);
+    assert_int_equal(data.called, 0);
+
+    evio_step_time(loop, EVIO_TIME_FROM_SEC(1));
+    assert_int_equal(evio_get_time(loop), time1 + EVIO_TIME_FROM_SEC(3600));
+    evio_run(loop, EVIO_RUN_ONCE);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_TIMER);
+
+    // Saturates at EVIO_TIME_MAX
+    evio_step_time(loop, EVIO_TIME_MAX);
+    assert_int_equal(evio_get_time(loop), EVIO_TIME_MAX);
+
+    evio_set_clockid(loop, old_clock);
+    assert_true(evio_get_time(loop) < EVIO_TIME_MAX);
+
+    evio_loop_free(loop);
+}
+
 TEST(test_evio_time_update)
 {
     evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
@@ -0,0 +1,286 @@
+#include "test.h"
+
+#define MT_PAIRS 32
+#define MT_ROUNDS 100
+
+typedef struct {
+    _Atomic size_t called;
+    _Atomic size_t bytes;
+    _Atomic size_t overlap;
+    _Atomic evio_mask emask;
+    _Atomic bool entered;
+    _Atomic bool left;
+} mt_cb_data;
+
+typedef struct {
+    evio_mt_poll w;
+    mt_cb_data *data;
+    _Atomic size_t inside;
+} mt_conn;
+
+static void read_cb(evio_mt *mt, evio_mt_poll *w, evio_mask emask)
+{
+    mt_cb_data *data = w->data;
+    atomic_fetch_add(&data->called, 1);
+    atomic_fetch_or(&data->emask, emask);
+
+    char buf[64];
+    for (ssize_t n; (n = read(w->fd, buf, sizeof(buf))) > 0;) {
+        atomic_fetch_add(&data->bytes, (size_t)n);
+    }
+}
+
+static void conn_cb(evio_mt *mt, evio_mt_poll *w, evio_mask emask)
+{
+    mt_conn *conn = container_of(w, mt_conn, w);
+
+    if (atomic_fetch_add(&conn->inside, 1) != 0) {
+        atomic_fetch_add(&conn->data->overlap, 1);
+    }
+
+    w->data = conn->data;
+    read_cb(mt, w, emask);
+
+    atomic_fetch_sub(&conn->inside, 1);
+}
+
+static void stop_cb(evio_mt *mt, evio_mt_poll *w, evio_mask emask)
+{
+    mt_cb_data *data = w->data;
+    atomic_fetch_add(&data->called, 1);
+
+    evio_mt_poll_stop(mt, w);
+}
+
+static void slow_cb(evio_mt *mt, evio_mt_poll *w, evio_mask emask)
+{
+    mt_cb_data *data = w->data;
+    atomic_fetch_add(&data->called, 1);
+    atomic_store(&data->entered, true);
+    usleep(100 * 1000);
+    atomic_store(&data->left, true);
+}
+
+static void write_cb(evio_mt *mt, evio_mt_poll *w, evio_mask emask)
+{
+    mt_cb_data *data = w->data;
+    atomic_fetch_add(&data->called, 1);
+    atomic_fetch_or(&data->emask, emask);
+
+    // Switch to read readiness on re-arm.
+    evio_mt_poll_set(w, EVIO_READ);
+
+    char buf[64];
+    for (ssize_t n; (n = read(w->fd, buf, sizeof(buf))) > 0;) {
+        atomic_fetch_add(&data->bytes, (size_t)n);
+    }
+}
+
+static void wait_for(_Atomic size_t *value, size_t expected)
+{
+    for (size_t i = 0; i < 2000 && atomic_load(value) < expected; ++i) {
+        usleep(1000);
+    }
+}
+
+TEST(test_evio_mt_dispatch)
+{
+    mt_cb_data data = { 0 };
+    evio_mt *mt = evio_mt_new(4);
+
+    int fds[MT_PAIRS][2];
+    mt_conn conns[MT_PAIRS];
+
+    for (size_t i = 0; i < MT_PAIRS; ++i) {
+        socket_pair(fds[i]);
+        conns[i] = (mt_conn) { .data = &data };
+        evio_mt_poll_init(&conns[i].w, conn_cb, fds[i][0], EVIO_READ);
+        assert_int_equal(evio_mt_poll_start(mt, &conns[i].w), 0);
+        assert_true(evio_mt_poll_is_active(&conns[i].w));
+
+        // Double start: no-op
+        assert_int_equal(evio_mt_poll_start(mt, &conns[i].w), 0);
+    }
+
+    for (size_t r = 0; r < MT_ROUNDS; ++r) {
+        for (size_t i = 0; i < MT_PAIRS; ++i) {
+            assert_int_equal(write(fds[i][1], "x", 1), 1);
+        }
+    }
+
+    wait_for(&data.bytes, MT_PAIRS * MT_ROUNDS);
+    assert_int_equal(atomic_load(&data.bytes), MT_PAIRS * MT_ROUNDS);
+
+    // No watcher ran concurrently with itself
+    assert_int_equal(atomic_load(&data.overlap), 0);
+    assert_int_equal(atomic_load(&data.emask), EVIO_READ);
+
+    for (size_t i = 0; i < MT_PAIRS; ++i) {
+        evio_mt_poll_stop(mt, &conns[i].w);
+        assert_false(evio_mt_poll_is_active(&conns[i].w));
+
+        // Double stop: no-op
+        evio_mt_poll_stop(mt, &conns[i].w);
+    }
+
+    // Stopped watchers get no events
+    size_t called = atomic_load(&data.called);
+    for (size_t i = 0; i < MT_PAIRS; ++i) {
+        assert_int_equal(write(fds[i][1], "x", 1), 1);
+    }
+    usleep(20 * 1000);
+    assert_int_equal(atomic_load(&data.called), called);
+
+    evio_mt_free(mt);
+
+    for (size_t i = 0; i < MT_PAIRS; ++i) {
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+}
+
+TEST(test_evio_mt_oneshot)
+{
+    mt_cb_data data = { 0 };
+    evio_mt *mt = evio_mt_new(0);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_mt_poll w;
+    evio_mt_poll_init(&w, read_cb, fds[0], EVIO_READ);
+    w.data = &data;
+    assert_int_equal(evio_mt_poll_start(mt, &w), 0);
+
+    // Level-triggered after re-arm: data left unread is reported again.
+    assert_int_equal(write(fds[1], "x", 1), 1);
+    wait_for(&data.bytes, 1);
+    assert_int_equal(write(fds[1], "y", 1), 1);
+    wait_for(&data.bytes, 2);
+    assert_int_equal(atomic_load(&data.bytes), 2);
+    assert_true(atomic_load(&data.called) >= 2);
+
+    // Restarted after a stop with a new generation
+    evio_mt_poll_stop(mt, &w);
+    assert_int_equal(evio_mt_poll_start(mt, &w), 0);
+    assert_int_equal(write(fds[1], "z", 1), 1);
+    wait_for(&data.bytes, 3);
+    assert_int_equal(atomic_load(&data.bytes), 3);
+
+    evio_mt_poll_stop(mt, &w);
+    evio_mt_free(mt);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(test_evio_mt_stop_self)
+{
+    mt_cb_data data = { 0 };
+    evio_mt *mt = evio_mt_new(2);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_mt_poll w;
+    evio_mt_poll_init(&w, stop_cb, fds[0], EVIO_READ);
+    w.data = &data;
+    assert_int_equal(evio_mt_poll_start(mt, &w), 0);
+
+    assert_int_equal(write(fds[1], "x", 1), 1);
+    wait_for(&data.called, 1);
+
+    // Never re-armed: the unread data is not reported again.
+    usleep(20 * 1000);
+    assert_int_equal(atomic_load(&data.called), 1);
+    assert_false(evio_mt_poll_is_active(&w));
+
+    evio_mt_free(mt);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(test_evio_mt_stop_running)
+{
+    mt_cb_data data = { 0 };
+    evio_mt *mt = evio_mt_new(2);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_mt_poll w;
+    evio_mt_poll_init(&w, slow_cb, fds[0], EVIO_READ);
+    w.data = &data;
+    assert_int_equal(evio_mt_poll_start(mt, &w), 0);
+
+    assert_int_equal(write(fds[1], "x", 1), 1);
+    for (size_t i = 0; i < 2000 && !atomic_load(&data.entered); ++i) {
+        usleep(1000);
+    }
+    assert_true(atomic_load(&data.entered));
+
+    // Waits for the callback running on a worker thread.
+    evio_mt_poll_stop(mt, &w);
+    assert_true(atomic_load(&data.left));
+
+    usleep(20 * 1000);
+    assert_int_equal(atomic_load(&data.called), 1);
+
+    evio_mt_free(mt);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(test_evio_mt_set)
+{
+    mt_cb_data data = { 0 };
+    evio_mt *mt = evio_mt_new(1);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_mt_poll w;
+    evio_mt_poll_init(&w, write_cb, fds[0], EVIO_WRITE);
+    w.data = &data;
+    assert_int_equal(evio_mt_poll_start(mt, &w), 0);
+
+    // Writable right away, then only read readiness is reported.
+    wait_for(&data.called, 1);
+    usleep(20 * 1000);
+    assert_int_equal(atomic_load(&data.called), 1);
+    assert_int_equal(atomic_load(&data.emask), EVIO_WRITE);
+
+    assert_int_equal(write(fds[1], "x", 1), 1);
+    wait_for(&data.bytes, 1);
+    assert_int_equal(atomic_load(&data.bytes), 1);
+    assert_true(atomic_load(&data.emask) & EVIO_READ);
+
+    evio_mt_poll_stop(mt, &w);
+    evio_mt_free(mt);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(test_evio_mt_start_error)
+{
+    evio_mt *mt = evio_mt_new(1);
+
+    evio_mt_poll w;
+    evio_mt_poll_init(&w, read_cb, -1, EVIO_READ);
+
+    errno = 0;
+    assert_int_equal(evio_mt_poll_start(mt, &w), -1);
+    assert_int_equal(errno, EBADF);
+    assert_false(evio_mt_poll_is_active(&w));
+
+    // The failed slot is reused
+    int fds[2];
+    socket_pair(fds);
+    w.fd = fds[0];
+    assert_int_equal(evio_mt_poll_start(mt, &w), 0);
+    assert_int_equal(w.slot, 1);
+
+    evio_mt_poll_stop(mt, &w);
+    evio_mt_free(mt);
+    close(fds[0]);
+    close(fds[1]);
+}
@@ -0,0 +1,232 @@
+#include "test.h"
+
+TEST(test_evio_pacer)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    loop->time = EVIO_TIME_FROM_SEC(100);
+
+    evio_pacer p;
+    evio_pacer_init(&p);
+
+    // 10 tokens per second, up to 5 at once.
+    uint32_t id = evio_pacer_add(&p, 10, 5);
+    assert_int_equal(evio_pacer_available(loop, &p, id), 5);
+
+    assert_true(evio_pacer_take(loop, &p, id, 3, NULL));
+    assert_int_equal(evio_pacer_available(loop, &p, id), 2);
+    assert_false(evio_pacer_take(loop, &p, id, 3, NULL));
+    assert_true(evio_pacer_take(loop, &p, id, 2, NULL));
+    assert_int_equal(evio_pacer_available(loop, &p, id), 0);
+    assert_false(evio_pacer_take(loop, &p, id, 1, NULL));
+
+    // More than the bucket size never fits.
+    loop->time += EVIO_TIME_FROM_SEC(10);
+    assert_false(evio_pacer_take(loop, &p, id, 6, NULL));
+
+    // Refills at the rate, up to the bucket size.
+    assert_int_equal(evio_pacer_available(loop, &p, id), 5);
+    assert_true(evio_pacer_take(loop, &p, id, 5, NULL));
+    loop->time += EVIO_TIME_FROM_MSEC(99);
+    assert_int_equal(evio_pacer_available(loop, &p, id), 0);
+    loop->time += EVIO_TIME_FROM_MSEC(1);
+    assert_int_equal(evio_pacer_available(loop, &p, id), 1);
+    loop->time += EVIO_TIME_FROM_MSEC(250);
+    assert_int_equal(evio_pacer_available(loop, &p, id), 3);
+
+    // The tokens are kept when the rate changes.
+    evio_pacer_set(loop, &p, id, 1000, 2);
+    assert_int_equal(evio_pacer_available(loop, &p, id), 2);
+    assert_true(evio_pacer_take(loop, &p, id, 2, NULL));
+    loop->time += EVIO_TIME_FROM_MSEC(1);
+    assert_int_equal(evio_pacer_available(loop, &p, id), 1);
+
+    // Rates that do not divide a second are rounded up per take.
+    uint32_t slow = evio_pacer_add(&p, 3, 1);
+    assert_int_not_equal(slow, id);
+    assert_true(evio_pacer_take(loop, &p, slow, 1, NULL));
+    loop->time += EVIO_TIME_FROM_SEC(1) / 3;
+    assert_false(evio_pacer_take(loop, &p, slow, 1, NULL));
+    loop->time += 1;
+    assert_true(evio_pacer_take(loop, &p, slow, 1, NULL));
+
+    // Removed indexes are reused, with a full bucket.
+    evio_pacer_remove(loop, &p, id);
+    assert_int_equal(evio_pacer_add(&p, 1, 7), id);
+    assert_int_equal(evio_pacer_available(loop, &p, id), 7);
+    assert_int_equal(evio_pacer_add(&p, 1, 1), 2);
+
+    // Large values saturate.
+    uint32_t big = evio_pacer_add(&p, 1, UINT64_MAX);
+    assert_int_equal(evio_pacer_available(loop, &p, big), UINT64_MAX);
+    assert_true(evio_pacer_take(loop, &p, big, UINT64_MAX / 2, NULL));
+    assert_int_equal(evio_pacer_available(loop, &p, big), 0);
+
+    uint32_t fast = evio_pacer_add(&p, EVIO_PACER_RATE_MAX, EVIO_PACER_RATE_MAX);
+    assert_true(evio_pacer_take(loop, &p, fast, EVIO_PACER_RATE_MAX, NULL));
+    loop->time += EVIO_TIME_FROM_SEC(1) / 2;
+    uint64_t half = evio_pacer_available(loop, &p, fast);
+    assert_true(half >= EVIO_PACER_RATE_MAX / 2 - 20 && half <= EVIO_PACER_RATE_MAX / 2);
+
+    assert_int_equal(evio_pacer_paused(&p), 0);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_pacer_stop(loop, &p);
+    evio_loop_free(loop);
+}
+
+typedef struct {
+    evio_pacer *p;
+    uint32_t id;
+    size_t reads;
+} pacer_reader;
+
+static void pacer_read_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_poll *io = container_of(base, evio_poll, base);
+    pacer_reader *r = base->data;
+
+    // Each read costs a token; without one, wait for the refill.
+    if (!evio_pacer_take(loop, r->p, r->id, 1, io)) {
+        assert_false(io->active);
+        return;
+    }
+
+    char c;
+    if (read(io->fd, &c, 1) == 1) {
+        r->reads++;
+    }
+}
+
+TEST(test_evio_pacer_pause)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    evio_pacer p;
+    evio_pacer_init(&p);
+
+    enum { COUNT = 64, READS = 12 };
+    int fds[COUNT][2];
+    evio_poll io[COUNT];
+    pacer_reader r[COUNT];
+
+    // 1000 reads per second for every tenant, after a burst of 4.
+    char buf[READS];
+    memset(buf, 'x', sizeof(buf));
+    for (size_t i = 0; i < COUNT; ++i) {
+        socket_pair(fds[i]);
+        assert_int_equal(write(fds[i][1], buf, sizeof(buf)), sizeof(buf));
+
+        r[i] = (pacer_reader) { .p = &p, .id = evio_pacer_add(&p, 1000, 4) };
+        evio_poll_init(&io[i], pacer_read_cb, fds[i][0], EVIO_READ);
+        io[i].data = &r[i];
+        evio_poll_start(loop, &io[i]);
+    }
+
+    evio_update_time(loop);
+    evio_time start = evio_get_time(loop);
+
+    // All the tenants drain their burst in the first iterations.
+    for (size_t i = 0; i < 8; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_int_equal(evio_pacer_paused(&p), COUNT);
+    for (size_t i = 0; i < COUNT; ++i) {
+        assert_int_equal(r[i].reads, 4);
+        assert_false(io[i].active);
+    }
+
+    // One timer entry for all the paused watchers, which keeps the loop alive.
+    assert_int_equal(loop->timer.count, 1);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    size_t total = 0;
+    for (size_t n = 0; n < 1000 && total < COUNT * READS; ++n) {
+        evio_run(loop, EVIO_RUN_ONCE);
+        total = 0;
+        for (size_t i = 0; i < COUNT; ++i) {
+            total += r[i].reads;
+        }
+    }
+    assert_int_equal(total, COUNT * READS);
+
+    // The remaining 8 reads of each tenant took at least 8 refills.
+    evio_update_time(loop);
+    assert_true(evio_get_time(loop) - start >= EVIO_TIME_FROM_MSEC(7));
+
+    // Removing a bucket forgets its paused watcher.
+    assert_int_equal(write(fds[0][1], buf, sizeof(buf)), sizeof(buf));
+    evio_poll_start(loop, &io[0]);
+    for (size_t i = 0; i < 8 && !evio_pacer_paused(&p); ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_int_equal(evio_pacer_paused(&p), 1);
+    evio_pacer_remove(loop, &p, r[0].id);
+    assert_int_equal(evio_pacer_paused(&p), 0);
+    assert_int_equal(loop->timer.count, 0);
+    assert_false(io[0].active);
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        evio_poll_stop(loop, &io[i]);
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+
+    evio_pacer_stop(loop, &p);
+    assert_int_equal(evio_refcount(loop), 0);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_pacer_set)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    evio_pacer p;
+    evio_pacer_init(&p);
+
+    int fds[2];
+    socket_pair(fds);
+    assert_int_equal(write(fds[1], "xy", 2), 2);
+
+    // A slow bucket, which a faster rate resumes early.
+    pacer_reader r = { .p = &p, .id = evio_pacer_add(&p, 1, 1) };
+    evio_poll io;
+    evio_poll_init(&io, pacer_read_cb, fds[0], EVIO_READ);
+    io.data = &r;
+    evio_poll_start(loop, &io);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(r.reads, 1);
+    assert_int_equal(evio_pacer_paused(&p), 1);
+    assert_true(evio_timer_remaining(loop, &p.tm) > EVIO_TIME_FROM_MSEC(900));
+
+    evio_pacer_set(loop, &p, r.id, 1000, 1);
+    assert_true(evio_timer_remaining(loop, &p.tm) <= EVIO_TIME_FROM_MSEC(1));
+
+    for (size_t i = 0; i < 100 && r.reads < 2; ++i) {
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+    assert_int_equal(r.reads, 2);
+
+    // A paused request above the new size waits for a full bucket instead.
+    uint32_t id = evio_pacer_add(&p, 1, 5);
+    assert_true(evio_pacer_take(loop, &p, id, 5, NULL));
+    assert_int_equal(write(fds[1], "z", 1), 1);
+    evio_poll_start(loop, &io);
+    assert_false(evio_pacer_take(loop, &p, id, 5, &io));
+    assert_false(io.active);
+    assert_int_equal(evio_pacer_paused(&p), 1);
+    assert_true(evio_timer_remaining(loop, &p.tm) > EVIO_TIME_FROM_SEC(4));
+
+    evio_pacer_set(loop, &p, id, 1000, 2);
+    assert_true(evio_timer_remaining(loop, &p.tm) <= EVIO_TIME_FROM_MSEC(2));
+
+    // Stopping the pacer leaves the watcher stopped.
+    evio_pacer_stop(loop, &p);
+    assert_false(io.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
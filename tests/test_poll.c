@@ -1649,3 +1649,324 @@ TEST(test_evio_poll_get_events)
     evio_poll_modify(&io, 0);
     assert_int_equal(evio_poll_get_events(&io), 0);
 }
+
+TEST(test_evio_poll_edge)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    int fds[2] = { -1, -1 };
+    assert_int_equal(pipe(fds), 0);
+
+    evio_poll io;
+    evio_poll_init(&io, generic_cb, fds[0], EVIO_READ | EVIO_EDGE);
+    io.data = &data;
+    assert_true(evio_poll_is_edge(&io));
+    assert_int_equal(evio_poll_get_events(&io), EVIO_READ);
+    evio_poll_start(loop, &io);
+
+    assert_int_equal(write(fds[1], "xx", 2), 2);
+
+    // Notified once per edge, even though data remains
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_POLL | EVIO_READ);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+
+    // New data: new edge
+    assert_int_equal(write(fds[1], "x", 1), 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 2);
+
+    // Switch to level-triggered: re-reported while readable
+    evio_poll_change(loop, &io, fds[0], EVIO_READ);
+    assert_false(evio_poll_is_edge(&io));
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 4);
+
+    // EVIO_EDGE alone stops the watcher
+    evio_poll_change(loop, &io, fds[0], EVIO_EDGE);
+    assert_false(evio_is_active(&io.base));
+
+    evio_loop_free(loop);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(test_evio_poll_edge_mixed)
+{
+    generic_cb_data et_data = { 0 };
+    generic_cb_data lt_data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    int fds[2] = { -1, -1 };
+    assert_int_equal(pipe(fds), 0);
+
+    evio_poll et;
+    evio_poll_init(&et, generic_cb, fds[0], EVIO_READ | EVIO_EDGE);
+    et.data = &et_data;
+    evio_poll_start(loop, &et);
+
+    evio_poll lt;
+    evio_poll_init(&lt, generic_cb, fds[0], EVIO_READ);
+    lt.data = &lt_data;
+    evio_poll_start(loop, &lt);
+
+    assert_int_equal(write(fds[1], "x", 1), 1);
+
+    // A level-triggered watcher keeps the fd level-triggered
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(loop->fds.ptr[fds[0]].emask, EVIO_READ);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(lt_data.called, 2);
+    assert_int_equal(et_data.called, 2);
+
+    // Only edge-triggered watchers left: re-registered edge-triggered
+    evio_poll_stop(loop, &lt);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(loop->fds.ptr[fds[0]].emask, EVIO_READ | EVIO_EDGE);
+    assert_int_equal(et_data.called, 3);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(et_data.called, 3);
+
+    evio_poll_stop(loop, &et);
+    evio_loop_free(loop);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(test_evio_poll_lazy)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    int sv[2] = { -1, -1 };
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv), 0);
+
+    evio_poll io;
+    evio_poll_init(&io, generic_cb, sv[0], EVIO_READ | EVIO_LAZY);
+    io.data = &data;
+    assert_true(evio_poll_is_edge(&io));
+    evio_poll_start(loop, &io);
+
+    // Registered for EPOLLOUT, but write readiness is filtered
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_fds *fds = &loop->fds.ptr[sv[0]];
+    assert_int_equal(fds->emask, EVIO_READ | EVIO_WRITE | EVIO_EDGE | EVIO_LAZY);
+    assert_true(fds->flags & EVIO_FD_WRITABLE);
+    assert_int_equal(data.called, 0);
+
+    const uint32_t gen = fds->gen;
+
+    // Write interest on: remembered readiness, no epoll_ctl()
+    evio_poll_change(loop, &io, sv[0], EVIO_READ | EVIO_WRITE | EVIO_LAZY);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_POLL | EVIO_WRITE);
+    assert_int_equal(fds->gen, gen);
+
+    // Toggling before dispatch drops the pending write event
+    evio_poll_change(loop, &io, sv[0], EVIO_READ | EVIO_LAZY);
+    evio_poll_change(loop, &io, sv[0], EVIO_READ | EVIO_WRITE | EVIO_LAZY);
+    evio_poll_change(loop, &io, sv[0], EVIO_READ | EVIO_LAZY);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(fds->gen, gen);
+
+    // Readable: only the wanted event is delivered
+    assert_int_equal(write(sv[1], "x", 1), 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 2);
+    assert_int_equal(data.emask, EVIO_POLL | EVIO_READ);
+
+    // Fill the socket: the next event clears the writable bit
+    char buf[4096] = { 0 };
+    while (write(sv[0], buf, sizeof(buf)) > 0) {
+        // Keep writing
+    }
+    assert_int_equal(write(sv[1], "x", 1), 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 3);
+    assert_false(fds->flags & EVIO_FD_WRITABLE);
+
+    evio_poll_change(loop, &io, sv[0], EVIO_READ | EVIO_WRITE | EVIO_LAZY);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 3);
+
+    // Draining the peer produces a new write edge
+    while (read(sv[1], buf, sizeof(buf)) > 0) {
+        // Keep reading
+    }
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 4);
+    assert_true(data.emask & EVIO_WRITE);
+    assert_int_equal(fds->gen, gen);
+
+    evio_poll_stop(loop, &io);
+    evio_loop_free(loop);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+TEST(test_evio_poll_lazy_mixed)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    int sv[2] = { -1, -1 };
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv), 0);
+
+    evio_poll lazy;
+    evio_poll_init(&lazy, generic_cb, sv[0], EVIO_READ | EVIO_LAZY);
+    lazy.data = &data;
+    evio_poll_start(loop, &lazy);
+
+    evio_poll lt;
+    evio_poll_init(&lt, dummy_cb, sv[0], EVIO_READ);
+    evio_poll_start(loop, &lt);
+
+    // A non-lazy watcher keeps the fd level-triggered without EPOLLOUT
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_fds *fds = &loop->fds.ptr[sv[0]];
+    assert_int_equal(fds->emask, EVIO_READ);
+    assert_false(fds->flags & EVIO_FD_WRITABLE);
+
+    // Write interest on: registered via epoll_ctl()
+    const uint32_t gen = fds->gen;
+    evio_poll_change(loop, &lazy, sv[0], EVIO_READ | EVIO_WRITE | EVIO_LAZY);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(fds->emask, EVIO_READ | EVIO_WRITE);
+    assert_int_not_equal(fds->gen, gen);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_POLL | EVIO_WRITE);
+
+    // Back to lazy-only: re-registered lazily
+    evio_poll_stop(loop, &lt);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(fds->emask, EVIO_READ | EVIO_WRITE | EVIO_EDGE | EVIO_LAZY);
+
+    // Start on an fd known writable: replayed immediately
+    evio_poll other;
+    evio_poll_init(&other, generic_cb, sv[0], EVIO_WRITE | EVIO_LAZY);
+    other.data = &data;
+    evio_poll_stop(loop, &lazy);
+    data.called = 0;
+    evio_poll_start(loop, &other);
+    assert_true(other.base.pending);
+
+    evio_poll_stop(loop, &other);
+    evio_loop_free(loop);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+TEST(test_evio_poll_lazy_fd_reuse)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    int sv[2] = { -1, -1 };
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv), 0);
+    const int fd = sv[0];
+
+    evio_poll io;
+    evio_poll_init(&io, generic_cb, fd, EVIO_READ | EVIO_LAZY);
+    io.data = &data;
+    evio_poll_start(loop, &io);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_true(loop->fds.ptr[fd].flags & EVIO_FD_WRITABLE);
+
+    // The last watcher stops: the readiness is forgotten
+    evio_poll_stop(loop, &io);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_false(loop->fds.ptr[fd].flags & EVIO_FD_WRITABLE);
+    assert_false(loop->fds.ptr[fd].emask & EVIO_LAZY);
+
+    // The fd number is reused for a full pipe
+    int fds[2] = { -1, -1 };
+    assert_int_equal(pipe2(fds, O_NONBLOCK), 0);
+    char buf[4096] = { 0 };
+    while (write(fds[1], buf, sizeof(buf)) > 0) {
+        // Keep writing
+    }
+    assert_int_equal(dup2(fds[1], fd), fd);
+
+    evio_poll_init(&io, generic_cb, fd, EVIO_WRITE | EVIO_LAZY);
+    io.data = &data;
+    evio_poll_start(loop, &io);
+    assert_false(io.base.pending);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 0);
+    assert_false(loop->fds.ptr[fd].flags & EVIO_FD_WRITABLE);
+
+    // Draining the pipe produces the write edge
+    while (read(fds[0], buf, sizeof(buf)) > 0) {
+        // Keep reading
+    }
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+    assert_true(data.emask & EVIO_WRITE);
+
+    evio_poll_stop(loop, &io);
+    evio_loop_free(loop);
+    close(fds[0]);
+    close(fds[1]);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+TEST(test_evio_poll_exclusive)
+{
+    generic_cb_data data = { 0 };
+    generic_cb_data other_data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    int sv[2] = { -1, -1 };
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv), 0);
+
+    evio_poll io;
+    evio_poll_init(&io, generic_cb, sv[0], EVIO_READ | EVIO_EXCLUSIVE);
+    io.data = &data;
+    evio_poll_start(loop, &io);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(loop->fds.ptr[sv[0]].emask, EVIO_READ | EVIO_EXCLUSIVE);
+    assert_int_equal(data.called, 0);
+
+    assert_int_equal(write(sv[1], "x", 1), 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+
+    // Exclusive registrations cannot be modified: re-registered instead
+    evio_poll_change(loop, &io, sv[0], EVIO_READ | EVIO_WRITE | EVIO_EXCLUSIVE);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(loop->fds.ptr[sv[0]].emask, EVIO_READ | EVIO_WRITE | EVIO_EXCLUSIVE);
+    assert_int_equal(data.called, 2);
+    assert_true(data.emask & EVIO_WRITE);
+
+    // A non-exclusive watcher makes the fd non-exclusive
+    evio_poll other;
+    evio_poll_init(&other, generic_cb, sv[0], EVIO_READ);
+    other.data = &other_data;
+    evio_poll_start(loop, &other);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(loop->fds.ptr[sv[0]].emask, EVIO_READ | EVIO_WRITE);
+    assert_int_equal(other_data.called, 1);
+    assert_int_equal(data.called, 3);
+
+    evio_poll_stop(loop, &other);
+    evio_poll_stop(loop, &io);
+    evio_loop_free(loop);
+    close(sv[0]);
+    close(sv[1]);
+}
@@ -0,0 +1,163 @@
+#include "test.h"
+#include "abort.h"
+
+typedef struct {
+    size_t called;
+    evio_mask emask;
+} generic_cb_data;
+
+static void generic_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    generic_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+}
+
+static char *dump_to_string(const evio_loop *loop)
+{
+    FILE *stream = tmpfile();
+    assert_non_null(stream);
+
+    evio_recorder_dump(loop, stream);
+
+    long size = ftell(stream);
+    assert_true(size > 0);
+    rewind(stream);
+
+    char *str = calloc(1, (size_t)size + 1);
+    assert_non_null(str);
+    assert_int_equal(fread(str, 1, (size_t)size, stream), (size_t)size);
+
+    fclose(stream);
+    return str;
+}
+
+TEST(test_evio_recorder_dump)
+{
+    generic_cb_data data = { 0 };
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    int fds[2];
+    assert_int_equal(pipe(fds), 0);
+    assert_int_equal(write(fds[1], "x", 1), 1);
+
+    evio_poll io;
+    evio_poll_init(&io, generic_cb, fds[0], EVIO_READ);
+    io.data = &data;
+    evio_poll_start(loop, &io);
+
+    evio_timer tm;
+    evio_timer_init(&tm, generic_cb, 0);
+    tm.data = &data;
+    evio_timer_start(loop, &tm, 0);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 2);
+
+    char *str = dump_to_string(loop);
+    assert_non_null(strstr(str, "evio flight recorder"));
+    assert_non_null(strstr(str, "ITER"));
+    assert_non_null(strstr(str, "op=ADD emask=0x1"));
+    assert_non_null(strstr(str, "POLL     fd="));
+    assert_non_null(strstr(str, "TIMER    w="));
+    assert_non_null(strstr(str, "DISPATCH w="));
+    free(str);
+
+    evio_poll_stop(loop, &io);
+    evio_loop_free(loop);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(test_evio_recorder_wrap)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    assert_int_equal(loop->rec_head, 0);
+
+    for (size_t i = 0; i < EVIO_RECORDER_EVENTS + 1; ++i) {
+        evio_recorder_add(loop, EVIO_REC_URING, 5, 0, NULL,
+                          (uint32_t)EPOLL_CTL_MOD | ((uint64_t)(uint32_t)-ENOENT << 32));
+    }
+
+    char *str = dump_to_string(loop);
+    char header[128];
+    snprintf(header, sizeof(header), "%zu of %zu records", EVIO_RECORDER_EVENTS,
+             EVIO_RECORDER_EVENTS + 1);
+    assert_non_null(strstr(str, header));
+    assert_non_null(strstr(str, "URING    fd=5 op=MOD res=-2"));
+    free(str);
+
+    evio_loop_free(loop);
+}
+
+static void unref_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_unref(loop);
+    evio_unref(loop);
+}
+
+static jmp_buf abort_jmp;
+
+// On a new thread: a run left by an abort keeps the thread's running loop set.
+static void *abort_thread(void *ptr)
+{
+    evio_loop *loop = ptr;
+
+    if (setjmp(abort_jmp) == 0) {
+        evio_unref(loop);
+    }
+
+    evio_prepare prepare;
+    evio_prepare_init(&prepare, unref_cb);
+    evio_prepare_start(loop, &prepare);
+
+    if (setjmp(abort_jmp) == 0) {
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+
+    return NULL;
+}
+
+TEST(test_evio_recorder_abort)
+{
+    struct evio_test_abort_state abort_st = { 0 };
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    evio_test_abort_begin(&abort_st, &abort_jmp);
+
+    pthread_t thread;
+    assert_int_equal(pthread_create(&thread, NULL, abort_thread, loop), 0);
+    assert_int_equal(pthread_join(thread, NULL), 0);
+
+    fflush(abort_st.stream);
+    long size = ftell(abort_st.stream);
+    assert_true(size > 0);
+    rewind(abort_st.stream);
+
+    char *str = calloc(1, (size_t)size + 1);
+    assert_non_null(str);
+    assert_int_equal(fread(str, 1, (size_t)size, abort_st.stream), (size_t)size);
+
+    // Running: the flight recorder of the loop is dumped.
+    char *run = strstr(str + 1, "\nABORT in evio_unref()");
+    assert_non_null(run);
+    assert_non_null(strstr(run, "evio flight recorder"));
+    assert_non_null(strstr(run, "ITER"));
+
+    // Not running: nothing is dumped.
+    *run = '\0';
+    assert_non_null(strstr(str, "ABORT in evio_unref()"));
+    assert_null(strstr(str, "evio flight recorder"));
+    free(str);
+
+    evio_test_abort_end(&abort_st);
+    evio_loop_free(loop);
+}
@@ -0,0 +1,267 @@
+#include "test.h"
+
+#include <signal.h>
+#include <sys/resource.h>
+
+#define RELAY_LEN (1024 * 1024)
+
+typedef struct {
+    size_t called;
+    evio_mask emask;
+} relay_cb_data;
+
+static void relay_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    relay_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+}
+
+TEST(test_evio_relay)
+{
+    relay_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int src[2], dst[2];
+    socket_pair(src);
+    socket_pair(dst);
+
+    evio_relay w;
+    evio_relay_init(&w, relay_cb, src[1], dst[0]);
+    w.data = &data;
+    evio_relay_start(loop, &w);
+    assert_true(w.active);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // Double start: no-op
+    evio_relay_start(loop, &w);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    unsigned char *buf = evio_malloc(RELAY_LEN);
+    for (size_t i = 0; i < RELAY_LEN; ++i) {
+        buf[i] = (unsigned char)(i * 31);
+    }
+
+    unsigned char *got = evio_malloc(RELAY_LEN);
+    size_t written = 0, received = 0;
+
+    for (size_t i = 0; i < 100000 && received < RELAY_LEN; ++i) {
+        if (written < RELAY_LEN) {
+            ssize_t n = write(src[0], buf + written, RELAY_LEN - written);
+            if (n > 0) {
+                written += (size_t)n;
+                if (written == RELAY_LEN) {
+                    assert_int_equal(shutdown(src[0], SHUT_WR), 0);
+                }
+            }
+        }
+
+        evio_run(loop, EVIO_RUN_NOWAIT);
+
+        ssize_t n = read(dst[1], got + received, RELAY_LEN - received);
+        if (n > 0) {
+            received += (size_t)n;
+        }
+    }
+
+    assert_int_equal(received, RELAY_LEN);
+    assert_int_equal(memcmp(buf, got, RELAY_LEN), 0);
+
+    // End of file is reported once all data was written.
+    for (size_t i = 0; i < 100 && !data.called; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ);
+    assert_false(w.active);
+    assert_int_equal(evio_relay_bytes(&w), RELAY_LEN);
+    assert_int_equal(evio_relay_error(&w), 0);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // Double stop: no-op
+    evio_relay_stop(loop, &w);
+
+    evio_free(buf);
+    evio_free(got);
+    close(src[0]);
+    close(src[1]);
+    close(dst[0]);
+    close(dst[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_relay_backpressure)
+{
+    relay_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int src[2], dst[2];
+    socket_pair(src);
+    socket_pair(dst);
+
+    evio_relay w;
+    evio_relay_init(&w, relay_cb, src[1], dst[0]);
+    w.data = &data;
+    evio_relay_start(loop, &w);
+
+    // The output is not read: the pipe and the output fill up.
+    static char chunk[64 * 1024];
+    size_t written = 0;
+    for (size_t i = 0; i < 1000; ++i) {
+        ssize_t n = write(src[0], chunk, sizeof(chunk));
+        if (n > 0) {
+            written += (size_t)n;
+        }
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+
+    // The input is no longer read, and only the output is watched.
+    assert_true(w.buffered > 0);
+    assert_true(w.readable);
+    assert_false(w.writable);
+    assert_false(w.in.active);
+    assert_true(w.out.active);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // Draining the output resumes the input.
+    size_t received = 0;
+    for (size_t i = 0; i < 100000 && received < written; ++i) {
+        ssize_t n = read(dst[1], chunk, sizeof(chunk));
+        if (n > 0) {
+            received += (size_t)n;
+        }
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_int_equal(received, written);
+    assert_int_equal(evio_relay_bytes(&w), written);
+
+    // Idle: only the input is watched.
+    assert_int_equal(w.buffered, 0);
+    assert_true(w.in.active);
+    assert_false(w.out.active);
+    assert_int_equal(data.called, 0);
+
+    // Stopping discards nothing pending and releases the pipe.
+    evio_relay_stop(loop, &w);
+    assert_int_equal(w.pipe[0], -1);
+    assert_int_equal(w.pipe[1], -1);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(src[0]);
+    close(src[1]);
+    close(dst[0]);
+    close(dst[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_relay_error)
+{
+    relay_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int src[2], dst[2];
+    socket_pair(src);
+    socket_pair(dst);
+    close(dst[1]);
+
+    // Splicing to a closed socket raises SIGPIPE.
+    void (*old)(int) = signal(SIGPIPE, SIG_IGN);
+
+    evio_relay w;
+    evio_relay_init(&w, relay_cb, src[1], dst[0]);
+    w.data = &data;
+    evio_relay_start(loop, &w);
+
+    assert_int_equal(write(src[0], "hello", 5), 5);
+    for (size_t i = 0; i < 100 && !data.called; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+
+    signal(SIGPIPE, old);
+
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ | EVIO_ERROR);
+    assert_int_equal(evio_relay_error(&w), EPIPE);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(src[0]);
+    close(src[1]);
+    close(dst[0]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_relay_bad_fd)
+{
+    relay_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int dst[2];
+    socket_pair(dst);
+
+    evio_relay w;
+    evio_relay_init(&w, relay_cb, 1000, dst[0]);
+    w.data = &data;
+    evio_relay_start(loop, &w);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ | EVIO_ERROR);
+    assert_int_equal(evio_relay_error(&w), EBADF);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(dst[0]);
+    close(dst[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_relay_pipe_fail)
+{
+    struct rlimit old_lim;
+    // GCOVR_EXCL_START
+    if (getrlimit(RLIMIT_NOFILE, &old_lim) != 0) {
+        TEST_SKIPF("getrlimit");
+    }
+    // GCOVR_EXCL_STOP
+
+    relay_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    // No room for the pipe.
+    int next_fd = dup(0);
+    close(next_fd);
+
+    struct rlimit new_lim;
+    new_lim.rlim_cur = next_fd;
+    new_lim.rlim_max = old_lim.rlim_max;
+
+    // GCOVR_EXCL_START
+    if (setrlimit(RLIMIT_NOFILE, &new_lim) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        evio_loop_free(loop);
+        TEST_SKIPF("setrlimit");
+    }
+    // GCOVR_EXCL_STOP
+
+    evio_relay w;
+    evio_relay_init(&w, relay_cb, fds[0], fds[1]);
+    w.data = &data;
+    evio_relay_start(loop, &w);
+    setrlimit(RLIMIT_NOFILE, &old_lim);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ | EVIO_ERROR);
+    assert_int_equal(evio_relay_error(&w), EMFILE);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
@@ -0,0 +1,478 @@
+#include "test.h"
+
+#include <sys/uio.h>
+
+typedef struct {
+    size_t called;
+    size_t reads;
+    size_t writes;
+    size_t errors;
+    size_t eof;
+    evio_mask emask;
+    int err;
+    bool echo;
+} stream_cb_data;
+
+static void stream_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_stream *w = container_of(base, evio_stream, base);
+    stream_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+
+    if (emask & EVIO_ERROR) {
+        data->errors++;
+        data->err = evio_stream_error(w);
+        return;
+    }
+
+    if (emask & EVIO_WRITE) {
+        data->writes++;
+        return;
+    }
+
+    data->reads++;
+    if (evio_stream_eof(w)) {
+        data->eof++;
+    }
+
+    if (data->echo) {
+        size_t len;
+        void *buf = evio_stream_peek(w, &len);
+        if (len) {
+            evio_stream_write(loop, w, buf, len);
+            evio_stream_consume(loop, w, len);
+        }
+    }
+}
+
+static size_t read_all(int fd, char *buf, size_t size)
+{
+    size_t len = 0;
+    while (len < size) {
+        ssize_t n = read(fd, buf + len, size - len);
+        if (n <= 0) {
+            break;
+        }
+        len += (size_t)n;
+    }
+    return len;
+}
+
+TEST(test_evio_stream)
+{
+    stream_cb_data data = { .echo = true };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_stream w;
+    evio_stream_init(&w, stream_cb, fds[0]);
+    w.data = &data;
+
+    // Writing on an inactive watcher: no-op
+    assert_false(evio_stream_write(loop, &w, "x", 1));
+    evio_stream_flush(loop, &w);
+    assert_int_equal(evio_stream_queued(&w), 0);
+
+    evio_stream_start(loop, &w);
+    assert_true(w.active);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // Double start: no-op
+    evio_stream_start(loop, &w);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // Small writes are queued until the loop is about to block.
+    assert_true(evio_stream_write(loop, &w, "hello ", 6));
+    assert_true(evio_stream_write(loop, &w, "world", 5));
+    assert_true(evio_stream_write(loop, &w, NULL, 0));
+    assert_int_equal(evio_stream_queued(&w), 11);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    char buf[64];
+    assert_int_equal(read(fds[1], buf, sizeof(buf)), -1);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(evio_stream_queued(&w), 0);
+    assert_int_equal(read_all(fds[1], buf, sizeof(buf)), 11);
+    assert_int_equal(memcmp(buf, "hello world", 11), 0);
+
+    // Echo: read, write back, consume
+    assert_int_equal(write(fds[1], "ping", 4), 4);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.reads, 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(read_all(fds[1], buf, sizeof(buf)), 4);
+    assert_int_equal(memcmp(buf, "ping", 4), 0);
+
+    // Unconsumed data is reported again with the next data.
+    data.echo = false;
+    assert_int_equal(write(fds[1], "ab", 2), 2);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(write(fds[1], "cd", 2), 2);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.reads, 3);
+
+    size_t len;
+    char *p = evio_stream_peek(&w, &len);
+    assert_int_equal(len, 4);
+    assert_int_equal(memcmp(p, "abcd", 4), 0);
+    evio_stream_consume(loop, &w, 1);
+    p = evio_stream_peek(&w, &len);
+    assert_int_equal(len, 3);
+    assert_int_equal(memcmp(p, "bcd", 3), 0);
+    evio_stream_consume(loop, &w, 3);
+
+    // The peer closes its side.
+    assert_int_equal(shutdown(fds[1], SHUT_WR), 0);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.eof, 1);
+    assert_true(evio_stream_eof(&w));
+    assert_true(w.active);
+
+    // Writing still works after end of file.
+    evio_stream_write(loop, &w, "bye", 3);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(read_all(fds[1], buf, sizeof(buf)), 3);
+    assert_int_equal(data.errors, 0);
+
+    evio_stream_stop(loop, &w);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // Double stop: no-op
+    evio_stream_stop(loop, &w);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+static void release_cb(void *ctx)
+{
+    ++*(size_t *)ctx;
+}
+
+TEST(test_evio_stream_writev)
+{
+    stream_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_stream w;
+    evio_stream_init(&w, stream_cb, fds[0]);
+    w.data = &data;
+
+    // Inactive: the buffers are released right away.
+    size_t released = 0;
+    char head[] = "head ", tail[] = "tail";
+    struct iovec iov[3] = {
+        { .iov_base = head, .iov_len = 5 },
+        { .iov_base = tail, .iov_len = 0 },
+        { .iov_base = tail, .iov_len = 4 },
+    };
+    assert_false(evio_stream_writev(loop, &w, iov, 3, release_cb, &released));
+    assert_int_equal(released, 1);
+
+    evio_stream_start(loop, &w);
+
+    // Caller-owned buffers are interleaved with copied data.
+    released = 0;
+    evio_stream_write(loop, &w, "<", 1);
+    assert_true(evio_stream_writev(loop, &w, iov, 3, release_cb, &released));
+    evio_stream_write(loop, &w, ">", 1);
+    assert_int_equal(evio_stream_queued(&w), 11);
+    assert_int_equal(released, 0);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(released, 1);
+
+    char buf[64];
+    assert_int_equal(read_all(fds[1], buf, sizeof(buf)), 11);
+    assert_int_equal(memcmp(buf, "<head tail>", 11), 0);
+
+    // Empty buffers are released right away.
+    evio_stream_writev(loop, &w, iov + 1, 1, release_cb, &released);
+    assert_int_equal(released, 2);
+    evio_stream_writev(loop, &w, iov, 1, NULL, NULL);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(read_all(fds[1], buf, sizeof(buf)), 5);
+
+    // Stopping releases unsent buffers.
+    evio_stream_writev(loop, &w, iov, 3, release_cb, &released);
+    evio_stream_stop(loop, &w);
+    assert_int_equal(released, 3);
+    assert_int_equal(evio_stream_queued(&w), 0);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_stream_watermarks)
+{
+    stream_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_stream w;
+    evio_stream_init(&w, stream_cb, fds[0]);
+    w.data = &data;
+    evio_stream_set_watermarks(&w, 64 * 1024, 128 * 1024);
+    assert_int_equal(w.low, 64 * 1024);
+    evio_stream_set_watermarks(&w, 64 * 1024, 16 * 1024);
+    evio_stream_start(loop, &w);
+
+    int sndbuf = 16 * 1024;
+    assert_int_equal(setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)), 0);
+
+    enum { TOTAL = 4 * 1024 * 1024 };
+    char *chunk = evio_malloc(100 * 1024);
+    for (size_t i = 0; i < 100 * 1024; ++i) {
+        chunk[i] = (char)(i % 251);
+    }
+
+    // Small writes fill chunks, a large write takes its own.
+    size_t written = 0;
+    while (evio_stream_write(loop, &w, chunk + written % 251, 1000)) {
+        written += 1000;
+    }
+    written += 1000;
+    assert_true(evio_stream_queued(&w) > 64 * 1024);
+    assert_false(evio_stream_write(loop, &w, chunk, 100 * 1024));
+    written += 100 * 1024;
+
+    // The socket buffer fills up, the rest waits for writability.
+    evio_stream_flush(loop, &w);
+    assert_true(evio_stream_queued(&w) > 0);
+    assert_int_equal(data.writes, 0);
+
+    // Flushing a blocked queue: no-op
+    size_t queued = evio_stream_queued(&w);
+    evio_stream_flush(loop, &w);
+    assert_int_equal(evio_stream_queued(&w), queued);
+
+    char *buf = evio_malloc(TOTAL);
+    size_t received = 0;
+    for (size_t i = 0; i < 10000 && received < written; ++i) {
+        ssize_t n = read(fds[1], buf + received, TOTAL - received);
+        if (n > 0) {
+            received += (size_t)n;
+        }
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+
+    assert_int_equal(received, written);
+    assert_int_equal(evio_stream_queued(&w), 0);
+    assert_int_equal(data.writes, 1);
+    assert_int_equal(data.emask, EVIO_WRITE);
+
+    for (size_t off = 0; off + 1000 < received - 100 * 1024; off += 1000) {
+        assert_int_equal(memcmp(buf + off, chunk + off % 251, 1000), 0);
+    }
+    assert_int_equal(memcmp(buf + received - 100 * 1024, chunk, 100 * 1024), 0);
+
+    evio_stream_stop(loop, &w);
+    evio_free(buf);
+    evio_free(chunk);
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_stream_pause)
+{
+    stream_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_stream w;
+    evio_stream_init(&w, stream_cb, fds[0]);
+    w.data = &data;
+
+    // Pausing before start
+    evio_stream_pause(loop, &w);
+    evio_stream_start(loop, &w);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    assert_int_equal(write(fds[1], "x", 1), 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.reads, 0);
+
+    evio_stream_resume(loop, &w);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.reads, 1);
+
+    evio_stream_pause(loop, &w);
+    assert_int_equal(write(fds[1], "y", 1), 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.reads, 1);
+
+    // A paused stream still writes.
+    evio_stream_write(loop, &w, "z", 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    char buf[4];
+    assert_int_equal(read(fds[1], buf, sizeof(buf)), 1);
+
+    evio_stream_resume(loop, &w);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.reads, 2);
+
+    size_t len;
+    char *p = evio_stream_peek(&w, &len);
+    assert_int_equal(len, 2);
+    assert_int_equal(memcmp(p, "xy", 2), 0);
+
+    evio_stream_stop(loop, &w);
+    evio_stream_resume(loop, &w);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_stream_read_watermark)
+{
+    stream_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_stream w;
+    evio_stream_init(&w, stream_cb, fds[0]);
+    w.data = &data;
+    evio_stream_set_read_watermark(loop, &w, 8);
+    evio_stream_start(loop, &w);
+
+    // Reading pauses with the watermark reached.
+    char buf[64 * 1024];
+    memset(buf, 'x', sizeof(buf));
+    assert_int_equal(write(fds[1], buf, 32), 32);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.reads, 1);
+    assert_false(w.io.active);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    assert_int_equal(write(fds[1], buf, 4), 4);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.reads, 1);
+
+    // Consuming below the watermark resumes it.
+    evio_stream_consume(loop, &w, 24);
+    assert_false(w.io.active);
+    evio_stream_consume(loop, &w, 1);
+    assert_true(w.io.active);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.reads, 2);
+
+    size_t len;
+    (void)evio_stream_peek(&w, &len);
+    assert_int_equal(len, 11);
+    assert_false(w.io.active);
+
+    // The read buffer stays bounded while nothing is consumed.
+    evio_stream_consume(loop, &w, len);
+    evio_stream_set_read_watermark(loop, &w, 16 * 1024);
+    assert_int_equal(write(fds[1], buf, sizeof(buf)), sizeof(buf));
+    for (size_t i = 0; i < 8; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_int_equal(data.reads, 3);
+    assert_true(w.rsize <= 64 * 1024);
+
+    // A pause on top of the watermark is kept.
+    evio_stream_pause(loop, &w);
+    (void)evio_stream_peek(&w, &len);
+    evio_stream_consume(loop, &w, len);
+    assert_false(w.io.active);
+    evio_stream_resume(loop, &w);
+    assert_true(w.io.active);
+
+    evio_stream_stop(loop, &w);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_stream_pipe)
+{
+    stream_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    assert_int_equal(pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+
+    // Non-sockets are written with writev.
+    evio_stream w;
+    evio_stream_init(&w, stream_cb, fds[1]);
+    w.data = &data;
+    evio_stream_start(loop, &w);
+    evio_stream_pause(loop, &w);
+
+    evio_stream_write(loop, &w, "pipe", 4);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_true(w.nosock);
+
+    char buf[8];
+    assert_int_equal(read(fds[0], buf, sizeof(buf)), 4);
+    assert_int_equal(memcmp(buf, "pipe", 4), 0);
+
+    evio_stream_stop(loop, &w);
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_stream_error)
+{
+    stream_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_stream w;
+    evio_stream_init(&w, stream_cb, fds[0]);
+    w.data = &data;
+    evio_stream_start(loop, &w);
+
+    // Writing to a closed peer fails without SIGPIPE.
+    close(fds[1]);
+    evio_stream_write(loop, &w, "x", 1);
+    evio_stream_pause(loop, &w);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    assert_int_equal(data.errors, 1);
+    assert_int_equal(data.emask, EVIO_WRITE | EVIO_ERROR);
+    assert_int_equal(evio_stream_error(&w), EPIPE);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // A bad fd
+    evio_stream_init(&w, stream_cb, 1000);
+    w.data = &data;
+    evio_stream_start(loop, &w);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    assert_int_equal(data.errors, 2);
+    assert_int_equal(data.emask, EVIO_READ | EVIO_ERROR);
+    assert_int_equal(evio_stream_error(&w), EBADF);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fds[0]);
+    evio_loop_free(loop);
+}
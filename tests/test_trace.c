@@ -0,0 +1,212 @@
+#include "test.h"
+
+typedef struct {
+    size_t called;
+    evio_mask emask;
+} generic_cb_data;
+
+static void generic_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    generic_cb_data *data = base->data;
+    data->called++;
+    data->emask = emask;
+}
+
+static void read_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_poll *w = (evio_poll *)base;
+    char buf[16];
+    (void)read(w->fd, buf, sizeof(buf));
+    generic_cb(loop, base, emask);
+}
+
+TEST(test_evio_trace_capture_replay)
+{
+    generic_cb_data io_data = { 0 };
+    generic_cb_data tm_data = { 0 };
+    generic_cb_data as_data = { 0 };
+
+    FILE *stream = tmpfile();
+    assert_non_null(stream);
+
+    int fds[2];
+    assert_int_equal(pipe(fds), 0);
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_poll io;
+    evio_poll_init(&io, read_cb, fds[0], EVIO_READ);
+    io.data = &io_data;
+    evio_poll_start(loop, &io);
+
+    evio_timer tm;
+    evio_timer_init(&tm, generic_cb, EVIO_TIME_FROM_MSEC(1));
+    tm.data = &tm_data;
+    evio_timer_start(loop, &tm, EVIO_TIME_FROM_MSEC(1));
+
+    evio_async as;
+    evio_async_init(&as, generic_cb);
+    as.data = &as_data;
+    evio_async_start(loop, &as);
+
+    evio_trace_start(loop, stream);
+
+    // Double start: no-op
+    evio_trace_start(loop, stream);
+
+    for (int i = 0; i < 3; ++i) {
+        assert_int_equal(write(fds[1], "x", 1), 1);
+        evio_async_send(loop, &as);
+        usleep(2 * 1000);
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+
+    assert_int_equal(evio_trace_stop(loop), 0);
+
+    // Double stop: no-op
+    assert_int_equal(evio_trace_stop(loop), 0);
+
+    assert_int_equal(io_data.called, 3);
+    assert_int_equal(as_data.called, 3);
+    assert_true(tm_data.called >= 1);
+
+    evio_poll_stop(loop, &io);
+    evio_timer_stop(loop, &tm);
+    evio_async_stop(loop, &as);
+    evio_loop_free(loop);
+
+    // Replay into a fresh loop with the same watchers.
+    const size_t tm_called = tm_data.called;
+    memset(&io_data, 0, sizeof(io_data));
+    memset(&tm_data, 0, sizeof(tm_data));
+    memset(&as_data, 0, sizeof(as_data));
+
+    loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_poll_init(&io, generic_cb, fds[0], EVIO_READ);
+    io.data = &io_data;
+    evio_poll_start(loop, &io);
+
+    evio_timer_init(&tm, generic_cb, EVIO_TIME_FROM_MSEC(1));
+    tm.data = &tm_data;
+    evio_timer_start(loop, &tm, EVIO_TIME_FROM_MSEC(1));
+
+    evio_async_init(&as, generic_cb);
+    as.data = &as_data;
+    evio_async_start(loop, &as);
+
+    rewind(stream);
+    clockid_t clock_id = evio_get_clockid(loop);
+    assert_int_equal(evio_trace_replay(loop, stream), 3);
+    assert_int_equal(evio_get_clockid(loop), clock_id);
+
+    assert_int_equal(io_data.called, 3);
+    assert_int_equal(io_data.emask, EVIO_POLL | EVIO_READ);
+    assert_int_equal(as_data.called, 3);
+    assert_int_equal(as_data.emask, EVIO_ASYNC);
+    assert_int_equal(tm_data.called, tm_called);
+
+    evio_poll_stop(loop, &io);
+    evio_timer_stop(loop, &tm);
+    evio_async_stop(loop, &as);
+    evio_loop_free(loop);
+
+    fclose(stream);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(test_evio_trace_signal)
+{
+    generic_cb_data data = { 0 };
+
+    FILE *stream = tmpfile();
+    assert_non_null(stream);
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_signal sig;
+    evio_signal_init(&sig, generic_cb, SIGUSR1);
+    sig.data = &data;
+    evio_signal_start(loop, &sig);
+
+    evio_trace_start(loop, stream);
+
+    kill(getpid(), SIGUSR1);
+    evio_run(loop, EVIO_RUN_ONCE);
+    assert_int_equal(data.called, 1);
+
+    assert_int_equal(evio_trace_stop(loop), 0);
+
+    data.called = 0;
+    rewind(stream);
+    assert_int_equal(evio_trace_replay(loop, stream), 1);
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_SIGNAL);
+
+    evio_signal_stop(loop, &sig);
+    evio_loop_free(loop);
+    fclose(stream);
+}
+
+TEST(test_evio_trace_invalid)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    // Empty stream
+    FILE *stream = tmpfile();
+    assert_non_null(stream);
+    errno = 0;
+    assert_int_equal(evio_trace_replay(loop, stream), -1);
+    assert_int_equal(errno, EINVAL);
+
+    // Unknown record type
+    evio_trace_start(loop, stream);
+    evio_trace_write(loop, 0xFF, 0, 0);
+    assert_int_equal(evio_trace_stop(loop), 0);
+
+    rewind(stream);
+    errno = 0;
+    assert_int_equal(evio_trace_replay(loop, stream), -1);
+    assert_int_equal(errno, EINVAL);
+    fclose(stream);
+
+    // Write failure
+    stream = fopen("/dev/null", "r");
+    assert_non_null(stream);
+    evio_trace_start(loop, stream);
+    assert_int_equal(evio_trace_stop(loop), -1);
+    fclose(stream);
+
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_trace_flush)
+{
+    FILE *stream = tmpfile();
+    assert_non_null(stream);
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_trace_start(loop, stream);
+    for (int i = 0; i < 1000; ++i) {
+        evio_trace_write(loop, EVIO_TRACE_TIME, 0, 0);
+    }
+
+    // Freeing the loop stops the capture
+    evio_loop_free(loop);
+
+    loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    rewind(stream);
+    assert_int_equal(evio_trace_replay(loop, stream), 1000);
+
+    evio_loop_free(loop);
+    fclose(stream);
+}
@@ -1,5 +1,8 @@
 #include "test.h"
 
+#include <dirent.h>
+#include <sys/stat.h>
+
 #include "evio_uring.h"
 #include "evio_uring_sys.h"
 
@@ -519,8 +522,8 @@ TEST(test_evio_poll_uring_autoflush)
     evio_poll io[EVIO_URING_EVENTS];
     int fds[EVIO_URING_EVENTS][2];
 
-    // This loop triggers the auto-flush logic in evio_uring_ctl
-    // when the submission queue becomes full.
+    // This loop fills the submission queue, the rest of the operations
+    // go through the overflow queue of evio_uring_ctl.
     for (size_t i = 0; i < EVIO_URING_EVENTS; ++i) {
         fds[i][0] = fds[i][1] = -1;
         assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]), 0);
@@ -546,6 +549,65 @@ TEST(test_evio_poll_uring_autoflush)
     evio_loop_free(loop);
 }
 
+#define URING_DEPTH_FDS 64
+
+TEST(test_evio_poll_uring_depth)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new_uring(EVIO_FLAG_NONE, 4);
+    assert_non_null(loop);
+
+    // GCOVR_EXCL_START
+    if (!loop->iou) {
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+    }
+    // GCOVR_EXCL_STOP
+
+    evio_poll io[URING_DEPTH_FDS];
+    int fds[URING_DEPTH_FDS][2];
+
+    for (size_t i = 0; i < URING_DEPTH_FDS; ++i) {
+        fds[i][0] = fds[i][1] = -1;
+        assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]), 0);
+        evio_poll_init(&io[i], generic_cb, fds[i][0], EVIO_READ);
+        io[i].data = &data;
+        evio_poll_start(loop, &io[i]);
+        assert_int_equal(write(fds[i][1], "x", 1), 1);
+    }
+
+    // An overflowed ADD is retried as MOD like any other.
+    int fd = fds[URING_DEPTH_FDS - 1][0];
+    evio_uring_test_inject_cqe_res_once(fd, EPOLL_CTL_ADD, -EEXIST);
+
+    // All operations are submitted in batches of the ring depth.
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_uring_test_inject_reset();
+    assert_int_equal(loop->iou_count, 0);
+    assert_int_equal(data.called, URING_DEPTH_FDS);
+
+    // Changes are kept in order: the last mask wins.
+    for (size_t i = 0; i < URING_DEPTH_FDS; ++i) {
+        evio_poll_change(loop, &io[i], fds[i][0], EVIO_WRITE);
+    }
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    for (size_t i = 0; i < URING_DEPTH_FDS; ++i) {
+        evio_poll_change(loop, &io[i], fds[i][0], EVIO_READ);
+    }
+    data.called = 0;
+    data.emask = 0;
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, URING_DEPTH_FDS);
+    assert_int_equal(data.emask & (EVIO_READ | EVIO_WRITE), EVIO_READ);
+
+    for (size_t i = 0; i < URING_DEPTH_FDS; ++i) {
+        evio_poll_stop(loop, &io[i]);
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+    evio_loop_free(loop);
+}
+
 static size_t drain_uring_events_loop(evio_loop *loop, generic_cb_data *data,
                                       size_t expected_calls, size_t loop_limit)
 {
@@ -972,7 +1034,7 @@ TEST(test_evio_uring_probe_epoll_ctl)
 static bool evio_test_uring_supported(void)
 {
     evio_uring_test_probe_reset();
-    evio_uring *iou = evio_uring_new();
+    evio_uring *iou = evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL);
     // GCOVR_EXCL_START
     if (!iou) {
         return false;
@@ -993,7 +1055,7 @@ TEST(test_evio_uring_probe_fail_single_mmap)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(false);
     evio_uring_test_probe_fail_mmap_at(1, ENOMEM);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_single_mmap_default_errno)
@@ -1007,7 +1069,7 @@ TEST(test_evio_uring_probe_fail_single_mmap_default_errno)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(false);
     evio_uring_test_probe_fail_mmap_at(1, 0);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_sq_mmap)
@@ -1021,7 +1083,7 @@ TEST(test_evio_uring_probe_fail_sq_mmap)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(true);
     evio_uring_test_probe_fail_mmap_at(1, ENOMEM);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_cq_mmap)
@@ -1035,7 +1097,7 @@ TEST(test_evio_uring_probe_fail_cq_mmap)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(true);
     evio_uring_test_probe_fail_mmap_at(2, ENOMEM);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_sqe_mmap)
@@ -1049,7 +1111,7 @@ TEST(test_evio_uring_probe_fail_sqe_mmap)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(true);
     evio_uring_test_probe_fail_mmap_at(3, ENOMEM);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_sqe_mmap_single_mmap)
@@ -1063,7 +1125,7 @@ TEST(test_evio_uring_probe_fail_sqe_mmap_single_mmap)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(false);
     evio_uring_test_probe_fail_mmap_at(2, ENOMEM);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_epoll_create)
@@ -1077,7 +1139,7 @@ TEST(test_evio_uring_probe_fail_epoll_create)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(true);
     evio_uring_test_probe_fail_epoll_create_once(EMFILE);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_epoll_create_single_mmap)
@@ -1091,7 +1153,7 @@ TEST(test_evio_uring_probe_fail_epoll_create_single_mmap)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(false);
     evio_uring_test_probe_fail_epoll_create_once(EMFILE);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_epoll_create_default_errno)
@@ -1105,7 +1167,7 @@ TEST(test_evio_uring_probe_fail_epoll_create_default_errno)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(true);
     evio_uring_test_probe_fail_epoll_create_once(0);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_eventfd)
@@ -1119,7 +1181,7 @@ TEST(test_evio_uring_probe_fail_eventfd)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(true);
     evio_uring_test_probe_fail_eventfd_once(EMFILE);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_eventfd_single_mmap)
@@ -1133,7 +1195,7 @@ TEST(test_evio_uring_probe_fail_eventfd_single_mmap)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(false);
     evio_uring_test_probe_fail_eventfd_once(EMFILE);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_eventfd_default_errno)
@@ -1147,7 +1209,7 @@ TEST(test_evio_uring_probe_fail_eventfd_default_errno)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(true);
     evio_uring_test_probe_fail_eventfd_once(0);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_setup_default_errno)
@@ -1160,7 +1222,7 @@ TEST(test_evio_uring_probe_fail_setup_default_errno)
 
     evio_uring_test_probe_reset();
     evio_uring_test_probe_fail_setup_once(0);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_setup_errno)
@@ -1173,32 +1235,32 @@ TEST(test_evio_uring_probe_fail_setup_errno)
 
     evio_uring_test_probe_reset();
     evio_uring_test_probe_fail_setup_once(EPERM);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_unsupported_enosys)
 {
     evio_uring_test_probe_reset();
     evio_uring_test_probe_fail_setup_once(ENOSYS);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_unsupported_enosys_negative)
 {
     evio_uring_test_probe_reset();
     evio_uring_test_probe_fail_setup_once(-ENOSYS);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_setup_fail_branches)
 {
     evio_uring_test_probe_reset();
     evio_uring_test_probe_fail_setup_once(EPERM);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 
     evio_uring_test_probe_reset();
     evio_uring_test_probe_fail_setup_once(ENOSYS);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_enter_ret)
@@ -1211,7 +1273,7 @@ TEST(test_evio_uring_probe_fail_enter_ret)
 
     evio_uring_test_probe_reset();
     evio_uring_test_probe_enter_ret_once(0, 0);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_enter_errno_default)
@@ -1224,7 +1286,7 @@ TEST(test_evio_uring_probe_fail_enter_errno_default)
 
     evio_uring_test_probe_reset();
     evio_uring_test_probe_enter_ret_once(-1, 0);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fail_enter_errno)
@@ -1237,7 +1299,7 @@ TEST(test_evio_uring_probe_fail_enter_errno)
 
     evio_uring_test_probe_reset();
     evio_uring_test_probe_enter_ret_once(-1, EINTR);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_empty_cq)
@@ -1251,7 +1313,7 @@ TEST(test_evio_uring_probe_empty_cq)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_enter_ret_once(1, 0);
     evio_uring_test_probe_force_cq_empty(true);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_fallback_without_register_probe)
@@ -1268,7 +1330,7 @@ TEST(test_evio_uring_probe_fallback_without_register_probe)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_register_probe(true);
 
-    evio_uring *iou = evio_uring_new();
+    evio_uring *iou = evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL);
     assert_non_null(iou);
     evio_uring_free(iou);
 #endif
@@ -1285,7 +1347,7 @@ TEST(test_evio_uring_probe_fallback_on_register_fail)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_fail_register_once(EPERM);
 
-    evio_uring *iou = evio_uring_new();
+    evio_uring *iou = evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL);
     assert_non_null(iou);
     evio_uring_free(iou);
 }
@@ -1321,7 +1383,7 @@ TEST(test_evio_uring_probe_force_einval)
 
     evio_uring_test_probe_reset();
     evio_uring_test_probe_force_cqe_res_once(-EINVAL);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 TEST(test_evio_uring_probe_force_other_error)
@@ -1334,7 +1396,7 @@ TEST(test_evio_uring_probe_force_other_error)
 
     evio_uring_test_probe_reset();
     evio_uring_test_probe_force_cqe_res_once(-EFAULT);
-    assert_null(evio_uring_new());
+    assert_null(evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL));
 }
 
 #ifdef IORING_SETUP_NO_SQARRAY
@@ -1349,7 +1411,7 @@ TEST(test_evio_uring_probe_no_sqarray)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_force_sq_off_array_zero(true);
 
-    evio_uring *iou = evio_uring_new();
+    evio_uring *iou = evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL);
     assert_non_null(iou);
     evio_uring_free(iou);
 }
@@ -1395,8 +1457,870 @@ TEST(test_evio_uring_probe_munmap_cq)
     evio_uring_test_probe_reset();
     evio_uring_test_probe_disable_single_mmap(true);
 
-    evio_uring *iou = evio_uring_new();
+    evio_uring *iou = evio_uring_new(EVIO_FLAG_URING, 0, -1, NULL);
     if (iou) {
         evio_uring_free(iou);
     }
 }
+
+static void uring_roundtrip_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_poll *io = container_of(base, evio_poll, base);
+    generic_cb(loop, base, emask);
+    evio_poll_stop(loop, io);
+}
+
+// No cmocka asserts: also runs on a separate thread.
+static void *uring_roundtrip(void *ptr)
+{
+    evio_loop *loop = ptr;
+    generic_cb_data data = { 0 };
+
+    int fds[2] = { -1, -1 };
+    if (pipe(fds) < 0) {
+        return NULL;
+    }
+
+    evio_poll io;
+    evio_poll_init(&io, generic_cb, fds[0], EVIO_READ);
+    io.data = &data;
+    evio_poll_start(loop, &io);
+
+    if (write(fds[1], "a", 1) == 1) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+
+    evio_poll_stop(loop, &io);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    // A full run enters the ring by the fd registered with this thread.
+    evio_poll_init(&io, uring_roundtrip_cb, fds[0], EVIO_READ);
+    io.data = &data;
+    evio_poll_start(loop, &io);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+
+    close(fds[0]);
+    close(fds[1]);
+    return data.called == 2 ? loop : NULL;
+}
+
+static void *uring_free_thread(void *ptr)
+{
+    evio_loop_free(ptr);
+    return NULL;
+}
+
+TEST(test_evio_uring_single_thread)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING | EVIO_FLAG_SINGLE_THREAD);
+    assert_non_null(loop);
+
+    // GCOVR_EXCL_START
+    if (!loop->iou) {
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+    }
+    // GCOVR_EXCL_STOP
+
+    assert_ptr_equal(uring_roundtrip(loop), loop);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_uring_other_thread)
+{
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    // GCOVR_EXCL_START
+    if (!loop->iou) {
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+    }
+    // GCOVR_EXCL_STOP
+
+    // The ring fd is registered with the running thread for each run only.
+    for (size_t i = 0; i < 4; ++i) {
+        void *ret = NULL;
+        pthread_t thread;
+        assert_int_equal(pthread_create(&thread, NULL, uring_roundtrip, loop), 0);
+        assert_int_equal(pthread_join(thread, &ret), 0);
+        assert_ptr_equal(ret, loop);
+    }
+
+    assert_ptr_equal(uring_roundtrip(loop), loop);
+
+    // Registered once, until unregistered.
+    if (evio_uring_register_ring(loop->iou)) {
+        assert_false(evio_uring_register_ring(loop->iou));
+        evio_uring_unregister_ring(loop->iou);
+    }
+
+    // Freed by another thread than the one that ran it.
+    pthread_t thread;
+    assert_int_equal(pthread_create(&thread, NULL, uring_free_thread, loop), 0);
+    assert_int_equal(pthread_join(thread, NULL), 0);
+}
+
+TEST(test_evio_uring_register_ring_fail)
+{
+    // GCOVR_EXCL_START
+    if (!evio_test_uring_supported()) {
+        TEST_SKIPF("io_uring unsupported by kernel");
+    }
+    // GCOVR_EXCL_STOP
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+    assert_non_null(loop->iou);
+
+    // The ring fd is not registered: entered by its plain fd.
+    evio_uring_test_probe_reset();
+    evio_uring_test_probe_fail_register_once(EBUSY);
+    assert_false(evio_uring_register_ring(loop->iou));
+    evio_uring_test_probe_fail_register_once(EBUSY);
+    assert_ptr_equal(uring_roundtrip(loop), loop);
+    evio_uring_test_probe_reset();
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_uring_sqpoll)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new_sqpoll(EVIO_FLAG_NONE, 0, -1);
+    assert_non_null(loop);
+
+    // GCOVR_EXCL_START
+    if (!loop->iou || !evio_uring_sqpoll(loop->iou)) {
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring SQPOLL unsupported by kernel");
+    }
+    // GCOVR_EXCL_STOP
+
+    assert_ptr_equal(uring_roundtrip(loop), loop);
+
+    int fds[2] = { -1, -1 };
+    assert_int_equal(pipe(fds), 0);
+    assert_int_equal(write(fds[1], "a", 1), 1);
+
+    // Failed operations are retried before the next epoll_wait().
+    evio_uring_test_inject_cqe_res_once(fds[0], EPOLL_CTL_ADD, -EEXIST);
+
+    evio_poll io;
+    evio_poll_init(&io, generic_cb, fds[0], EVIO_READ);
+    io.data = &data;
+    evio_poll_start(loop, &io);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_uring_test_inject_reset();
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask & (EVIO_READ | EVIO_WRITE), EVIO_READ);
+
+    // Errors are reported like without SQPOLL.
+    evio_uring_test_inject_cqe_res_once(fds[0], EPOLL_CTL_MOD, -EBADF);
+    evio_poll_change(loop, &io, fds[0], EVIO_READ | EVIO_WRITE);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_invoke_pending(loop);
+    evio_uring_test_inject_reset();
+    assert_true(data.emask & EVIO_ERROR);
+    assert_false(io.active);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_uring_sqpoll_fallback)
+{
+    // The thread cannot be bound to a CPU that does not exist.
+    evio_loop *loop = evio_loop_new_sqpoll(EVIO_FLAG_NONE, 0, 100000);
+    assert_non_null(loop);
+
+    // GCOVR_EXCL_START
+    if (!loop->iou) {
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+    }
+    // GCOVR_EXCL_STOP
+
+    assert_false(evio_uring_sqpoll(loop->iou));
+    assert_ptr_equal(uring_roundtrip(loop), loop);
+    evio_loop_free(loop);
+}
+
+// Counts the threads of the process, including kernel io_uring threads.
+static size_t uring_task_count(void)
+{
+    DIR *dir = opendir("/proc/self/task");
+    assert_non_null(dir);
+
+    size_t count = 0;
+    for (struct dirent *ent; (ent = readdir(dir));) {
+        count += ent->d_name[0] != '.';
+    }
+
+    closedir(dir);
+    return count;
+}
+
+#define URING_ATTACHED_LOOPS 4
+
+TEST(test_evio_uring_attached)
+{
+    evio_loop *parent = evio_loop_new_sqpoll(EVIO_FLAG_NONE, 0, -1);
+    assert_non_null(parent);
+
+    // GCOVR_EXCL_START
+    if (!parent->iou || !evio_uring_sqpoll(parent->iou)) {
+        evio_loop_free(parent);
+        TEST_SKIPF("io_uring SQPOLL unsupported by kernel");
+    }
+    // GCOVR_EXCL_STOP
+
+    size_t tasks = uring_task_count();
+
+    // Attached loops share the polling thread of the parent.
+    evio_loop *loops[URING_ATTACHED_LOOPS];
+    for (size_t i = 0; i < URING_ATTACHED_LOOPS; ++i) {
+        loops[i] = evio_loop_new_attached(EVIO_FLAG_NONE, 16, parent);
+        assert_non_null(loops[i]);
+        assert_non_null(loops[i]->iou);
+        assert_true(evio_uring_sqpoll(loops[i]->iou));
+    }
+
+    assert_int_equal(uring_task_count(), tasks);
+
+    // Without the parent ring, each loop starts a thread of its own.
+    evio_loop *other = evio_loop_new_sqpoll(EVIO_FLAG_NONE, 16, -1);
+    assert_non_null(other);
+    assert_true(evio_uring_sqpoll(other->iou));
+    assert_int_equal(uring_task_count(), tasks + 1);
+    evio_loop_free(other);
+
+    // The attached loops outlive the parent.
+    evio_loop_free(parent);
+    for (size_t i = 0; i < URING_ATTACHED_LOOPS; ++i) {
+        assert_ptr_equal(uring_roundtrip(loops[i]), loops[i]);
+        evio_loop_free(loops[i]);
+    }
+}
+
+TEST(test_evio_uring_attached_no_sqpoll)
+{
+    evio_loop *parent = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(parent);
+
+    // GCOVR_EXCL_START
+    if (!parent->iou) {
+        evio_loop_free(parent);
+        TEST_SKIPF("io_uring unsupported by kernel");
+    }
+    // GCOVR_EXCL_STOP
+
+    // Without a polling thread to share, SQPOLL is not started either.
+    evio_loop *loop = evio_loop_new_attached(EVIO_FLAG_SQPOLL, 0, parent);
+    assert_non_null(loop);
+    assert_non_null(loop->iou);
+    assert_false(evio_uring_sqpoll(loop->iou));
+    assert_ptr_equal(uring_roundtrip(loop), loop);
+    evio_loop_free(loop);
+
+    // A parent without a ring gives a regular io_uring loop.
+    evio_loop *plain = evio_loop_new(EVIO_FLAG_NONE);
+    loop = evio_loop_new_attached(EVIO_FLAG_NONE, 0, plain);
+    assert_non_null(loop);
+    assert_non_null(loop->iou);
+    assert_ptr_equal(uring_roundtrip(loop), loop);
+    evio_loop_free(loop);
+    evio_loop_free(plain);
+
+    evio_loop_free(parent);
+}
+
+// Counts the accepted connections.
+static void uring_accept_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_accept *w = container_of(base, evio_accept, base);
+    generic_cb_data *data = base->data;
+    data->emask = emask;
+
+    for (int fd; (fd = evio_accept_next(w)) >= 0;) {
+        data->called++;
+        close(fd);
+    }
+}
+
+static void uring_run_until(evio_loop *loop, const size_t *count, size_t want)
+{
+    for (size_t i = 0; i < 100 && *count < want; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+}
+
+TEST(test_evio_accept_uring)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    // GCOVR_EXCL_START
+    if (!loop->iou) {
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+    }
+    // GCOVR_EXCL_STOP
+
+    struct sockaddr_in addr;
+    int lfd = listen_socket(&addr);
+
+    evio_accept w;
+    evio_accept_init(&w, uring_accept_cb, lfd);
+    w.data = &data;
+    evio_accept_start(loop, &w);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    int cfds[3];
+    connect_clients(&addr, cfds, 3);
+    uring_run_until(loop, &data.called, 3);
+    assert_int_equal(data.called, 3);
+    assert_int_equal(data.emask, EVIO_READ);
+
+    // Multishot accept replaces the epoll registration.
+    assert_false(w.io.active);
+
+    // Paused at the fd limit: the retry timer runs instead of the request.
+    w.limit = 0;
+    int more[2];
+    connect_clients(&addr, more, 2);
+    for (size_t i = 0; i < 10 && !w.tm.active; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_true(w.tm.active);
+    assert_false(w.io.active);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    w.limit = INT_MAX;
+    for (size_t i = 0; i < 10 && w.tm.active; ++i) {
+        evio_run(loop, EVIO_RUN_ONCE);
+    }
+    uring_run_until(loop, &data.called, 5);
+    assert_int_equal(data.called, 5);
+
+    // Stopping cancels the request.
+    evio_accept_stop(loop, &w);
+    assert_int_equal(evio_refcount(loop), 0);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    close_clients(cfds, 3);
+    close_clients(more, 2);
+    close(lfd);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_accept_uring_error)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    // Not listening: the accept request fails.
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    assert_true(fd >= 0);
+
+    evio_accept w;
+    evio_accept_init(&w, generic_cb, fd);
+    w.data = &data;
+    evio_accept_start(loop, &w);
+
+    for (size_t i = 0; i < 10 && !data.called; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_int_equal(data.called, 1);
+    assert_true(data.emask & EVIO_ERROR);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    close(fd);
+    evio_loop_free(loop);
+}
+
+typedef struct {
+    size_t released;
+    size_t sent;
+    size_t copied;
+    int err;
+} uring_zsend_data;
+
+// Takes the released buffers.
+static void uring_zsend_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_zsend *w = container_of(base, evio_zsend, base);
+    uring_zsend_data *data = base->data;
+
+    for (evio_zsend_done done; evio_zsend_next(w, &done);) {
+        data->released++;
+        data->sent += done.sent;
+        data->copied += done.copied;
+        if (done.err) {
+            data->err = done.err;
+        }
+    }
+}
+
+// Runs the loop until `count` buffers are released, reading from `peer`.
+static void uring_zsend_run(evio_loop *loop, uring_zsend_data *data, size_t count, int peer)
+{
+    static char buf[64 * 1024];
+    for (size_t i = 0; i < 10000 && data->released < count; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+        while (peer >= 0 && read(peer, buf, sizeof(buf)) > 0) {}
+    }
+}
+
+TEST(test_evio_zsend_uring)
+{
+    enum { LEN = 256 * 1024 };
+    uring_zsend_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    if (!loop->iou) {
+        // GCOVR_EXCL_START
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+        // GCOVR_EXCL_STOP
+    }
+
+    int fds[2];
+    tcp_pair(fds);
+
+    char *buf = evio_malloc(LEN);
+    memset(buf, 'x', LEN);
+
+    // Each buffer is one IORING_OP_SEND_ZC request.
+    evio_zsend w;
+    evio_zsend_init(&w, uring_zsend_cb, fds[0]);
+    w.data = &data;
+    evio_zsend_start(loop, &w);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_zsend_write(loop, &w, buf, LEN, NULL);
+    evio_zsend_write(loop, &w, buf, LEN, NULL);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    uring_zsend_run(loop, &data, 2, fds[1]);
+    assert_int_equal(data.released, 2);
+    assert_int_equal(data.sent, 2 * LEN);
+    assert_int_equal(data.err, 0);
+    assert_int_equal(evio_zsend_pending(&w), 0);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // Stopping with requests in flight drops them without a callback.
+    for (size_t i = 0; i < 64; ++i) {
+        evio_zsend_write(loop, &w, buf, LEN, NULL);
+    }
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_true(evio_zsend_pending(&w) > 0);
+
+    evio_zsend_stop(loop, &w);
+    assert_int_equal(evio_zsend_pending(&w), 0);
+    assert_int_equal(evio_refcount(loop), 0);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.released, 2);
+
+    // The canceled requests complete once the socket is closed.
+    close(fds[0]);
+    close(fds[1]);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_loop_free(loop);
+    evio_free(buf);
+}
+
+TEST(test_evio_zsend_uring_fallback)
+{
+    uring_zsend_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    if (!loop->iou) {
+        // GCOVR_EXCL_START
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+        // GCOVR_EXCL_STOP
+    }
+
+    int fds[2];
+    socket_pair(fds);
+
+    // No zero-copy on unix sockets: the data is copied instead.
+    evio_zsend w;
+    evio_zsend_init(&w, uring_zsend_cb, fds[0]);
+    w.data = &data;
+    evio_zsend_start(loop, &w);
+
+    evio_zsend_write(loop, &w, "hello", 5, NULL);
+    uring_zsend_run(loop, &data, 1, -1);
+    assert_int_equal(data.released, 1);
+    assert_int_equal(data.sent, 5);
+    assert_int_equal(data.copied, 1);
+    assert_int_equal(data.err, 0);
+
+    char buf[8];
+    assert_int_equal(read(fds[1], buf, sizeof(buf)), 5);
+    assert_int_equal(memcmp(buf, "hello", 5), 0);
+
+    // A closed peer fails the send.
+    close(fds[1]);
+    evio_zsend_write(loop, &w, "world", 5, NULL);
+    uring_zsend_run(loop, &data, 2, -1);
+    assert_int_equal(data.released, 2);
+    assert_int_equal(data.sent, 5);
+    assert_int_equal(data.err, EPIPE);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_zsend_stop(loop, &w);
+    close(fds[0]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_relay_uring)
+{
+    enum { LEN = 256 * 1024 };
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    if (!loop->iou) {
+        // GCOVR_EXCL_START
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+        // GCOVR_EXCL_STOP
+    }
+
+    int src[2], dst[2];
+    socket_pair(src);
+    socket_pair(dst);
+
+    // The relay polls both ends through io_uring poll requests.
+    evio_relay w;
+    evio_relay_init(&w, generic_cb, src[1], dst[0]);
+    w.data = &data;
+    evio_relay_start(loop, &w);
+
+    unsigned char *buf = evio_malloc(LEN);
+    unsigned char *got = evio_malloc(LEN);
+    for (size_t i = 0; i < LEN; ++i) {
+        buf[i] = (unsigned char)(i * 31);
+    }
+
+    size_t written = 0, received = 0;
+    for (size_t i = 0; i < 100000 && received < LEN; ++i) {
+        if (written < LEN) {
+            ssize_t n = write(src[0], buf + written, LEN - written);
+            if (n > 0 && (written += (size_t)n) == LEN) {
+                assert_int_equal(shutdown(src[0], SHUT_WR), 0);
+            }
+        }
+
+        evio_run(loop, EVIO_RUN_NOWAIT);
+
+        ssize_t n = read(dst[1], got + received, LEN - received);
+        if (n > 0) {
+            received += (size_t)n;
+        }
+    }
+    assert_int_equal(received, LEN);
+    assert_int_equal(memcmp(buf, got, LEN), 0);
+
+    for (size_t i = 0; i < 100 && !data.called; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_READ);
+    assert_int_equal(evio_relay_bytes(&w), LEN);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_free(buf);
+    evio_free(got);
+    close(src[0]);
+    close(src[1]);
+    close(dst[0]);
+    close(dst[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_fs_uring)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    if (!loop->iou) {
+        // GCOVR_EXCL_START
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+        // GCOVR_EXCL_STOP
+    }
+
+    char path[] = "/tmp/evio_fs_XXXXXX";
+    int tmp = mkstemp(path);
+    assert_true(tmp >= 0);
+    close(tmp);
+
+    evio_fs w;
+    evio_fs_init(&w, generic_cb);
+    w.data = &data;
+
+    evio_fs_open(loop, &w, path, O_RDWR | O_TRUNC | O_CLOEXEC, 0);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(data.emask, EVIO_READ);
+    int fd = (int)evio_fs_result(&w);
+    assert_true(fd >= 0);
+
+    evio_fs_write(loop, &w, fd, "hello world", 11, 0);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(data.emask, EVIO_WRITE);
+    assert_int_equal(evio_fs_result(&w), 11);
+
+    evio_fs_fsync(loop, &w, fd, true);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(evio_fs_result(&w), 0);
+
+    struct statx st;
+    evio_fs_statx(loop, &w, fd, "", AT_EMPTY_PATH, STATX_SIZE, &st);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(evio_fs_result(&w), 0);
+    assert_int_equal(st.stx_size, 11);
+
+    char buf[16];
+    evio_fs_read(loop, &w, fd, buf, sizeof(buf), 6);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(evio_fs_result(&w), 5);
+    assert_int_equal(memcmp(buf, "world", 5), 0);
+
+    evio_fs_close(loop, &w, fd);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(evio_fs_result(&w), 0);
+    assert_int_equal(data.called, 6);
+
+    // Errors are results too.
+    evio_fs_open(loop, &w, "/nonexistent/evio_fs", O_RDONLY | O_CLOEXEC, 0);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(evio_fs_result(&w), -ENOENT);
+
+    evio_fs_write(loop, &w, -1, "x", 1, -1);
+    evio_run(loop, EVIO_RUN_DEFAULT);
+    assert_int_equal(evio_fs_result(&w), -EBADF);
+    assert_int_equal(data.called, 8);
+
+    // All of them went through the ring, not the thread pool.
+    assert_null(loop->fsq);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    unlink(path);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_fs_uring_stop)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    int fds[2];
+    assert_int_equal(pipe(fds), 0);
+
+    evio_fs w;
+    evio_fs_init(&w, generic_cb);
+    w.data = &data;
+
+    char buf[4];
+    evio_fs_read(loop, &w, fds[0], buf, sizeof(buf), -1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+
+    // The pending read is canceled.
+    evio_fs_stop(loop, &w);
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 0);
+
+    // A canceled open closes its file.
+    evio_fs_open(loop, &w, "/dev/null", O_RDONLY | O_CLOEXEC, 0);
+    evio_fs_stop(loop, &w);
+    assert_int_equal(data.called, 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_cork_uring)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    if (!loop->iou) {
+        // GCOVR_EXCL_START
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+        // GCOVR_EXCL_STOP
+    }
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_cork w;
+    evio_cork_init(&w, generic_cb, fds[0]);
+    w.data = &data;
+
+    // The corked data goes out in one send request at the end of the iteration.
+    evio_cork_write(loop, &w, "hello", 5);
+    evio_cork_write(loop, &w, "world", 5);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_non_null(w.op);
+
+    // Its completion is reaped by the next iteration.
+    for (size_t i = 0; i < 100 && w.active; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_false(w.active);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    char buf[16];
+    assert_int_equal(read(fds[1], buf, sizeof(buf)), 10);
+    assert_int_equal(memcmp(buf, "helloworld", 10), 0);
+
+    // More than the socket holds: the request is retried after the peer reads.
+    int sndbuf = 16 * 1024;
+    assert_int_equal(setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)), 0);
+
+    enum { TOTAL = 1024 * 1024 };
+    char *out = evio_malloc(TOTAL);
+    char *in = evio_malloc(TOTAL);
+    for (size_t i = 0; i < TOTAL; ++i) {
+        out[i] = (char)(i % 251);
+    }
+    evio_cork_write(loop, &w, out, TOTAL);
+
+    size_t received = 0;
+    for (size_t i = 0; i < 100000 && received < TOTAL; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+        ssize_t n = read(fds[1], in + received, TOTAL - received);
+        if (n > 0) {
+            received += (size_t)n;
+        }
+    }
+    assert_int_equal(received, TOTAL);
+    assert_int_equal(memcmp(in, out, TOTAL), 0);
+
+    // Stopping with a request in flight leaves its buffer to the completion.
+    evio_cork_write(loop, &w, out, TOTAL);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_cork_stop(loop, &w);
+    assert_false(w.active);
+    assert_null(w.op);
+    assert_int_equal(evio_refcount(loop), 0);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, 0);
+
+    evio_free(in);
+    evio_free(out);
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_cork_uring_error)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    if (!loop->iou) {
+        // GCOVR_EXCL_START
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+        // GCOVR_EXCL_STOP
+    }
+
+    // The send request fails on a pipe, which is then written directly.
+    int fds[2];
+    assert_int_equal(pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+
+    evio_cork w;
+    evio_cork_init(&w, generic_cb, fds[1]);
+    w.data = &data;
+    evio_cork_write(loop, &w, "pipe", 4);
+
+    for (size_t i = 0; i < 100 && w.active; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_false(w.active);
+    assert_true(w.nosock);
+
+    char buf[8];
+    assert_int_equal(read(fds[0], buf, sizeof(buf)), 4);
+    assert_int_equal(memcmp(buf, "pipe", 4), 0);
+    evio_cork_stop(loop, &w);
+    close(fds[0]);
+    close(fds[1]);
+
+    // A closed peer fails the send request without SIGPIPE.
+    socket_pair(fds);
+    close(fds[1]);
+    evio_cork_init(&w, generic_cb, fds[0]);
+    w.data = &data;
+    evio_cork_write(loop, &w, "x", 1);
+
+    for (size_t i = 0; i < 100 && w.active; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+    }
+    assert_int_equal(data.called, 1);
+    assert_int_equal(data.emask, EVIO_WRITE | EVIO_ERROR);
+    assert_int_equal(evio_cork_error(&w), EPIPE);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_cork_stop(loop, &w);
+    close(fds[0]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_poll_exclusive_uring)
+{
+    generic_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_URING);
+    assert_non_null(loop);
+
+    if (!loop->iou) {
+        // GCOVR_EXCL_START
+        evio_loop_free(loop);
+        TEST_SKIPF("io_uring unsupported by kernel");
+        // GCOVR_EXCL_STOP
+    }
+
+    int sv[2];
+    socket_pair(sv);
+
+    evio_poll io;
+    evio_poll_init(&io, generic_cb, sv[0], EVIO_READ | EVIO_EXCLUSIVE);
+    io.data = &data;
+    evio_poll_start(loop, &io);
+
+    assert_int_equal(write(sv[1], "x", 1), 1);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(loop->fds.ptr[sv[0]].emask, EVIO_READ | EVIO_EXCLUSIVE);
+    assert_int_equal(data.called, 1);
+
+    // The re-registration (delete and add) goes through the ring.
+    evio_poll_change(loop, &io, sv[0], EVIO_READ | EVIO_WRITE | EVIO_EXCLUSIVE);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(loop->fds.ptr[sv[0]].emask, EVIO_READ | EVIO_WRITE | EVIO_EXCLUSIVE);
+    assert_int_equal(data.called, 2);
+    assert_true(data.emask & EVIO_WRITE);
+
+    evio_poll_stop(loop, &io);
+    evio_loop_free(loop);
+    close(sv[0]);
+    close(sv[1]);
+}
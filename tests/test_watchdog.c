@@ -0,0 +1,111 @@
+#include "test.h"
+
+typedef struct {
+    _Atomic size_t called;
+    _Atomic(evio_cb) cb;
+    _Atomic evio_time elapsed;
+} watchdog_data;
+
+static void watchdog_cb(evio_loop *loop, evio_cb cb, evio_time elapsed, void *ctx)
+{
+    watchdog_data *data = ctx;
+    atomic_store(&data->cb, cb);
+    atomic_store(&data->elapsed, elapsed);
+    atomic_fetch_add(&data->called, 1);
+}
+
+static void stall_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    usleep(200 * 1000);
+}
+
+static void nested_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    usleep(200 * 1000);
+}
+
+static void stop_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    evio_watchdog_stop(loop);
+}
+
+TEST(test_evio_watchdog_stall)
+{
+    watchdog_data data = { 0 };
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_watchdog_start(loop, EVIO_TIME_FROM_MSEC(20), watchdog_cb, &data);
+
+    // Double start: no-op
+    evio_watchdog_start(loop, EVIO_TIME_FROM_MSEC(20), watchdog_cb, NULL);
+
+    evio_timer tm;
+    evio_timer_init(&tm, stall_cb, 0);
+    evio_timer_start(loop, &tm, 0);
+
+    evio_run(loop, EVIO_RUN_DEFAULT);
+
+    // Reported once per stall
+    assert_int_equal(atomic_load(&data.called), 1);
+    assert_true(atomic_load(&data.cb) == stall_cb);
+    assert_true(atomic_load(&data.elapsed) >= EVIO_TIME_FROM_MSEC(20));
+
+    evio_watchdog_stop(loop);
+
+    // Double stop: no-op
+    evio_watchdog_stop(loop);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_watchdog_nested)
+{
+    watchdog_data data = { 0 };
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_watchdog_start(loop, EVIO_TIME_FROM_MSEC(20), watchdog_cb, &data);
+
+    evio_timer tm;
+    evio_timer_init(&tm, nested_cb, 0);
+    evio_timer_start(loop, &tm, 0);
+
+    evio_run(loop, EVIO_RUN_DEFAULT);
+
+    // The outer callback is still attributed after the nested run returns
+    assert_int_equal(atomic_load(&data.called), 1);
+    assert_true(atomic_load(&data.cb) == nested_cb);
+
+    // Freeing the loop stops the watchdog
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_watchdog_idle)
+{
+    watchdog_data data = { 0 };
+
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+    assert_non_null(loop);
+
+    evio_watchdog_start(loop, EVIO_TIME_FROM_MSEC(20), watchdog_cb, &data);
+
+    // Outside evio_run: not a stall
+    usleep(100 * 1000);
+
+    // Blocked in epoll: not a stall
+    evio_timer tm;
+    evio_timer_init(&tm, stop_cb, 0);
+    evio_timer_start(loop, &tm, EVIO_TIME_FROM_MSEC(100));
+
+    evio_run(loop, EVIO_RUN_DEFAULT);
+
+    assert_int_equal(atomic_load(&data.called), 0);
+
+    // Stopped from a loop callback
+    assert_null(loop->wd);
+
+    evio_loop_free(loop);
+}
@@ -0,0 +1,212 @@
+#include "test.h"
+
+#define ZSEND_LEN (256 * 1024)
+
+typedef struct {
+    size_t called;
+    size_t released;
+    size_t sent;
+    size_t copied;
+    int err;
+    evio_mask emask;
+} zsend_cb_data;
+
+static void zsend_cb(evio_loop *loop, evio_base *base, evio_mask emask)
+{
+    zsend_cb_data *data = base->data;
+    data->called++;
+    data->emask |= emask;
+
+    evio_zsend *w = container_of(base, evio_zsend, base);
+    for (evio_zsend_done done; evio_zsend_next(w, &done);) {
+        data->released++;
+        data->sent += done.sent;
+        data->copied += done.copied;
+        if (done.err) {
+            data->err = done.err;
+        }
+    }
+}
+
+static size_t drain(int fd)
+{
+    static char buf[64 * 1024];
+    size_t total = 0;
+    for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0;) {
+        total += (size_t)n;
+    }
+    return total;
+}
+
+static void run_until_released(evio_loop *loop, zsend_cb_data *data, size_t count, int peer)
+{
+    for (size_t i = 0; i < 10000 && data->released < count; ++i) {
+        evio_run(loop, EVIO_RUN_NOWAIT);
+        if (peer >= 0) {
+            drain(peer);
+        }
+    }
+}
+
+TEST(test_evio_zsend)
+{
+    zsend_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    tcp_pair(fds);
+
+    char *buf = evio_malloc(ZSEND_LEN);
+    memset(buf, 'x', ZSEND_LEN);
+
+    evio_zsend w;
+    evio_zsend_init(&w, zsend_cb, fds[0]);
+    w.data = &data;
+    evio_zsend_start(loop, &w);
+
+    // Double start: no-op
+    evio_zsend_start(loop, &w);
+
+    // Idle watchers do not keep the loop alive.
+    assert_int_equal(evio_refcount(loop), 0);
+
+    evio_zsend_write(loop, &w, buf, ZSEND_LEN, NULL);
+    evio_zsend_write(loop, &w, buf, ZSEND_LEN, NULL);
+    evio_zsend_write(loop, &w, buf, 0, NULL);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    run_until_released(loop, &data, 3, fds[1]);
+    assert_int_equal(data.released, 3);
+    assert_int_equal(data.sent, 2 * ZSEND_LEN);
+    assert_int_equal(data.err, 0);
+    assert_true(data.emask & EVIO_WRITE);
+    assert_false(data.emask & EVIO_ERROR);
+    assert_int_equal(evio_zsend_pending(&w), 0);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // Nothing released
+    evio_zsend_done done;
+    assert_false(evio_zsend_next(&w, &done));
+
+    evio_zsend_stop(loop, &w);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // Double stop: no-op
+    evio_zsend_stop(loop, &w);
+
+    evio_free(buf);
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_zsend_copy)
+{
+    zsend_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+
+    evio_zsend w;
+    evio_zsend_init(&w, zsend_cb, fds[0]);
+    w.data = &data;
+    evio_zsend_start(loop, &w);
+
+    // No zero-copy support: the data is copied and released right away.
+    evio_zsend_write(loop, &w, "hello", 5, &data);
+    run_until_released(loop, &data, 1, -1);
+    assert_int_equal(data.released, 1);
+    assert_int_equal(data.sent, 5);
+    assert_int_equal(data.copied, 1);
+    assert_int_equal(data.err, 0);
+
+    char buf[8];
+    assert_int_equal(read(fds[1], buf, sizeof(buf)), 5);
+    assert_int_equal(memcmp(buf, "hello", 5), 0);
+
+    evio_zsend_stop(loop, &w);
+    close(fds[0]);
+    close(fds[1]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_zsend_error)
+{
+    zsend_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    socket_pair(fds);
+    close(fds[1]);
+
+    evio_zsend w;
+    evio_zsend_init(&w, zsend_cb, fds[0]);
+    w.data = &data;
+    evio_zsend_start(loop, &w);
+
+    evio_zsend_write(loop, &w, "hello", 5, NULL);
+    run_until_released(loop, &data, 1, -1);
+    assert_int_equal(data.released, 1);
+    assert_int_equal(data.sent, 0);
+    assert_int_equal(data.err, EPIPE);
+    assert_true(data.emask & EVIO_ERROR);
+
+    // Buffers written after a failure are released with the error.
+    data.err = 0;
+    evio_zsend_write(loop, &w, "world", 5, NULL);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.released, 2);
+    assert_int_equal(data.err, EPIPE);
+    assert_int_equal(evio_refcount(loop), 0);
+
+    // Restarting clears the error.
+    evio_zsend_stop(loop, &w);
+    evio_zsend_start(loop, &w);
+    assert_int_equal(w.err, 0);
+
+    evio_zsend_stop(loop, &w);
+    close(fds[0]);
+    evio_loop_free(loop);
+}
+
+TEST(test_evio_zsend_stop_queued)
+{
+    zsend_cb_data data = { 0 };
+    evio_loop *loop = evio_loop_new(EVIO_FLAG_NONE);
+
+    int fds[2];
+    tcp_pair(fds);
+
+    char *buf = evio_malloc(ZSEND_LEN);
+    memset(buf, 'x', ZSEND_LEN);
+
+    evio_zsend w;
+    evio_zsend_init(&w, zsend_cb, fds[0]);
+    w.data = &data;
+    evio_zsend_start(loop, &w);
+
+    // More than the socket buffers hold, with the peer not reading.
+    for (size_t i = 0; i < 64; ++i) {
+        evio_zsend_write(loop, &w, buf, ZSEND_LEN, NULL);
+    }
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_true(evio_zsend_pending(&w) > 0);
+    assert_int_equal(evio_refcount(loop), 1);
+
+    // Buffers not released are dropped without a callback.
+    size_t called = data.called;
+    evio_zsend_stop(loop, &w);
+    assert_int_equal(evio_zsend_pending(&w), 0);
+    assert_int_equal(evio_refcount(loop), 0);
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    assert_int_equal(data.called, called);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    // Requests still held by the kernel complete after the socket is closed.
+    evio_run(loop, EVIO_RUN_NOWAIT);
+    evio_loop_free(loop);
+    evio_free(buf);
+}